@@ -0,0 +1,296 @@
+#include "adaptive_stream.h"
+#include "camera_probe.h"
+#include "client_congestion.h"
+
+#define ADAPTIVE_STATE_KEY "adaptive-stream"
+
+enum {
+    BRANCH_MAIN = 0,
+    BRANCH_SUB = 1
+};
+
+typedef struct {
+    gchar *camera_name;
+    GstElement *selector;
+    GstPad *pads[2];
+    gint current;             /* atomic, nhánh đang phát */
+    gint target;              /* atomic, nhánh muốn chuyển tới (chờ keyframe) */
+
+    /* unprepared chạy trên thread pool RTSP còn timer chạy trên main context: state có refcount
+     * (pipeline + timer), media chỉ được dùng khi giữ lock và bị xóa khi unprepare */
+    GMutex lock;
+    GSource *timer;
+    GstRTSPMedia *media;
+
+    /* Chỉ truy cập từ timer */
+    gint64 last_switch_us;
+    gint64 good_since_us;
+    guint up_hold_sec;
+    guint switches;
+} AdaptiveState;
+
+/* Chỉ số mạng của một lần đo, -1 = không có */
+typedef struct {
+    gint loss_percent;
+    gint rtt_ms;
+    gint jitter_ms;
+    gint sendq_percent;
+} AdaptiveMetrics;
+
+gboolean adaptive_stream_supported(const CameraConfig *cam) {
+    CodecType main_codec = camera_resolve_codec(cam, TRUE);
+    CodecType sub_codec = camera_resolve_codec(cam, FALSE);
+    return main_codec == sub_codec && (main_codec == CODEC_H264 || main_codec == CODEC_H265);
+}
+
+gchar* adaptive_stream_launch_desc(const CameraConfig *cam,
+                                   const gchar *src_desc,
+                                   const gchar *sendq_desc) {
+    const gchar *codec = camera_resolve_codec(cam, TRUE) == CODEC_H265 ? "h265" : "h264";
+
+    /* Nhánh không active bị input-selector bỏ ngay (sync-streams=false).
+     * config-interval=-1: mỗi IDR có SPS/PPS, client nhận cấu hình mới khi đổi độ phân giải */
+    return g_strdup_printf(
+        "rtspsrc location=%s protocols=tcp %s ! "
+        "rtp%sdepay ! %sparse config-interval=-1 ! " ADAPTIVE_SELECTOR_NAME ".sink_0 "
+        "rtspsrc location=%s protocols=tcp %s ! "
+        "rtp%sdepay ! %sparse config-interval=-1 ! " ADAPTIVE_SELECTOR_NAME ".sink_1 "
+        "input-selector name=" ADAPTIVE_SELECTOR_NAME " sync-streams=false cache-buffers=false ! "
+        "%s ! rtp%spay name=pay0 pt=96 config-interval=-1 mtu=1400",
+        cam->rtsp_url_main, src_desc, codec, codec,
+        cam->rtsp_url_sub, src_desc, codec, codec,
+        sendq_desc, codec);
+}
+
+static void adaptive_state_clear(gpointer data) {
+    AdaptiveState *state = data;
+    for (gint i = 0; i < 2; i++) {
+        if (state->pads[i]) gst_object_unref(state->pads[i]);
+    }
+    if (state->selector) gst_object_unref(state->selector);
+    if (state->timer) g_source_unref(state->timer);
+    g_mutex_clear(&state->lock);
+    g_free(state->camera_name);
+}
+
+static void adaptive_state_unref(gpointer data) {
+    g_atomic_rc_box_release_full(data, adaptive_state_clear);
+}
+
+static const gchar* branch_name(gint branch) {
+    return branch == BRANCH_MAIN ? "main" : "sub";
+}
+
+/* Chuyển nhánh chỉ tại keyframe của nhánh đích: client không thấy frame hỏng */
+static GstPadProbeReturn selector_sink_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    AdaptiveState *state = user_data;
+    gint branch = pad == state->pads[BRANCH_MAIN] ? BRANCH_MAIN : BRANCH_SUB;
+
+    if (g_atomic_int_get(&state->target) != branch || g_atomic_int_get(&state->current) == branch) {
+        return GST_PAD_PROBE_OK;
+    }
+
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    if (GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DELTA_UNIT)) {
+        return GST_PAD_PROBE_OK;
+    }
+
+    g_object_set(state->selector, "active-pad", pad, NULL);
+    g_atomic_int_set(&state->current, branch);
+    g_print("[adaptive] %s: switched to %s stream at keyframe\n", state->camera_name, branch_name(branch));
+    return GST_PAD_PROBE_OK;
+}
+
+void adaptive_stream_prepare(GstElement *pipeline, const gchar *camera_name) {
+    GstElement *selector = gst_bin_get_by_name(GST_BIN(pipeline), ADAPTIVE_SELECTOR_NAME);
+    if (!selector) return;
+
+    AdaptiveState *state = g_atomic_rc_box_new0(AdaptiveState);
+    g_mutex_init(&state->lock);
+    state->camera_name = g_strdup(camera_name);
+    state->selector = selector;
+    state->pads[BRANCH_MAIN] = gst_element_get_static_pad(selector, "sink_0");
+    state->pads[BRANCH_SUB] = gst_element_get_static_pad(selector, "sink_1");
+    state->current = BRANCH_SUB;
+    state->target = BRANCH_SUB;
+    state->up_hold_sec = ADAPTIVE_UP_HOLD_SEC;
+
+    if (!state->pads[BRANCH_MAIN] || !state->pads[BRANCH_SUB]) {
+        g_printerr("[adaptive] %s: selector pads missing\n", camera_name);
+        adaptive_state_unref(state);
+        return;
+    }
+
+    /* Bắt đầu bằng sub: client ở xa không bị stall ngay từ đầu */
+    g_object_set(selector, "active-pad", state->pads[BRANCH_SUB], NULL);
+
+    for (gint i = 0; i < 2; i++) {
+        gst_pad_add_probe(state->pads[i], GST_PAD_PROBE_TYPE_BUFFER, selector_sink_probe, state, NULL);
+    }
+
+    g_object_set_data_full(G_OBJECT(pipeline), ADAPTIVE_STATE_KEY, state, adaptive_state_unref);
+}
+
+/* Report block do client gửi (RTCP RR) nằm trong stats của source nội bộ (sender) */
+static void read_rtcp_metrics(GstRTSPMedia *media, AdaptiveMetrics *metrics) {
+    GstRTSPStream *stream = gst_rtsp_media_n_streams(media) > 0 ? gst_rtsp_media_get_stream(media, 0) : NULL;
+    if (!stream) return;
+
+    GObject *session = gst_rtsp_stream_get_rtpsession(stream);
+    if (!session) return;
+
+    GstStructure *stats = NULL;
+    g_object_get(session, "stats", &stats, NULL);
+    g_object_unref(session);
+    if (!stats) return;
+
+    const GValue *sources = gst_structure_get_value(stats, "source-stats");
+    guint clock_rate = 90000;
+
+    for (guint i = 0; sources && i < gst_value_array_get_size(sources); i++) {
+        const GstStructure *source = gst_value_get_structure(gst_value_array_get_value(sources, i));
+        gboolean internal = FALSE, have_rb = FALSE;
+        guint fraction_lost = 0, jitter = 0, round_trip = 0;
+        gint rate = 0;
+
+        gst_structure_get_boolean(source, "internal", &internal);
+        gst_structure_get_boolean(source, "have-rb", &have_rb);
+        if (!internal || !have_rb) continue;
+
+        gst_structure_get_uint(source, "rb-fractionlost", &fraction_lost);
+        gst_structure_get_uint(source, "rb-jitter", &jitter);
+        gst_structure_get_uint(source, "rb-round-trip", &round_trip);
+        if (gst_structure_get_int(source, "clock-rate", &rate) && rate > 0) clock_rate = rate;
+
+        metrics->loss_percent = (gint)(fraction_lost * 100 / 256);
+        metrics->jitter_ms = (gint)((guint64)jitter * 1000 / clock_rate);
+        /* round-trip: 1/65536 giây; 0 = client chưa có LSR/DLSR */
+        metrics->rtt_ms = round_trip > 0 ? (gint)(((guint64)round_trip * 1000) >> 16) : -1;
+        break;
+    }
+
+    gst_structure_free(stats);
+}
+
+static void read_sendq_metrics(GstRTSPMedia *media, AdaptiveMetrics *metrics) {
+    GstElement *element = gst_rtsp_media_get_element(media);
+    if (!element) return;
+
+    GstElement *queue = gst_bin_get_by_name(GST_BIN(element), CLIENT_SENDQ_NAME);
+    if (queue) {
+        guint64 level = 0, max_time = 0;
+        guint level_bytes = 0, max_bytes = 0;
+        g_object_get(queue,
+                     "current-level-time", &level, "max-size-time", &max_time,
+                     "current-level-bytes", &level_bytes, "max-size-bytes", &max_bytes,
+                     NULL);
+
+        gint percent = 0;
+        if (max_time > 0) percent = MAX(percent, (gint)(level * 100 / max_time));
+        if (max_bytes > 0) percent = MAX(percent, (gint)((guint64)level_bytes * 100 / max_bytes));
+        metrics->sendq_percent = percent;
+        gst_object_unref(queue);
+    }
+    gst_object_unref(element);
+}
+
+static gboolean metrics_bad(const AdaptiveMetrics *m) {
+    return m->loss_percent >= ADAPTIVE_DOWN_LOSS_PERCENT ||
+           m->rtt_ms >= ADAPTIVE_DOWN_RTT_MS ||
+           m->jitter_ms >= ADAPTIVE_DOWN_JITTER_MS ||
+           m->sendq_percent >= ADAPTIVE_DOWN_SENDQ_PERCENT;
+}
+
+/* Chỉ số không có (-1) không chặn việc lên main, trừ send queue (luôn có) */
+static gboolean metrics_good(const AdaptiveMetrics *m) {
+    return m->loss_percent <= ADAPTIVE_UP_LOSS_PERCENT &&
+           m->rtt_ms <= ADAPTIVE_UP_RTT_MS &&
+           m->jitter_ms <= ADAPTIVE_UP_JITTER_MS &&
+           m->sendq_percent >= 0 && m->sendq_percent <= ADAPTIVE_UP_SENDQ_PERCENT;
+}
+
+static void request_switch(AdaptiveState *state, gint branch, const AdaptiveMetrics *m, gint64 now) {
+    g_atomic_int_set(&state->target, branch);
+    state->last_switch_us = now;
+    state->switches++;
+    g_print("[adaptive] %s: -> %s (loss=%d%% rtt=%dms jitter=%dms sendq=%d%%, up-hold=%us)\n",
+            state->camera_name, branch_name(branch),
+            m->loss_percent, m->rtt_ms, m->jitter_ms, m->sendq_percent, state->up_hold_sec);
+}
+
+static gboolean adaptive_tick(gpointer user_data) {
+    AdaptiveState *state = user_data;
+
+    g_mutex_lock(&state->lock);
+    GstRTSPMediaStatus status = state->media ? gst_rtsp_media_get_status(state->media)
+                                             : GST_RTSP_MEDIA_STATUS_UNPREPARED;
+    if (status == GST_RTSP_MEDIA_STATUS_UNPREPARED || status == GST_RTSP_MEDIA_STATUS_ERROR) {
+        g_mutex_unlock(&state->lock);
+        return G_SOURCE_REMOVE;
+    }
+    if (status != GST_RTSP_MEDIA_STATUS_PREPARED) {
+        g_mutex_unlock(&state->lock);
+        return G_SOURCE_CONTINUE;
+    }
+
+    AdaptiveMetrics m = { -1, -1, -1, -1 };
+    read_rtcp_metrics(state->media, &m);
+    read_sendq_metrics(state->media, &m);
+    g_mutex_unlock(&state->lock);
+
+    gint64 now = g_get_monotonic_time();
+    gboolean dwell_ok = now - state->last_switch_us >= ADAPTIVE_MIN_DWELL_SEC * G_USEC_PER_SEC;
+    gint target = g_atomic_int_get(&state->target);
+
+    if (target == BRANCH_MAIN) {
+        if (metrics_bad(&m) && dwell_ok) {
+            /* Vừa lên main đã phải xuống: link không chịu nổi main, chờ lâu hơn lần sau */
+            if (now - state->last_switch_us < 3 * (gint64)state->up_hold_sec * G_USEC_PER_SEC) {
+                state->up_hold_sec = MIN(state->up_hold_sec * 2, ADAPTIVE_UP_HOLD_MAX_SEC);
+            }
+            state->good_since_us = 0;
+            request_switch(state, BRANCH_SUB, &m, now);
+        }
+        return G_SOURCE_CONTINUE;
+    }
+
+    if (!metrics_good(&m)) {
+        state->good_since_us = 0;
+        return G_SOURCE_CONTINUE;
+    }
+
+    if (state->good_since_us == 0) state->good_since_us = now;
+    if (dwell_ok && now - state->good_since_us >= (gint64)state->up_hold_sec * G_USEC_PER_SEC) {
+        request_switch(state, BRANCH_MAIN, &m, now);
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+/* Thread pool RTSP: sau khi trả về, timer không còn chạm vào media */
+static void on_media_unprepared(GstRTSPMedia *media, gpointer user_data) {
+    AdaptiveState *state = user_data;
+    g_mutex_lock(&state->lock);
+    state->media = NULL;
+    if (state->timer) g_source_destroy(state->timer);
+    g_mutex_unlock(&state->lock);
+    g_print("[adaptive] %s: session ended after %u switch(es)\n", state->camera_name, state->switches);
+}
+
+void adaptive_stream_attach(GstRTSPMedia *media) {
+    GstElement *element = gst_rtsp_media_get_element(media);
+    if (!element) return;
+
+    AdaptiveState *state = g_object_get_data(G_OBJECT(element), ADAPTIVE_STATE_KEY);
+    gst_object_unref(element);
+    if (!state || state->timer) return;
+
+    /* Media sở hữu pipeline (và một ref của state); timer giữ ref riêng tới khi source bị hủy */
+    g_mutex_lock(&state->lock);
+    state->media = media;
+    state->last_switch_us = g_get_monotonic_time();
+    state->timer = g_timeout_source_new(ADAPTIVE_POLL_MS);
+    g_source_set_callback(state->timer, adaptive_tick, g_atomic_rc_box_acquire(state), adaptive_state_unref);
+    g_source_attach(state->timer, NULL);
+    g_mutex_unlock(&state->lock);
+    g_signal_connect(media, "unprepared", G_CALLBACK(on_media_unprepared), state);
+}
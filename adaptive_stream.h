@@ -0,0 +1,39 @@
+#ifndef ADAPTIVE_STREAM_H
+#define ADAPTIVE_STREAM_H
+
+#include <gst/gst.h>
+#include <gst/rtsp-server/rtsp-server.h>
+#include "camera_config.h"
+
+/* ?stream=auto: bắt đầu bằng sub, tự chuyển main/sub tại keyframe trong cùng session */
+#define ADAPTIVE_STREAM_VALUE  "auto"
+#define ADAPTIVE_SELECTOR_NAME "sel"
+
+#define ADAPTIVE_POLL_MS             1000
+/* Hạ xuống sub khi bất kỳ chỉ số nào vượt ngưỡng */
+#define ADAPTIVE_DOWN_LOSS_PERCENT   5
+#define ADAPTIVE_DOWN_RTT_MS         400
+#define ADAPTIVE_DOWN_JITTER_MS      80
+#define ADAPTIVE_DOWN_SENDQ_PERCENT  50
+/* Lên main khi tất cả chỉ số dưới ngưỡng liên tục trong up-hold */
+#define ADAPTIVE_UP_LOSS_PERCENT     1
+#define ADAPTIVE_UP_RTT_MS           150
+#define ADAPTIVE_UP_JITTER_MS        30
+#define ADAPTIVE_UP_SENDQ_PERCENT    10
+#define ADAPTIVE_UP_HOLD_SEC         10
+#define ADAPTIVE_UP_HOLD_MAX_SEC     120   /* lên rồi lại rớt ngay: up-hold tăng gấp đôi */
+#define ADAPTIVE_MIN_DWELL_SEC       5     /* thời gian tối thiểu giữa hai lần chuyển */
+
+/* Camera có thể chạy adaptive: main và sub cùng codec passthrough */
+gboolean adaptive_stream_supported(const CameraConfig *cam);
+
+/* Launch string: hai nhánh ingest -> input-selector -> send queue -> pay0 */
+gchar* adaptive_stream_launch_desc(const CameraConfig *cam,
+                                   const gchar *src_desc,
+                                   const gchar *sendq_desc);
+
+/* Gắn trạng thái vào pipeline (create_element) và bắt đầu theo dõi RTCP (media-configure) */
+void adaptive_stream_prepare(GstElement *pipeline, const gchar *camera_name);
+void adaptive_stream_attach(GstRTSPMedia *media);
+
+#endif // ADAPTIVE_STREAM_H
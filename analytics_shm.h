@@ -0,0 +1,82 @@
+#ifndef ANALYTICS_SHM_H
+#define ANALYTICS_SHM_H
+
+#include <stdint.h>
+
+/* Layout vùng shared memory của analytics tap: ABI với process đọc (không phụ thuộc glib).
+ *
+ * Process đọc kết nối socket SOCK_SEQPACKET <record-dir>/.analytics.sock, gửi
+ *   "ATTACH <camera> <raw|encoded|both> <depth> <drop-new|drop-old>"
+ * nhận "OK <consumer> <size>" kèm fd memfd (SCM_RIGHTS) hoặc "ERR <lý do>", rồi
+ * mmap(size, PROT_READ | PROT_WRITE, MAP_SHARED). Giữ kết nối suốt lúc đọc: đóng là detach.
+ *
+ * Đọc (c = &header->consumers[consumer]), không copy dữ liệu frame:
+ *   while (tail < head(acquire)) {
+ *       if (skip_to > tail) { nhả slot của [tail, skip_to); tail = skip_to; continue; }
+ *       slot = queue[tail % ANALYTICS_SHM_QUEUE_MAX];
+ *       dùng dữ liệu tại data_offset + slot * slot_size (size byte);
+ *       nhả slot: __atomic_sub_fetch(&slots[slot].refs, 1, __ATOMIC_RELEASE);
+ *       __atomic_store_n(&c->tail, tail + 1, __ATOMIC_RELEASE);
+ *   }
+ * Slot chưa nhả thì server không ghi đè: consumer chậm chỉ làm mất frame của chính nó
+ * (depth + policy). Mỗi consumer chỉ giữ tối đa depth slot (drop-old: 2 * depth) và server
+ * chia slot lúc ATTACH nên consumer dừng đọc không lấy slot của consumer khác; depth thực tế
+ * có thể nhỏ hơn depth xin (đọc lại consumers[i].depth), hết slot thì ATTACH bị từ chối. */
+#define ANALYTICS_SHM_MAGIC          0x50415441u   /* "ATAP" */
+#define ANALYTICS_SHM_VERSION        1
+#define ANALYTICS_SHM_MAX_CONSUMERS  16
+#define ANALYTICS_SHM_QUEUE_MAX      64
+
+/* Loại frame trong slot (cũng là mask đăng ký của consumer) */
+#define ANALYTICS_KIND_RAW           (1 << 0)   /* I420, plane liền nhau, stride = width, width/2 */
+#define ANALYTICS_KIND_ENCODED       (1 << 1)   /* một access unit Annex-B */
+
+/* Khi hàng đợi của consumer đã đủ depth frame */
+#define ANALYTICS_DROP_NEW           0          /* giữ frame cũ, bỏ frame mới */
+#define ANALYTICS_DROP_OLD           1          /* bỏ frame cũ (skip_to), luôn có frame mới nhất */
+
+#define ANALYTICS_FLAG_KEYFRAME      (1 << 0)
+
+#define ANALYTICS_CODEC_H264         0
+#define ANALYTICS_CODEC_H265         1
+
+typedef struct {
+    uint32_t active;            /* server: 1 khi entry thuộc một kết nối */
+    uint32_t kinds;             /* server: ANALYTICS_KIND_* đã đăng ký */
+    uint32_t depth;             /* server: depth thực tế sau khi chia slot */
+    uint32_t policy;            /* ANALYTICS_DROP_* */
+    uint64_t head;              /* server */
+    uint64_t tail;              /* consumer */
+    uint64_t skip_to;           /* server: frame trước đó đã bị bỏ (drop-old) */
+    uint64_t dropped;           /* server */
+    uint32_t queue[ANALYTICS_SHM_QUEUE_MAX];
+} AnalyticsShmConsumer;
+
+typedef struct {
+    uint32_t refs;              /* số consumer còn giữ slot */
+    uint32_t kind;
+    uint64_t seq;               /* số thứ tự frame của tap */
+    int64_t pts_ns;
+    int64_t wall_us;            /* wallclock UTC lúc server nhận */
+    uint32_t size;
+    uint32_t flags;             /* ANALYTICS_FLAG_* */
+} AnalyticsShmSlot;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t size;              /* toàn bộ vùng map */
+    uint64_t data_offset;       /* căn theo page */
+    uint32_t slot_count;
+    uint32_t slot_size;
+    uint32_t width;             /* frame giải mã */
+    uint32_t height;
+    uint32_t fps;
+    uint32_t codec;             /* ANALYTICS_CODEC_* của bitstream */
+    uint64_t produced;
+    uint64_t slot_starved;      /* frame bỏ vì hết slot trống (consumer nhả sai refs) */
+    AnalyticsShmConsumer consumers[ANALYTICS_SHM_MAX_CONSUMERS];
+    AnalyticsShmSlot slots[];
+} AnalyticsShmHeader;
+
+#endif // ANALYTICS_SHM_H
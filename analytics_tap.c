@@ -0,0 +1,739 @@
+#define _GNU_SOURCE   /* memfd_create, accept4 */
+#include "analytics_tap.h"
+#include "server_context.h"
+#include "camera_probe.h"
+#include "handoff.h"
+#include <gst/gst.h>
+#include <gst/app/gstappsink.h>
+#include <gst/video/video.h>
+#include <glib-unix.h>
+#include <glib/gstdio.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+
+#define ANALYTICS_MSG_MAX  256
+
+typedef struct {
+    gboolean main_stream;
+    guint width;
+    guint height;
+    guint fps;
+} TapConfig;
+
+typedef struct AnalyticsTap AnalyticsTap;
+
+/* Bản phía server của depth/policy (consumer ghi được vùng map, không tin giá trị trong đó) */
+typedef struct {
+    guint depth;
+    guint policy;
+    guint pin_max;               /* số slot tối đa consumer này giữ cùng lúc */
+} TapConsumer;
+
+/* Một kết nối điều khiển; index >= 0 sau ATTACH thành công */
+typedef struct {
+    gint fd;
+    guint watch;
+    AnalyticsTap *tap;
+    gint index;
+} TapClient;
+
+/* Một camera: pipeline ingest + giải mã và vùng shared memory, sống tới khi hết consumer */
+struct AnalyticsTap {
+    gchar *camera_name;
+    CodecType codec;
+    guint width;
+    guint height;
+    gint memfd;
+    gsize map_size;
+    AnalyticsShmHeader *shm;
+    guint8 *data;
+
+    GMutex lock;                 /* consumer table + publish (hai appsink chạy trên hai thread) */
+    TapClient *clients[ANALYTICS_SHM_MAX_CONSUMERS];
+    TapConsumer consumers[ANALYTICS_SHM_MAX_CONSUMERS];
+    guint n_clients;
+    guint n_raw;
+    guint next_slot;
+    guint64 seq;
+    gint need_keyframe;          /* atomic: decoder vừa bật, bỏ AU tới keyframe */
+
+    GstElement *pipeline;
+    GstElement *valve;
+    guint idle_timer;
+    guint retry_timer;
+};
+
+static GHashTable *configs = NULL;   /* camera name -> TapConfig* */
+static GHashTable *taps = NULL;      /* camera name -> AnalyticsTap*, chỉ truy cập trên main context */
+static GList *clients = NULL;        /* TapClient* */
+static gchar *socket_path = NULL;
+static gint listen_fd = -1;
+static guint listen_watch = 0;
+
+/* ===== Ring (gọi khi giữ tap->lock) ===== */
+
+static gsize raw_frame_size(guint width, guint height) {
+    return (gsize)width * height + 2 * (gsize)(width / 2) * (height / 2);
+}
+
+static gint claim_slot(AnalyticsTap *tap) {
+    AnalyticsShmHeader *shm = tap->shm;
+    for (guint i = 0; i < shm->slot_count; i++) {
+        guint slot = (tap->next_slot + i) % shm->slot_count;
+        if (__atomic_load_n(&shm->slots[slot].refs, __ATOMIC_ACQUIRE) == 0) {
+            tap->next_slot = slot + 1;
+            return slot;
+        }
+    }
+    return -1;
+}
+
+/* Số slot tối đa một consumer giữ: drop-new giữ tối đa depth frame chưa đọc, drop-old
+ * giữ thêm các frame đã skip tới khi consumer bước qua (nó tự nhả, xem analytics_shm.h) */
+static guint consumer_pin_max(guint depth, guint policy) {
+    return MIN(policy == ANALYTICS_DROP_OLD ? depth * 2 : depth, ANALYTICS_SHM_QUEUE_MAX);
+}
+
+/* Đưa slot vào hàng đợi consumer theo depth + policy; FALSE nếu frame bị bỏ với consumer này */
+static gboolean consumer_push(AnalyticsShmConsumer *c, const TapConsumer *limits, guint slot) {
+    guint64 head = c->head;
+    guint64 tail = __atomic_load_n(&c->tail, __ATOMIC_ACQUIRE);
+    guint64 start = MAX(tail, c->skip_to);
+
+    /* Consumer ngừng đọc hẳn: không giữ quá phần slot đã cấp lúc attach */
+    if (head - tail >= limits->pin_max) {
+        __atomic_store_n(&c->dropped, c->dropped + 1, __ATOMIC_RELAXED);
+        return FALSE;
+    }
+
+    if (head - start >= limits->depth) {
+        if (limits->policy == ANALYTICS_DROP_NEW) {
+            __atomic_store_n(&c->dropped, c->dropped + 1, __ATOMIC_RELAXED);
+            return FALSE;
+        }
+        guint64 skip_to = head - limits->depth + 1;
+        __atomic_store_n(&c->dropped, c->dropped + (skip_to - start), __ATOMIC_RELAXED);
+        __atomic_store_n(&c->skip_to, skip_to, __ATOMIC_RELEASE);
+    }
+
+    c->queue[head % ANALYTICS_SHM_QUEUE_MAX] = slot;
+    __atomic_store_n(&c->head, head + 1, __ATOMIC_RELEASE);
+    return TRUE;
+}
+
+/* Copy I420 về plane liền nhau (stride = width của plane): bản copy duy nhất phía server */
+static gsize copy_frame(GstVideoFrame *frame, guint8 *dst) {
+    guint8 *out = dst;
+    for (guint p = 0; p < 3; p++) {
+        guint width = GST_VIDEO_FRAME_COMP_WIDTH(frame, p);
+        guint height = GST_VIDEO_FRAME_COMP_HEIGHT(frame, p);
+        gint stride = GST_VIDEO_FRAME_PLANE_STRIDE(frame, p);
+        const guint8 *src = GST_VIDEO_FRAME_PLANE_DATA(frame, p);
+        for (guint y = 0; y < height; y++) {
+            memcpy(out, src + (gsize)y * stride, width);
+            out += width;
+        }
+    }
+    return out - dst;
+}
+
+static void publish(AnalyticsTap *tap, guint kind, GstBuffer *buffer, GstVideoFrame *frame) {
+    g_mutex_lock(&tap->lock);
+    AnalyticsShmHeader *shm = tap->shm;
+
+    guint targets[ANALYTICS_SHM_MAX_CONSUMERS];
+    guint n_targets = 0;
+    for (guint i = 0; i < ANALYTICS_SHM_MAX_CONSUMERS; i++) {
+        if (tap->clients[i] && (shm->consumers[i].kinds & kind)) targets[n_targets++] = i;
+    }
+
+    gsize size = frame ? raw_frame_size(tap->width, tap->height) : gst_buffer_get_size(buffer);
+    gint slot = n_targets > 0 && size <= shm->slot_size ? claim_slot(tap) : -1;
+    if (slot < 0) {
+        if (n_targets > 0) {
+            __atomic_store_n(&shm->slot_starved, shm->slot_starved + 1, __ATOMIC_RELAXED);
+        }
+        g_mutex_unlock(&tap->lock);
+        return;
+    }
+
+    guint8 *dst = tap->data + (gsize)slot * shm->slot_size;
+    if (frame) {
+        size = copy_frame(frame, dst);
+    } else {
+        gst_buffer_extract(buffer, 0, dst, size);
+    }
+
+    AnalyticsShmSlot *s = &shm->slots[slot];
+    s->kind = kind;
+    s->seq = ++tap->seq;
+    s->pts_ns = GST_BUFFER_PTS_IS_VALID(buffer) ? (gint64)GST_BUFFER_PTS(buffer) : -1;
+    s->wall_us = g_get_real_time();
+    s->size = size;
+    s->flags = kind == ANALYTICS_KIND_ENCODED &&
+               !GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DELTA_UNIT) ? ANALYTICS_FLAG_KEYFRAME : 0;
+
+    /* refs đặt trước khi head tiến: consumer nhanh không thể nhả trước */
+    __atomic_store_n(&s->refs, n_targets, __ATOMIC_RELEASE);
+    for (guint i = 0; i < n_targets; i++) {
+        if (!consumer_push(&shm->consumers[targets[i]], &tap->consumers[targets[i]], slot)) {
+            __atomic_sub_fetch(&s->refs, 1, __ATOMIC_RELEASE);
+        }
+    }
+    __atomic_store_n(&shm->produced, shm->produced + 1, __ATOMIC_RELAXED);
+    g_mutex_unlock(&tap->lock);
+}
+
+/* ===== Pipeline ===== */
+
+static GstFlowReturn on_encoded_sample(GstAppSink *sink, gpointer user_data) {
+    GstSample *sample = gst_app_sink_pull_sample(sink);
+    if (!sample) return GST_FLOW_EOS;
+    publish(user_data, ANALYTICS_KIND_ENCODED, gst_sample_get_buffer(sample), NULL);
+    gst_sample_unref(sample);
+    return GST_FLOW_OK;
+}
+
+static GstFlowReturn on_raw_sample(GstAppSink *sink, gpointer user_data) {
+    GstSample *sample = gst_app_sink_pull_sample(sink);
+    if (!sample) return GST_FLOW_EOS;
+
+    GstVideoInfo info;
+    GstVideoFrame frame;
+    GstBuffer *buffer = gst_sample_get_buffer(sample);
+    if (gst_video_info_from_caps(&info, gst_sample_get_caps(sample)) &&
+        gst_video_frame_map(&frame, &info, buffer, GST_MAP_READ)) {
+        publish(user_data, ANALYTICS_KIND_RAW, buffer, &frame);
+        gst_video_frame_unmap(&frame);
+    }
+    gst_sample_unref(sample);
+    return GST_FLOW_OK;
+}
+
+/* Decoder vừa được bật giữa GOP: bỏ AU tới keyframe để không ra ảnh lỗi */
+static GstPadProbeReturn valve_src_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    AnalyticsTap *tap = user_data;
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+
+    if (!g_atomic_int_get(&tap->need_keyframe)) return GST_PAD_PROBE_OK;
+    if (GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DELTA_UNIT)) return GST_PAD_PROBE_DROP;
+    g_atomic_int_set(&tap->need_keyframe, FALSE);
+    return GST_PAD_PROBE_OK;
+}
+
+static void tap_update_valve(AnalyticsTap *tap) {
+    gboolean drop = tap->n_raw == 0;
+    gboolean dropping = TRUE;
+    g_object_get(tap->valve, "drop", &dropping, NULL);
+    if (dropping && !drop) g_atomic_int_set(&tap->need_keyframe, TRUE);
+    if (dropping != drop) g_object_set(tap->valve, "drop", drop, NULL);
+}
+
+static gboolean tap_retry(gpointer user_data) {
+    AnalyticsTap *tap = user_data;
+    tap->retry_timer = 0;
+    g_atomic_int_set(&tap->need_keyframe, TRUE);
+    gst_element_set_state(tap->pipeline, GST_STATE_PLAYING);
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean tap_bus_cb(GstBus *bus, GstMessage *msg, gpointer user_data) {
+    AnalyticsTap *tap = user_data;
+
+    if (GST_MESSAGE_TYPE(msg) != GST_MESSAGE_ERROR && GST_MESSAGE_TYPE(msg) != GST_MESSAGE_EOS) {
+        return G_SOURCE_CONTINUE;
+    }
+    if (GST_MESSAGE_TYPE(msg) == GST_MESSAGE_ERROR) {
+        GError *err = NULL;
+        gst_message_parse_error(msg, &err, NULL);
+        g_printerr("[analytics] %s: %s, retrying in %ds\n", tap->camera_name, err->message,
+                   ANALYTICS_TAP_RETRY_SEC);
+        g_error_free(err);
+    } else {
+        g_printerr("[analytics] %s: stream ended, retrying in %ds\n", tap->camera_name,
+                   ANALYTICS_TAP_RETRY_SEC);
+    }
+
+    /* Consumer giữ nguyên vùng map, chỉ không có frame trong lúc chờ */
+    if (!tap->retry_timer) {
+        gst_element_set_state(tap->pipeline, GST_STATE_NULL);
+        tap->retry_timer = g_timeout_add_seconds(ANALYTICS_TAP_RETRY_SEC, tap_retry, tap);
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean tap_build_pipeline(AnalyticsTap *tap, const CameraConfig *cam, const TapConfig *config) {
+    gboolean h265 = tap->codec == CODEC_H265;
+    /* Một ingest: tee ra bitstream (luôn chạy, rẻ) và nhánh giải mã (valve đóng khi không
+     * có consumer raw); videorate chỉ bỏ frame nên decoder vẫn chạy ở fps gốc */
+    gchar *launch = g_strdup_printf(
+        "rtspsrc location=%s protocols=tcp latency=100 ! %s ! %s config-interval=-1 ! "
+        "video/x-%s,stream-format=byte-stream,alignment=au ! tee name=t "
+        "t. ! queue leaky=downstream max-size-buffers=8 max-size-bytes=0 max-size-time=0 ! "
+        "appsink name=encoded sync=false max-buffers=8 drop=true "
+        "t. ! queue leaky=downstream max-size-buffers=4 max-size-bytes=0 max-size-time=0 ! "
+        "valve name=decode drop=true ! decodebin ! videorate drop-only=true ! videoscale ! "
+        "videoconvert ! video/x-raw,format=I420,width=%u,height=%u,framerate=%u/1 ! "
+        "appsink name=raw sync=false max-buffers=2 drop=true",
+        config->main_stream ? cam->rtsp_url_main : cam->rtsp_url_sub,
+        h265 ? "rtph265depay" : "rtph264depay", h265 ? "h265parse" : "h264parse",
+        h265 ? "h265" : "h264", config->width, config->height, config->fps);
+
+    GError *error = NULL;
+    GstElement *pipeline = gst_parse_launch(launch, &error);
+    g_free(launch);
+    if (error) {
+        g_printerr("[analytics] Pipeline error: %s\n", error->message);
+        g_error_free(error);
+        if (pipeline) gst_object_unref(pipeline);
+        return FALSE;
+    }
+
+    GstAppSinkCallbacks encoded_callbacks = { .new_sample = on_encoded_sample };
+    GstAppSinkCallbacks raw_callbacks = { .new_sample = on_raw_sample };
+    GstElement *encoded = gst_bin_get_by_name(GST_BIN(pipeline), "encoded");
+    GstElement *raw = gst_bin_get_by_name(GST_BIN(pipeline), "raw");
+    gst_app_sink_set_callbacks(GST_APP_SINK(encoded), &encoded_callbacks, tap, NULL);
+    gst_app_sink_set_callbacks(GST_APP_SINK(raw), &raw_callbacks, tap, NULL);
+    gst_object_unref(encoded);
+    gst_object_unref(raw);
+
+    tap->valve = gst_bin_get_by_name(GST_BIN(pipeline), "decode");
+    GstPad *pad = gst_element_get_static_pad(tap->valve, "src");
+    gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, valve_src_probe, tap, NULL);
+    gst_object_unref(pad);
+
+    GstBus *bus = gst_pipeline_get_bus(GST_PIPELINE(pipeline));
+    gst_bus_add_watch(bus, tap_bus_cb, tap);
+    gst_object_unref(bus);
+
+    tap->pipeline = pipeline;
+    return TRUE;
+}
+
+/* ===== Tap ===== */
+
+static gboolean tap_map(AnalyticsTap *tap, guint fps) {
+    gsize page = sysconf(_SC_PAGESIZE);
+    gsize slot_size = MAX(raw_frame_size(tap->width, tap->height), ANALYTICS_TAP_MIN_SLOT_SIZE);
+    slot_size = (slot_size + page - 1) / page * page;
+    gsize header = sizeof(AnalyticsShmHeader) + ANALYTICS_TAP_SLOTS * sizeof(AnalyticsShmSlot);
+    gsize data_offset = (header + page - 1) / page * page;
+    gsize size = data_offset + ANALYTICS_TAP_SLOTS * slot_size;
+
+    gchar *name = g_strdup_printf("analytics-%s", tap->camera_name);
+    gint fd = memfd_create(name, MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    g_free(name);
+    if (fd < 0 || ftruncate(fd, size) < 0) {
+        g_printerr("[analytics] memfd: %s\n", g_strerror(errno));
+        if (fd >= 0) close(fd);
+        return FALSE;
+    }
+    /* Consumer không thể đổi kích thước vùng map của server */
+    fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL);
+
+    void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        g_printerr("[analytics] mmap: %s\n", g_strerror(errno));
+        close(fd);
+        return FALSE;
+    }
+
+    AnalyticsShmHeader *shm = map;
+    shm->version = ANALYTICS_SHM_VERSION;
+    shm->size = size;
+    shm->data_offset = data_offset;
+    shm->slot_count = ANALYTICS_TAP_SLOTS;
+    shm->slot_size = slot_size;
+    shm->width = tap->width;
+    shm->height = tap->height;
+    shm->fps = fps;
+    shm->codec = tap->codec == CODEC_H265 ? ANALYTICS_CODEC_H265 : ANALYTICS_CODEC_H264;
+    __atomic_store_n(&shm->magic, ANALYTICS_SHM_MAGIC, __ATOMIC_RELEASE);
+
+    tap->memfd = fd;
+    tap->map_size = size;
+    tap->shm = shm;
+    tap->data = (guint8 *)map + data_offset;
+    return TRUE;
+}
+
+static void tap_free(gpointer data) {
+    AnalyticsTap *tap = data;
+
+    if (tap->idle_timer) g_source_remove(tap->idle_timer);
+    if (tap->retry_timer) g_source_remove(tap->retry_timer);
+    if (tap->pipeline) {
+        /* NULL chờ streaming thread dừng: sau đó appsink không còn chạm vào tap */
+        gst_element_set_state(tap->pipeline, GST_STATE_NULL);
+        GstBus *bus = gst_pipeline_get_bus(GST_PIPELINE(tap->pipeline));
+        gst_bus_remove_watch(bus);
+        gst_object_unref(bus);
+        gst_object_unref(tap->valve);
+        gst_object_unref(tap->pipeline);
+    }
+    if (tap->shm) munmap(tap->shm, tap->map_size);
+    if (tap->memfd >= 0) close(tap->memfd);
+    g_mutex_clear(&tap->lock);
+    g_print("[analytics] Tap %s stopped\n", tap->camera_name);
+    g_free(tap->camera_name);
+    g_free(tap);
+}
+
+static AnalyticsTap* tap_get(const gchar *camera_name, gchar **error) {
+    AnalyticsTap *tap = g_hash_table_lookup(taps, camera_name);
+    if (tap) return tap;
+
+    CameraConfig *cam = find_camera(camera_name);
+    if (!cam) {
+        *error = g_strdup("unknown camera");
+        return NULL;
+    }
+
+    TapConfig defaults = { FALSE, ANALYTICS_TAP_DEFAULT_WIDTH, ANALYTICS_TAP_DEFAULT_HEIGHT,
+                           ANALYTICS_TAP_DEFAULT_FPS };
+    TapConfig *stored = configs ? g_hash_table_lookup(configs, camera_name) : NULL;
+    TapConfig copy = stored ? *stored : defaults;
+    TapConfig *config = &copy;
+    if (!cam->rtsp_url_sub) config->main_stream = TRUE;
+
+    tap = g_new0(AnalyticsTap, 1);
+    tap->camera_name = g_strdup(camera_name);
+    tap->codec = camera_resolve_codec(cam, config->main_stream);
+    tap->width = config->width;
+    tap->height = config->height;
+    tap->memfd = -1;
+    g_mutex_init(&tap->lock);
+
+    if (!tap_map(tap, config->fps) || !tap_build_pipeline(tap, cam, config)) {
+        tap_free(tap);
+        *error = g_strdup("tap setup failed");
+        return NULL;
+    }
+
+    gst_element_set_state(tap->pipeline, GST_STATE_PLAYING);
+    g_hash_table_insert(taps, tap->camera_name, tap);
+    g_print("[analytics] Tap %s started (%s, %ux%u @ %u fps)\n", camera_name,
+            config->main_stream ? "main" : "sub", config->width, config->height, config->fps);
+    return tap;
+}
+
+static gboolean tap_idle_stop(gpointer user_data) {
+    AnalyticsTap *tap = user_data;
+    tap->idle_timer = 0;
+    g_hash_table_remove(taps, tap->camera_name);
+    return G_SOURCE_REMOVE;
+}
+
+/* Tổng pin_max của mọi consumer luôn < slot_count: luôn còn slot trống để ghi frame mới,
+ * consumer dừng đọc chỉ giữ phần slot của nó. depth bị giảm cho vừa phần còn lại
+ * (consumer đọc depth thực tế trong consumers[i].depth). NULL nếu attach được */
+static const gchar* tap_attach(AnalyticsTap *tap, TapClient *client, guint kinds, guint depth, guint policy) {
+    g_mutex_lock(&tap->lock);
+    gint index = -1;
+    guint pinned = 0;
+    for (guint i = 0; i < ANALYTICS_SHM_MAX_CONSUMERS; i++) {
+        if (tap->clients[i]) {
+            pinned += tap->consumers[i].pin_max;
+        } else if (index < 0) {
+            index = i;
+        }
+    }
+    if (index < 0) {
+        g_mutex_unlock(&tap->lock);
+        return "too many consumers";
+    }
+
+    guint available = tap->shm->slot_count - 1 - MIN(pinned, tap->shm->slot_count - 1);
+    while (depth > 1 && consumer_pin_max(depth, policy) > available) depth--;
+    if (consumer_pin_max(depth, policy) > available) {
+        g_mutex_unlock(&tap->lock);
+        return "no free slots";
+    }
+
+    TapConsumer *limits = &tap->consumers[index];
+    limits->depth = depth;
+    limits->policy = policy;
+    limits->pin_max = consumer_pin_max(depth, policy);
+
+    AnalyticsShmConsumer *c = &tap->shm->consumers[index];
+    memset(c, 0, sizeof(*c));
+    c->kinds = kinds;
+    c->depth = depth;
+    c->policy = policy;
+    __atomic_store_n(&c->active, 1, __ATOMIC_RELEASE);
+
+    tap->clients[index] = client;
+    tap->n_clients++;
+    if (kinds & ANALYTICS_KIND_RAW) tap->n_raw++;
+    g_mutex_unlock(&tap->lock);
+
+    client->tap = tap;
+    client->index = index;
+    if (tap->idle_timer) {
+        g_source_remove(tap->idle_timer);
+        tap->idle_timer = 0;
+    }
+    tap_update_valve(tap);
+    return NULL;
+}
+
+/* Nhả mọi slot consumer còn giữ (kể cả frame đã skip nhưng chưa bước qua) */
+static void tap_detach(TapClient *client) {
+    AnalyticsTap *tap = client->tap;
+    if (!tap) return;
+
+    g_mutex_lock(&tap->lock);
+    AnalyticsShmConsumer *c = &tap->shm->consumers[client->index];
+    guint64 tail = __atomic_load_n(&c->tail, __ATOMIC_ACQUIRE);
+    for (guint64 i = tail; i < c->head; i++) {
+        guint slot = c->queue[i % ANALYTICS_SHM_QUEUE_MAX];
+        if (slot < tap->shm->slot_count) {
+            __atomic_sub_fetch(&tap->shm->slots[slot].refs, 1, __ATOMIC_RELEASE);
+        }
+    }
+    __atomic_store_n(&c->active, 0, __ATOMIC_RELEASE);
+    if (c->kinds & ANALYTICS_KIND_RAW) tap->n_raw--;
+    c->kinds = 0;
+    tap->clients[client->index] = NULL;
+    tap->n_clients--;
+    g_mutex_unlock(&tap->lock);
+
+    client->tap = NULL;
+    client->index = -1;
+    tap_update_valve(tap);
+    if (tap->n_clients == 0 && !tap->idle_timer) {
+        tap->idle_timer = g_timeout_add_seconds(ANALYTICS_TAP_IDLE_SEC, tap_idle_stop, tap);
+    }
+}
+
+/* ===== Socket điều khiển ===== */
+
+static gboolean send_reply(gint fd, const gchar *text, gint pass_fd) {
+    union {
+        struct cmsghdr align;
+        gchar buf[CMSG_SPACE(sizeof(gint))];
+    } control;
+    struct iovec iov = { (void *)text, strlen(text) };
+    struct msghdr msg;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+
+    if (pass_fd >= 0) {
+        memset(&control, 0, sizeof(control));
+        msg.msg_control = control.buf;
+        msg.msg_controllen = sizeof(control.buf);
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(gint));
+        memcpy(CMSG_DATA(cmsg), &pass_fd, sizeof(gint));
+    }
+
+    gssize sent;
+    do {
+        sent = sendmsg(fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+    } while (sent < 0 && errno == EINTR);
+    return sent == (gssize)iov.iov_len;
+}
+
+static void client_close(TapClient *client) {
+    tap_detach(client);
+    if (client->watch) g_source_remove(client->watch);
+    close(client->fd);
+    clients = g_list_remove(clients, client);
+    g_free(client);
+}
+
+/* "ATTACH <camera> <raw|encoded|both> <depth> <drop-new|drop-old>" */
+static gchar* client_attach(TapClient *client, gchar **args, AnalyticsTap **out_tap) {
+    if (g_strv_length(args) != 5 || g_strcmp0(args[0], "ATTACH") != 0) return g_strdup("bad request");
+    if (client->tap) return g_strdup("already attached");
+
+    guint kinds = g_strcmp0(args[2], "raw") == 0 ? ANALYTICS_KIND_RAW
+                : g_strcmp0(args[2], "encoded") == 0 ? ANALYTICS_KIND_ENCODED
+                : g_strcmp0(args[2], "both") == 0 ? ANALYTICS_KIND_RAW | ANALYTICS_KIND_ENCODED : 0;
+    if (!kinds) return g_strdup("bad kind");
+
+    gint64 depth = g_ascii_strtoll(args[3], NULL, 10);
+    if (depth <= 0) depth = ANALYTICS_TAP_DEFAULT_DEPTH;
+    depth = CLAMP(depth, 1, ANALYTICS_SHM_QUEUE_MAX / 2);
+
+    guint policy;
+    if (g_strcmp0(args[4], "drop-new") == 0) {
+        policy = ANALYTICS_DROP_NEW;
+    } else if (g_strcmp0(args[4], "drop-old") == 0) {
+        policy = ANALYTICS_DROP_OLD;
+    } else {
+        return g_strdup("bad policy");
+    }
+
+    gchar *error = NULL;
+    AnalyticsTap *tap = tap_get(args[1], &error);
+    if (!tap) return error;
+    const gchar *refused = tap_attach(tap, client, kinds, (guint)depth, policy);
+    if (refused) {
+        /* Tap vừa tạo mà không attach được thì cũng để idle timer dọn */
+        if (tap->n_clients == 0 && !tap->idle_timer) {
+            tap->idle_timer = g_timeout_add_seconds(ANALYTICS_TAP_IDLE_SEC, tap_idle_stop, tap);
+        }
+        return g_strdup(refused);
+    }
+    *out_tap = tap;
+    return NULL;
+}
+
+static gboolean on_client_message(gint fd, GIOCondition condition, gpointer user_data) {
+    TapClient *client = user_data;
+    gchar buf[ANALYTICS_MSG_MAX];
+
+    gssize len = (condition & G_IO_IN) ? recv(fd, buf, sizeof(buf) - 1, MSG_DONTWAIT) : 0;
+    if (len < 0 && (errno == EAGAIN || errno == EINTR)) return G_SOURCE_CONTINUE;
+    if (len <= 0) {
+        if (client->tap) {
+            g_print("[analytics] Consumer %d of %s detached\n", client->index, client->tap->camera_name);
+        }
+        client->watch = 0;
+        client_close(client);
+        return G_SOURCE_REMOVE;
+    }
+    buf[len] = '\0';
+    g_strchomp(buf);
+
+    gchar **args = g_strsplit(buf, " ", -1);
+    AnalyticsTap *tap = NULL;
+    gchar *error = client_attach(client, args, &tap);
+    g_strfreev(args);
+
+    if (error) {
+        gchar *reply = g_strdup_printf("ERR %s", error);
+        send_reply(fd, reply, -1);
+        g_free(reply);
+        g_free(error);
+        return G_SOURCE_CONTINUE;
+    }
+
+    gchar *reply = g_strdup_printf("OK %d %" G_GSIZE_FORMAT, client->index, tap->map_size);
+    gboolean sent = send_reply(fd, reply, tap->memfd);
+    g_free(reply);
+    if (!sent) {
+        client->watch = 0;
+        client_close(client);
+        return G_SOURCE_REMOVE;
+    }
+    g_print("[analytics] Consumer %d attached to %s\n", client->index, tap->camera_name);
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean on_connect(gint fd, GIOCondition condition, gpointer user_data) {
+    gint peer = accept4(fd, NULL, NULL, SOCK_CLOEXEC | SOCK_NONBLOCK);
+    if (peer < 0) return G_SOURCE_CONTINUE;
+
+    TapClient *client = g_new0(TapClient, 1);
+    client->fd = peer;
+    client->index = -1;
+    client->watch = g_unix_fd_add(peer, G_IO_IN | G_IO_HUP | G_IO_ERR, on_client_message, client);
+    clients = g_list_prepend(clients, client);
+    return G_SOURCE_CONTINUE;
+}
+
+/* bind trong thư mục tạm 0700 rồi rename sang path: socket chỉ xuất hiện ở path khi đã có mode */
+static gboolean bind_private(gint fd, const gchar *path, mode_t mode) {
+    gchar *dir_name = g_path_get_dirname(path);
+    gchar *tmp_dir = g_build_filename(dir_name, ".analytics-XXXXXX", NULL);
+    g_free(dir_name);
+    if (!g_mkdtemp_full(tmp_dir, 0700)) {
+        g_free(tmp_dir);
+        return FALSE;
+    }
+    gchar *tmp_path = g_build_filename(tmp_dir, "sock", NULL);
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    gboolean ok = FALSE;
+    if (strlen(tmp_path) >= sizeof(addr.sun_path)) {
+        errno = ENAMETOOLONG;
+    } else {
+        strcpy(addr.sun_path, tmp_path);
+        ok = bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0 &&
+             chmod(tmp_path, mode) == 0 &&
+             g_rename(tmp_path, path) == 0;
+    }
+
+    gint saved_errno = errno;
+    if (!ok) g_unlink(tmp_path);
+    g_rmdir(tmp_dir);
+    g_free(tmp_path);
+    g_free(tmp_dir);
+    errno = saved_errno;
+    return ok;
+}
+
+/* ===== API ===== */
+
+gboolean analytics_tap_init(const gchar *base_path) {
+    socket_path = g_build_filename(base_path, ANALYTICS_TAP_SOCKET_NAME, NULL);
+
+    gint fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        g_printerr("[analytics] socket: %s\n", g_strerror(errno));
+        g_clear_pointer(&socket_path, g_free);
+        return FALSE;
+    }
+
+    /* Sau takeover, consumer mới kết nối vào process này; consumer cũ đọc tiếp tới khi process cũ thoát */
+    /* rename thay thế socket cũ (nếu có) một cách nguyên tử */
+    if (!bind_private(fd, socket_path, 0660) || listen(fd, 16) < 0) {
+        g_printerr("[analytics] Cannot listen on %s: %s\n", socket_path, g_strerror(errno));
+        close(fd);
+        g_clear_pointer(&socket_path, g_free);
+        return FALSE;
+    }
+
+    taps = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, tap_free);
+    listen_fd = fd;
+    listen_watch = g_unix_fd_add(fd, G_IO_IN, on_connect, NULL);
+    g_print("[analytics] Frame tap socket: %s\n", socket_path);
+    return TRUE;
+}
+
+void analytics_tap_set_camera(const gchar *camera_name, gboolean main_stream,
+                              guint width, guint height, guint fps) {
+    if (!configs) configs = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+
+    TapConfig *config = g_new0(TapConfig, 1);
+    config->main_stream = main_stream;
+    /* I420: kích thước chẵn để plane chroma đúng width/2 x height/2 */
+    config->width = MAX(width, 2) & ~1u;
+    config->height = MAX(height, 2) & ~1u;
+    config->fps = MAX(fps, 1);
+    g_hash_table_replace(configs, g_strdup(camera_name), config);
+}
+
+void analytics_tap_shutdown(void) {
+    while (clients) client_close(clients->data);
+    g_clear_pointer(&taps, g_hash_table_destroy);
+
+    if (listen_watch) {
+        g_source_remove(listen_watch);
+        listen_watch = 0;
+    }
+    if (listen_fd >= 0) {
+        close(listen_fd);
+        listen_fd = -1;
+        /* Đang handoff: path đã thuộc về process mới */
+        if (!handoff_in_progress()) g_unlink(socket_path);
+    }
+    g_clear_pointer(&socket_path, g_free);
+    g_clear_pointer(&configs, g_hash_table_destroy);
+}
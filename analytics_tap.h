@@ -0,0 +1,32 @@
+#ifndef ANALYTICS_TAP_H
+#define ANALYTICS_TAP_H
+
+#include <glib.h>
+#include "analytics_shm.h"
+
+/* Tap cho process analytics chạy cùng máy: mỗi camera chỉ ingest và giải mã một lần
+ * (khi có consumer), frame đã scale + bitstream gốc vào ring trong shared memory
+ * (analytics_shm.h). Consumer đọc thẳng trong vùng map, không copy, không RTSP. */
+#define ANALYTICS_TAP_SOCKET_NAME    ".analytics.sock"
+#define ANALYTICS_TAP_DEFAULT_WIDTH  640
+#define ANALYTICS_TAP_DEFAULT_HEIGHT 360
+#define ANALYTICS_TAP_DEFAULT_FPS    5
+#define ANALYTICS_TAP_SLOTS          32
+/* Slot tối thiểu (access unit lớn hơn bị bỏ) */
+#define ANALYTICS_TAP_MIN_SLOT_SIZE  (1024 * 1024)
+#define ANALYTICS_TAP_DEFAULT_DEPTH  4
+/* Consumer cuối detach: giữ pipeline chừng này cho lần attach lại */
+#define ANALYTICS_TAP_IDLE_SEC       10
+#define ANALYTICS_TAP_RETRY_SEC      5
+
+/* Nghe trên <base_path>/.analytics.sock */
+gboolean analytics_tap_init(const gchar *base_path);
+
+/* Độ phân giải/fps giải mã và stream nguồn của camera (mặc định sub, 640x360 @ 5 fps) */
+void analytics_tap_set_camera(const gchar *camera_name, gboolean main_stream,
+                              guint width, guint height, guint fps);
+
+/* Dừng mọi tap, đóng kết nối consumer */
+void analytics_tap_shutdown(void);
+
+#endif // ANALYTICS_TAP_H
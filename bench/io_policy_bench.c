@@ -0,0 +1,179 @@
+/* Benchmark: throughput playback khi có nhiều stream recording ghi song song.
+ *
+ * Build:  cd bench && qmake io_policy_bench.pro && make
+ * Chạy:   ./io_policy_bench --dir /mnt/hdd/bench --writers 200 --policy
+ *         ./io_policy_bench --dir /mnt/hdd/bench --writers 200
+ *
+ * Writer giả lập recording (ghi tuần tự theo bitrate), reader giả lập playback
+ * (đọc tuần tự chuỗi segment, sau đó đọc lại segment "hot" vừa xem).
+ * Kết quả in ra một dòng JSON.
+ */
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include "../io_policy.h"
+
+#define CHUNK_SIZE (64 * 1024)
+
+static gchar *opt_dir = NULL;
+static gint opt_writers = 64;
+static gint opt_rate_kb = 512;        /* mỗi writer, ~4 Mbps */
+static gint opt_duration = 30;
+static gint opt_files = 8;
+static gint opt_file_mb = 64;
+static gboolean opt_policy = FALSE;
+
+static volatile gint running = 1;
+
+static GOptionEntry entries[] = {
+    { "dir", 'd', 0, G_OPTION_ARG_FILENAME, &opt_dir, "Working directory (on the disk under test)", "DIR" },
+    { "writers", 'w', 0, G_OPTION_ARG_INT, &opt_writers, "Concurrent recording writers", "N" },
+    { "rate", 'r', 0, G_OPTION_ARG_INT, &opt_rate_kb, "Write rate per writer (KB/s)", "KB" },
+    { "duration", 't', 0, G_OPTION_ARG_INT, &opt_duration, "Seconds of recording load", "SEC" },
+    { "files", 'f', 0, G_OPTION_ARG_INT, &opt_files, "Playback segments in the chain", "N" },
+    { "file-mb", 's', 0, G_OPTION_ARG_INT, &opt_file_mb, "Size of each playback segment (MB)", "MB" },
+    { "policy", 'p', 0, G_OPTION_ARG_NONE, &opt_policy, "Enable the I/O policy", NULL },
+    { NULL }
+};
+
+static gpointer writer_func(gpointer data) {
+    gint id = GPOINTER_TO_INT(data);
+    gchar *path = g_strdup_printf("%s/rec/w%d.mkv", opt_dir, id);
+    int fd = g_open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    IoWriteTracker *tracker = opt_policy ? io_write_tracker_new(path) : NULL;
+    gchar *buf = g_malloc0(CHUNK_SIZE);
+    gint64 start = g_get_monotonic_time();
+    guint64 total = 0;
+
+    while (g_atomic_int_get(&running) && fd >= 0) {
+        if (write(fd, buf, CHUNK_SIZE) != CHUNK_SIZE) break;
+        total += CHUNK_SIZE;
+        if (tracker) io_write_tracker_advance(tracker, CHUNK_SIZE);
+
+        gint64 expected_us = (gint64)(total * G_USEC_PER_SEC / ((guint64)opt_rate_kb * 1024));
+        gint64 elapsed_us = g_get_monotonic_time() - start;
+        if (expected_us > elapsed_us) g_usleep(expected_us - elapsed_us);
+    }
+
+    if (tracker) io_write_tracker_unref(tracker);
+    if (fd >= 0) close(fd);
+    g_unlink(path);
+    g_free(buf);
+    g_free(path);
+    return NULL;
+}
+
+static gchar* playback_path(gint i) {
+    return g_strdup_printf("%s/playback/%d.mkv", opt_dir, i);
+}
+
+static void prepare_playback_files(void) {
+    gchar *buf = g_malloc0(CHUNK_SIZE);
+    for (gint i = 0; i < opt_files; i++) {
+        gchar *path = playback_path(i);
+        int fd = g_open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        for (gint64 n = 0; fd >= 0 && n < (gint64)opt_file_mb * 1024 * 1024; n += CHUNK_SIZE) {
+            if (write(fd, buf, CHUNK_SIZE) != CHUNK_SIZE) break;
+        }
+        if (fd >= 0) {
+            fdatasync(fd);
+            posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+            close(fd);
+        }
+        g_free(path);
+    }
+    g_free(buf);
+}
+
+/* Đọc một file, trả về số byte; prefetch file kế tiếp ở nửa file nếu bật policy */
+static guint64 read_file(const gchar *path, const gchar *next) {
+    int fd = g_open(path, O_RDONLY | O_CLOEXEC, 0);
+    if (fd < 0) return 0;
+    if (opt_policy) io_policy_reader_hint(fd);
+
+    gchar *buf = g_malloc(CHUNK_SIZE);
+    guint64 size = (guint64)opt_file_mb * 1024 * 1024;
+    guint64 total = 0;
+    gboolean prefetched = FALSE;
+    gssize n;
+
+    while ((n = read(fd, buf, CHUNK_SIZE)) > 0) {
+        total += n;
+        if (opt_policy && next && !prefetched &&
+            total * 100 >= size * IO_POLICY_PREFETCH_AT_PERCENT) {
+            io_policy_prefetch_async(next);
+            prefetched = TRUE;
+        }
+    }
+
+    g_free(buf);
+    close(fd);
+    return total;
+}
+
+static gdouble mb_per_sec(guint64 bytes, gint64 elapsed_us) {
+    return elapsed_us > 0 ? (bytes / (1024.0 * 1024.0)) / (elapsed_us / 1e6) : 0.0;
+}
+
+int main(int argc, char *argv[]) {
+    GError *error = NULL;
+    GOptionContext *context = g_option_context_new("- playback throughput under recording load");
+    g_option_context_add_main_entries(context, entries, NULL);
+    if (!g_option_context_parse(context, &argc, &argv, &error) || !opt_dir) {
+        g_printerr("%s\n", error ? error->message : "--dir is required");
+        return 1;
+    }
+    g_option_context_free(context);
+
+    gchar *rec_dir = g_build_filename(opt_dir, "rec", NULL);
+    gchar *playback_dir = g_build_filename(opt_dir, "playback", NULL);
+    g_mkdir_with_parents(rec_dir, 0755);
+    g_mkdir_with_parents(playback_dir, 0755);
+
+    prepare_playback_files();
+
+    GThread **writers = g_new0(GThread *, opt_writers);
+    for (gint i = 0; i < opt_writers; i++) {
+        writers[i] = g_thread_new("bench-writer", writer_func, GINT_TO_POINTER(i));
+    }
+
+    /* Cho writer chạy một lúc để page cache đầy dữ liệu recording */
+    g_usleep((gulong)MIN(opt_duration / 3, 10) * G_USEC_PER_SEC);
+
+    /* Chuỗi playback: đọc tuần tự các segment */
+    gint64 start = g_get_monotonic_time();
+    guint64 chain_bytes = 0;
+    for (gint i = 0; i < opt_files; i++) {
+        gchar *path = playback_path(i);
+        gchar *next = i + 1 < opt_files ? playback_path(i + 1) : NULL;
+        chain_bytes += read_file(path, next);
+        g_free(next);
+        g_free(path);
+    }
+    gint64 chain_us = g_get_monotonic_time() - start;
+
+    /* Người xem khác mở lại segment cuối: còn trong page cache hay đã bị recording đẩy ra */
+    g_usleep((gulong)MAX(opt_duration - opt_duration / 3, 1) * G_USEC_PER_SEC / 2);
+    gchar *hot = playback_path(opt_files - 1);
+    start = g_get_monotonic_time();
+    guint64 hot_bytes = read_file(hot, NULL);
+    gint64 hot_us = g_get_monotonic_time() - start;
+    g_free(hot);
+
+    g_atomic_int_set(&running, 0);
+    for (gint i = 0; i < opt_writers; i++) {
+        g_thread_join(writers[i]);
+    }
+    g_free(writers);
+
+    g_print("{\"bench\":\"io_policy\",\"policy\":%s,\"writers\":%d,\"write_kb_s\":%d,"
+            "\"chain_read_mb_s\":%.1f,\"hot_reread_mb_s\":%.1f}\n",
+            opt_policy ? "true" : "false", opt_writers, opt_rate_kb,
+            mb_per_sec(chain_bytes, chain_us), mb_per_sec(hot_bytes, hot_us));
+
+    g_free(rec_dir);
+    g_free(playback_dir);
+    return 0;
+}
@@ -0,0 +1,17 @@
+TARGET = io_policy_bench
+TEMPLATE = app
+CONFIG -= qt
+
+SOURCES += \
+    io_policy_bench.c \
+    ../io_policy.c
+
+HEADERS += \
+    ../io_policy.h
+
+INCLUDEPATH += /usr/include/gstreamer-1.0 \
+               /usr/include/glib-2.0 \
+               /usr/lib/x86_64-linux-gnu/glib-2.0/include
+
+LIBS += -L/usr/lib/x86_64-linux-gnu \
+        -lgstreamer-1.0 -lgobject-2.0 -lglib-2.0 -lpthread
@@ -0,0 +1,597 @@
+/* Microbenchmark: các đường tra cứu recording cho playback.
+ *
+ * Build:  cd bench && qmake lookup_bench.pro && make
+ * Chạy:   ./lookup_bench --dir /dev/shm/lookup --cameras 100 --days 7
+ *         ./lookup_bench --dir /mnt/hdd/lookup --cameras 500 --days 30 --segment-sec 600 --drop-caches
+ *         ./lookup_bench --dir /dev/shm/lookup --baseline before.jsonl > after.jsonl
+ *
+ * Sinh cây recording giả (file rỗng, cùng layout với recording_manager:
+ * <quality>/<camera>/Y/m/d/H/<epoch>.mkv theo giờ local) và segment index tương ứng,
+ * sau đó đo từng hàm: latency p50/p99, số lần cấp phát và số syscall trên mỗi lần gọi.
+ * Mỗi benchmark in ra một dòng JSON. Với --baseline: so với kết quả cũ, exit 1 nếu chậm
+ * hơn (p50) hoặc cấp phát nhiều hơn quá --threshold phần trăm.
+ *
+ * Syscall đếm qua tracepoint raw_syscalls:sys_enter (perf_event_open), cần
+ * perf_event_paranoid <= 1 hoặc CAP_PERFMON; không có quyền thì in -1.
+ */
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <sys/vfs.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../recording_lookup.h"
+#include "../segment_index.h"
+#include "../storage_tiers.h"
+#include "../playback_factory.h"
+
+#define TMPFS_MAGIC 0x01021994
+
+static gchar *opt_dir = NULL;
+static gint opt_cameras = 16;
+static gint opt_days = 2;
+static gint opt_segment_sec = 120;
+static gint opt_requests = 2000;
+static gint opt_scan_requests = 50;
+static gint opt_micro_ops = 200000;
+static gint opt_duration = 300;
+static gboolean opt_no_index = FALSE;
+static gboolean opt_drop_caches = FALSE;
+static gboolean opt_keep = FALSE;
+static gchar *opt_baseline = NULL;
+static gint opt_threshold = 10;
+
+static GOptionEntry entries[] = {
+    { "dir", 'd', 0, G_OPTION_ARG_FILENAME, &opt_dir, "Tree root (tmpfs or the disk under test)", "DIR" },
+    { "cameras", 'c', 0, G_OPTION_ARG_INT, &opt_cameras, "Cameras in the tree (1-500)", "N" },
+    { "days", 'D', 0, G_OPTION_ARG_INT, &opt_days, "Days of recordings per camera", "N" },
+    { "segment-sec", 's', 0, G_OPTION_ARG_INT, &opt_segment_sec, "Segment length", "SEC" },
+    { "requests", 'n', 0, G_OPTION_ARG_INT, &opt_requests, "Requests per index benchmark", "N" },
+    { "scan-requests", 'S', 0, G_OPTION_ARG_INT, &opt_scan_requests, "Requests per directory-scan benchmark", "N" },
+    { "micro-ops", 'm', 0, G_OPTION_ARG_INT, &opt_micro_ops, "Calls per string-parsing benchmark", "N" },
+    { "duration", 0, 0, G_OPTION_ARG_INT, &opt_duration, "Playback duration per request", "SEC" },
+    { "no-index", 0, 0, G_OPTION_ARG_NONE, &opt_no_index, "Do not build the segment index", NULL },
+    { "drop-caches", 0, 0, G_OPTION_ARG_NONE, &opt_drop_caches, "Drop the page/dentry cache before each scan (root)", NULL },
+    { "keep", 'k', 0, G_OPTION_ARG_NONE, &opt_keep, "Reuse an existing tree and keep it afterwards", NULL },
+    { "baseline", 'b', 0, G_OPTION_ARG_FILENAME, &opt_baseline, "Previous output to compare against", "FILE" },
+    { "threshold", 't', 0, G_OPTION_ARG_INT, &opt_threshold, "Allowed regression (percent)", "PCT" },
+    { NULL }
+};
+
+/* ---- Đếm cấp phát: chặn malloc/calloc/realloc của cả process (glib dùng malloc hệ thống) ---- */
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static gboolean alloc_counting = FALSE;
+static guint64 alloc_count = 0;
+static guint64 alloc_bytes = 0;
+
+void *malloc(size_t size) {
+    if (alloc_counting) {
+        alloc_count++;
+        alloc_bytes += size;
+    }
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size) {
+    if (alloc_counting) {
+        alloc_count++;
+        alloc_bytes += n * size;
+    }
+    return __libc_calloc(n, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    if (alloc_counting) {
+        alloc_count++;
+        alloc_bytes += size;
+    }
+    return __libc_realloc(ptr, size);
+}
+
+/* ---- Đếm syscall ---- */
+
+static int syscall_fd = -1;
+
+static gint64 read_tracepoint_id(void) {
+    static const gchar *paths[] = {
+        "/sys/kernel/tracing/events/raw_syscalls/sys_enter/id",
+        "/sys/kernel/debug/tracing/events/raw_syscalls/sys_enter/id",
+        NULL
+    };
+
+    for (gint i = 0; paths[i]; i++) {
+        gchar *contents = NULL;
+        if (g_file_get_contents(paths[i], &contents, NULL, NULL)) {
+            gint64 id = g_ascii_strtoll(contents, NULL, 10);
+            g_free(contents);
+            return id;
+        }
+    }
+    return -1;
+}
+
+static void syscall_counter_open(void) {
+    gint64 id = read_tracepoint_id();
+    if (id < 0) return;
+
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_TRACEPOINT;
+    attr.size = sizeof(attr);
+    attr.config = (guint64)id;
+    attr.disabled = 1;
+    attr.sample_period = 0;
+
+    syscall_fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+    if (syscall_fd < 0) {
+        g_printerr("[bench] Syscall counting unavailable (perf_event_open failed)\n");
+    }
+}
+
+static gint64 syscall_counter_read(void) {
+    guint64 value = 0;
+    if (syscall_fd < 0 || read(syscall_fd, &value, sizeof(value)) != sizeof(value)) return -1;
+    return (gint64)value;
+}
+
+/* ---- Kết quả ---- */
+
+typedef struct {
+    const gchar *name;
+    GArray *samples_ns;     /* gint64, một mẫu mỗi lần gọi (hoặc mỗi batch) */
+    guint64 ops;
+    guint64 allocs;
+    guint64 bytes;
+    gint64 syscalls;        /* -1 nếu không đếm được */
+} BenchResult;
+
+static void bench_begin(BenchResult *r, const gchar *name) {
+    memset(r, 0, sizeof(*r));
+    r->name = name;
+    r->samples_ns = g_array_new(FALSE, FALSE, sizeof(gint64));
+    r->syscalls = syscall_fd >= 0 ? 0 : -1;
+}
+
+static gint64 now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (gint64)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* Bắt đầu/kết thúc vùng đo; mẫu latency = thời gian vùng / ops */
+static gint64 measure_start(void) {
+    if (syscall_fd >= 0) {
+        ioctl(syscall_fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(syscall_fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+    alloc_count = 0;
+    alloc_bytes = 0;
+    alloc_counting = TRUE;
+    return now_ns();
+}
+
+static void measure_stop(BenchResult *r, gint64 start, guint ops) {
+    gint64 elapsed = now_ns() - start;
+    alloc_counting = FALSE;
+
+    if (syscall_fd >= 0) {
+        ioctl(syscall_fd, PERF_EVENT_IOC_DISABLE, 0);
+        /* Trừ chính ioctl DISABLE (sys_enter của nó đã được đếm) */
+        gint64 n = syscall_counter_read();
+        if (n > 0) n--;
+        r->syscalls = (n < 0 || r->syscalls < 0) ? -1 : r->syscalls + n;
+    }
+
+    gint64 per_op = ops > 0 ? elapsed / ops : elapsed;
+    g_array_append_val(r->samples_ns, per_op);
+    r->ops += ops;
+    r->allocs += alloc_count;
+    r->bytes += alloc_bytes;
+}
+
+static gint compare_gint64(gconstpointer a, gconstpointer b) {
+    gint64 x = *(const gint64 *)a;
+    gint64 y = *(const gint64 *)b;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+static gdouble percentile_us(GArray *samples, gdouble pct) {
+    if (samples->len == 0) return 0;
+    guint idx = (guint)(pct / 100.0 * (samples->len - 1) + 0.5);
+    return g_array_index(samples, gint64, idx) / 1000.0;
+}
+
+static GHashTable *baseline = NULL; /* name -> gdouble[2] {p50_us, allocs_per_op} */
+static gint regressions = 0;
+
+static void check_baseline(const gchar *name, gdouble p50_us, gdouble allocs_per_op) {
+    gdouble *old = baseline ? g_hash_table_lookup(baseline, name) : NULL;
+    if (!old) return;
+
+    gdouble limit = 1.0 + opt_threshold / 100.0;
+    if (old[0] > 0 && p50_us > old[0] * limit) {
+        g_printerr("[bench] REGRESSION %s: p50 %.3f us -> %.3f us (+%.1f%%)\n",
+                   name, old[0], p50_us, (p50_us / old[0] - 1.0) * 100.0);
+        regressions++;
+    }
+    /* Cấp phát tất định: cho phép lệch +1 (làm tròn) */
+    if (allocs_per_op > old[1] * limit + 1.0) {
+        g_printerr("[bench] REGRESSION %s: allocs/op %.1f -> %.1f\n", name, old[1], allocs_per_op);
+        regressions++;
+    }
+}
+
+static void bench_end(BenchResult *r) {
+    g_array_sort(r->samples_ns, compare_gint64);
+
+    gdouble ops = r->ops > 0 ? (gdouble)r->ops : 1.0;
+    gdouble p50 = percentile_us(r->samples_ns, 50);
+    gdouble p99 = percentile_us(r->samples_ns, 99);
+    gdouble allocs = r->allocs / ops;
+
+    printf("{\"name\":\"%s\",\"ops\":%" G_GUINT64_FORMAT ",\"p50_us\":%.3f,\"p99_us\":%.3f,"
+           "\"allocs_per_op\":%.1f,\"bytes_per_op\":%.0f,\"syscalls_per_op\":%.1f}\n",
+           r->name, r->ops, p50, p99, allocs, r->bytes / ops,
+           r->syscalls < 0 ? -1.0 : r->syscalls / ops);
+    fflush(stdout);
+
+    check_baseline(r->name, p50, allocs);
+    g_array_unref(r->samples_ns);
+}
+
+static void load_baseline(const gchar *path) {
+    gchar *contents = NULL;
+    if (!g_file_get_contents(path, &contents, NULL, NULL)) {
+        g_printerr("[bench] Cannot read baseline %s\n", path);
+        return;
+    }
+
+    GRegex *re = g_regex_new("\"name\":\"([^\"]+)\".*\"p50_us\":([0-9.]+).*\"allocs_per_op\":([0-9.]+)",
+                             0, 0, NULL);
+    gchar **lines = g_strsplit(contents, "\n", -1);
+    baseline = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+
+    for (gint i = 0; lines[i]; i++) {
+        GMatchInfo *match = NULL;
+        if (g_regex_match(re, lines[i], 0, &match)) {
+            gdouble *v = g_new(gdouble, 2);
+            gchar *p50 = g_match_info_fetch(match, 2);
+            gchar *allocs = g_match_info_fetch(match, 3);
+            v[0] = g_ascii_strtod(p50, NULL);
+            v[1] = g_ascii_strtod(allocs, NULL);
+            g_hash_table_replace(baseline, g_match_info_fetch(match, 1), v);
+            g_free(p50);
+            g_free(allocs);
+        }
+        g_match_info_free(match);
+    }
+
+    g_strfreev(lines);
+    g_regex_unref(re);
+    g_free(contents);
+}
+
+/* ---- Cây recording giả ---- */
+
+static gint64 tree_end_ts = 0;
+static gint64 tree_start_ts = 0;
+static guint64 tree_segments = 0;
+
+static gchar* camera_name(gint index) {
+    return g_strdup_printf("cam%03d", index);
+}
+
+static gchar* segment_path(const gchar *camera, gint64 ts) {
+    time_t t = (time_t)ts;
+    struct tm tm;
+    localtime_r(&t, &tm);
+    return g_strdup_printf("%s/%s/%s/%04d/%02d/%02d/%02d/%" G_GINT64_FORMAT ".mkv",
+                           opt_dir, RECORD_HI_QUALITY, camera,
+                           tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, ts);
+}
+
+static gchar* tree_stamp(void) {
+    return g_strdup_printf("%d %d %d\n", opt_cameras, opt_days, opt_segment_sec);
+}
+
+/* Cây (và index) có sẵn trong opt_dir được sinh với cùng tham số: lấy lại thời điểm kết thúc */
+static gboolean tree_reusable(void) {
+    gchar *path = g_build_filename(opt_dir, ".bench-tree", NULL);
+    gchar *expected = tree_stamp();
+    gchar *contents = NULL;
+    gboolean ok = FALSE;
+
+    if (g_file_get_contents(path, &contents, NULL, NULL) && g_str_has_prefix(contents, expected)) {
+        tree_end_ts = g_ascii_strtoll(contents + strlen(expected), NULL, 10);
+        ok = tree_end_ts > 0;
+    }
+
+    g_free(contents);
+    g_free(expected);
+    g_free(path);
+    return ok;
+}
+
+static void remove_tree(void) {
+    gchar *cmd = g_strdup_printf("rm -rf '%s'", opt_dir);
+    if (system(cmd) != 0) g_printerr("[bench] Cannot clean %s\n", opt_dir);
+    g_free(cmd);
+}
+
+static void generate_tree(void) {
+    gint64 begin = g_get_monotonic_time();
+    gchar *last_dir = NULL;
+
+    for (gint c = 0; c < opt_cameras; c++) {
+        gchar *camera = camera_name(c);
+        for (gint64 ts = tree_start_ts; ts < tree_end_ts; ts += opt_segment_sec) {
+            gchar *path = segment_path(camera, ts);
+            gchar *dir = g_path_get_dirname(path);
+            if (g_strcmp0(dir, last_dir) != 0) {
+                g_mkdir_with_parents(dir, 0755);
+                g_free(last_dir);
+                last_dir = g_strdup(dir);
+            }
+
+            int fd = g_open(path, O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+            if (fd >= 0) close(fd);
+            if (!opt_no_index) {
+                segment_index_add(camera, STREAM_MAIN, ts * G_USEC_PER_SEC,
+                                  (ts + opt_segment_sec) * G_USEC_PER_SEC, path, 0);
+            }
+            g_free(dir);
+            g_free(path);
+        }
+        g_free(camera);
+    }
+    g_free(last_dir);
+
+    gchar *stamp_path = g_build_filename(opt_dir, ".bench-tree", NULL);
+    gchar *stamp = tree_stamp();
+    gchar *contents = g_strdup_printf("%s%" G_GINT64_FORMAT "\n", stamp, tree_end_ts);
+    g_file_set_contents(stamp_path, contents, -1, NULL);
+    g_free(contents);
+    g_free(stamp);
+    g_free(stamp_path);
+
+    g_printerr("[bench] Generated %" G_GUINT64_FORMAT " segments in %.1f s\n",
+               tree_segments, (g_get_monotonic_time() - begin) / 1e6);
+}
+
+static void drop_caches(void) {
+    if (!opt_drop_caches) return;
+    sync();
+    if (!g_file_set_contents("/proc/sys/vm/drop_caches", "3", 1, NULL)) {
+        g_printerr("[bench] Cannot drop caches (needs root), continuing warm\n");
+        opt_drop_caches = FALSE;
+    }
+}
+
+static const gchar* fs_type(const gchar *path) {
+    struct statfs st;
+    if (statfs(path, &st) != 0) return "unknown";
+    switch ((unsigned long)st.f_type) {
+    case TMPFS_MAGIC: return "tmpfs";
+    case 0xEF53:      return "ext4";
+    case 0x58465342:  return "xfs";
+    case 0x9123683E:  return "btrfs";
+    default:          return "other";
+    }
+}
+
+/* Timestamp yêu cầu ngẫu nhiên, giữa một segment, đủ chỗ cho duration */
+static gint64 random_request_us(GRand *rand) {
+    gint64 last = MAX(tree_start_ts + 1, tree_end_ts - opt_duration);
+    gint64 offset = g_rand_int_range(rand, 0, (gint32)(last - tree_start_ts));
+    return (tree_start_ts + offset) * G_USEC_PER_SEC + 500000;
+}
+
+/* Không đo thời gian in log (nhưng vẫn đo chi phí format chuỗi log) */
+static void discard_print(const gchar *string) {
+    (void)string;
+}
+
+/* ---- Benchmark ---- */
+
+static void bench_parse_query_param(void) {
+    static const gchar *query = "stream=main&timestamp=1731556800.250&duration=300&profile=low";
+    static const gchar *params[] = { "stream", "timestamp", "duration", "missing" };
+    const guint batch = 1000;
+    BenchResult r;
+
+    bench_begin(&r, "parse_query_param");
+    for (gint done = 0; done < opt_micro_ops; done += batch) {
+        gint64 start = measure_start();
+        for (guint i = 0; i < batch; i++) {
+            g_free(parse_query_param(query, params[i & 3]));
+        }
+        measure_stop(&r, start, batch);
+    }
+    bench_end(&r);
+}
+
+static void bench_path_to_timestamp(void) {
+    gchar *camera = camera_name(0);
+    gchar *epoch_path = segment_path(camera, tree_start_ts);
+    /* File splitmux (<epoch>_00001.mkv) vẫn parse theo tên; file không có epoch: theo thư mục giờ */
+    gchar *dir = g_path_get_dirname(epoch_path);
+    gchar *hour_path = g_build_filename(dir, "segment_00001.mkv", NULL);
+    const guint batch = 1000;
+    time_t ts;
+    BenchResult r;
+
+    bench_begin(&r, "path_to_timestamp/epoch");
+    for (gint done = 0; done < opt_micro_ops; done += batch) {
+        gint64 start = measure_start();
+        for (guint i = 0; i < batch; i++) path_to_timestamp(epoch_path, &ts);
+        measure_stop(&r, start, batch);
+    }
+    bench_end(&r);
+
+    bench_begin(&r, "path_to_timestamp/hour_dir");
+    for (gint done = 0; done < opt_micro_ops; done += batch) {
+        gint64 start = measure_start();
+        for (guint i = 0; i < batch; i++) path_to_timestamp(hour_path, &ts);
+        measure_stop(&r, start, batch);
+    }
+    bench_end(&r);
+
+    g_free(hour_path);
+    g_free(dir);
+    g_free(epoch_path);
+    g_free(camera);
+}
+
+static void bench_scan_recordings(GRand *rand) {
+    BenchResult r;
+
+    bench_begin(&r, "scan_recordings_recursive");
+    for (gint i = 0; i < opt_scan_requests; i++) {
+        gchar *camera = camera_name(g_rand_int_range(rand, 0, opt_cameras));
+        gchar *base = g_strdup_printf("%s/%s/%s", opt_dir, RECORD_HI_QUALITY, camera);
+        GList *files = NULL;
+
+        drop_caches();
+        gint64 start = measure_start();
+        scan_recordings_recursive(base, &files);
+        g_list_free_full(files, g_free);
+        measure_stop(&r, start, 1);
+
+        g_free(base);
+        g_free(camera);
+    }
+    bench_end(&r);
+}
+
+static void bench_lookup(GRand *rand, const gchar *name, gint requests, gboolean cold_index) {
+    BenchResult r;
+
+    bench_begin(&r, name);
+    for (gint i = 0; i < requests; i++) {
+        gchar *camera = camera_name(g_rand_int_range(rand, 0, opt_cameras));
+        gint64 start_us = random_request_us(rand);
+        GArray *clocks = g_array_new(FALSE, TRUE, sizeof(SegmentClock));
+
+        /* Index lạnh: bỏ cache ngày, lần tra cứu phải đọc lại log */
+        if (cold_index) segment_index_init(opt_dir);
+        if (opt_no_index) drop_caches();
+
+        gint64 start = measure_start();
+        GList *files = get_recording_files_from_timestamp(camera, start_us, STREAM_MAIN,
+                                                          opt_duration, clocks);
+        measure_stop(&r, start, 1);
+
+        if (!files) g_printerr("[bench] %s: no files for %s @ %" G_GINT64_FORMAT "\n",
+                               name, camera, start_us);
+        g_list_free_full(files, g_free);
+        g_array_unref(clocks);
+        g_free(camera);
+    }
+    bench_end(&r);
+}
+
+static void bench_find_recording_file(GRand *rand) {
+    BenchResult r;
+
+    bench_begin(&r, "search_recordings_recursive");
+    for (gint i = 0; i < opt_scan_requests; i++) {
+        gchar *camera = camera_name(g_rand_int_range(rand, 0, opt_cameras));
+        gint64 ts = tree_start_ts + (random_request_us(rand) / G_USEC_PER_SEC - tree_start_ts) /
+                    opt_segment_sec * opt_segment_sec;
+
+        drop_caches();
+        gint64 start = measure_start();
+        gchar *path = find_recording_file(camera, ts, STREAM_MAIN);
+        measure_stop(&r, start, 1);
+
+        if (!path) g_printerr("[bench] search: no file for %s @ %" G_GINT64_FORMAT "\n", camera, ts);
+        g_free(path);
+        g_free(camera);
+    }
+    bench_end(&r);
+}
+
+int main(int argc, char *argv[]) {
+    GError *error = NULL;
+    GOptionContext *context = g_option_context_new("- recording lookup microbenchmarks");
+    g_option_context_add_main_entries(context, entries, NULL);
+    if (!g_option_context_parse(context, &argc, &argv, &error)) {
+        g_printerr("%s\n", error->message);
+        return 2;
+    }
+    g_option_context_free(context);
+
+    if (!opt_dir) {
+        g_printerr("--dir is required\n");
+        return 2;
+    }
+    opt_cameras = CLAMP(opt_cameras, 1, 500);
+    opt_days = MAX(opt_days, 1);
+    opt_segment_sec = MAX(opt_segment_sec, 1);
+
+    /* Cây kết thúc ở đầu giờ gần nhất; --keep dùng lại cây (và index) cùng tham số */
+    gboolean reuse = opt_keep && !opt_no_index && tree_reusable();
+    if (!reuse) {
+        tree_end_ts = g_get_real_time() / G_USEC_PER_SEC / 3600 * 3600;
+        remove_tree();
+    }
+    tree_start_ts = tree_end_ts - (gint64)opt_days * 86400;
+    tree_segments = (guint64)((tree_end_ts - tree_start_ts) / opt_segment_sec) * opt_cameras;
+    g_mkdir_with_parents(opt_dir, 0755);
+
+    /* Tier duy nhất = thư mục benchmark: fallback scan và find_recording_file tìm ở đây */
+    storage_tiers_add("bench", opt_dir, 100, 0);
+    if (!opt_no_index) segment_index_init(opt_dir);
+    if (opt_baseline) load_baseline(opt_baseline);
+
+    if (reuse) {
+        g_printerr("[bench] Reusing tree in %s\n", opt_dir);
+    } else {
+        generate_tree();
+    }
+    syscall_counter_open();
+
+    printf("{\"name\":\"tree\",\"cameras\":%d,\"days\":%d,\"segment_sec\":%d,"
+           "\"segments\":%" G_GUINT64_FORMAT ",\"fs\":\"%s\",\"index\":%s,\"drop_caches\":%s}\n",
+           opt_cameras, opt_days, opt_segment_sec, tree_segments, fs_type(opt_dir),
+           opt_no_index ? "false" : "true", opt_drop_caches ? "true" : "false");
+    fflush(stdout);
+
+    g_set_print_handler(discard_print);
+    GRand *rand = g_rand_new_with_seed(42);
+
+    bench_parse_query_param();
+    bench_path_to_timestamp();
+    bench_scan_recordings(rand);
+    if (!opt_no_index) {
+        bench_lookup(rand, "get_recording_files/index_warm", opt_requests, FALSE);
+        bench_lookup(rand, "get_recording_files/index_cold", opt_requests, TRUE);
+    } else {
+        bench_lookup(rand, "get_recording_files/scan", opt_scan_requests, FALSE);
+    }
+    bench_find_recording_file(rand);
+
+    g_rand_free(rand);
+    g_set_print_handler(NULL);
+
+    if (syscall_fd >= 0) close(syscall_fd);
+    if (baseline) g_hash_table_unref(baseline);
+    if (!opt_keep) remove_tree();
+
+    if (regressions > 0) {
+        g_printerr("[bench] %d regression(s) over %d%% against %s\n",
+                   regressions, opt_threshold, opt_baseline);
+        return 1;
+    }
+    return 0;
+}
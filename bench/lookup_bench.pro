@@ -0,0 +1,23 @@
+TARGET = lookup_bench
+TEMPLATE = app
+CONFIG -= qt
+
+SOURCES += \
+    lookup_bench.c \
+    ../playback_factory.c \
+    ../recording_lookup.c \
+    ../segment_index.c \
+    ../storage_tiers.c
+
+HEADERS += \
+    ../playback_factory.h \
+    ../recording_lookup.h \
+    ../segment_index.h \
+    ../storage_tiers.h
+
+INCLUDEPATH += /usr/include/gstreamer-1.0 \
+               /usr/include/glib-2.0 \
+               /usr/lib/x86_64-linux-gnu/glib-2.0/include
+
+LIBS += -L/usr/lib/x86_64-linux-gnu \
+        -lgstrtspserver-1.0 -lgstreamer-1.0 -lgobject-2.0 -lglib-2.0 -lpthread
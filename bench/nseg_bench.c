@@ -0,0 +1,229 @@
+/* Benchmark: số session playback mỗi core, Matroska so với native segment.
+ *
+ * Build:  cd bench && qmake nseg_bench.pro && make
+ * Chạy:   ./nseg_bench --dir /dev/shm/nseg --sessions 16
+ *         ./nseg_bench --dir /mnt/nvme/nseg --input /path/1718000000.mkv --sessions 32 --rounds 5
+ *
+ * Tạo (hoặc dùng --input) một segment H.264 MKV, chuyển sang .nseg, rồi với mỗi định dạng
+ * chạy --sessions pipeline playback song song trong cùng process, giống đường playback
+ * của server tới payloader:
+ *   mkv:    segmentcachesrc ! matroskademux ! h264parse ! rtph264pay ! fakesink sync=false
+ *   native: nativesegmentsrc ! h264parse ! rtph264pay ! fakesink sync=false
+ * CPU (user+sys, getrusage) chia cho thời lượng media đã phát ra sessions_per_core:
+ * số session realtime một core phục vụ được. Mỗi định dạng in một dòng JSON.
+ */
+#include <gst/gst.h>
+#include <glib/gstdio.h>
+#include <sys/resource.h>
+#include <stdio.h>
+#include "../native_segment.h"
+#include "../segment_cache.h"
+
+static gchar *opt_dir = NULL;
+static gchar *opt_input = NULL;
+static gint opt_seconds = 60;
+static gint opt_sessions = 8;
+static gint opt_rounds = 3;
+static gboolean opt_keep = FALSE;
+
+static GOptionEntry entries[] = {
+    { "dir", 'd', 0, G_OPTION_ARG_FILENAME, &opt_dir, "Working directory for the test segments", "DIR" },
+    { "input", 'i', 0, G_OPTION_ARG_FILENAME, &opt_input, "Existing H.264 MKV segment instead of a generated one", "FILE" },
+    { "seconds", 's', 0, G_OPTION_ARG_INT, &opt_seconds, "Length of the generated segment", "SEC" },
+    { "sessions", 'n', 0, G_OPTION_ARG_INT, &opt_sessions, "Concurrent playback sessions", "N" },
+    { "rounds", 'r', 0, G_OPTION_ARG_INT, &opt_rounds, "Rounds per format (best round is reported)", "N" },
+    { "keep", 'k', 0, G_OPTION_ARG_NONE, &opt_keep, "Keep the generated segments", NULL },
+    { NULL }
+};
+
+static gdouble cpu_seconds(void) {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 +
+           ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+}
+
+static glong minor_faults(void) {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_minflt;
+}
+
+/* Chạy một pipeline tới EOS (tạo/chuyển file) */
+static gboolean run_to_eos(const gchar *launch) {
+    GError *error = NULL;
+    GstElement *pipeline = gst_parse_launch(launch, &error);
+
+    if (error) {
+        g_printerr("[bench] Pipeline error: %s\n", error->message);
+        g_error_free(error);
+        if (pipeline) gst_object_unref(pipeline);
+        return FALSE;
+    }
+
+    gst_element_set_state(pipeline, GST_STATE_PLAYING);
+    GstBus *bus = gst_element_get_bus(pipeline);
+    GstMessage *msg = gst_bus_timed_pop_filtered(bus, GST_CLOCK_TIME_NONE,
+                                                 GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+    gboolean ok = msg && GST_MESSAGE_TYPE(msg) == GST_MESSAGE_EOS;
+    if (msg) gst_message_unref(msg);
+    gst_object_unref(bus);
+
+    gst_element_set_state(pipeline, GST_STATE_NULL);
+    gst_object_unref(pipeline);
+    return ok;
+}
+
+typedef struct {
+    gdouble wall;
+    gdouble cpu;
+    glong faults;
+    guint failed;
+} RoundResult;
+
+/* --sessions pipeline chạy song song; chờ tất cả EOS */
+static RoundResult run_round(const gchar *launch) {
+    RoundResult result = {0};
+    GstElement **pipelines = g_new0(GstElement *, opt_sessions);
+    GstBus **buses = g_new0(GstBus *, opt_sessions);
+
+    for (gint i = 0; i < opt_sessions; i++) {
+        pipelines[i] = gst_parse_launch(launch, NULL);
+        buses[i] = pipelines[i] ? gst_element_get_bus(pipelines[i]) : NULL;
+    }
+
+    gdouble cpu_start = cpu_seconds();
+    glong faults_start = minor_faults();
+    gint64 wall_start = g_get_monotonic_time();
+
+    for (gint i = 0; i < opt_sessions; i++) {
+        if (pipelines[i]) gst_element_set_state(pipelines[i], GST_STATE_PLAYING);
+    }
+
+    for (gint i = 0; i < opt_sessions; i++) {
+        if (!pipelines[i]) {
+            result.failed++;
+            continue;
+        }
+        GstMessage *msg = gst_bus_timed_pop_filtered(buses[i], GST_CLOCK_TIME_NONE,
+                                                     GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+        if (!msg || GST_MESSAGE_TYPE(msg) != GST_MESSAGE_EOS) result.failed++;
+        if (msg) gst_message_unref(msg);
+    }
+
+    result.wall = (g_get_monotonic_time() - wall_start) / 1e6;
+    result.cpu = cpu_seconds() - cpu_start;
+    result.faults = minor_faults() - faults_start;
+
+    for (gint i = 0; i < opt_sessions; i++) {
+        if (!pipelines[i]) continue;
+        gst_element_set_state(pipelines[i], GST_STATE_NULL);
+        gst_object_unref(buses[i]);
+        gst_object_unref(pipelines[i]);
+    }
+    g_free(pipelines);
+    g_free(buses);
+    return result;
+}
+
+static gdouble bench_format(const gchar *name, const gchar *launch, gdouble media_seconds) {
+    RoundResult best = {0};
+
+    /* Round đầu làm nóng page cache; báo round tốn ít CPU nhất */
+    run_round(launch);
+    for (gint r = 0; r < opt_rounds; r++) {
+        RoundResult result = run_round(launch);
+        if (r == 0 || result.cpu < best.cpu) best = result;
+    }
+
+    gdouble total_media = media_seconds * opt_sessions;
+    gdouble per_core = best.cpu > 0 ? total_media / best.cpu : 0;
+    printf("{\"name\":\"%s\",\"sessions\":%d,\"media_sec\":%.1f,\"wall_sec\":%.3f,"
+           "\"cpu_sec\":%.3f,\"minor_faults\":%ld,\"failed\":%u,\"sessions_per_core\":%.1f}\n",
+           name, opt_sessions, total_media, best.wall, best.cpu, best.faults, best.failed, per_core);
+    fflush(stdout);
+    return per_core;
+}
+
+int main(int argc, char *argv[]) {
+    GError *error = NULL;
+    GOptionContext *context = g_option_context_new("- playback sessions per core, mkv vs native segment");
+    g_option_context_add_main_entries(context, entries, NULL);
+    g_option_context_add_group(context, gst_init_get_option_group());
+    if (!g_option_context_parse(context, &argc, &argv, &error)) {
+        g_printerr("%s\n", error->message);
+        return 2;
+    }
+    g_option_context_free(context);
+
+    if (!opt_dir) {
+        g_printerr("--dir is required\n");
+        return 2;
+    }
+    opt_sessions = CLAMP(opt_sessions, 1, 1024);
+    opt_rounds = MAX(opt_rounds, 1);
+    opt_seconds = MAX(opt_seconds, 1);
+
+    gst_init(&argc, &argv);
+    segment_cache_init(SEGMENT_CACHE_MAX_BYTES);
+    native_segment_init();
+    g_mkdir_with_parents(opt_dir, 0755);
+
+    gchar *mkv_path = opt_input ? g_strdup(opt_input) : g_build_filename(opt_dir, "bench.mkv", NULL);
+    gchar *nseg_path = g_build_filename(opt_dir, "bench" NATIVE_SEGMENT_EXT, NULL);
+    gboolean ok = TRUE;
+
+    if (!opt_input) {
+        /* 720p25, GOP 2 s như camera thường gặp */
+        gchar *launch = g_strdup_printf(
+            "videotestsrc num-buffers=%d pattern=ball ! "
+            "video/x-raw,width=1280,height=720,framerate=25/1 ! "
+            "x264enc tune=zerolatency speed-preset=ultrafast bitrate=2048 key-int-max=50 ! "
+            "h264parse ! matroskamux ! filesink location=\"%s\"",
+            opt_seconds * 25, mkv_path);
+        g_printerr("[bench] Generating %d s test segment...\n", opt_seconds);
+        ok = run_to_eos(launch);
+        g_free(launch);
+    }
+
+    if (ok) {
+        gchar *launch = g_strdup_printf(
+            "filesrc location=\"%s\" ! matroskademux ! h264parse ! "
+            NATIVE_SEGMENT_SINK_NAME " location=\"%s\"",
+            mkv_path, nseg_path);
+        ok = run_to_eos(launch);
+        g_free(launch);
+    }
+
+    NativeSegment *segment = ok ? native_segment_open(nseg_path, NULL) : NULL;
+    if (!segment) {
+        g_printerr("[bench] Could not prepare test segments\n");
+        return 1;
+    }
+    gdouble media_seconds = native_segment_duration(segment) / 1e9;
+    native_segment_unref(segment);
+
+    gchar *mkv_launch = g_strdup_printf(
+        "segmentcachesrc location=\"%s\" ! matroskademux ! h264parse ! "
+        "rtph264pay pt=96 config-interval=-1 mtu=1400 ! fakesink sync=false",
+        mkv_path);
+    gchar *native_launch = g_strdup_printf(
+        NATIVE_SEGMENT_SRC_NAME " location=\"%s\" ! h264parse ! "
+        "rtph264pay pt=96 config-interval=-1 mtu=1400 ! fakesink sync=false",
+        nseg_path);
+
+    gdouble mkv = bench_format("mkv", mkv_launch, media_seconds);
+    gdouble native = bench_format("native", native_launch, media_seconds);
+    printf("{\"name\":\"speedup\",\"native_over_mkv\":%.2f}\n", mkv > 0 ? native / mkv : 0);
+
+    g_free(mkv_launch);
+    g_free(native_launch);
+
+    if (!opt_keep) {
+        if (!opt_input) g_unlink(mkv_path);
+        g_unlink(nseg_path);
+    }
+    g_free(mkv_path);
+    g_free(nseg_path);
+    return 0;
+}
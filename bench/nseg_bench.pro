@@ -0,0 +1,21 @@
+TARGET = nseg_bench
+TEMPLATE = app
+CONFIG -= qt
+
+SOURCES += \
+    nseg_bench.c \
+    ../io_policy.c \
+    ../native_segment.c \
+    ../segment_cache.c
+
+HEADERS += \
+    ../io_policy.h \
+    ../native_segment.h \
+    ../segment_cache.h
+
+INCLUDEPATH += /usr/include/gstreamer-1.0 \
+               /usr/include/glib-2.0 \
+               /usr/lib/x86_64-linux-gnu/glib-2.0/include
+
+LIBS += -L/usr/lib/x86_64-linux-gnu \
+        -lgstbase-1.0 -lgstreamer-1.0 -lgobject-2.0 -lglib-2.0 -lpthread
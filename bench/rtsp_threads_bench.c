@@ -0,0 +1,371 @@
+/* Benchmark: latency request RTSP theo số thread của pool khi có nhiều session.
+ *
+ * Build:  cd bench && qmake rtsp_threads_bench.pro && make
+ * Chạy:   ./rtsp_threads_bench --sessions 1000 --threads 0,1,2,4,8 --rounds 20
+ *
+ * Với mỗi giá trị --threads: khởi động server trong process (mount test nhẹ, shared),
+ * mở N kết nối, mỗi kết nối DESCRIBE + SETUP (interleaved) để giữ session.
+ * Sau đó mỗi round gửi GET_PARAMETER đồng thời trên tất cả kết nối và đo thời gian
+ * tới khi nhận response. Mỗi cấu hình in ra một dòng JSON.
+ */
+#include <gst/gst.h>
+#include <gst/rtsp-server/rtsp-server.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include "../rtsp_threads.h"
+
+#define BENCH_MOUNT "/bench"
+#define RESPONSE_MAX 4096
+
+static gint opt_sessions = 1000;
+static gchar *opt_threads = NULL;
+static gint opt_rounds = 20;
+static gint opt_port = 18554;
+static gchar *opt_rtsp_cpus = NULL;
+
+static GOptionEntry entries[] = {
+    { "sessions", 'n', 0, G_OPTION_ARG_INT, &opt_sessions, "Concurrent RTSP sessions", "N" },
+    { "threads", 't', 0, G_OPTION_ARG_STRING, &opt_threads, "Pool sizes to test (default 0,1,2,4,8)", "LIST" },
+    { "rounds", 'r', 0, G_OPTION_ARG_INT, &opt_rounds, "Request rounds per pool size", "N" },
+    { "port", 'p', 0, G_OPTION_ARG_INT, &opt_port, "First server port", "PORT" },
+    { "rtsp-cpus", 'c', 0, G_OPTION_ARG_STRING, &opt_rtsp_cpus, "Pin RTSP pool threads to CPUs", "LIST" },
+    { NULL }
+};
+
+typedef struct {
+    int fd;
+    gchar *session;
+    gint cseq;
+    gchar buf[RESPONSE_MAX];
+    gsize len;
+} BenchConn;
+
+/* ===== Server trong thread riêng ===== */
+
+typedef struct {
+    GMainContext *context;
+    GMainLoop *loop;
+    GstRTSPServer *server;
+    GThread *thread;
+    guint port;
+    gint max_threads;
+    GMutex lock;
+    GCond cond;
+    gboolean ready;
+} BenchServer;
+
+static gpointer server_thread_func(gpointer data) {
+    BenchServer *bs = data;
+
+    g_main_context_push_thread_default(bs->context);
+
+    bs->server = gst_rtsp_server_new();
+    gchar *service = g_strdup_printf("%u", bs->port);
+    gst_rtsp_server_set_service(bs->server, service);
+    g_free(service);
+    g_object_set(bs->server, "backlog", 1024, NULL);
+    rtsp_threads_setup(bs->server, bs->max_threads);
+
+    GstRTSPMediaFactory *factory = gst_rtsp_media_factory_new();
+    gst_rtsp_media_factory_set_launch(factory,
+        "( videotestsrc is-live=true pattern=black ! video/x-raw,width=16,height=16,framerate=1/1 ! "
+        "rtpvrawpay name=pay0 pt=96 )");
+    gst_rtsp_media_factory_set_shared(factory, TRUE);
+
+    GstRTSPMountPoints *mounts = gst_rtsp_server_get_mount_points(bs->server);
+    gst_rtsp_mount_points_add_factory(mounts, BENCH_MOUNT, factory);
+    g_object_unref(mounts);
+
+    gst_rtsp_server_attach(bs->server, bs->context);
+
+    g_mutex_lock(&bs->lock);
+    bs->ready = TRUE;
+    g_cond_signal(&bs->cond);
+    g_mutex_unlock(&bs->lock);
+
+    g_main_loop_run(bs->loop);
+
+    g_main_context_pop_thread_default(bs->context);
+    return NULL;
+}
+
+static BenchServer* server_start(guint port, gint max_threads) {
+    BenchServer *bs = g_new0(BenchServer, 1);
+    bs->context = g_main_context_new();
+    bs->loop = g_main_loop_new(bs->context, FALSE);
+    bs->port = port;
+    bs->max_threads = max_threads;
+    g_mutex_init(&bs->lock);
+    g_cond_init(&bs->cond);
+
+    bs->thread = g_thread_new("bench-server", server_thread_func, bs);
+
+    g_mutex_lock(&bs->lock);
+    while (!bs->ready) g_cond_wait(&bs->cond, &bs->lock);
+    g_mutex_unlock(&bs->lock);
+    return bs;
+}
+
+static void server_stop(BenchServer *bs) {
+    g_main_loop_quit(bs->loop);
+    g_thread_join(bs->thread);
+
+    GstRTSPSessionPool *pool = gst_rtsp_server_get_session_pool(bs->server);
+    gst_rtsp_session_pool_cleanup(pool);
+    g_object_unref(pool);
+    g_object_unref(bs->server);
+
+    g_main_loop_unref(bs->loop);
+    g_main_context_unref(bs->context);
+    g_mutex_clear(&bs->lock);
+    g_cond_clear(&bs->cond);
+    g_free(bs);
+}
+
+/* ===== Client ===== */
+
+static int conn_open(guint port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static gboolean conn_send(BenchConn *conn, const gchar *method, const gchar *url, const gchar *extra) {
+    GString *req = g_string_new(NULL);
+
+    g_string_append_printf(req, "%s %s RTSP/1.0\r\nCSeq: %d\r\n", method, url, ++conn->cseq);
+    if (conn->session) g_string_append_printf(req, "Session: %s\r\n", conn->session);
+    if (extra) g_string_append_printf(req, "%s\r\n", extra);
+    g_string_append(req, "\r\n");
+
+    gboolean ok = write(conn->fd, req->str, req->len) == (gssize)req->len;
+    g_string_free(req, TRUE);
+    return ok;
+}
+
+/* Một response RTSP hoàn chỉnh trong buffer (bỏ qua gói interleaved '$'), FALSE nếu chưa đủ */
+static gboolean conn_take_response(BenchConn *conn, gchar **response) {
+    for (;;) {
+        if (conn->len >= 4 && conn->buf[0] == '$') {
+            gsize frame = 4 + (((guint8)conn->buf[2] << 8) | (guint8)conn->buf[3]);
+            if (conn->len < frame) return FALSE;
+            memmove(conn->buf, conn->buf + frame, conn->len - frame);
+            conn->len -= frame;
+            continue;
+        }
+
+        gchar *end = g_strstr_len(conn->buf, conn->len, "\r\n\r\n");
+        if (!end) return FALSE;
+
+        gsize header_len = end + 4 - conn->buf;
+        gsize body_len = 0;
+        gchar *cl = g_strstr_len(conn->buf, header_len, "Content-Length:");
+        if (cl) body_len = strtoul(cl + 15, NULL, 10);
+        if (conn->len < header_len + body_len) return FALSE;
+
+        if (response) *response = g_strndup(conn->buf, header_len);
+        memmove(conn->buf, conn->buf + header_len + body_len, conn->len - header_len - body_len);
+        conn->len -= header_len + body_len;
+        return TRUE;
+    }
+}
+
+static gboolean conn_read(BenchConn *conn) {
+    if (conn->len == sizeof(conn->buf)) {
+        conn->len = 0;   /* không xảy ra với response nhỏ; tránh kẹt */
+    }
+    gssize n = read(conn->fd, conn->buf + conn->len, sizeof(conn->buf) - conn->len);
+    if (n <= 0) return FALSE;
+    conn->len += n;
+    return TRUE;
+}
+
+static gchar* conn_request(BenchConn *conn, const gchar *method, const gchar *url, const gchar *extra) {
+    gchar *response = NULL;
+    if (!conn_send(conn, method, url, extra)) return NULL;
+    while (!conn_take_response(conn, &response)) {
+        if (!conn_read(conn)) return NULL;
+    }
+    return response;
+}
+
+static gboolean conn_setup(BenchConn *conn, guint port) {
+    gchar *url = g_strdup_printf("rtsp://127.0.0.1:%u%s", port, BENCH_MOUNT);
+    gchar *setup_url = g_strdup_printf("%s/stream=0", url);
+    gboolean ok = FALSE;
+
+    conn->fd = conn_open(port);
+    if (conn->fd < 0) goto out;
+
+    gchar *resp = conn_request(conn, "DESCRIBE", url, "Accept: application/sdp");
+    if (!resp || !g_str_has_prefix(resp, "RTSP/1.0 200")) {
+        g_free(resp);
+        goto out;
+    }
+    g_free(resp);
+
+    resp = conn_request(conn, "SETUP", setup_url, "Transport: RTP/AVP/TCP;unicast;interleaved=0-1");
+    gchar *session = resp ? strstr(resp, "Session: ") : NULL;
+    if (session) {
+        session += 9;
+        conn->session = g_strndup(session, strcspn(session, ";\r\n"));
+        ok = TRUE;
+    }
+    g_free(resp);
+
+out:
+    g_free(setup_url);
+    g_free(url);
+    return ok;
+}
+
+static gint compare_double(gconstpointer a, gconstpointer b) {
+    gdouble x = *(const gdouble *)a, y = *(const gdouble *)b;
+    return x < y ? -1 : x > y;
+}
+
+static gdouble percentile(GArray *sorted, gdouble p) {
+    if (sorted->len == 0) return 0;
+    guint idx = (guint)(p * (sorted->len - 1));
+    return g_array_index(sorted, gdouble, idx);
+}
+
+/* Một round: gửi GET_PARAMETER trên mọi kết nối rồi poll tới khi đủ response */
+static void run_round(BenchConn *conns, gint count, const gchar *url, GArray *latencies, gint *errors) {
+    struct pollfd *pfds = g_new0(struct pollfd, count);
+    gint64 *sent_us = g_new0(gint64, count);
+    gint pending = 0;
+
+    for (gint i = 0; i < count; i++) {
+        pfds[i].fd = -1;
+        if (conns[i].fd < 0) continue;
+        sent_us[i] = g_get_monotonic_time();
+        if (conn_send(&conns[i], "GET_PARAMETER", url, NULL)) {
+            pfds[i].fd = conns[i].fd;
+            pfds[i].events = POLLIN;
+            pending++;
+        } else {
+            (*errors)++;
+        }
+    }
+
+    while (pending > 0) {
+        int ready = poll(pfds, count, 5000);
+        if (ready <= 0) {
+            *errors += pending;
+            break;
+        }
+
+        for (gint i = 0; i < count; i++) {
+            if (pfds[i].fd < 0 || !(pfds[i].revents & (POLLIN | POLLERR | POLLHUP))) continue;
+
+            gchar *response = NULL;
+            if (!conn_read(&conns[i])) {
+                (*errors)++;
+                pfds[i].fd = -1;
+                pending--;
+                continue;
+            }
+            if (conn_take_response(&conns[i], &response)) {
+                gdouble ms = (g_get_monotonic_time() - sent_us[i]) / 1000.0;
+                g_array_append_val(latencies, ms);
+                g_free(response);
+                pfds[i].fd = -1;
+                pending--;
+            }
+        }
+    }
+
+    g_free(sent_us);
+    g_free(pfds);
+}
+
+static void run_config(gint max_threads, guint port) {
+    BenchServer *bs = server_start(port, max_threads);
+    BenchConn *conns = g_new0(BenchConn, opt_sessions);
+    gchar *url = g_strdup_printf("rtsp://127.0.0.1:%u%s", port, BENCH_MOUNT);
+    gint established = 0, errors = 0;
+
+    gint64 setup_start = g_get_monotonic_time();
+    for (gint i = 0; i < opt_sessions; i++) {
+        if (conn_setup(&conns[i], port)) {
+            established++;
+        } else {
+            if (conns[i].fd >= 0) close(conns[i].fd);
+            conns[i].fd = -1;
+        }
+    }
+    gdouble setup_ms = (g_get_monotonic_time() - setup_start) / 1000.0;
+
+    GArray *latencies = g_array_new(FALSE, FALSE, sizeof(gdouble));
+    gint64 run_start = g_get_monotonic_time();
+    for (gint r = 0; r < opt_rounds; r++) {
+        run_round(conns, opt_sessions, url, latencies, &errors);
+    }
+    gdouble run_sec = (g_get_monotonic_time() - run_start) / (gdouble)G_USEC_PER_SEC;
+    g_array_sort(latencies, compare_double);
+
+    g_print("{\"threads\":%d,\"sessions\":%d,\"established\":%d,\"setup_ms\":%.1f,"
+            "\"requests\":%u,\"errors\":%d,\"req_per_sec\":%.0f,"
+            "\"p50_ms\":%.2f,\"p90_ms\":%.2f,\"p99_ms\":%.2f,\"max_ms\":%.2f}\n",
+            max_threads, opt_sessions, established, setup_ms,
+            latencies->len, errors, run_sec > 0 ? latencies->len / run_sec : 0,
+            percentile(latencies, 0.50), percentile(latencies, 0.90),
+            percentile(latencies, 0.99), percentile(latencies, 1.0));
+
+    for (gint i = 0; i < opt_sessions; i++) {
+        if (conns[i].fd >= 0) close(conns[i].fd);
+        g_free(conns[i].session);
+    }
+    g_array_unref(latencies);
+    g_free(conns);
+    g_free(url);
+    server_stop(bs);
+}
+
+int main(int argc, char *argv[]) {
+    GError *error = NULL;
+    GOptionContext *context = g_option_context_new("- RTSP thread pool benchmark");
+    g_option_context_add_main_entries(context, entries, NULL);
+    g_option_context_add_group(context, gst_init_get_option_group());
+    if (!g_option_context_parse(context, &argc, &argv, &error)) {
+        g_printerr("%s\n", error->message);
+        return 1;
+    }
+    g_option_context_free(context);
+
+    /* 1000 session = 1000 socket phía client + 1000 phía server */
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+
+    if (opt_rtsp_cpus) rtsp_threads_set_cpus(THREAD_ROLE_RTSP, opt_rtsp_cpus);
+
+    gchar **counts = g_strsplit(opt_threads ? opt_threads : "0,1,2,4,8", ",", -1);
+    for (gint i = 0; counts[i]; i++) {
+        run_config(atoi(counts[i]), opt_port + i);
+    }
+    g_strfreev(counts);
+    return 0;
+}
@@ -0,0 +1,17 @@
+TARGET = rtsp_threads_bench
+TEMPLATE = app
+CONFIG -= qt
+
+SOURCES += \
+    rtsp_threads_bench.c \
+    ../rtsp_threads.c
+
+HEADERS += \
+    ../rtsp_threads.h
+
+INCLUDEPATH += /usr/include/gstreamer-1.0 \
+               /usr/include/glib-2.0 \
+               /usr/lib/x86_64-linux-gnu/glib-2.0/include
+
+LIBS += -L/usr/lib/x86_64-linux-gnu \
+        -lgstrtspserver-1.0 -lgstrtsp-1.0 -lgstsdp-1.0 -lgstreamer-1.0 -lgobject-2.0 -lglib-2.0 -lpthread
@@ -0,0 +1,203 @@
+/* Benchmark: gói UDP mỗi giây trên một core của sender, sendto vs sendmmsg vs GSO, qua loopback.
+ *
+ * Build:  cd bench && qmake udp_egress_bench.pro && make
+ * Chạy:   ./udp_egress_bench --clients 16 --frames 20000
+ *         ./udp_egress_bench --clients 64 --packets 100 --mode gso
+ *
+ * Mỗi frame giả lập một access unit sau rtph264pay mtu=1400: một gói STAP-A (SPS/PPS) nhỏ,
+ * --packets - 2 gói FU-A đúng mtu và gói FU-A cuối ngắn hơn. Sender gửi từng frame tới
+ * --clients socket nhận trên 127.0.0.1 qua UdpBatch (cùng code với server); một thread
+ * khác đọc và đếm gói nhận được. CPU đo trên thread sender (CLOCK_THREAD_CPUTIME_ID):
+ * pps_per_core = datagram đã gửi / giây CPU của sender. Mỗi mode in một dòng JSON.
+ */
+#define _GNU_SOURCE   /* recvmmsg */
+#include <glib.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include "../udp_egress.h"
+
+#define RECV_BATCH 64
+
+static gint opt_clients = 8;
+static gint opt_frames = 10000;
+static gint opt_packets = 30;
+static gint opt_mtu = 1400;
+static gchar *opt_mode = NULL;
+
+static GOptionEntry entries[] = {
+    { "clients", 'c', 0, G_OPTION_ARG_INT, &opt_clients, "Receiving sockets (destinations)", "N" },
+    { "frames", 'f', 0, G_OPTION_ARG_INT, &opt_frames, "Access units sent per mode", "N" },
+    { "packets", 'p', 0, G_OPTION_ARG_INT, &opt_packets, "RTP packets per access unit", "N" },
+    { "mtu", 'm', 0, G_OPTION_ARG_INT, &opt_mtu, "RTP packet size", "BYTES" },
+    { "mode", 0, 0, G_OPTION_ARG_STRING, &opt_mode, "Only run sendto, sendmmsg or gso", "MODE" },
+    { NULL }
+};
+
+static int *recv_fds = NULL;
+static gint receiving = 0;
+static gint received = 0;
+
+static gdouble thread_cpu_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static gpointer receiver_thread(gpointer data) {
+    struct pollfd *pfds = g_new0(struct pollfd, opt_clients);
+    struct mmsghdr msgs[RECV_BATCH];
+    struct iovec iov[RECV_BATCH];
+    static guint8 buf[RECV_BATCH][2048];
+
+    for (gint i = 0; i < opt_clients; i++) {
+        pfds[i].fd = recv_fds[i];
+        pfds[i].events = POLLIN;
+    }
+    for (gint i = 0; i < RECV_BATCH; i++) {
+        iov[i].iov_base = buf[i];
+        iov[i].iov_len = sizeof(buf[i]);
+    }
+
+    while (g_atomic_int_get(&receiving)) {
+        if (poll(pfds, opt_clients, 50) <= 0) continue;
+        for (gint i = 0; i < opt_clients; i++) {
+            if (!(pfds[i].revents & POLLIN)) continue;
+            int n;
+            do {
+                memset(msgs, 0, sizeof(msgs));
+                for (gint k = 0; k < RECV_BATCH; k++) {
+                    msgs[k].msg_hdr.msg_iov = &iov[k];
+                    msgs[k].msg_hdr.msg_iovlen = 1;
+                }
+                n = recvmmsg(pfds[i].fd, msgs, RECV_BATCH, MSG_DONTWAIT, NULL);
+                if (n > 0) g_atomic_int_add(&received, n);
+            } while (n == RECV_BATCH);
+        }
+    }
+
+    g_free(pfds);
+    return NULL;
+}
+
+static void run_mode(UdpEgressMode requested, int send_fd, const UdpEgressDest *dests,
+                     guint8 **packets, const gsize *sizes) {
+    UdpEgressMode mode = udp_egress_init(requested);
+    if (mode != requested) {
+        printf("{\"mode\":\"%s\",\"skipped\":\"kernel supports only %s\"}\n",
+               udp_egress_mode_name(requested), udp_egress_mode_name(mode));
+        return;
+    }
+
+    UdpBatch *batch = udp_batch_new();
+    g_atomic_int_set(&received, 0);
+
+    gint64 wall_start = g_get_monotonic_time();
+    gdouble cpu_start = thread_cpu_seconds();
+
+    for (gint f = 0; f < opt_frames; f++) {
+        for (gint p = 0; p < opt_packets; p++) {
+            struct iovec iov = { packets[p], sizes[p] };
+            udp_batch_add(batch, &iov, 1);
+        }
+        udp_batch_flush(batch, send_fd, dests, opt_clients);
+        udp_batch_clear(batch);
+    }
+
+    gdouble cpu = thread_cpu_seconds() - cpu_start;
+    gdouble wall = (g_get_monotonic_time() - wall_start) / 1e6;
+    g_usleep(200 * 1000);   /* receiver đọc nốt */
+
+    guint64 sent, syscalls, dropped;
+    udp_batch_get_stats(batch, &sent, &syscalls, &dropped);
+    /* GSO có thể đã tự hạ xuống sendmmsg giữa chừng (NIC/kernel từ chối) */
+    printf("{\"mode\":\"%s\",\"effective\":\"%s\",\"clients\":%d,\"packets_per_frame\":%d,"
+           "\"datagrams\":%" G_GUINT64_FORMAT ",\"syscalls\":%" G_GUINT64_FORMAT ","
+           "\"dropped\":%" G_GUINT64_FORMAT ",\"received\":%d,"
+           "\"cpu_sec\":%.3f,\"wall_sec\":%.3f,\"pps_per_core\":%.0f}\n",
+           udp_egress_mode_name(requested), udp_egress_mode_name(udp_egress_mode()),
+           opt_clients, opt_packets, sent, syscalls, dropped,
+           g_atomic_int_get(&received), cpu, wall, cpu > 0 ? sent / cpu : 0);
+    fflush(stdout);
+    udp_batch_free(batch);
+}
+
+int main(int argc, char *argv[]) {
+    GError *error = NULL;
+    GOptionContext *context = g_option_context_new("- UDP egress packets per second per core");
+    g_option_context_add_main_entries(context, entries, NULL);
+    if (!g_option_context_parse(context, &argc, &argv, &error)) {
+        g_printerr("%s\n", error->message);
+        return 2;
+    }
+    g_option_context_free(context);
+
+    UdpEgressMode only = UDP_EGRESS_SENDTO;
+    if (opt_mode && !udp_egress_parse_mode(opt_mode, &only)) {
+        g_printerr("Unknown --mode %s\n", opt_mode);
+        return 2;
+    }
+    opt_clients = CLAMP(opt_clients, 1, 1024);
+    opt_packets = CLAMP(opt_packets, 2, UDP_EGRESS_MAX_PACKETS);
+    opt_mtu = CLAMP(opt_mtu, 64, 1472);
+
+    /* Đích: socket nhận trên loopback, buffer lớn để hạn chế drop phía nhận */
+    recv_fds = g_new0(int, opt_clients);
+    UdpEgressDest *dests = g_new0(UdpEgressDest, opt_clients);
+    for (gint i = 0; i < opt_clients; i++) {
+        struct sockaddr_in addr = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+        socklen_t len = sizeof(addr);
+        int rcvbuf = 8 * 1024 * 1024;
+
+        recv_fds[i] = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        setsockopt(recv_fds[i], SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+        if (recv_fds[i] < 0 || bind(recv_fds[i], (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+            getsockname(recv_fds[i], (struct sockaddr *)&addr, &len) != 0) {
+            g_printerr("Could not bind receiver %d\n", i);
+            return 1;
+        }
+        memcpy(&dests[i].addr, &addr, len);
+        dests[i].len = len;
+        dests[i].refs = 1;
+    }
+
+    /* Sender non-blocking giống socket của GstRTSPStream */
+    int send_fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    int sndbuf = 4 * 1024 * 1024;
+    setsockopt(send_fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+
+    /* Access unit mẫu: STAP-A, FU-A x (packets - 2), FU-A cuối */
+    guint8 **packets = g_new0(guint8 *, opt_packets);
+    gsize *sizes = g_new0(gsize, opt_packets);
+    for (gint p = 0; p < opt_packets; p++) {
+        sizes[p] = p == 0 ? 48 : (p == opt_packets - 1 ? (gsize)opt_mtu / 2 : (gsize)opt_mtu);
+        packets[p] = g_malloc0(sizes[p]);
+        packets[p][0] = 0x80;
+        packets[p][1] = 96 | (p == opt_packets - 1 ? 0x80 : 0);
+    }
+
+    g_atomic_int_set(&receiving, 1);
+    GThread *receiver = g_thread_new("bench-recv", receiver_thread, NULL);
+
+    for (gint mode = UDP_EGRESS_SENDTO; mode <= UDP_EGRESS_GSO; mode++) {
+        if (opt_mode && mode != (gint)only) continue;
+        run_mode((UdpEgressMode)mode, send_fd, dests, packets, sizes);
+    }
+
+    g_atomic_int_set(&receiving, 0);
+    g_thread_join(receiver);
+
+    for (gint p = 0; p < opt_packets; p++) g_free(packets[p]);
+    for (gint i = 0; i < opt_clients; i++) close(recv_fds[i]);
+    close(send_fd);
+    g_free(packets);
+    g_free(sizes);
+    g_free(dests);
+    g_free(recv_fds);
+    return 0;
+}
@@ -0,0 +1,17 @@
+TARGET = udp_egress_bench
+TEMPLATE = app
+CONFIG -= qt
+
+SOURCES += \
+    udp_egress_bench.c \
+    ../udp_egress.c
+
+HEADERS += \
+    ../udp_egress.h
+
+INCLUDEPATH += /usr/include/gstreamer-1.0 \
+               /usr/include/glib-2.0 \
+               /usr/lib/x86_64-linux-gnu/glib-2.0/include
+
+LIBS += -L/usr/lib/x86_64-linux-gnu \
+        -lgstrtspserver-1.0 -lgstreamer-1.0 -lgio-2.0 -lgobject-2.0 -lglib-2.0 -lpthread
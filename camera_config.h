@@ -9,6 +9,16 @@ typedef enum {
     CODEC_AUTO
 } CodecType;
 
+/* Thông tin stream phát hiện được từ SDP khi probe camera */
+typedef struct {
+    gboolean probed;
+    CodecType codec;
+    gchar *profile;
+    gint width;
+    gint height;
+    gchar *parameter_sets;   /* sprop-parameter-sets (H264) hoặc vps,sps,pps (H265) */
+} StreamProbeInfo;
+
 typedef struct {
     gchar *name;
     gchar *rtsp_url_main;
@@ -18,6 +28,9 @@ typedef struct {
     gboolean is_recording;
     gchar *current_record_file_main;
     gchar *current_record_file_sub;
+    StreamProbeInfo probe_main;
+    StreamProbeInfo probe_sub;
+    gchar *latency_profile;   /* tên latency profile của mount, NULL = mặc định */
 } CameraConfig;
 
 #endif
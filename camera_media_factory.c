@@ -4,6 +4,27 @@
 #include <time.h>
 #include "playback_factory.h"
 #include "recording_manager.h"
+#include "client_congestion.h"
+#include "camera_probe.h"
+#include "segment_index.h"
+#include "recording_lookup.h"
+#include "segment_clock.h"
+#include "storage_tiers.h"
+#include "segment_cache.h"
+#include "native_segment.h"
+#include "session_trace.h"
+#include "latency_measure.h"
+#include "latency_profile.h"
+#include "adaptive_stream.h"
+#include "rtsp_threads.h"
+#include "udp_egress.h"
+#include "profiling.h"
+#include "clip_playback.h"
+#include "dvr_buffer.h"
+
+/* Client mở cùng URL playback trong khoảng này dùng chung một media */
+#define PLAYBACK_SHARE_WINDOW_SEC 10
+#define PLAYBACK_SHARED_KEY "playback-shared"
 
 /* Seek parameters structure */
 typedef struct {
@@ -12,22 +33,19 @@ typedef struct {
     gboolean seek_pending;
 } SeekParams;
 
-/* Parse query parameter */
-static gchar* parse_query_param(const gchar *query, const gchar *param) {
-    if (!query) return NULL;
-    gchar *search = g_strdup_printf("%s=", param);
-    const gchar *pos = strstr(query, search);
-    g_free(search);
-    if (!pos) return NULL;
-    pos += strlen(param) + 1;
-    const gchar *end = strchr(pos, '&');
-    if (end) return g_strndup(pos, end - pos);
-    return g_strdup(pos);
-}
+/* Thế hệ media playback dùng chung cho một key (camera, stream, start, duration) */
+typedef struct {
+    guint generation;
+    gint64 created_us;
+} PlaybackShare;
 
 struct _CameraMediaFactory {
     GstRTSPMediaFactory parent;
     CameraConfig *camera;
+
+    GMutex share_lock;
+    GHashTable *playback_shares;   /* key -> PlaybackShare* */
+    guint next_generation;
 };
 
 G_DEFINE_TYPE(CameraMediaFactory, camera_media_factory, GST_TYPE_RTSP_MEDIA_FACTORY)
@@ -37,6 +55,22 @@ static void on_media_prepared(GstRTSPMedia *media, gpointer user_data);
 static gboolean on_bus_message(GstBus *bus, GstMessage *msg, gpointer user_data);
 
 static void media_configure_cb(GstRTSPMediaFactory *factory, GstRTSPMedia *media, gpointer user_data) {
+    session_trace_watch_media(media);
+
+    /* Streaming thread của media chạy trên nhóm core ingest (nếu cấu hình) */
+    GstElement *element = gst_rtsp_media_get_element(media);
+    gboolean clip = clip_playback_is_clip(element);
+    gboolean dvr = dvr_buffer_is_dvr(element);
+    GstObject *pipeline = gst_object_get_parent(GST_OBJECT(element));
+    if (pipeline) {
+        rtsp_threads_pin_pipeline(GST_ELEMENT(pipeline), THREAD_ROLE_INGEST);
+        gchar *label = g_strdup_printf("rtsp:%s", CAMERA_MEDIA_FACTORY(user_data)->camera->name);
+        profiling_track_pipeline(GST_ELEMENT(pipeline), label);
+        g_free(label);
+        gst_object_unref(pipeline);
+    }
+    gst_object_unref(element);
+
     gst_rtsp_media_set_latency(media, 200);
     gst_rtsp_media_set_transport_mode(media, GST_RTSP_TRANSPORT_MODE_PLAY);
     gst_rtsp_media_set_profiles(media, GST_RTSP_PROFILE_AVP);
@@ -46,7 +80,13 @@ static void media_configure_cb(GstRTSPMediaFactory *factory, GstRTSPMedia *media
     CameraMediaFactory *cam_factory = CAMERA_MEDIA_FACTORY(user_data);
     SeekParams *params = g_object_get_data(G_OBJECT(cam_factory), "seek-params");
 
-    if (params) {
+    if (clip) {
+        /* ?ranges=: các đoạn tự dừng theo segment.stop, hết đoạn cuối thì kết thúc session */
+        gst_rtsp_media_set_eos_shutdown(media, TRUE);
+    } else if (dvr) {
+        /* Timeshift từ RAM: không nối camera, seek trong session qua PLAY Range */
+        gst_rtsp_media_set_eos_shutdown(media, FALSE);
+    } else if (params) {
         g_print("media_configure_cb: offset=%ld ns, duration=%ld ns\n",
                 params->seek_offset, params->duration_limit);
 
@@ -64,6 +104,10 @@ static void media_configure_cb(GstRTSPMediaFactory *factory, GstRTSPMedia *media
 
             /* Connect to prepared signal */
             g_signal_connect(media, "prepared", G_CALLBACK(on_media_prepared), NULL);
+
+            /* Cùng một đoạn playback: client mở trong cửa sổ share dùng chung pipeline (xem gen_key) */
+            gst_rtsp_media_set_shared(media, TRUE);
+            g_object_set_data(G_OBJECT(media), PLAYBACK_SHARED_KEY, GINT_TO_POINTER(TRUE));
         } else {
             /* Live stream - no eos shutdown */
             gst_rtsp_media_set_eos_shutdown(media, FALSE);
@@ -74,6 +118,26 @@ static void media_configure_cb(GstRTSPMediaFactory *factory, GstRTSPMedia *media
     } else {
         /* Default for live streams */
         gst_rtsp_media_set_eos_shutdown(media, FALSE);
+
+        /* Latency profile chọn trong create_element (mount hoặc ?profile=) */
+        const LatencyProfile *profile = latency_profile_from_media(media);
+        if (profile) {
+            latency_profile_apply_media(media, profile);
+        }
+
+        /* Policy cho client chậm - chỉ ảnh hưởng tới client đang request */
+        GstRTSPContext *rtsp_ctx = gst_rtsp_context_get_current();
+        if (rtsp_ctx && rtsp_ctx->client) {
+            client_congestion_attach(media, rtsp_ctx->client,
+                                     profile ? &profile->sendq : client_congestion_default_policy());
+        }
+
+        /* ?stream=auto: chọn main/sub theo RTCP RR và send queue */
+        adaptive_stream_attach(media);
+
+        /* RTP tới client UDP gửi theo từng access unit (sendmmsg/GSO). Playback, clip và DVR
+         * giữ multiudpsink sync=TRUE để phát đúng nhịp clock */
+        udp_egress_attach_media(media);
     }
 }
 
@@ -200,6 +264,11 @@ static gboolean on_bus_message(GstBus *bus, GstMessage *msg, gpointer user_data)
         }
         case GST_MESSAGE_ASYNC_DONE: {
             g_print("✓ Async operations completed\n");
+            /* ASYNC_DONE sau seek flush = seek hoàn tất */
+            SeekParams *params = g_object_get_data(G_OBJECT(pipeline), "seek-params");
+            if (params && !params->seek_pending) {
+                session_trace_mark(session_trace_from_pipeline(pipeline), TRACE_STAGE_SEEK_DONE);
+            }
             break;
         }
         default:
@@ -209,179 +278,83 @@ static gboolean on_bus_message(GstBus *bus, GstMessage *msg, gpointer user_data)
     return TRUE;
 }
 
-static gboolean path_to_timestamp(const gchar *path, time_t *out_ts) {
-    const gchar *base = strrchr(path, '/');
-    base = base ? base + 1 : path;
 
-    long ts = 0;
-    if (sscanf(base, "%ld", &ts) == 1 &&
-        ts > 1500000000 && ts < 2000000000) {
-        *out_ts = (time_t)ts;
-        return TRUE;
+/* Vị trí (timestamp trong file đầu) của frame tại start_us.
+ * Có mapping từ recording: chính xác tới frame; không có: theo tên file (giây) */
+static gint64 playback_start_position(const gchar *first_file, const SegmentClock *clock, gint64 start_us) {
+    if (clock && clock->source != SEGMENT_CLOCK_NONE) {
+        gint64 position = segment_clock_to_pts(clock, start_us);
+        g_print("Seek position: %.3f sec in file (%s clock)\n", (gdouble)MAX(position, 0) / GST_SECOND,
+                clock->source == SEGMENT_CLOCK_NTP ? "NTP" : "arrival");
+        return MAX(position, 0);
     }
 
-    const gchar *p = path;
-    gint year, mon, day, hour;
-
-    while ((p = strchr(p, '/')) != NULL) {
-        p++;
-        if (sscanf(p, "%4d/%2d/%2d/%2d",
-                   &year, &mon, &day, &hour) == 4) {
-            struct tm tm = {0};
-            tm.tm_year = year - 1900;
-            tm.tm_mon  = mon - 1;
-            tm.tm_mday = day;
-            tm.tm_hour = hour;
-            tm.tm_isdst = -1;
-            *out_ts = mktime(&tm);
-            return TRUE;
-        }
+    time_t file_ts = 0;
+    if (path_to_timestamp(first_file, &file_ts) && start_us > (gint64)file_ts * G_USEC_PER_SEC) {
+        gint64 position = (start_us - (gint64)file_ts * G_USEC_PER_SEC) * GST_USECOND;
+        g_print("Seek position: %.3f sec from file start (filename time)\n",
+                (gdouble)position / GST_SECOND);
+        return position;
     }
-    return FALSE;
+    return 0;
 }
 
-static void scan_recordings_recursive(const gchar *base_dir, GList **files) {
-    GDir *dir = g_dir_open(base_dir, 0, NULL);
-    if (!dir) return;
-
-    const gchar *name;
-    while ((name = g_dir_read_name(dir))) {
-        gchar *full = g_build_filename(base_dir, name, NULL);
-
-        if (g_file_test(full, G_FILE_TEST_IS_DIR)) {
-            scan_recordings_recursive(full, files);
-            g_free(full);
-            continue;
-        }
-
-        if (!g_str_has_suffix(name, ".mp4") && !g_str_has_suffix(name, ".mkv")) {
-            g_free(full);
-            continue;
-        }
-
-        time_t file_ts = 0;
-        if (!path_to_timestamp(full, &file_ts)) {
-            g_free(full);
-            continue;
-        }
-
-        *files = g_list_insert_sorted(*files, full, (GCompareFunc)g_strcmp0);
-    }
-
-    g_dir_close(dir);
-}
-
-static GList* get_recording_files_from_timestamp(const gchar *camera_name,
-                                                  gint64 start_ts,
-                                                  StreamType stream_type,
-                                                  gint64 duration) {
-    GList *all_files = NULL;
-    GList *result = NULL;
-
-    gchar *base_dir = g_strdup_printf(
-        "/home/oryza/Oryza/recordings/%s/%s",
-        stream_type == STREAM_MAIN ? "hi_quality" : "low_quality",
-        camera_name);
-
-    g_print("DEBUG: Scanning for files at timestamp %ld (%s)\n", (long)start_ts,
-            g_date_time_format(g_date_time_new_from_unix_local(start_ts), "%Y-%m-%d %H:%M:%S"));
-
-    scan_recordings_recursive(base_dir, &all_files);
-
-    if (!all_files) {
-        g_print("ERROR: No recording files found in %s\n", base_dir);
-        g_free(base_dir);
-        return NULL;
-    }
-
-    g_print("DEBUG: Found %d total files\n", g_list_length(all_files));
-
-    all_files = g_list_sort(all_files, (GCompareFunc)g_strcmp0);
-
-    GList *start_file = NULL;
-    time_t best_ts = 0;
-
-    for (GList *l = all_files; l != NULL; l = l->next) {
-        gchar *file = (gchar *)l->data;
-        time_t file_ts = 0;
-
-        if (!path_to_timestamp(file, &file_ts)) continue;
+/* Wallclock thật cho từng frame: meta trên parser của mỗi segment, extension trên pay0 */
+static void playback_attach_clocks(GstElement *pipeline, GArray *clocks) {
+    gboolean any = FALSE;
 
-        g_print("  File: %s (ts=%ld, time=%s)\n",
-                file, (long)file_ts,
-                g_date_time_format(g_date_time_new_from_unix_local(file_ts), "%H:%M:%S"));
+    for (guint i = 0; i < clocks->len; i++) {
+        const SegmentClock *clock = &g_array_index(clocks, SegmentClock, i);
+        if (clock->source == SEGMENT_CLOCK_NONE) continue;
 
-        if (file_ts <= start_ts) {
-            if (file_ts > best_ts || best_ts == 0) {
-                best_ts = file_ts;
-                start_file = l;
-            }
+        gchar *name = g_strdup_printf("parse%u", i);
+        GstElement *parser = gst_bin_get_by_name(GST_BIN(pipeline), name);
+        if (parser) {
+            segment_clock_stamp_frames(parser, clock);
+            gst_object_unref(parser);
+            any = TRUE;
         }
+        g_free(name);
     }
 
-    if (!start_file) {
-        g_print("ERROR: No file found with timestamp <= %ld\n", (long)start_ts);
-        g_list_free_full(all_files, g_free);
-        g_free(base_dir);
-        return NULL;
+    if (any) {
+        GstElement *pay = gst_bin_get_by_name(GST_BIN(pipeline), "pay0");
+        segment_clock_attach_payloader(pay);
+        if (pay) gst_object_unref(pay);
     }
+}
 
-    g_print("  ✓ START FILE: %s (ts=%ld)\n", (gchar *)start_file->data, (long)best_ts);
-
-    /* Only include files needed for the duration */
-    gint64 end_ts = start_ts + duration;
-    gboolean found_end = FALSE;
-
-    for (GList *l = start_file; l != NULL; l = l->next) {
-        gchar *file = (gchar *)l->data;
-        result = g_list_append(result, g_strdup(file));
-
-        /* If duration specified, stop when we have enough files */
-        if (duration > 0) {
-            time_t file_ts = 0;
-            if (path_to_timestamp(file, &file_ts) && file_ts >= end_ts) {
-                found_end = TRUE;
-                break;
-            }
-        }
-    }
-
-    g_list_free_full(all_files, g_free);
-    g_free(base_dir);
-
-    g_print("Selected %d files for playback", g_list_length(result));
-    if (duration > 0) {
-        g_print(" (covering %ld seconds)\n", (long)duration);
+/* Nguồn AU cho một segment: native đọc thẳng từ mmap, MKV qua cache + demux */
+static void append_segment_source(GString *str, const gchar *file, const gchar *next) {
+    if (native_segment_is_native_path(file)) {
+        g_string_append_printf(str, NATIVE_SEGMENT_SRC_NAME " location=\"%s\" next-location=\"%s\" ! ",
+                               file, next);
     } else {
-        g_print("\n");
+        g_string_append_printf(str, "segmentcachesrc location=\"%s\" next-location=\"%s\" ! "
+                               "matroskademux ! ", file, next);
     }
-
-    return result;
 }
 
-static GstElement* create_playback_pipeline(GList *files, gint64 start_ts, gint64 duration, SeekParams **out_params) {
+static GstElement* create_playback_pipeline(GList *files, GArray *clocks, gint64 start_us,
+                                            gint64 duration, SeekParams **out_params) {
     if (!files) return NULL;
 
     SeekParams *params = g_new0(SeekParams, 1);
+    const SegmentClock *first_clock = clocks->len > 0 ? &g_array_index(clocks, SegmentClock, 0) : NULL;
 
     if (g_list_length(files) == 1) {
         gchar *file = (gchar *)files->data;
+        gint64 offset_ns = playback_start_position(file, first_clock, start_us);
 
-        time_t file_ts = 0;
-        gint64 offset_ns = 0;
-        if (path_to_timestamp(file, &file_ts) && start_ts > file_ts) {
-            offset_ns = (start_ts - file_ts) * GST_SECOND;
-            g_print("Single file - seek offset: %ld seconds from file start\n",
-                    offset_ns / GST_SECOND);
-        }
-
+        GString *source_str = g_string_new("");
+        append_segment_source(source_str, file, "");
         gchar *launch_str = g_strdup_printf(
-            "filesrc location=\"%s\" ! "
-            "matroskademux ! "
-            "h264parse ! "
+            "%s"
+            "h264parse name=parse0 ! "
             "queue max-size-time=5000000000 max-size-bytes=0 max-size-buffers=0 ! "
             "rtph264pay name=pay0 pt=96 config-interval=-1 mtu=1400",
-            file);
+            source_str->str);
+        g_string_free(source_str, TRUE);
 
         GError *error = NULL;
         GstElement *pipeline = gst_parse_launch(launch_str, &error);
@@ -394,6 +367,7 @@ static GstElement* create_playback_pipeline(GList *files, gint64 start_ts, gint6
             return NULL;
         }
 
+        playback_attach_clocks(pipeline, clocks);
         params->seek_offset = offset_ns;
         params->duration_limit = duration > 0 ? duration * GST_SECOND : 0;
         *out_params = params;
@@ -412,12 +386,14 @@ static GstElement* create_playback_pipeline(GList *files, gint64 start_ts, gint6
             g_string_append(concat_str, " ");
         }
 
+        /* Segment kế tiếp được prefetch khi đọc tới nửa segment này */
+        const gchar *next = l->next ? (const gchar *)l->next->data : "";
+        append_segment_source(concat_str, file, next);
         g_string_append_printf(concat_str,
-            "filesrc location=\"%s\" ! "
-            "matroskademux ! h264parse ! "
+            "h264parse name=parse%d ! "
             "queue max-size-time=3000000000 name=q%d "
             "q%d. ! concat. ",
-            file, file_count, file_count);
+            file_count, file_count, file_count);
 
         file_count++;
     }
@@ -443,13 +419,8 @@ static GstElement* create_playback_pipeline(GList *files, gint64 start_ts, gint6
         return NULL;
     }
 
-    time_t first_file_ts = 0;
-    gint64 offset_ns = 0;
-    if (path_to_timestamp((gchar *)files->data, &first_file_ts) && start_ts > first_file_ts) {
-        offset_ns = (start_ts - first_file_ts) * GST_SECOND;
-        g_print("Concat - seek offset: %ld seconds from first file\n",
-                offset_ns / GST_SECOND);
-    }
+    playback_attach_clocks(pipeline, clocks);
+    gint64 offset_ns = playback_start_position((gchar *)files->data, first_clock, start_us);
 
     params->seek_offset = offset_ns;
     params->duration_limit = duration > 0 ? duration * GST_SECOND : 0;
@@ -467,38 +438,103 @@ static GstElement* camera_media_factory_create_element(GstRTSPMediaFactory *fact
     gchar *stream_id = parse_query_param(query, "stream");
     gchar *timestamp_str = parse_query_param(query, "timestamp");
     gchar *duration_str = parse_query_param(query, "duration");
+    gchar *ranges_str = parse_query_param(query, CLIP_PLAYBACK_PARAM);
 
     const gchar *rtsp_url;
     CodecType codec;
     gboolean is_main_stream = TRUE;
+    gboolean adaptive = FALSE;
+
+    /* ?stream=auto chỉ cho live và khi main/sub cùng codec; không được thì dùng sub */
+    if (g_strcmp0(stream_id, ADAPTIVE_STREAM_VALUE) == 0) {
+        adaptive = !timestamp_str && !ranges_str && adaptive_stream_supported(cam);
+        if (!adaptive) {
+            g_print("[adaptive] %s: not available, using sub stream\n", cam->name);
+        }
+    }
 
-    if (stream_id && g_strcmp0(stream_id, "1") == 0) {
+    if (g_strcmp0(stream_id, ADAPTIVE_STREAM_VALUE) == 0 && !adaptive) {
+        rtsp_url = cam->rtsp_url_sub;
+        is_main_stream = FALSE;
+    } else if (stream_id && g_strcmp0(stream_id, "1") == 0) {
         rtsp_url = cam->rtsp_url_sub;
-        codec = cam->codec_sub;
         is_main_stream = FALSE;
     } else {
         rtsp_url = cam->rtsp_url_main;
-        codec = cam->codec_main;
+    }
+
+    /* CODEC_AUTO dùng codec đã probe từ SDP để chọn pipeline passthrough */
+    codec = camera_resolve_codec(cam, is_main_stream);
+
+    SessionTrace *trace = session_trace_begin(cam->name, timestamp_str != NULL || ranges_str != NULL);
+
+    /* Nhiều đoạn nối nhau trong một session */
+    if (ranges_str && !timestamp_str) {
+        GArray *ranges = clip_playback_parse_ranges(ranges_str);
+        GstElement *pipeline = NULL;
+
+        if (ranges) {
+            pipeline = clip_playback_create(cam->name, is_main_stream ? STREAM_MAIN : STREAM_SUB, ranges);
+            session_trace_mark(trace, TRACE_STAGE_SEGMENT_LOOKUP);
+            g_array_unref(ranges);
+        } else {
+            g_printerr("[clip] %s: invalid ranges '%s'\n", cam->name, ranges_str);
+        }
+
+        if (pipeline) {
+            session_trace_mark(trace, TRACE_STAGE_PIPELINE_BUILD);
+            session_trace_attach(trace, pipeline);
+        }
+        session_trace_unref(trace);
+        g_free(ranges_str);
+        g_free(stream_id);
+        g_free(duration_str);
+        return pipeline;
+    }
+    g_free(ranges_str);
+
+    /* ?dvr=-N: phát từ ring trong RAM, không có dữ liệu thì về live thường */
+    gchar *dvr_str = timestamp_str ? NULL : parse_query_param(query, DVR_BUFFER_PARAM);
+    if (dvr_str && !adaptive) {
+        GstElement *pipeline = dvr_buffer_create_pipeline(cam->name,
+                                                          is_main_stream ? STREAM_MAIN : STREAM_SUB,
+                                                          g_ascii_strtoll(dvr_str, NULL, 10));
+        g_free(dvr_str);
+        if (pipeline) {
+            session_trace_mark(trace, TRACE_STAGE_PIPELINE_BUILD);
+            session_trace_attach(trace, pipeline);
+            session_trace_unref(trace);
+            g_free(stream_id);
+            g_free(duration_str);
+            return pipeline;
+        }
+    } else {
+        g_free(dvr_str);
     }
 
     if (timestamp_str) {
-        gint64 start_ts = g_ascii_strtoll(timestamp_str, NULL, 10);
+        gint64 start_us = parse_timestamp_us(timestamp_str);
+        gint64 start_ts = start_us / G_USEC_PER_SEC;
         gint64 duration = duration_str ? g_ascii_strtoll(duration_str, NULL, 10) : 0;
 
         g_print("\n=== PLAYBACK REQUEST ===\n");
         g_print("Camera: %s\n", cam->name);
-        g_print("Start timestamp: %ld (%s)\n", (long)start_ts,
+        g_print("Start timestamp: %.3f (%s)\n", (gdouble)start_us / G_USEC_PER_SEC,
                 g_date_time_format(g_date_time_new_from_unix_local(start_ts), "%Y-%m-%d %H:%M:%S"));
         if (duration > 0) {
             g_print("Duration: %ld seconds\n", (long)duration);
         }
 
-        GList *files = get_recording_files_from_timestamp(cam->name, start_ts,
+        GArray *clocks = g_array_new(FALSE, TRUE, sizeof(SegmentClock));
+        GList *files = get_recording_files_from_timestamp(cam->name, start_us,
                                                           is_main_stream ? STREAM_MAIN : STREAM_SUB,
-                                                          duration);
+                                                          duration, clocks);
+        session_trace_mark(trace, TRACE_STAGE_SEGMENT_LOOKUP);
 
         if (!files) {
             g_printerr("ERROR: No playback files found\n");
+            g_array_unref(clocks);
+            session_trace_unref(trace);
             g_free(stream_id);
             g_free(timestamp_str);
             g_free(duration_str);
@@ -512,8 +548,9 @@ static GstElement* camera_media_factory_create_element(GstRTSPMediaFactory *fact
         g_print("========================\n\n");
 
         SeekParams *seek_params = NULL;
-        GstElement *pipeline = create_playback_pipeline(files, start_ts, duration, &seek_params);
+        GstElement *pipeline = create_playback_pipeline(files, clocks, start_us, duration, &seek_params);
 
+        g_array_unref(clocks);
         g_list_free_full(files, g_free);
         g_free(stream_id);
         g_free(timestamp_str);
@@ -523,86 +560,238 @@ static GstElement* camera_media_factory_create_element(GstRTSPMediaFactory *fact
             g_object_set_data_full(G_OBJECT(factory), "seek-params", seek_params, g_free);
         }
 
+        if (pipeline) {
+            session_trace_mark(trace, TRACE_STAGE_PIPELINE_BUILD);
+            session_trace_attach(trace, pipeline);
+        }
+        session_trace_unref(trace);
+
         return pipeline;
     }
 
-    /* Live streaming pipeline */
+    /* Live streaming pipeline - mỗi client có send queue riêng */
     gchar *launch_str = NULL;
+    const LatencyProfile *profile = latency_profile_resolve(query, cam->latency_profile);
+    gchar *src_desc = latency_profile_source_desc(profile);
+    gchar *sendq = client_congestion_queue_desc(&profile->sendq);
 
-    if (codec == CODEC_H265) {
+    if (adaptive) {
+        launch_str = adaptive_stream_launch_desc(cam, src_desc, sendq);
+    } else if (codec == CODEC_H265) {
         if (is_main_stream && cam->is_recording && cam->current_record_file_main) {
             launch_str = g_strdup_printf(
-                "rtspsrc location=%s protocols=tcp latency=200 buffer-mode=auto ! "
+                "rtspsrc location=%s protocols=tcp %s ! "
                 "rtph265depay ! h265parse config-interval=-1 ! tee name=t "
-                "t. ! queue max-size-buffers=3 leaky=downstream ! "
+                "t. ! %s ! "
                 "rtph265pay name=pay0 pt=96 config-interval=-1 mtu=1400 "
                 "t. ! queue ! mp4mux ! filesink location=%s",
-                rtsp_url, cam->current_record_file_main);
+                rtsp_url, src_desc, sendq, cam->current_record_file_main);
         } else {
             launch_str = g_strdup_printf(
-                "rtspsrc location=%s protocols=tcp latency=200 buffer-mode=auto ! "
-                "rtph265depay ! h265parse config-interval=-1 ! "
+                "rtspsrc location=%s protocols=tcp %s ! "
+                "rtph265depay ! h265parse config-interval=-1 ! %s ! "
                 "rtph265pay name=pay0 pt=96 config-interval=-1 mtu=1400",
-                rtsp_url);
+                rtsp_url, src_desc, sendq);
         }
     } else if (codec == CODEC_AUTO) {
         if (is_main_stream && cam->is_recording && cam->current_record_file_main) {
             launch_str = g_strdup_printf(
-                "rtspsrc location=%s protocols=tcp latency=200 buffer-mode=auto ! "
+                "rtspsrc location=%s protocols=tcp %s ! "
                 "decodebin ! tee name=t "
                 "t. ! queue ! x264enc tune=zerolatency speed-preset=ultrafast ! "
-                "h264parse config-interval=-1 ! "
+                "h264parse config-interval=-1 ! %s ! "
                 "rtph264pay name=pay0 pt=96 config-interval=-1 mtu=1400 "
                 "t. ! queue ! x264enc ! h264parse ! mp4mux ! filesink location=%s",
-                rtsp_url, cam->current_record_file_main);
+                rtsp_url, src_desc, sendq, cam->current_record_file_main);
         } else {
             launch_str = g_strdup_printf(
-                "rtspsrc location=%s protocols=tcp latency=200 buffer-mode=auto ! "
+                "rtspsrc location=%s protocols=tcp %s ! "
                 "decodebin ! x264enc tune=zerolatency speed-preset=ultrafast ! "
-                "h264parse config-interval=-1 ! "
+                "h264parse config-interval=-1 ! %s ! "
                 "rtph264pay name=pay0 pt=96 config-interval=-1 mtu=1400",
-                rtsp_url);
+                rtsp_url, src_desc, sendq);
         }
     } else {
         if (is_main_stream && cam->is_recording && cam->current_record_file_main) {
             launch_str = g_strdup_printf(
-                "rtspsrc location=%s protocols=tcp latency=200 buffer-mode=auto ! "
+                "rtspsrc location=%s protocols=tcp %s ! "
                 "rtph264depay ! h264parse config-interval=-1 ! tee name=t "
-                "t. ! queue max-size-buffers=3 leaky=downstream ! "
+                "t. ! %s ! "
                 "rtph264pay name=pay0 pt=96 config-interval=-1 mtu=1400 "
                 "t. ! queue ! mp4mux ! filesink location=%s",
-                rtsp_url, cam->current_record_file_main);
+                rtsp_url, src_desc, sendq, cam->current_record_file_main);
         } else {
             launch_str = g_strdup_printf(
-                "rtspsrc location=%s protocols=tcp latency=200 buffer-mode=auto ! "
-                "rtph264depay ! h264parse config-interval=-1 ! "
+                "rtspsrc location=%s protocols=tcp %s ! "
+                "rtph264depay ! h264parse config-interval=-1 ! %s ! "
                 "rtph264pay name=pay0 pt=96 config-interval=-1 mtu=1400",
-                rtsp_url);
+                rtsp_url, src_desc, sendq);
         }
     }
 
+    g_free(sendq);
+    g_free(src_desc);
+
     GError *error = NULL;
     GstElement *pipeline = gst_parse_launch(launch_str, &error);
     if (error) {
         g_printerr("Pipeline error: %s\n", error->message);
         g_error_free(error);
         g_free(launch_str);
+        session_trace_unref(trace);
         return NULL;
     }
 
+    session_trace_mark(trace, TRACE_STAGE_PIPELINE_BUILD);
+    session_trace_attach(trace, pipeline);
+    session_trace_unref(trace);
+
+    latency_profile_attach(pipeline, profile);
+    g_print("[%s] Live stream with latency profile '%s'\n", cam->name, profile->name);
+
+    if (adaptive) {
+        adaptive_stream_prepare(pipeline, cam->name);
+    }
+
+    /* ?measure=latency: đóng dấu thời gian từng access unit vào RTP header extension */
+    gchar *measure = parse_query_param(query, LATENCY_MEASURE_PARAM);
+    if (g_strcmp0(measure, LATENCY_MEASURE_VALUE) == 0) {
+        latency_measure_attach(pipeline);
+    }
+    g_free(measure);
+
     g_free(launch_str);
     g_free(stream_id);
     return pipeline;
 }
 
+static GstRTSPFilterResult other_transport_filter(GstRTSPStream *stream, GstRTSPStreamTransport *trans,
+                                                  gpointer user_data) {
+    return trans == user_data ? GST_RTSP_FILTER_KEEP : GST_RTSP_FILTER_REF;
+}
+
+/* PLAY Range trên playback đang dùng chung sẽ seek cả client khác: chỉ nhận Range từ đầu
+ * (client vào ở vị trí hiện tại của media chung), seek khác trả 456 */
+static GstRTSPStatusCode on_pre_play_request(GstRTSPClient *client, GstRTSPContext *ctx, gpointer user_data) {
+    if (!ctx->media || !g_object_get_data(G_OBJECT(ctx->media), PLAYBACK_SHARED_KEY)) {
+        return GST_RTSP_STS_OK;
+    }
+
+    gchar *range_str = NULL;
+    if (gst_rtsp_message_get_header(ctx->request, GST_RTSP_HDR_RANGE, &range_str, 0) != GST_RTSP_OK) {
+        return GST_RTSP_STS_OK;
+    }
+
+    /* Transport của client chỉ được thêm khi PLAYING (PLAY đầu tiên chưa có, PLAY sau đã có):
+     * đếm transport của các session khác, không có thì client này là người xem duy nhất */
+    GstRTSPStream *stream = gst_rtsp_media_get_stream(ctx->media, 0);
+    GstRTSPStreamTransport *own = ctx->sessmedia ? gst_rtsp_session_media_get_transport(ctx->sessmedia, 0) : NULL;
+    GList *transports = stream ? gst_rtsp_stream_transport_filter(stream, other_transport_filter, own) : NULL;
+    guint others = g_list_length(transports);
+    g_list_free_full(transports, g_object_unref);
+    if (others == 0) return GST_RTSP_STS_OK;
+
+    GstRTSPTimeRange *range = NULL;
+    gboolean from_start = FALSE;
+    if (gst_rtsp_range_parse(range_str, &range) == GST_RTSP_OK) {
+        from_start = range->unit == GST_RTSP_RANGE_NPT &&
+                     range->max.type == GST_RTSP_TIME_END &&
+                     (range->min.type == GST_RTSP_TIME_NOW ||
+                      (range->min.type == GST_RTSP_TIME_SECONDS && range->min.seconds == 0));
+        gst_rtsp_range_free(range);
+    }
+
+    if (!from_start) {
+        g_print("Refusing Range %s on shared playback media (%u other viewers)\n", range_str, others);
+        return GST_RTSP_STS_HEADER_FIELD_NOT_VALID_FOR_RESOURCE;
+    }
+    gst_rtsp_message_remove_header(ctx->request, GST_RTSP_HDR_RANGE, -1);
+    return GST_RTSP_STS_OK;
+}
+
+static void on_client_connected(GstRTSPServer *server, GstRTSPClient *client, gpointer user_data) {
+    g_signal_connect(client, "pre-play-request", G_CALLBACK(on_pre_play_request), NULL);
+}
+
+void camera_media_factory_watch_clients(GstRTSPServer *server) {
+    g_signal_connect(server, "client-connected", G_CALLBACK(on_client_connected), NULL);
+}
+
+/* Key của media: playback có cùng (camera, stream, start, duration) và mở trong
+ * PLAYBACK_SHARE_WINDOW_SEC dùng chung một media; sau cửa sổ thì tạo thế hệ mới
+ * để client đến muộn không bị nối vào giữa một phiên đang phát. */
+static gchar* camera_media_factory_gen_key(GstRTSPMediaFactory *factory, const GstRTSPUrl *url) {
+    CameraMediaFactory *cam_factory = CAMERA_MEDIA_FACTORY(factory);
+    gchar *timestamp_str = parse_query_param(url->query, "timestamp");
+
+    if (!timestamp_str) {
+        return GST_RTSP_MEDIA_FACTORY_CLASS(camera_media_factory_parent_class)->gen_key(factory, url);
+    }
+
+    gchar *stream_id = parse_query_param(url->query, "stream");
+    gchar *duration_str = parse_query_param(url->query, "duration");
+    gchar *base_key = g_strdup_printf("playback/%s/%d/%" G_GINT64_FORMAT "/%" G_GINT64_FORMAT,
+                                      cam_factory->camera->name,
+                                      g_strcmp0(stream_id, "1") == 0 ? STREAM_SUB : STREAM_MAIN,
+                                      parse_timestamp_us(timestamp_str),
+                                      duration_str ? g_ascii_strtoll(duration_str, NULL, 10) : 0);
+    gint64 now = g_get_monotonic_time();
+
+    g_mutex_lock(&cam_factory->share_lock);
+
+    /* Bỏ các entry đã hết cửa sổ (generation luôn tăng nên không trùng media cũ) */
+    GHashTableIter iter;
+    gpointer value;
+    g_hash_table_iter_init(&iter, cam_factory->playback_shares);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        PlaybackShare *share = value;
+        if (now - share->created_us > PLAYBACK_SHARE_WINDOW_SEC * G_USEC_PER_SEC) {
+            g_hash_table_iter_remove(&iter);
+        }
+    }
+
+    PlaybackShare *share = g_hash_table_lookup(cam_factory->playback_shares, base_key);
+    if (!share) {
+        share = g_new0(PlaybackShare, 1);
+        share->generation = ++cam_factory->next_generation;
+        share->created_us = now;
+        g_hash_table_insert(cam_factory->playback_shares, g_strdup(base_key), share);
+    }
+    gchar *key = g_strdup_printf("%s#%u", base_key, share->generation);
+
+    g_mutex_unlock(&cam_factory->share_lock);
+
+    g_free(base_key);
+    g_free(duration_str);
+    g_free(stream_id);
+    g_free(timestamp_str);
+    return key;
+}
+
+static void camera_media_factory_finalize(GObject *object) {
+    CameraMediaFactory *factory = CAMERA_MEDIA_FACTORY(object);
+
+    g_hash_table_unref(factory->playback_shares);
+    g_mutex_clear(&factory->share_lock);
+
+    G_OBJECT_CLASS(camera_media_factory_parent_class)->finalize(object);
+}
+
 static void camera_media_factory_class_init(CameraMediaFactoryClass *klass) {
+    GObjectClass *object_class = G_OBJECT_CLASS(klass);
     GstRTSPMediaFactoryClass *factory_class = GST_RTSP_MEDIA_FACTORY_CLASS(klass);
+
+    object_class->finalize = camera_media_factory_finalize;
     factory_class->create_element = camera_media_factory_create_element;
+    factory_class->gen_key = camera_media_factory_gen_key;
 }
 
 static void camera_media_factory_init(CameraMediaFactory *factory) {
     GstRTSPMediaFactory *base_factory = GST_RTSP_MEDIA_FACTORY(factory);
 
+    g_mutex_init(&factory->share_lock);
+    factory->playback_shares = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+
     gst_rtsp_media_factory_set_shared(base_factory, FALSE);
     gst_rtsp_media_factory_set_protocols(base_factory,
                                          GST_RTSP_LOWER_TRANS_TCP | GST_RTSP_LOWER_TRANS_UDP);
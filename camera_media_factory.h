@@ -9,4 +9,7 @@ G_DECLARE_FINAL_TYPE(CameraMediaFactory, camera_media_factory, CAMERA, MEDIA_FAC
 
 CameraMediaFactory* camera_media_factory_new(CameraConfig *cam);
 
+/* Chặn PLAY Range seek trên media playback đang dùng chung (gọi một lần cho server) */
+void camera_media_factory_watch_clients(GstRTSPServer *server);
+
 #endif
@@ -0,0 +1,363 @@
+#include "camera_probe.h"
+#include <gst/gst.h>
+#include <gst/rtsp/rtsp.h>
+#include <gst/sdp/sdp.h>
+#include <gst/codecparsers/gsth264parser.h>
+#include <gst/codecparsers/gsth265parser.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    const gchar *camera_name;
+    const gchar *rtsp_url;
+    gboolean main_stream;
+    StreamProbeInfo *info;
+    guint timeout_ms;
+} ProbeJob;
+
+static const gchar* h264_profile_name(guint8 profile_idc) {
+    switch (profile_idc) {
+        case 66:  return "baseline";
+        case 77:  return "main";
+        case 88:  return "extended";
+        case 100: return "high";
+        case 110: return "high-10";
+        case 122: return "high-4:2:2";
+        case 244: return "high-4:4:4";
+        default:  return "unknown";
+    }
+}
+
+static const gchar* h265_profile_name(guint8 profile_idc) {
+    switch (profile_idc) {
+        case 1:  return "main";
+        case 2:  return "main-10";
+        case 3:  return "main-still-picture";
+        case 4:  return "format-range-extensions";
+        default: return "unknown";
+    }
+}
+
+static gboolean parse_h264_sps(const guint8 *data, gsize size, StreamProbeInfo *info) {
+    GstH264NalUnit nalu;
+    GstH264SPS sps;
+
+    if (size < 4 || (data[0] & 0x1f) != GST_H264_NAL_SPS) return FALSE;
+
+    memset(&nalu, 0, sizeof(nalu));
+    nalu.type = GST_H264_NAL_SPS;
+    nalu.data = (guint8 *)data;
+    nalu.size = size;
+    nalu.header_bytes = 1;
+    nalu.valid = TRUE;
+
+    if (gst_h264_parse_sps(&nalu, &sps) != GST_H264_PARSER_OK) return FALSE;
+
+    info->width = sps.frame_cropping_flag ? sps.crop_rect_width : sps.width;
+    info->height = sps.frame_cropping_flag ? sps.crop_rect_height : sps.height;
+    g_free(info->profile);
+    info->profile = g_strdup(h264_profile_name(sps.profile_idc));
+
+    gst_h264_sps_clear(&sps);
+    return TRUE;
+}
+
+static gboolean parse_h265_sps(const guint8 *data, gsize size, StreamProbeInfo *info) {
+    GstH265NalUnit nalu;
+    GstH265SPS sps;
+    gboolean ok;
+
+    if (size < 4 || ((data[0] >> 1) & 0x3f) != GST_H265_NAL_SPS) return FALSE;
+
+    memset(&nalu, 0, sizeof(nalu));
+    nalu.type = GST_H265_NAL_SPS;
+    nalu.data = (guint8 *)data;
+    nalu.size = size;
+    nalu.header_bytes = 2;
+    nalu.valid = TRUE;
+
+    GstH265Parser *parser = gst_h265_parser_new();
+    ok = gst_h265_parser_parse_sps(parser, &nalu, &sps, FALSE) == GST_H265_PARSER_OK;
+    if (ok) {
+        info->width = sps.conformance_window_flag ? sps.crop_rect_width : sps.width;
+        info->height = sps.conformance_window_flag ? sps.crop_rect_height : sps.height;
+        g_free(info->profile);
+        info->profile = g_strdup(h265_profile_name(sps.profile_tier_level.profile_idc));
+    }
+    gst_h265_parser_free(parser);
+
+    return ok;
+}
+
+/* Giải mã danh sách base64 cách nhau bởi dấu phẩy và parse SPS đầu tiên tìm được */
+static void parse_sprop_sps(const gchar *sprop, CodecType codec, StreamProbeInfo *info) {
+    if (!sprop) return;
+
+    gchar **parts = g_strsplit(sprop, ",", -1);
+    for (gint i = 0; parts[i]; i++) {
+        gsize len = 0;
+        guchar *nal = g_base64_decode(parts[i], &len);
+        gboolean ok = codec == CODEC_H265 ? parse_h265_sps(nal, len, info)
+                                          : parse_h264_sps(nal, len, info);
+        g_free(nal);
+        if (ok) break;
+    }
+    g_strfreev(parts);
+}
+
+/* Lấy codec + parameter sets từ media video đầu tiên trong SDP */
+static gboolean parse_sdp_video(const guint8 *body, guint size, StreamProbeInfo *info) {
+    GstSDPMessage *sdp = NULL;
+    gboolean found = FALSE;
+
+    if (gst_sdp_message_new(&sdp) != GST_SDP_OK) return FALSE;
+    if (gst_sdp_message_parse_buffer(body, size, sdp) != GST_SDP_OK) {
+        gst_sdp_message_free(sdp);
+        return FALSE;
+    }
+
+    for (guint m = 0; m < gst_sdp_message_medias_len(sdp) && !found; m++) {
+        const GstSDPMedia *media = gst_sdp_message_get_media(sdp, m);
+        if (g_strcmp0(gst_sdp_media_get_media(media), "video") != 0) continue;
+        if (gst_sdp_media_formats_len(media) == 0) continue;
+
+        gint pt = atoi(gst_sdp_media_get_format(media, 0));
+        GstCaps *caps = gst_sdp_media_get_caps_from_media(media, pt);
+        if (!caps) continue;
+
+        GstStructure *s = gst_caps_get_structure(caps, 0);
+        const gchar *encoding = gst_structure_get_string(s, "encoding-name");
+
+        if (g_ascii_strcasecmp(encoding ? encoding : "", "H264") == 0) {
+            const gchar *sprop = gst_structure_get_string(s, "sprop-parameter-sets");
+            info->codec = CODEC_H264;
+            info->parameter_sets = g_strdup(sprop);
+            parse_sprop_sps(sprop, CODEC_H264, info);
+            if (!info->profile) {
+                info->profile = g_strdup(gst_structure_get_string(s, "profile-level-id"));
+            }
+        } else if (g_ascii_strcasecmp(encoding ? encoding : "", "H265") == 0) {
+            const gchar *vps = gst_structure_get_string(s, "sprop-vps");
+            const gchar *sps = gst_structure_get_string(s, "sprop-sps");
+            const gchar *pps = gst_structure_get_string(s, "sprop-pps");
+            info->codec = CODEC_H265;
+            if (vps && sps && pps) {
+                info->parameter_sets = g_strdup_printf("%s,%s,%s", vps, sps, pps);
+            }
+            parse_sprop_sps(sps, CODEC_H265, info);
+        } else {
+            /* Codec khác (MJPEG, ...) - giữ CODEC_AUTO để dùng pipeline decode */
+            info->codec = CODEC_AUTO;
+        }
+
+        gst_caps_unref(caps);
+        found = TRUE;
+    }
+
+    gst_sdp_message_free(sdp);
+    return found;
+}
+
+/* Cấu hình auth từ header WWW-Authenticate (ưu tiên Digest) */
+static gboolean setup_auth(GstRTSPConnection *conn, GstRTSPMessage *response, const GstRTSPUrl *url) {
+    GstRTSPAuthMethod method = GST_RTSP_AUTH_NONE;
+
+    if (!url->user || !url->passwd) return FALSE;
+
+    GstRTSPAuthCredential **credentials =
+        gst_rtsp_message_parse_auth_credentials(response, GST_RTSP_HDR_WWW_AUTHENTICATE);
+    if (!credentials) return FALSE;
+
+    for (GstRTSPAuthCredential **c = credentials; *c; c++) {
+        if ((*c)->scheme == GST_RTSP_AUTH_DIGEST) {
+            method = GST_RTSP_AUTH_DIGEST;
+            gst_rtsp_connection_clear_auth_params(conn);
+            for (GstRTSPAuthParam **p = (*c)->params; p && *p; p++) {
+                gst_rtsp_connection_set_auth_param(conn, (*p)->name, (*p)->value);
+            }
+            break;
+        }
+        if ((*c)->scheme == GST_RTSP_AUTH_BASIC) {
+            method = GST_RTSP_AUTH_BASIC;
+        }
+    }
+    gst_rtsp_auth_credentials_free(credentials);
+
+    if (method == GST_RTSP_AUTH_NONE) return FALSE;
+
+    gst_rtsp_connection_set_auth(conn, method, url->user, url->passwd);
+    return TRUE;
+}
+
+gboolean camera_probe_stream(const gchar *rtsp_url,
+                             guint timeout_ms,
+                             StreamProbeInfo *info) {
+    GstRTSPUrl *url = NULL;
+    GstRTSPConnection *conn = NULL;
+    gchar *request_uri = NULL;
+    gboolean ok = FALSE;
+    gint64 timeout_us = (gint64)timeout_ms * 1000;
+
+    if (!rtsp_url || gst_rtsp_url_parse(rtsp_url, &url) != GST_RTSP_OK) {
+        return FALSE;
+    }
+
+    if (gst_rtsp_connection_create(url, &conn) != GST_RTSP_OK) {
+        gst_rtsp_url_free(url);
+        return FALSE;
+    }
+
+    if (gst_rtsp_connection_connect_usec(conn, timeout_us) != GST_RTSP_OK) {
+        goto done;
+    }
+
+    request_uri = gst_rtsp_url_get_request_uri(url);
+
+    /* Lần 1 không auth, lần 2 với auth nếu camera trả về 401 */
+    for (gint attempt = 0; attempt < 2 && !ok; attempt++) {
+        GstRTSPMessage request = { 0 };
+        GstRTSPMessage response = { 0 };
+
+        gst_rtsp_message_init_request(&request, GST_RTSP_DESCRIBE, request_uri);
+        gst_rtsp_message_add_header(&request, GST_RTSP_HDR_ACCEPT, "application/sdp");
+        gchar *cseq = g_strdup_printf("%d", attempt + 1);
+        gst_rtsp_message_add_header(&request, GST_RTSP_HDR_CSEQ, cseq);
+        g_free(cseq);
+
+        GstRTSPResult res = gst_rtsp_connection_send_usec(conn, &request, timeout_us);
+        gst_rtsp_message_unset(&request);
+        if (res != GST_RTSP_OK) break;
+
+        if (gst_rtsp_connection_receive_usec(conn, &response, timeout_us) != GST_RTSP_OK) {
+            gst_rtsp_message_unset(&response);
+            break;
+        }
+
+        GstRTSPStatusCode code = response.type_data.response.code;
+        if (code == GST_RTSP_STS_UNAUTHORIZED && attempt == 0) {
+            gboolean retry = setup_auth(conn, &response, url);
+            gst_rtsp_message_unset(&response);
+            if (!retry) break;
+            continue;
+        }
+
+        if (code == GST_RTSP_STS_OK) {
+            guint8 *body = NULL;
+            guint body_size = 0;
+            gst_rtsp_message_get_body(&response, &body, &body_size);
+            ok = body && parse_sdp_video(body, body_size, info);
+        }
+        gst_rtsp_message_unset(&response);
+        break;
+    }
+
+    gst_rtsp_connection_close(conn);
+
+done:
+    g_free(request_uri);
+    gst_rtsp_connection_free(conn);
+    gst_rtsp_url_free(url);
+
+    info->probed = ok;
+    return ok;
+}
+
+static void probe_job_func(gpointer data, gpointer user_data) {
+    ProbeJob *job = data;
+    gint64 start = g_get_monotonic_time();
+
+    camera_probe_info_clear(job->info);
+    gboolean ok = camera_probe_stream(job->rtsp_url, job->timeout_ms, job->info);
+    gint64 elapsed_ms = (g_get_monotonic_time() - start) / 1000;
+
+    if (ok) {
+        g_print("[probe] %s-%s: %s %s %dx%d (%ld ms)\n",
+                job->camera_name,
+                job->main_stream ? "MAIN" : "SUB",
+                job->info->codec == CODEC_H265 ? "H265" :
+                job->info->codec == CODEC_H264 ? "H264" : "other",
+                job->info->profile ? job->info->profile : "?",
+                job->info->width, job->info->height,
+                (long)elapsed_ms);
+    } else {
+        g_printerr("[probe] %s-%s: DESCRIBE failed (%ld ms)\n",
+                   job->camera_name,
+                   job->main_stream ? "MAIN" : "SUB",
+                   (long)elapsed_ms);
+    }
+
+    g_free(job);
+}
+
+void camera_probe_all(CameraConfig *cameras,
+                      gint count,
+                      guint max_concurrency,
+                      guint timeout_ms) {
+    gint64 start = g_get_monotonic_time();
+    GError *error = NULL;
+
+    if (count <= 0) return;
+    if (max_concurrency == 0) max_concurrency = CAMERA_PROBE_CONCURRENCY;
+
+    GThreadPool *pool = g_thread_pool_new(probe_job_func, NULL, max_concurrency, FALSE, &error);
+    if (!pool) {
+        g_printerr("Failed to create probe thread pool: %s\n", error->message);
+        g_error_free(error);
+        return;
+    }
+
+    for (gint i = 0; i < count; i++) {
+        CameraConfig *cam = &cameras[i];
+
+        for (gint s = 0; s < 2; s++) {
+            gboolean main_stream = (s == 0);
+            const gchar *url = main_stream ? cam->rtsp_url_main : cam->rtsp_url_sub;
+            if (!url) continue;
+
+            ProbeJob *job = g_new0(ProbeJob, 1);
+            job->camera_name = cam->name;
+            job->rtsp_url = url;
+            job->main_stream = main_stream;
+            job->info = main_stream ? &cam->probe_main : &cam->probe_sub;
+            job->timeout_ms = timeout_ms;
+            g_thread_pool_push(pool, job, NULL);
+        }
+    }
+
+    /* Chờ tất cả job xong */
+    g_thread_pool_free(pool, FALSE, TRUE);
+
+    for (gint i = 0; i < count; i++) {
+        CameraConfig *cam = &cameras[i];
+        for (gint s = 0; s < 2; s++) {
+            gboolean main_stream = (s == 0);
+            CodecType configured = main_stream ? cam->codec_main : cam->codec_sub;
+            const StreamProbeInfo *info = main_stream ? &cam->probe_main : &cam->probe_sub;
+
+            if (info->probed && configured != CODEC_AUTO && info->codec != CODEC_AUTO &&
+                configured != info->codec) {
+                g_printerr("[probe] %s-%s: configured codec disagrees with SDP, using configured\n",
+                           cam->name, main_stream ? "MAIN" : "SUB");
+            }
+        }
+    }
+
+    g_print("[probe] Probed %d cameras in %ld ms\n",
+            count, (long)((g_get_monotonic_time() - start) / 1000));
+}
+
+CodecType camera_resolve_codec(const CameraConfig *cam, gboolean main_stream) {
+    CodecType codec = main_stream ? cam->codec_main : cam->codec_sub;
+    const StreamProbeInfo *info = main_stream ? &cam->probe_main : &cam->probe_sub;
+
+    if (codec == CODEC_AUTO && info->probed) {
+        return info->codec;
+    }
+    return codec;
+}
+
+void camera_probe_info_clear(StreamProbeInfo *info) {
+    g_free(info->profile);
+    g_free(info->parameter_sets);
+    memset(info, 0, sizeof(StreamProbeInfo));
+}
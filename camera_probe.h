@@ -0,0 +1,27 @@
+#ifndef CAMERA_PROBE_H
+#define CAMERA_PROBE_H
+
+#include <glib.h>
+#include "camera_config.h"
+
+#define CAMERA_PROBE_CONCURRENCY  32
+#define CAMERA_PROBE_TIMEOUT_MS   3000
+
+/* Probe song song tất cả camera (chỉ DESCRIBE/SDP), kết quả lưu vào probe_main/probe_sub */
+void camera_probe_all(CameraConfig *cameras,
+                      gint count,
+                      guint max_concurrency,
+                      guint timeout_ms);
+
+/* Probe một URL, trả về FALSE nếu không lấy được SDP */
+gboolean camera_probe_stream(const gchar *rtsp_url,
+                             guint timeout_ms,
+                             StreamProbeInfo *info);
+
+/* Codec thực tế của stream: codec cấu hình, hoặc codec đã probe nếu là CODEC_AUTO */
+CodecType camera_resolve_codec(const CameraConfig *cam, gboolean main_stream);
+
+/* Giải phóng dữ liệu probe */
+void camera_probe_info_clear(StreamProbeInfo *info);
+
+#endif // CAMERA_PROBE_H
@@ -0,0 +1,253 @@
+#include "client_congestion.h"
+#include <string.h>
+
+/* Bộ đếm cho mỗi client - dùng chung giữa tất cả media của client đó */
+typedef struct {
+    GstRTSPClient *client;      /* NULL sau khi client đóng */
+    gchar *peer;
+    guint64 leaked;             /* buffer bị queue leak khi đầy */
+    guint64 skipped;            /* delta frame bị bỏ khi chờ keyframe */
+    guint64 resyncs;            /* số lần nhảy tới keyframe tiếp theo */
+    guint64 disconnects;
+    gboolean closing;
+} ClientCongestionStats;
+
+/* Trạng thái của một send queue (một media) */
+typedef struct {
+    ClientCongestionStats *stats;
+    guint disconnect_after_ms;
+    gint waiting_keyframe;      /* atomic */
+    gint congested;             /* atomic */
+    GMutex lock;
+    gint64 congested_since;
+    gint64 last_overrun;
+} SendQueueWatch;
+
+static const ClientCongestionPolicy default_policy = {
+    CLIENT_SENDQ_MAX_BYTES,
+    CLIENT_SENDQ_MAX_TIME_NS,
+    CLIENT_CONGESTION_DISCONNECT_MS
+};
+
+static GMutex stats_lock;
+static GHashTable *client_stats = NULL;   /* GstRTSPClient* -> ClientCongestionStats* */
+
+const ClientCongestionPolicy* client_congestion_default_policy(void) {
+    return &default_policy;
+}
+
+gchar* client_congestion_queue_desc(const ClientCongestionPolicy *policy) {
+    if (!policy) policy = &default_policy;
+
+    return g_strdup_printf(
+        "queue name=" CLIENT_SENDQ_NAME " max-size-buffers=0 max-size-bytes=%u "
+        "max-size-time=%" G_GUINT64_FORMAT " leaky=downstream",
+        policy->max_bytes, policy->max_time_ns);
+}
+
+static void stats_clear(gpointer data) {
+    ClientCongestionStats *stats = data;
+    g_free(stats->peer);
+}
+
+static void stats_release(gpointer data) {
+    g_atomic_rc_box_release_full(data, stats_clear);
+}
+
+static void print_stats_line(const ClientCongestionStats *stats) {
+    g_print("  %-21s leaked=%" G_GUINT64_FORMAT " skipped=%" G_GUINT64_FORMAT
+            " resyncs=%" G_GUINT64_FORMAT " disconnects=%" G_GUINT64_FORMAT "\n",
+            stats->peer ? stats->peer : "?",
+            stats->leaked, stats->skipped, stats->resyncs, stats->disconnects);
+}
+
+static void on_client_closed(GstRTSPClient *client, gpointer user_data) {
+    g_mutex_lock(&stats_lock);
+    ClientCongestionStats *stats = g_hash_table_lookup(client_stats, client);
+    if (stats) {
+        stats->client = NULL;
+        if (stats->leaked || stats->skipped) {
+            g_print("[congestion] Client closed:\n");
+            print_stats_line(stats);
+        }
+        g_hash_table_remove(client_stats, client);
+    }
+    g_mutex_unlock(&stats_lock);
+}
+
+static void on_client_connected(GstRTSPServer *server, GstRTSPClient *client, gpointer user_data) {
+    ClientCongestionStats *stats = g_atomic_rc_box_new0(ClientCongestionStats);
+    GstRTSPConnection *conn = gst_rtsp_client_get_connection(client);
+
+    stats->client = client;
+    stats->peer = g_strdup(conn ? gst_rtsp_connection_get_ip(conn) : NULL);
+
+    g_mutex_lock(&stats_lock);
+    g_hash_table_insert(client_stats, client, stats);
+    g_mutex_unlock(&stats_lock);
+
+    g_signal_connect(client, "closed", G_CALLBACK(on_client_closed), NULL);
+}
+
+void client_congestion_init(GstRTSPServer *server) {
+    g_mutex_lock(&stats_lock);
+    if (!client_stats) {
+        client_stats = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, stats_release);
+    }
+    g_mutex_unlock(&stats_lock);
+
+    g_signal_connect(server, "client-connected", G_CALLBACK(on_client_connected), NULL);
+}
+
+static gboolean close_congested_client(gpointer user_data) {
+    GstRTSPClient *client = GST_RTSP_CLIENT(user_data);
+    gst_rtsp_client_close(client);
+    return G_SOURCE_REMOVE;
+}
+
+static void send_queue_watch_free(gpointer data) {
+    SendQueueWatch *watch = data;
+    stats_release(watch->stats);
+    g_mutex_clear(&watch->lock);
+    g_free(watch);
+}
+
+/* Queue đầy: buffer cũ nhất bị leak, client phải chờ keyframe tiếp theo */
+static void on_sendq_overrun(GstElement *queue, gpointer user_data) {
+    SendQueueWatch *watch = user_data;
+    ClientCongestionStats *stats = watch->stats;
+    gint64 now = g_get_monotonic_time();
+    gboolean new_resync = !g_atomic_int_get(&watch->waiting_keyframe);
+    gboolean disconnect = FALSE;
+
+    g_atomic_int_set(&watch->waiting_keyframe, TRUE);
+    g_atomic_int_set(&watch->congested, TRUE);
+
+    g_mutex_lock(&watch->lock);
+    if (watch->congested_since == 0) {
+        watch->congested_since = now;
+    }
+    watch->last_overrun = now;
+    if (watch->disconnect_after_ms > 0 &&
+        now - watch->congested_since > (gint64)watch->disconnect_after_ms * 1000) {
+        disconnect = TRUE;
+    }
+    g_mutex_unlock(&watch->lock);
+
+    GstRTSPClient *client = NULL;
+
+    g_mutex_lock(&stats_lock);
+    stats->leaked++;
+    if (new_resync) {
+        stats->resyncs++;
+    }
+    if (disconnect && !stats->closing && stats->client) {
+        stats->closing = TRUE;
+        stats->disconnects++;
+        client = g_object_ref(stats->client);
+    }
+    g_mutex_unlock(&stats_lock);
+
+    if (client) {
+        g_print("[congestion] Client %s congested for more than %u ms - disconnecting\n",
+                stats->peer ? stats->peer : "?", watch->disconnect_after_ms);
+        g_main_context_invoke_full(NULL, G_PRIORITY_DEFAULT,
+                                   close_congested_client, client, g_object_unref);
+    }
+}
+
+/* Bỏ delta frame cho tới keyframe tiếp theo, chỉ áp dụng cho client này */
+static GstPadProbeReturn sendq_src_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    SendQueueWatch *watch = user_data;
+    GstBuffer *buf = GST_PAD_PROBE_INFO_BUFFER(info);
+
+    if (g_atomic_int_get(&watch->waiting_keyframe)) {
+        if (GST_BUFFER_FLAG_IS_SET(buf, GST_BUFFER_FLAG_DELTA_UNIT)) {
+            g_mutex_lock(&stats_lock);
+            watch->stats->skipped++;
+            g_mutex_unlock(&stats_lock);
+            return GST_PAD_PROBE_DROP;
+        }
+        g_atomic_int_set(&watch->waiting_keyframe, FALSE);
+    }
+
+    if (g_atomic_int_get(&watch->congested)) {
+        gint64 now = g_get_monotonic_time();
+
+        g_mutex_lock(&watch->lock);
+        if (now - watch->last_overrun > CLIENT_CONGESTION_RECOVER_MS * 1000) {
+            watch->congested_since = 0;
+            g_atomic_int_set(&watch->congested, FALSE);
+        }
+        g_mutex_unlock(&watch->lock);
+    }
+
+    return GST_PAD_PROBE_OK;
+}
+
+void client_congestion_attach(GstRTSPMedia *media,
+                              GstRTSPClient *client,
+                              const ClientCongestionPolicy *policy) {
+    if (!media || !client) return;
+    if (!policy) policy = &default_policy;
+
+    g_mutex_lock(&stats_lock);
+    ClientCongestionStats *stats = client_stats ? g_hash_table_lookup(client_stats, client) : NULL;
+    if (stats) {
+        g_atomic_rc_box_acquire(stats);
+    }
+    g_mutex_unlock(&stats_lock);
+
+    if (!stats) {
+        return;
+    }
+
+    GstElement *pipeline = gst_rtsp_media_get_element(media);
+    GstElement *queue = pipeline ? gst_bin_get_by_name(GST_BIN(pipeline), CLIENT_SENDQ_NAME) : NULL;
+
+    if (!queue) {
+        stats_release(stats);
+        if (pipeline) gst_object_unref(pipeline);
+        return;
+    }
+
+    SendQueueWatch *watch = g_new0(SendQueueWatch, 1);
+    watch->stats = stats;
+    watch->disconnect_after_ms = policy->disconnect_after_ms;
+    g_mutex_init(&watch->lock);
+
+    /* watch sống cùng queue */
+    g_object_set_data_full(G_OBJECT(queue), "congestion-watch", watch, send_queue_watch_free);
+    g_object_set(queue, "silent", FALSE, NULL);
+    g_signal_connect(queue, "overrun", G_CALLBACK(on_sendq_overrun), watch);
+
+    GstPad *src_pad = gst_element_get_static_pad(queue, "src");
+    gst_pad_add_probe(src_pad, GST_PAD_PROBE_TYPE_BUFFER, sendq_src_probe, watch, NULL);
+    gst_object_unref(src_pad);
+
+    gst_object_unref(queue);
+    gst_object_unref(pipeline);
+}
+
+gboolean client_congestion_report(gpointer user_data) {
+    GHashTableIter iter;
+    gpointer value;
+    gboolean header = FALSE;
+
+    g_mutex_lock(&stats_lock);
+    if (client_stats) {
+        g_hash_table_iter_init(&iter, client_stats);
+        while (g_hash_table_iter_next(&iter, NULL, &value)) {
+            ClientCongestionStats *stats = value;
+            if (!stats->leaked && !stats->skipped) continue;
+            if (!header) {
+                g_print("[congestion] Per-client drops:\n");
+                header = TRUE;
+            }
+            print_stats_line(stats);
+        }
+    }
+    g_mutex_unlock(&stats_lock);
+
+    return G_SOURCE_CONTINUE;
+}
@@ -0,0 +1,40 @@
+#ifndef CLIENT_CONGESTION_H
+#define CLIENT_CONGESTION_H
+
+#include <gst/gst.h>
+#include <gst/rtsp-server/rtsp-server.h>
+
+/* Tên queue gửi riêng cho mỗi client trong live pipeline */
+#define CLIENT_SENDQ_NAME "sendq"
+
+/* Giới hạn mặc định của send queue */
+#define CLIENT_SENDQ_MAX_BYTES           (2 * 1024 * 1024)
+#define CLIENT_SENDQ_MAX_TIME_NS         1000000000ULL
+#define CLIENT_CONGESTION_DISCONNECT_MS  10000
+#define CLIENT_CONGESTION_RECOVER_MS     2000
+
+/* Policy cho client chậm */
+typedef struct {
+    guint max_bytes;             /* 0 = không giới hạn byte */
+    guint64 max_time_ns;         /* 0 = không giới hạn thời gian */
+    guint disconnect_after_ms;   /* 0 = không bao giờ ngắt kết nối */
+} ClientCongestionPolicy;
+
+/* Policy mặc định (dùng các giá trị CLIENT_SENDQ_*) */
+const ClientCongestionPolicy* client_congestion_default_policy(void);
+
+/* Mô tả queue cho launch string, ví dụ "queue name=sendq max-size-bytes=..." */
+gchar* client_congestion_queue_desc(const ClientCongestionPolicy *policy);
+
+/* Theo dõi client kết nối vào server */
+void client_congestion_init(GstRTSPServer *server);
+
+/* Gắn policy vào send queue của media cho client đang xử lý request */
+void client_congestion_attach(GstRTSPMedia *media,
+                              GstRTSPClient *client,
+                              const ClientCongestionPolicy *policy);
+
+/* In bộ đếm drop theo từng client (GSourceFunc) */
+gboolean client_congestion_report(gpointer user_data);
+
+#endif // CLIENT_CONGESTION_H
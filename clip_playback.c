@@ -0,0 +1,543 @@
+#include "clip_playback.h"
+#include <string.h>
+#include "recording_lookup.h"
+#include "segment_clock.h"
+#include "segment_cache.h"
+#include "native_segment.h"
+
+/* Chờ tối đa chừng này cho seek của một file trước khi đọc tiếp (tránh kẹt nếu seek lỗi) */
+#define CLIP_SEEK_WAIT_US (2 * G_USEC_PER_SEC)
+
+/* Một file trong chuỗi phát: phần [start_pos, stop_pos) của file thuộc một đoạn */
+typedef struct {
+    gchar *path;
+    SegmentClock clock;
+    gint64 start_pos;       /* ns trong file, -1: từ đầu file */
+    gint64 stop_pos;        /* ns trong file, -1: tới hết file */
+    guint range;
+    gboolean first_of_range;
+} ClipPiece;
+
+typedef enum {
+    PIECE_WAIT_DATA = 0,    /* chờ buffer đầu: demux đã đọc header, seek được */
+    PIECE_SEEKING,          /* đã gửi seek, bỏ mọi thứ tới segment của seek */
+    PIECE_FLOWING,
+    PIECE_SKIPPED           /* seek lỗi: bỏ cả file, chỉ cho EOS đi */
+} PieceState;
+
+typedef struct _ClipPlayback ClipPlayback;
+
+/* Bin "nguồn ! h264parse ! queue" của một file, nối vào concat */
+typedef struct {
+    ClipPlayback *clip;
+    guint index;
+    GstElement *bin;        /* NULL khi đã gỡ khỏi pipeline */
+    GstPad *concat_pad;
+    gint64 seek_start;      /* keyframe đã xác định trước (native) hoặc start_pos */
+    gint state;             /* PieceState, atomic */
+    gint seek_seqnum;       /* atomic */
+    gboolean started;       /* buffer đầu đã đi qua (streaming thread) */
+
+    GMutex lock;
+    GCond cond;
+    gboolean flushing;
+} ClipBranch;
+
+struct _ClipPlayback {
+    gchar *camera;
+    GArray *pieces;         /* ClipPiece */
+    guint n_ranges;
+    GWeakRef pipeline;
+
+    GMutex lock;
+    GPtrArray *branches;    /* ClipBranch* theo index piece, NULL nếu chưa dựng */
+    guint next_build;
+    guint current;
+};
+
+typedef enum {
+    CLIP_JOB_SEEK,
+    CLIP_JOB_ADVANCE
+} ClipJobType;
+
+typedef struct {
+    ClipJobType type;
+    ClipPlayback *clip;
+    ClipBranch *branch;
+} ClipJob;
+
+static GThreadPool *clip_pool = NULL;
+static GMutex clip_pool_lock;
+
+static void clip_playback_clear(ClipPlayback *clip) {
+    for (guint i = 0; i < clip->pieces->len; i++) {
+        g_free(g_array_index(clip->pieces, ClipPiece, i).path);
+    }
+    g_array_unref(clip->pieces);
+    g_ptr_array_unref(clip->branches);
+    g_weak_ref_clear(&clip->pipeline);
+    g_mutex_clear(&clip->lock);
+    g_free(clip->camera);
+}
+
+static void clip_playback_unref(gpointer data) {
+    g_atomic_rc_box_release_full(data, (GDestroyNotify)clip_playback_clear);
+}
+
+static void clip_branch_free(gpointer data) {
+    ClipBranch *branch = data;
+    if (branch->concat_pad) gst_object_unref(branch->concat_pad);
+    g_mutex_clear(&branch->lock);
+    g_cond_clear(&branch->cond);
+    g_free(branch);
+}
+
+/* Probe giữ ref tới clip: pad của branch có thể sống lâu hơn pipeline data */
+static void clip_branch_release(gpointer data) {
+    clip_playback_unref(((ClipBranch *)data)->clip);
+}
+
+static void clip_job_func(gpointer data, gpointer user_data);
+
+static void push_job(ClipJobType type, ClipPlayback *clip, ClipBranch *branch) {
+    ClipJob *job = g_new0(ClipJob, 1);
+    job->type = type;
+    job->clip = g_atomic_rc_box_acquire(clip);
+    job->branch = branch;
+
+    g_mutex_lock(&clip_pool_lock);
+    if (!clip_pool) {
+        clip_pool = g_thread_pool_new(clip_job_func, NULL, CLIP_PLAYBACK_THREADS, FALSE, NULL);
+    }
+    g_mutex_unlock(&clip_pool_lock);
+
+    g_thread_pool_push(clip_pool, job, NULL);
+}
+
+/* ===== Ranges ===== */
+
+GArray* clip_playback_parse_ranges(const gchar *value) {
+    if (!value || !value[0]) return NULL;
+
+    GArray *ranges = g_array_new(FALSE, FALSE, sizeof(ClipRange));
+    gchar **items = g_strsplit(value, ",", -1);
+
+    for (gchar **item = items; *item; item++) {
+        gchar *dash = strchr(*item, '-');
+        if (!dash || ranges->len >= CLIP_PLAYBACK_MAX_RANGES) {
+            g_array_unref(ranges);
+            g_strfreev(items);
+            return NULL;
+        }
+        *dash = '\0';
+
+        ClipRange range = {
+            .start_us = parse_timestamp_us(*item),
+            .end_us = parse_timestamp_us(dash + 1),
+        };
+        if (range.start_us <= 0 || range.end_us <= range.start_us) {
+            g_array_unref(ranges);
+            g_strfreev(items);
+            return NULL;
+        }
+        g_array_append_val(ranges, range);
+    }
+    g_strfreev(items);
+
+    if (ranges->len == 0) {
+        g_array_unref(ranges);
+        return NULL;
+    }
+    return ranges;
+}
+
+/* Các file của một đoạn; vị trí trong file theo mapping của recording,
+ * không có mapping thì theo tên file (độ chính xác giây, pts 0 = đầu file) */
+static guint add_range_pieces(ClipPlayback *clip, StreamType stream_type,
+                              const ClipRange *range, guint range_index) {
+    gint64 duration = (range->end_us - range->start_us + G_USEC_PER_SEC - 1) / G_USEC_PER_SEC;
+    GArray *clocks = g_array_new(FALSE, TRUE, sizeof(SegmentClock));
+    GList *files = get_recording_files_from_timestamp(clip->camera, range->start_us, stream_type,
+                                                      duration, clocks);
+    guint added = 0;
+    guint i = 0;
+
+    for (GList *l = files; l != NULL; l = l->next, i++) {
+        const gchar *path = l->data;
+        SegmentClock clock = {0};
+        time_t file_ts = 0;
+
+        if (i < clocks->len) {
+            clock = g_array_index(clocks, SegmentClock, i);
+        }
+        gboolean has_ts = path_to_timestamp(path, &file_ts);
+        if (added > 0 && has_ts && (gint64)file_ts * G_USEC_PER_SEC >= range->end_us) break;
+
+        if (clock.source == SEGMENT_CLOCK_NONE && has_ts) {
+            clock.pts_ns = 0;
+            clock.wall_us = (gint64)file_ts * G_USEC_PER_SEC;
+            clock.source = SEGMENT_CLOCK_ARRIVAL;
+        }
+
+        ClipPiece piece = {0};
+        piece.path = g_strdup(path);
+        piece.clock = clock;
+        piece.range = range_index;
+        piece.first_of_range = added == 0;
+        piece.start_pos = -1;
+        piece.stop_pos = -1;
+        if (added == 0 && clock.source != SEGMENT_CLOCK_NONE) {
+            piece.start_pos = MAX(segment_clock_to_pts(&clock, range->start_us), 0);
+        }
+        g_array_append_val(clip->pieces, piece);
+        added++;
+    }
+
+    /* File cuối của đoạn dừng ở end (demux/nguồn tự EOS theo segment.stop) */
+    if (added > 0) {
+        ClipPiece *last = &g_array_index(clip->pieces, ClipPiece, clip->pieces->len - 1);
+        if (last->clock.source != SEGMENT_CLOCK_NONE) {
+            last->stop_pos = MAX(segment_clock_to_pts(&last->clock, range->end_us), 0);
+        }
+    }
+
+    g_list_free_full(files, g_free);
+    g_array_unref(clocks);
+    return added;
+}
+
+/* ===== Branch ===== */
+
+static GstPadProbeReturn branch_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    ClipBranch *branch = user_data;
+    gint state = g_atomic_int_get(&branch->state);
+
+    if (info->type & GST_PAD_PROBE_TYPE_BUFFER) {
+        switch (state) {
+            case PIECE_WAIT_DATA:
+                g_atomic_int_set(&branch->state, PIECE_SEEKING);
+                push_job(CLIP_JOB_SEEK, branch->clip, branch);
+                /* fall through */
+            case PIECE_SEEKING: {
+                /* Chờ flush của seek thay vì đọc tiếp phần file trước điểm bắt đầu */
+                gint64 deadline = g_get_monotonic_time() + CLIP_SEEK_WAIT_US;
+                g_mutex_lock(&branch->lock);
+                while (!branch->flushing && g_atomic_int_get(&branch->state) == PIECE_SEEKING) {
+                    if (!g_cond_wait_until(&branch->cond, &branch->lock, deadline)) break;
+                }
+                g_mutex_unlock(&branch->lock);
+                return GST_PAD_PROBE_DROP;
+            }
+            case PIECE_SKIPPED:
+                return GST_PAD_PROBE_DROP;
+            default:
+                break;
+        }
+
+        /* Cờ discontinuity (bit D của replay extension) chỉ ở frame đầu mỗi đoạn,
+         * không ở chỗ nối hai file trong cùng đoạn */
+        if (!branch->started) {
+            branch->started = TRUE;
+            const ClipPiece *piece = &g_array_index(branch->clip->pieces, ClipPiece, branch->index);
+            GstBuffer *buffer = gst_buffer_make_writable(GST_PAD_PROBE_INFO_BUFFER(info));
+            if (piece->first_of_range) {
+                GST_BUFFER_FLAG_SET(buffer, GST_BUFFER_FLAG_DISCONT);
+            } else {
+                GST_BUFFER_FLAG_UNSET(buffer, GST_BUFFER_FLAG_DISCONT);
+            }
+            GST_PAD_PROBE_INFO_DATA(info) = buffer;
+        }
+        return GST_PAD_PROBE_OK;
+    }
+
+    GstEvent *event = GST_PAD_PROBE_INFO_EVENT(info);
+    switch (GST_EVENT_TYPE(event)) {
+        case GST_EVENT_FLUSH_START:
+        case GST_EVENT_FLUSH_STOP:
+            if (state == PIECE_FLOWING) return GST_PAD_PROBE_OK;
+            /* Flush do seek riêng của file này: không lan xuống concat */
+            g_mutex_lock(&branch->lock);
+            branch->flushing = GST_EVENT_TYPE(event) == GST_EVENT_FLUSH_START;
+            g_cond_broadcast(&branch->cond);
+            g_mutex_unlock(&branch->lock);
+            return GST_PAD_PROBE_DROP;
+        case GST_EVENT_SEGMENT:
+            if (state == PIECE_SEEKING &&
+                gst_event_get_seqnum(event) == (guint32)g_atomic_int_get(&branch->seek_seqnum)) {
+                g_atomic_int_set(&branch->state, PIECE_FLOWING);
+                return GST_PAD_PROBE_OK;
+            }
+            return state == PIECE_FLOWING ? GST_PAD_PROBE_OK : GST_PAD_PROBE_DROP;
+        case GST_EVENT_EOS:
+            /* Nguồn có thể đọc hết file trước khi seek tới: EOS đó không tính */
+            return state == PIECE_WAIT_DATA || state == PIECE_SEEKING ?
+                   GST_PAD_PROBE_DROP : GST_PAD_PROBE_OK;
+        default:
+            return GST_PAD_PROBE_OK;
+    }
+}
+
+static void branch_seek(ClipPlayback *clip, ClipBranch *branch) {
+    const ClipPiece *piece = &g_array_index(clip->pieces, ClipPiece, branch->index);
+    GstSeekFlags flags = GST_SEEK_FLAG_FLUSH;
+    gboolean ok = FALSE;
+
+    /* Native: keyframe đã tìm qua index nên seek chính xác; MKV: demux tự lùi về keyframe */
+    flags |= native_segment_is_native_path(piece->path) ?
+             GST_SEEK_FLAG_ACCURATE : GST_SEEK_FLAG_KEY_UNIT | GST_SEEK_FLAG_SNAP_BEFORE;
+
+    g_mutex_lock(&clip->lock);
+    GstElement *bin = branch->bin ? gst_object_ref(branch->bin) : NULL;
+    g_mutex_unlock(&clip->lock);
+
+    if (bin) {
+        GstElement *parse = gst_bin_get_by_name(GST_BIN(bin), "parse");
+        GstPad *pad = gst_element_get_static_pad(parse, "src");
+        GstEvent *seek = gst_event_new_seek(1.0, GST_FORMAT_TIME, flags,
+                                            GST_SEEK_TYPE_SET, MAX(branch->seek_start, 0),
+                                            piece->stop_pos >= 0 ? GST_SEEK_TYPE_SET : GST_SEEK_TYPE_NONE,
+                                            piece->stop_pos >= 0 ? piece->stop_pos : GST_CLOCK_TIME_NONE);
+        g_atomic_int_set(&branch->seek_seqnum, (gint)gst_event_get_seqnum(seek));
+        ok = gst_pad_send_event(pad, seek);
+        gst_object_unref(pad);
+        gst_object_unref(parse);
+        gst_object_unref(bin);
+    }
+
+    if (!ok) {
+        g_printerr("[clip] %s: seek failed in %s, skipping file\n", clip->camera, piece->path);
+        g_mutex_lock(&branch->lock);
+        g_atomic_int_set(&branch->state, PIECE_SKIPPED);
+        g_cond_broadcast(&branch->cond);
+        g_mutex_unlock(&branch->lock);
+    }
+}
+
+/* Dựng bin cho piece index và nối vào concat (gọi với clip->lock).
+ * Phần đọc trước: next-location của nguồn nạp file sau vào cache, keyframe của file
+ * native được tìm qua index ngay tại đây (ngoài streaming thread của file đang phát). */
+static gboolean build_branch(ClipPlayback *clip, GstElement *pipeline, GstElement *concat,
+                             guint index, gboolean running) {
+    const ClipPiece *piece = &g_array_index(clip->pieces, ClipPiece, index);
+    const gchar *next = index + 1 < clip->pieces->len ?
+                        g_array_index(clip->pieces, ClipPiece, index + 1).path : "";
+    gchar *desc;
+
+    if (native_segment_is_native_path(piece->path)) {
+        desc = g_strdup_printf(NATIVE_SEGMENT_SRC_NAME " location=\"%s\" next-location=\"%s\" ! ",
+                               piece->path, next);
+    } else {
+        desc = g_strdup_printf(SEGMENT_CACHE_SRC_NAME " location=\"%s\" next-location=\"%s\" ! "
+                               "matroskademux ! ", piece->path, next);
+    }
+    gchar *launch = g_strdup_printf("%sh264parse name=parse ! "
+                                    "queue max-size-time=3000000000 max-size-bytes=0 max-size-buffers=0",
+                                    desc);
+    g_free(desc);
+
+    GError *error = NULL;
+    GstElement *bin = gst_parse_bin_from_description(launch, TRUE, &error);
+    g_free(launch);
+    if (!bin) {
+        g_printerr("[clip] %s: cannot build source for %s: %s\n", clip->camera, piece->path,
+                   error ? error->message : "unknown error");
+        g_clear_error(&error);
+        return FALSE;
+    }
+    g_clear_error(&error);
+
+    ClipBranch *branch = g_new0(ClipBranch, 1);
+    branch->clip = clip;
+    branch->index = index;
+    branch->bin = bin;
+    branch->seek_start = piece->start_pos;
+    g_mutex_init(&branch->lock);
+    g_cond_init(&branch->cond);
+
+    if (piece->start_pos > 0 && native_segment_is_native_path(piece->path)) {
+        NativeSegment *segment = native_segment_open(piece->path, NULL);
+        if (segment) {
+            const NativeFrame *frame = native_segment_frame(segment,
+                                                            native_segment_seek(segment, piece->start_pos));
+            if (frame && frame->pts >= 0) branch->seek_start = frame->pts;
+            native_segment_unref(segment);
+        }
+    }
+
+    gboolean needs_seek = piece->start_pos >= 0 || piece->stop_pos >= 0;
+    branch->state = needs_seek ? PIECE_WAIT_DATA : PIECE_FLOWING;
+
+    GstElement *parse = gst_bin_get_by_name(GST_BIN(bin), "parse");
+    segment_clock_stamp_frames(parse, &piece->clock);
+    GstPad *parse_src = gst_element_get_static_pad(parse, "src");
+    gst_pad_add_probe(parse_src,
+                      GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM |
+                      GST_PAD_PROBE_TYPE_EVENT_FLUSH,
+                      branch_probe, branch, clip_branch_release);
+    g_atomic_rc_box_acquire(clip);
+    gst_object_unref(parse_src);
+    gst_object_unref(parse);
+
+    gchar *name = g_strdup_printf("piece%u", index);
+    gst_object_set_name(GST_OBJECT(bin), name);
+    g_free(name);
+
+    gst_bin_add(GST_BIN(pipeline), bin);
+    branch->concat_pad = gst_element_request_pad_simple(concat, "sink_%u");
+    GstPad *src = gst_element_get_static_pad(bin, "src");
+    gst_pad_link(src, branch->concat_pad);
+    gst_object_unref(src);
+
+    g_ptr_array_index(clip->branches, index) = branch;
+
+    if (running) {
+        gst_element_sync_state_with_parent(bin);
+    }
+    return TRUE;
+}
+
+static void release_branch(GstElement *pipeline, GstElement *concat, GstElement *bin, GstPad *concat_pad) {
+    gst_element_set_state(bin, GST_STATE_NULL);
+    gst_element_release_request_pad(concat, concat_pad);
+    gst_bin_remove(GST_BIN(pipeline), bin);
+}
+
+/* concat chuyển sang file mới: gỡ file đã phát xong, dựng trước file kế tiếp */
+static void branch_advance(ClipPlayback *clip) {
+    GstElement *pipeline = g_weak_ref_get(&clip->pipeline);
+    if (!pipeline) return;
+
+    GstElement *concat = gst_bin_get_by_name(GST_BIN(pipeline), "concat");
+    GstPad *active = NULL;
+    g_object_get(concat, "active-pad", &active, NULL);
+
+    GPtrArray *finished = g_ptr_array_new();
+    gboolean switched = FALSE;
+
+    g_mutex_lock(&clip->lock);
+    for (guint i = 0; i < clip->next_build; i++) {
+        ClipBranch *branch = g_ptr_array_index(clip->branches, i);
+        if (branch && branch->concat_pad == active && i != clip->current) {
+            clip->current = i;
+            switched = TRUE;
+        }
+    }
+    for (guint i = 0; i < clip->current; i++) {
+        ClipBranch *branch = g_ptr_array_index(clip->branches, i);
+        if (branch && branch->bin) {
+            g_ptr_array_add(finished, branch);
+        }
+    }
+    while (clip->next_build < clip->pieces->len &&
+           clip->next_build <= clip->current + CLIP_PLAYBACK_PREFETCH) {
+        build_branch(clip, pipeline, concat, clip->next_build++, TRUE);
+    }
+    const ClipPiece *piece = &g_array_index(clip->pieces, ClipPiece, clip->current);
+    guint range = piece->range;
+    gboolean range_start = switched && piece->first_of_range;
+    g_mutex_unlock(&clip->lock);
+
+    for (guint i = 0; i < finished->len; i++) {
+        ClipBranch *branch = g_ptr_array_index(finished, i);
+        release_branch(pipeline, concat, branch->bin, branch->concat_pad);
+        g_mutex_lock(&clip->lock);
+        branch->bin = NULL;
+        g_mutex_unlock(&clip->lock);
+    }
+    g_ptr_array_unref(finished);
+
+    if (range_start) {
+        g_print("[clip] %s: range %u/%u\n", clip->camera, range + 1, clip->n_ranges);
+    }
+
+    if (active) gst_object_unref(active);
+    gst_object_unref(concat);
+    gst_object_unref(pipeline);
+}
+
+static void clip_job_func(gpointer data, gpointer user_data) {
+    ClipJob *job = data;
+
+    switch (job->type) {
+        case CLIP_JOB_SEEK:
+            branch_seek(job->clip, job->branch);
+            break;
+        case CLIP_JOB_ADVANCE:
+            branch_advance(job->clip);
+            break;
+    }
+
+    clip_playback_unref(job->clip);
+    g_free(job);
+}
+
+/* Streaming thread của file vừa hết: không đổi pipeline ở đây */
+static void on_active_pad(GObject *concat, GParamSpec *pspec, gpointer user_data) {
+    push_job(CLIP_JOB_ADVANCE, user_data, NULL);
+}
+
+/* ===== Pipeline ===== */
+
+GstElement* clip_playback_create(const gchar *camera_name, StreamType stream_type, GArray *ranges) {
+    ClipPlayback *clip = g_atomic_rc_box_new0(ClipPlayback);
+    clip->camera = g_strdup(camera_name);
+    clip->pieces = g_array_new(FALSE, TRUE, sizeof(ClipPiece));
+    g_mutex_init(&clip->lock);
+    g_weak_ref_init(&clip->pipeline, NULL);
+
+    for (guint i = 0; i < ranges->len; i++) {
+        const ClipRange *range = &g_array_index(ranges, ClipRange, i);
+        if (add_range_pieces(clip, stream_type, range, clip->n_ranges) == 0) {
+            g_printerr("[clip] %s: no recording for range %u, skipped\n", camera_name, i + 1);
+            continue;
+        }
+        clip->n_ranges++;
+    }
+
+    if (clip->pieces->len == 0) {
+        clip->branches = g_ptr_array_new();
+        clip_playback_unref(clip);
+        return NULL;
+    }
+    clip->branches = g_ptr_array_new_with_free_func(clip_branch_free);
+    g_ptr_array_set_size(clip->branches, clip->pieces->len);
+
+    GError *error = NULL;
+    GstElement *pipeline = gst_parse_launch(
+        "concat name=concat ! "
+        "queue max-size-time=5000000000 max-size-bytes=0 max-size-buffers=0 ! "
+        "h264parse ! "
+        "rtph264pay name=pay0 pt=96 config-interval=-1 mtu=1400", &error);
+    if (error) {
+        g_printerr("Pipeline error: %s\n", error->message);
+        g_error_free(error);
+        if (pipeline) gst_object_unref(pipeline);
+        clip_playback_unref(clip);
+        return NULL;
+    }
+
+    g_weak_ref_set(&clip->pipeline, pipeline);
+    GstElement *concat = gst_bin_get_by_name(GST_BIN(pipeline), "concat");
+
+    g_mutex_lock(&clip->lock);
+    while (clip->next_build < clip->pieces->len && clip->next_build <= CLIP_PLAYBACK_PREFETCH) {
+        build_branch(clip, pipeline, concat, clip->next_build++, FALSE);
+    }
+    g_mutex_unlock(&clip->lock);
+
+    g_signal_connect_data(concat, "notify::active-pad", G_CALLBACK(on_active_pad),
+                          g_atomic_rc_box_acquire(clip), (GClosureNotify)clip_playback_unref, 0);
+    gst_object_unref(concat);
+
+    GstElement *pay = gst_bin_get_by_name(GST_BIN(pipeline), "pay0");
+    segment_clock_attach_payloader(pay);
+    if (pay) gst_object_unref(pay);
+
+    g_print("[clip] %s: %u ranges, %u files\n", camera_name, clip->n_ranges, clip->pieces->len);
+    g_object_set_data_full(G_OBJECT(pipeline), "clip-playback", clip, clip_playback_unref);
+    return pipeline;
+}
+
+gboolean clip_playback_is_clip(GstElement *element) {
+    return element && g_object_get_data(G_OBJECT(element), "clip-playback") != NULL;
+}
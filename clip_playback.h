@@ -0,0 +1,34 @@
+#ifndef CLIP_PLAYBACK_H
+#define CLIP_PLAYBACK_H
+
+#include <gst/gst.h>
+#include "recording_manager.h"
+
+/* Playback nhiều đoạn liền nhau trong một session (ví dụ các event motion trong ngày):
+ *   rtsp://host/<camera>?ranges=<start>-<end>,<start>-<end>[&stream=1]
+ * start/end là unix time tính bằng giây (cho phép phần lẻ như ?timestamp=).
+ * Các đoạn phát nối nhau theo thứ tự trong URL, timestamp RTP liên tục; frame đầu mỗi
+ * đoạn mang cờ discontinuity trong ONVIF replay extension cùng wallclock của nó.
+ * Đoạn kế tiếp được dựng, nạp trước và seek tới keyframe trong khi đoạn hiện tại phát. */
+#define CLIP_PLAYBACK_PARAM        "ranges"
+#define CLIP_PLAYBACK_MAX_RANGES   256
+/* Số file dựng sẵn phía trước file đang phát */
+#define CLIP_PLAYBACK_PREFETCH     1
+#define CLIP_PLAYBACK_THREADS      2
+
+/* Một đoạn [start_us, end_us) wallclock UTC */
+typedef struct {
+    gint64 start_us;
+    gint64 end_us;
+} ClipRange;
+
+/* "<start>-<end>,..." -> GArray of ClipRange, NULL nếu sai cú pháp hoặc rỗng */
+GArray* clip_playback_parse_ranges(const gchar *value);
+
+/* Pipeline phát các đoạn (pay0 là rtph264pay), NULL nếu không đoạn nào có recording */
+GstElement* clip_playback_create(const gchar *camera_name, StreamType stream_type, GArray *ranges);
+
+/* Element do clip_playback_create tạo? */
+gboolean clip_playback_is_clip(GstElement *element);
+
+#endif // CLIP_PLAYBACK_H
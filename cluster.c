@@ -0,0 +1,578 @@
+#include "cluster.h"
+#include "http_control.h"
+#include "recording_lookup.h"
+#include "segment_index.h"
+#include <json-glib/json-glib.h>
+#include <glib/gstdio.h>
+#include <string.h>
+
+#define CLUSTER_NODES_DIR     "nodes"
+#define CLUSTER_NODE_SUFFIX   ".node"
+#define CLUSTER_REDIRECT_KEY  "cluster-redirect"
+
+/* Node còn sống theo heartbeat gần nhất */
+typedef struct {
+    gchar *node_id;
+    gchar *host;
+    guint port;
+    gint64 seen_us;     /* wallclock trong heartbeat */
+} ClusterNode;
+
+/* Camera đổi chủ sau một lần tính lại (gọi callback ngoài lock) */
+typedef struct {
+    gchar *camera_name;
+    gboolean owned;
+} OwnershipChange;
+
+static gboolean enabled = FALSE;
+static gchar *nodes_dir = NULL;
+static gchar *heartbeat_path = NULL;
+static gchar *self_id = NULL;
+static gchar *self_host = NULL;
+static guint self_port = 0;
+
+static GMutex cluster_lock;
+static GPtrArray *cameras = NULL;       /* gchar* */
+static GPtrArray *nodes = NULL;         /* ClusterNode*, node đang sống (gồm node này) */
+static GHashTable *owners = NULL;       /* camera -> node_id */
+static ClusterOwnershipFunc ownership_func = NULL;
+static gpointer ownership_data = NULL;
+
+static GThread *cluster_thread = NULL;
+static GMutex thread_lock;
+static GCond thread_cond;
+static gboolean thread_running = FALSE;
+static gboolean handed_off = FALSE;
+
+/* Một worker duy nhất áp dụng đổi chủ theo đúng thứ tự: dừng recording có thể mất
+ * vài giây mỗi stream, không được chặn heartbeat trên cluster thread */
+static GThreadPool *ownership_pool = NULL;
+
+/* Forward declarations */
+static void cluster_http_handler(SoupServer *server, SoupServerMessage *msg, const char *path,
+                                 GHashTable *query, gpointer user_data);
+
+static void cluster_node_free(gpointer data) {
+    ClusterNode *node = data;
+    g_free(node->node_id);
+    g_free(node->host);
+    g_free(node);
+}
+
+static void ownership_change_free(gpointer data) {
+    OwnershipChange *change = data;
+    g_free(change->camera_name);
+    g_free(change);
+}
+
+/* node_id dùng làm tên file heartbeat */
+static gboolean valid_node_id(const gchar *node_id) {
+    if (!node_id || !node_id[0] || node_id[0] == '.') return FALSE;
+    for (const gchar *p = node_id; *p; p++) {
+        if (!g_ascii_isalnum(*p) && *p != '-' && *p != '_' && *p != '.' && *p != ':') return FALSE;
+    }
+    return TRUE;
+}
+
+gboolean cluster_init(const gchar *cluster_dir,
+                      const gchar *node_id,
+                      const gchar *advertise_host,
+                      guint rtsp_port) {
+    if (!valid_node_id(node_id)) {
+        g_printerr("[cluster] Invalid node id '%s'\n", node_id ? node_id : "");
+        return FALSE;
+    }
+
+    nodes_dir = g_build_filename(cluster_dir, CLUSTER_NODES_DIR, NULL);
+    if (g_mkdir_with_parents(nodes_dir, 0755) != 0) {
+        g_printerr("[cluster] Cannot create %s\n", nodes_dir);
+        g_clear_pointer(&nodes_dir, g_free);
+        return FALSE;
+    }
+
+    gchar *file_name = g_strconcat(node_id, CLUSTER_NODE_SUFFIX, NULL);
+    heartbeat_path = g_build_filename(nodes_dir, file_name, NULL);
+    g_free(file_name);
+
+    self_id = g_strdup(node_id);
+    self_host = g_strdup(advertise_host);
+    self_port = rtsp_port;
+
+    cameras = g_ptr_array_new_with_free_func(g_free);
+    nodes = g_ptr_array_new_with_free_func(cluster_node_free);
+    owners = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    enabled = TRUE;
+
+    g_print("[cluster] Node %s (rtsp://%s:%u), shared dir %s\n",
+            self_id, self_host, self_port, cluster_dir);
+    return TRUE;
+}
+
+gboolean cluster_enabled(void) {
+    return enabled;
+}
+
+const gchar* cluster_node_id(void) {
+    return self_id;
+}
+
+void cluster_add_camera(const gchar *camera_name) {
+    if (!enabled) return;
+    g_mutex_lock(&cluster_lock);
+    g_ptr_array_add(cameras, g_strdup(camera_name));
+    g_mutex_unlock(&cluster_lock);
+}
+
+void cluster_set_ownership_func(ClusterOwnershipFunc func, gpointer user_data) {
+    ownership_func = func;
+    ownership_data = user_data;
+}
+
+/* ===== Membership ===== */
+
+static void write_heartbeat(void) {
+    gchar *contents = g_strdup_printf("%s %u %" G_GINT64_FORMAT "\n",
+                                      self_host, self_port, g_get_real_time());
+    GError *error = NULL;
+
+    /* set_contents ghi file tạm rồi rename: node khác không đọc được heartbeat dở dang */
+    if (!g_file_set_contents(heartbeat_path, contents, -1, &error)) {
+        g_printerr("[cluster] Heartbeat failed: %s\n", error->message);
+        g_error_free(error);
+    }
+    g_free(contents);
+}
+
+static gint compare_node_id(gconstpointer a, gconstpointer b) {
+    const ClusterNode *na = *(ClusterNode * const *)a;
+    const ClusterNode *nb = *(ClusterNode * const *)b;
+    return g_strcmp0(na->node_id, nb->node_id);
+}
+
+/* Node có heartbeat chưa quá hạn, sắp xếp theo node_id. Node này luôn có mặt
+ * (kể cả khi ghi heartbeat lỗi) để không tự nhả hết camera. */
+static GPtrArray* read_live_nodes(void) {
+    GPtrArray *live = g_ptr_array_new_with_free_func(cluster_node_free);
+    gint64 now_us = g_get_real_time();
+    GDir *dir = g_dir_open(nodes_dir, 0, NULL);
+
+    ClusterNode *self = g_new0(ClusterNode, 1);
+    self->node_id = g_strdup(self_id);
+    self->host = g_strdup(self_host);
+    self->port = self_port;
+    self->seen_us = now_us;
+    g_ptr_array_add(live, self);
+
+    const gchar *name;
+    while (dir && (name = g_dir_read_name(dir)) != NULL) {
+        if (!g_str_has_suffix(name, CLUSTER_NODE_SUFFIX)) continue;
+
+        gchar *node_id = g_strndup(name, strlen(name) - strlen(CLUSTER_NODE_SUFFIX));
+        gchar *path = g_build_filename(nodes_dir, name, NULL);
+        gchar *contents = NULL;
+        gchar host[256];
+        guint port = 0;
+        gint64 seen_us = 0;
+
+        if (g_strcmp0(node_id, self_id) != 0 &&
+            g_file_get_contents(path, &contents, NULL, NULL) &&
+            sscanf(contents, "%255s %u %" G_GINT64_FORMAT, host, &port, &seen_us) == 3 &&
+            now_us - seen_us <= CLUSTER_NODE_TIMEOUT_SEC * G_USEC_PER_SEC &&
+            live->len < CLUSTER_MAX_NODES) {
+            ClusterNode *node = g_new0(ClusterNode, 1);
+            node->node_id = node_id;
+            node->host = g_strdup(host);
+            node->port = port;
+            node->seen_us = seen_us;
+            g_ptr_array_add(live, node);
+            node_id = NULL;
+        }
+
+        g_free(contents);
+        g_free(path);
+        g_free(node_id);
+    }
+    if (dir) g_dir_close(dir);
+
+    g_ptr_array_sort(live, compare_node_id);
+    return live;
+}
+
+/* ===== Bảng sở hữu =====
+ * Rendezvous hashing: camera thuộc node có điểm hash(node, camera) cao nhất. Mọi node tính
+ * cùng một bảng từ cùng tập node sống, không cần đồng thuận; khi một node rời đi chỉ camera
+ * của node đó đổi chủ, chia đều cho các node còn lại. */
+
+static guint64 rendezvous_score(const gchar *node_id, const gchar *camera_name) {
+    guint64 h = 14695981039346656037ULL;   /* FNV-1a */
+    for (const gchar *p = node_id; *p; p++) {
+        h = (h ^ (guchar)*p) * 1099511628211ULL;
+    }
+    h = (h ^ '/') * 1099511628211ULL;
+    for (const gchar *p = camera_name; *p; p++) {
+        h = (h ^ (guchar)*p) * 1099511628211ULL;
+    }
+
+    /* Trộn thêm (finalizer của MurmurHash3) để điểm phân bố đều */
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+static const gchar* pick_owner(GPtrArray *live, const gchar *camera_name) {
+    const gchar *best = NULL;
+    guint64 best_score = 0;
+
+    for (guint i = 0; i < live->len; i++) {
+        ClusterNode *node = g_ptr_array_index(live, i);
+        guint64 score = rendezvous_score(node->node_id, camera_name);
+        if (!best || score > best_score) {
+            best = node->node_id;
+            best_score = score;
+        }
+    }
+    return best;
+}
+
+static gboolean node_listed(GPtrArray *list, const gchar *node_id) {
+    for (guint i = 0; i < list->len; i++) {
+        ClusterNode *node = g_ptr_array_index(list, i);
+        if (g_strcmp0(node->node_id, node_id) == 0) return TRUE;
+    }
+    return FALSE;
+}
+
+static void log_membership(GPtrArray *old_nodes, GPtrArray *new_nodes) {
+    for (guint i = 0; i < new_nodes->len; i++) {
+        ClusterNode *node = g_ptr_array_index(new_nodes, i);
+        if (!node_listed(old_nodes, node->node_id)) {
+            g_print("[cluster] Node %s joined (%s:%u)\n", node->node_id, node->host, node->port);
+        }
+    }
+    for (guint i = 0; i < old_nodes->len; i++) {
+        ClusterNode *node = g_ptr_array_index(old_nodes, i);
+        if (!node_listed(new_nodes, node->node_id)) {
+            g_print("[cluster] Node %s left\n", node->node_id);
+        }
+    }
+}
+
+/* Đọc heartbeat, tính lại bảng và báo camera đổi chủ của node này */
+static void cluster_rebalance(void) {
+    GPtrArray *live = read_live_nodes();
+    GPtrArray *changes = g_ptr_array_new_with_free_func(ownership_change_free);
+
+    g_mutex_lock(&cluster_lock);
+    log_membership(nodes, live);
+
+    for (guint i = 0; i < cameras->len; i++) {
+        const gchar *camera_name = g_ptr_array_index(cameras, i);
+        const gchar *owner = pick_owner(live, camera_name);
+        const gchar *previous = g_hash_table_lookup(owners, camera_name);
+        gboolean was_owned = g_strcmp0(previous, self_id) == 0;
+        gboolean owned = g_strcmp0(owner, self_id) == 0;
+
+        if (g_strcmp0(previous, owner) != 0) {
+            g_print("[cluster] %s -> %s\n", camera_name, owner);
+            g_hash_table_replace(owners, g_strdup(camera_name), g_strdup(owner));
+        }
+        if (owned != was_owned) {
+            OwnershipChange *change = g_new0(OwnershipChange, 1);
+            change->camera_name = g_strdup(camera_name);
+            change->owned = owned;
+            g_ptr_array_add(changes, change);
+        }
+    }
+
+    g_ptr_array_unref(nodes);
+    nodes = live;
+    g_mutex_unlock(&cluster_lock);
+
+    if (changes->len > 0 && ownership_func && ownership_pool) {
+        g_thread_pool_push(ownership_pool, changes, NULL);
+    } else {
+        g_ptr_array_unref(changes);
+    }
+}
+
+/* Worker: áp dụng một lượt đổi chủ (chạy ngoài cluster thread) */
+static void ownership_worker(gpointer data, gpointer user_data) {
+    GPtrArray *changes = data;
+
+    /* Nhả camera trước rồi mới nhận: không giữ hai pipeline recording lâu hơn cần thiết */
+    for (gint pass = 0; pass < 2; pass++) {
+        for (guint i = 0; i < changes->len; i++) {
+            OwnershipChange *change = g_ptr_array_index(changes, i);
+            if (change->owned == (pass == 1)) {
+                ownership_func(change->camera_name, change->owned, ownership_data);
+            }
+        }
+    }
+    g_ptr_array_unref(changes);
+}
+
+gboolean cluster_owns(const gchar *camera_name) {
+    if (!enabled) return TRUE;
+
+    g_mutex_lock(&cluster_lock);
+    const gchar *owner = g_hash_table_lookup(owners, camera_name);
+    /* Camera không nằm trong bảng (không chia cho cluster): phục vụ tại chỗ */
+    gboolean owned = !owner || g_strcmp0(owner, self_id) == 0;
+    g_mutex_unlock(&cluster_lock);
+    return owned;
+}
+
+gchar* cluster_owner_base_url(const gchar *camera_name) {
+    gchar *url = NULL;
+
+    if (!enabled) return NULL;
+
+    g_mutex_lock(&cluster_lock);
+    const gchar *owner = g_hash_table_lookup(owners, camera_name);
+    for (guint i = 0; owner && i < nodes->len; i++) {
+        ClusterNode *node = g_ptr_array_index(nodes, i);
+        if (g_strcmp0(node->node_id, owner) == 0 && g_strcmp0(owner, self_id) != 0) {
+            url = g_strdup_printf("rtsp://%s:%u", node->host, node->port);
+            break;
+        }
+    }
+    g_mutex_unlock(&cluster_lock);
+    return url;
+}
+
+/* ===== RTSP redirect ===== */
+
+/* Playback có segment tại thời điểm yêu cầu trong index của node này (ghi trước khi camera
+ * đổi chủ): phục vụ tại chỗ thay vì redirect sang node không có file */
+static gboolean playback_available_locally(const gchar *camera_name, const gchar *query) {
+    gchar *timestamp_str = parse_query_param(query, "timestamp");
+    if (!timestamp_str) return FALSE;
+
+    gchar *stream_id = parse_query_param(query, "stream");
+    StreamType stream_type = g_strcmp0(stream_id, "1") == 0 ? STREAM_SUB : STREAM_MAIN;
+    gint64 start_us = parse_timestamp_us(timestamp_str);
+    gboolean found = FALSE;
+
+    GPtrArray *records = segment_index_query(camera_name, stream_type, start_us, start_us + 1);
+    for (guint i = 0; i < records->len && !found; i++) {
+        SegmentRecord *record = g_ptr_array_index(records, i);
+        found = record->start_us <= start_us && start_us < record->end_us;
+    }
+
+    g_ptr_array_unref(records);
+    g_free(stream_id);
+    g_free(timestamp_str);
+    return found;
+}
+
+/* "/cam_1/stream=0" -> "cam_1" */
+static gchar* camera_from_path(const gchar *abspath) {
+    if (!abspath) return NULL;
+    while (*abspath == '/') abspath++;
+    if (!*abspath) return NULL;
+
+    const gchar *end = strchr(abspath, '/');
+    return end ? g_strndup(abspath, end - abspath) : g_strdup(abspath);
+}
+
+static GstRTSPStatusCode check_owner(GstRTSPClient *client, GstRTSPContext *ctx) {
+    if (!ctx->uri) return GST_RTSP_STS_OK;
+
+    gchar *camera_name = camera_from_path(ctx->uri->abspath);
+    GstRTSPStatusCode status = GST_RTSP_STS_OK;
+
+    if (camera_name && !cluster_owns(camera_name) &&
+        !playback_available_locally(camera_name, ctx->uri->query)) {
+        gchar *base = cluster_owner_base_url(camera_name);
+        if (base) {
+            gchar *location = ctx->uri->query
+                ? g_strdup_printf("%s%s?%s", base, ctx->uri->abspath, ctx->uri->query)
+                : g_strdup_printf("%s%s", base, ctx->uri->abspath);
+
+            g_print("[cluster] Redirect %s -> %s\n", camera_name, location);
+            g_object_set_data_full(G_OBJECT(client), CLUSTER_REDIRECT_KEY, location, g_free);
+            status = GST_RTSP_STS_MOVE_TEMPORARILY;
+            g_free(base);
+        }
+    }
+
+    g_free(camera_name);
+    return status;
+}
+
+static GstRTSPStatusCode on_pre_request(GstRTSPClient *client, GstRTSPContext *ctx, gpointer user_data) {
+    return check_owner(client, ctx);
+}
+
+/* Response 302 do server tạo từ status code ở trên: thêm header Location */
+static void on_send_message(GstRTSPClient *client, GstRTSPContext *ctx,
+                            gpointer message, gpointer user_data) {
+    GstRTSPMessage *msg = message;
+    GstRTSPStatusCode code;
+
+    if (gst_rtsp_message_get_type(msg) != GST_RTSP_MESSAGE_RESPONSE) return;
+    if (gst_rtsp_message_parse_response(msg, &code, NULL, NULL) != GST_RTSP_OK ||
+        code != GST_RTSP_STS_MOVE_TEMPORARILY) return;
+
+    gchar *location = g_object_steal_data(G_OBJECT(client), CLUSTER_REDIRECT_KEY);
+    if (location) {
+        gst_rtsp_message_add_header(msg, GST_RTSP_HDR_LOCATION, location);
+        g_free(location);
+    }
+}
+
+static void on_client_connected(GstRTSPServer *server, GstRTSPClient *client, gpointer user_data) {
+    /* Media được tạo trong DESCRIBE, hoặc SETUP nếu client bỏ qua DESCRIBE */
+    g_signal_connect(client, "pre-describe-request", G_CALLBACK(on_pre_request), NULL);
+    g_signal_connect(client, "pre-setup-request", G_CALLBACK(on_pre_request), NULL);
+    g_signal_connect(client, "send-message", G_CALLBACK(on_send_message), NULL);
+}
+
+void cluster_attach(GstRTSPServer *server) {
+    if (!enabled) return;
+    g_signal_connect(server, "client-connected", G_CALLBACK(on_client_connected), NULL);
+}
+
+/* ===== Thread ===== */
+
+static gboolean cluster_should_run(void) {
+    g_mutex_lock(&thread_lock);
+    gboolean running = thread_running;
+    g_mutex_unlock(&thread_lock);
+    return running;
+}
+
+static gpointer cluster_thread_func(gpointer data) {
+    while (cluster_should_run()) {
+        write_heartbeat();
+        cluster_rebalance();
+
+        g_mutex_lock(&thread_lock);
+        if (thread_running) {
+            gint64 deadline = g_get_monotonic_time() + CLUSTER_HEARTBEAT_SEC * G_USEC_PER_SEC;
+            g_cond_wait_until(&thread_cond, &thread_lock, deadline);
+        }
+        g_mutex_unlock(&thread_lock);
+    }
+    return NULL;
+}
+
+void cluster_start(void) {
+    if (!enabled) return;
+
+    g_mutex_lock(&thread_lock);
+    if (thread_running) {
+        g_mutex_unlock(&thread_lock);
+        return;
+    }
+    thread_running = TRUE;
+    g_mutex_unlock(&thread_lock);
+
+    ownership_pool = g_thread_pool_new(ownership_worker, NULL, 1, FALSE, NULL);
+
+    /* Lượt đầu chạy đồng bộ: bảng sở hữu có sẵn trước khi server nhận client
+     * (recording của camera được nhận khởi động trên worker) */
+    write_heartbeat();
+    cluster_rebalance();
+
+    cluster_thread = g_thread_new("cluster", cluster_thread_func, NULL);
+    http_control_add_handler("/cluster", cluster_http_handler, NULL);
+}
+
+static void stop_thread(void) {
+    g_mutex_lock(&thread_lock);
+    thread_running = FALSE;
+    g_cond_signal(&thread_cond);
+    g_mutex_unlock(&thread_lock);
+
+    if (cluster_thread) {
+        g_thread_join(cluster_thread);
+        cluster_thread = NULL;
+    }
+
+    /* Bỏ lượt đổi chủ còn xếp hàng, chờ lượt đang chạy xong */
+    if (ownership_pool) {
+        g_thread_pool_free(ownership_pool, TRUE, TRUE);
+        ownership_pool = NULL;
+    }
+}
+
+void cluster_hand_off(void) {
+    if (!enabled) return;
+
+    stop_thread();
+    handed_off = TRUE;
+    g_print("[cluster] Node %s handing off to successor process\n", self_id);
+}
+
+void cluster_stop(void) {
+    if (!enabled) return;
+
+    stop_thread();
+    if (handed_off) return;
+
+    /* Rời cluster: node khác thấy ở lượt heartbeat kế tiếp, không phải chờ timeout */
+    g_unlink(heartbeat_path);
+    g_print("[cluster] Node %s left the cluster\n", self_id);
+}
+
+/* Bảng node + sở hữu hiện tại (JSON) */
+static gchar* cluster_status_json(void) {
+    JsonBuilder *builder = json_builder_new();
+
+    json_builder_begin_object(builder);
+    json_builder_set_member_name(builder, "node");
+    json_builder_add_string_value(builder, self_id ? self_id : "");
+
+    g_mutex_lock(&cluster_lock);
+    json_builder_set_member_name(builder, "nodes");
+    json_builder_begin_array(builder);
+    for (guint i = 0; nodes && i < nodes->len; i++) {
+        ClusterNode *node = g_ptr_array_index(nodes, i);
+        json_builder_begin_object(builder);
+        json_builder_set_member_name(builder, "id");
+        json_builder_add_string_value(builder, node->node_id);
+        json_builder_set_member_name(builder, "host");
+        json_builder_add_string_value(builder, node->host);
+        json_builder_set_member_name(builder, "port");
+        json_builder_add_int_value(builder, node->port);
+        json_builder_set_member_name(builder, "heartbeat_age_ms");
+        json_builder_add_int_value(builder, (g_get_real_time() - node->seen_us) / 1000);
+        json_builder_end_object(builder);
+    }
+    json_builder_end_array(builder);
+
+    json_builder_set_member_name(builder, "owners");
+    json_builder_begin_object(builder);
+    for (guint i = 0; cameras && i < cameras->len; i++) {
+        const gchar *camera_name = g_ptr_array_index(cameras, i);
+        const gchar *owner = g_hash_table_lookup(owners, camera_name);
+        json_builder_set_member_name(builder, camera_name);
+        json_builder_add_string_value(builder, owner ? owner : "");
+    }
+    json_builder_end_object(builder);
+    g_mutex_unlock(&cluster_lock);
+
+    json_builder_end_object(builder);
+
+    JsonGenerator *generator = json_generator_new();
+    JsonNode *root = json_builder_get_root(builder);
+    json_generator_set_root(generator, root);
+    gchar *json = json_generator_to_data(generator, NULL);
+
+    json_node_unref(root);
+    g_object_unref(generator);
+    g_object_unref(builder);
+    return json;
+}
+
+/* GET /cluster */
+static void cluster_http_handler(SoupServer *server, SoupServerMessage *msg, const char *path,
+                                 GHashTable *query, gpointer user_data) {
+    gchar *json = cluster_status_json();
+    http_control_respond(msg, SOUP_STATUS_OK, "application/json", json);
+    g_free(json);
+}
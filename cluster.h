@@ -0,0 +1,50 @@
+#ifndef CLUSTER_H
+#define CLUSTER_H
+
+#include <glib.h>
+#include <gst/rtsp-server/rtsp-server.h>
+
+/* Heartbeat của node ghi vào <cluster_dir>/nodes/<node_id>.node */
+#define CLUSTER_HEARTBEAT_SEC     2
+#define CLUSTER_NODE_TIMEOUT_SEC  6
+#define CLUSTER_MAX_NODES         64
+
+/* Gọi (từ thread cluster) khi node này nhận hoặc mất quyền sở hữu camera */
+typedef void (*ClusterOwnershipFunc)(const gchar *camera_name,
+                                     gboolean owned,
+                                     gpointer user_data);
+
+/* Bật cluster mode: các node cùng cluster_dir (thư mục chia sẻ: NFS, hoặc local khi test)
+ * thấy nhau qua heartbeat; advertise_host:rtsp_port là địa chỉ client dùng khi bị redirect */
+gboolean cluster_init(const gchar *cluster_dir,
+                      const gchar *node_id,
+                      const gchar *advertise_host,
+                      guint rtsp_port);
+
+gboolean cluster_enabled(void);
+const gchar* cluster_node_id(void);
+
+/* Camera tham gia phân chia (mọi node phải có cùng danh sách) */
+void cluster_add_camera(const gchar *camera_name);
+
+void cluster_set_ownership_func(ClusterOwnershipFunc func, gpointer user_data);
+
+/* Node này sở hữu camera? Luôn TRUE khi không bật cluster mode */
+gboolean cluster_owns(const gchar *camera_name);
+
+/* rtsp://host:port của node sở hữu camera, NULL nếu là node này hoặc không rõ */
+gchar* cluster_owner_base_url(const gchar *camera_name);
+
+/* DESCRIBE/SETUP cho camera của node khác: trả 302 với Location tới node sở hữu */
+void cluster_attach(GstRTSPServer *server);
+
+/* Thread heartbeat + tính lại bảng sở hữu, GET /cluster trên http_control;
+ * stop xóa heartbeat để node khác nhận camera ngay */
+void cluster_start(void);
+void cluster_stop(void);
+
+/* Restart không downtime: dừng thread nhưng giữ heartbeat - process kế nhiệm chạy cùng
+ * node id nên node khác không thấy camera đổi chủ. cluster_stop sau đó không xóa heartbeat */
+void cluster_hand_off(void);
+
+#endif // CLUSTER_H
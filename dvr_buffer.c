@@ -0,0 +1,583 @@
+#include "dvr_buffer.h"
+#include <gst/app/gstappsrc.h>
+
+/* Một access unit trong ring: buffer của recording giữ nguyên (chỉ thêm ref) */
+typedef struct {
+    GstBuffer *buffer;
+    GstCaps *caps;
+    gint64 ts;              /* timeline chung của module (ns, theo DTS), tăng dần */
+    gint64 pts_delta;       /* pts - dts (B-frame) */
+    gboolean keyframe;
+} DvrFrame;
+
+/* Ring của một camera/stream; frame đầu ring luôn là keyframe (bỏ theo cả GOP) */
+typedef struct {
+    gchar *key;             /* "<camera>/<main|sub>" */
+    guint window_sec;
+    guint64 max_bytes;
+    DvrFrame *slots;        /* slot = seq % capacity */
+    guint capacity;
+    guint64 head;           /* seq frame cũ nhất */
+    guint64 tail;           /* seq frame kế tiếp */
+    guint64 bytes;
+    gint64 last_ts;
+    GstCaps *caps;          /* caps hiện tại của parser recording */
+    GList *readers;         /* DvrReader* */
+    guint taps;             /* recording pipeline đang đưa AU vào ring */
+    guint close_source;     /* hẹn đóng ring khi không còn tap */
+    gboolean closed;
+} DvrRing;
+
+/* Một lần dựng recording pipeline: PTS bắt đầu lại nên neo vào timeline của ring */
+typedef struct {
+    DvrRing *ring;
+    gint64 first_dts;
+    gint64 ts0;
+} DvrTap;
+
+/* Một session: npt = ts - origin + shift */
+typedef struct {
+    DvrRing *ring;
+    GWeakRef appsrc;
+    guint64 next_seq;
+    gint64 origin;
+    gint64 shift;
+    GstCaps *caps;          /* caps đã đặt cho appsrc */
+    gint wants;             /* atomic: need-data/enough-data của appsrc */
+    gboolean started;
+    gboolean seek_pending;  /* PLAY Range chưa áp dụng: chờ need-data sau flush của appsrc */
+    guint64 seek_offset;
+} DvrReader;
+
+typedef struct {
+    guint window_sec;
+    guint64 max_bytes;
+} DvrLimit;
+
+static GMutex dvr_lock;
+static GHashTable *rings = NULL;       /* key -> DvrRing* (ref) */
+static GHashTable *limits = NULL;      /* camera -> DvrLimit* */
+static guint64 dvr_budget = 0;
+static guint64 dvr_total = 0;
+static gint64 dvr_epoch_us = 0;
+
+static void frame_clear(DvrFrame *frame) {
+    gst_buffer_unref(frame->buffer);
+    gst_caps_unref(frame->caps);
+    frame->buffer = NULL;
+    frame->caps = NULL;
+}
+
+static DvrFrame* ring_frame(DvrRing *ring, guint64 seq) {
+    return &ring->slots[seq % ring->capacity];
+}
+
+/* Bỏ hết frame (gọi với dvr_lock) */
+static void ring_drain(DvrRing *ring) {
+    for (guint64 seq = ring->head; seq < ring->tail; seq++) {
+        frame_clear(ring_frame(ring, seq));
+    }
+    dvr_total -= ring->bytes;
+    ring->bytes = 0;
+    ring->head = ring->tail;
+}
+
+static void ring_clear(DvrRing *ring) {
+    g_free(ring->slots);
+    if (ring->caps) gst_caps_unref(ring->caps);
+    g_free(ring->key);
+}
+
+static void ring_unref(gpointer data) {
+    g_atomic_rc_box_release_full(data, (GDestroyNotify)ring_clear);
+}
+
+/* Bảng ring và giới hạn theo camera (gọi với dvr_lock) */
+static void ensure_tables(void) {
+    if (!rings) {
+        rings = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, ring_unref);
+        limits = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    }
+}
+
+static void ring_grow(DvrRing *ring) {
+    guint capacity = ring->capacity ? ring->capacity * 2 : 1024;
+    DvrFrame *slots = g_new0(DvrFrame, capacity);
+
+    for (guint64 seq = ring->head; seq < ring->tail; seq++) {
+        slots[seq % capacity] = *ring_frame(ring, seq);
+    }
+    g_free(ring->slots);
+    ring->slots = slots;
+    ring->capacity = capacity;
+}
+
+/* Keyframe kế tiếp sau head (tail nếu ring chỉ còn một GOP) */
+static guint64 ring_next_gop(DvrRing *ring) {
+    for (guint64 seq = ring->head + 1; seq < ring->tail; seq++) {
+        if (ring_frame(ring, seq)->keyframe) return seq;
+    }
+    return ring->tail;
+}
+
+/* Bỏ GOP cũ nhất; không bỏ GOP đang ghi dở (FALSE) */
+static gboolean ring_evict_gop(DvrRing *ring) {
+    guint64 next = ring_next_gop(ring);
+    if (next >= ring->tail) return FALSE;
+
+    for (guint64 seq = ring->head; seq < next; seq++) {
+        DvrFrame *frame = ring_frame(ring, seq);
+        gsize size = gst_buffer_get_size(frame->buffer);
+        ring->bytes -= size;
+        dvr_total -= size;
+        frame_clear(frame);
+    }
+    ring->head = next;
+    return TRUE;
+}
+
+/* Budget chung vượt: bỏ GOP cũ nhất trong mọi ring (timeline chung nên so được) */
+static void enforce_budget(void) {
+    while (dvr_total > dvr_budget) {
+        DvrRing *oldest = NULL;
+        GHashTableIter iter;
+        gpointer value;
+
+        g_hash_table_iter_init(&iter, rings);
+        while (g_hash_table_iter_next(&iter, NULL, &value)) {
+            DvrRing *ring = value;
+            if (ring_next_gop(ring) >= ring->tail) continue;
+            if (!oldest || ring_frame(ring, ring->head)->ts < ring_frame(oldest, oldest->head)->ts) {
+                oldest = ring;
+            }
+        }
+        if (!oldest) break;
+        ring_evict_gop(oldest);
+    }
+}
+
+/* Keyframe cuối có ts <= target (head nếu target trước ring) */
+static guint64 ring_seek(DvrRing *ring, gint64 target) {
+    if (ring->head >= ring->tail) return ring->tail;
+
+    guint64 lo = ring->head;
+    guint64 hi = ring->tail;
+    while (hi - lo > 1) {
+        guint64 mid = lo + (hi - lo) / 2;
+        if (ring_frame(ring, mid)->ts <= target) lo = mid;
+        else hi = mid;
+    }
+    while (lo > ring->head && !ring_frame(ring, lo)->keyframe) lo--;
+    return lo;
+}
+
+/* ===== Session ===== */
+
+/* Đẩy frame cho session tới khi appsrc đủ hoặc hết ring (gọi với dvr_lock).
+ * enough-data phát ra ngay trong push nên cờ wants là atomic, không cần lock. */
+static void reader_fill(DvrReader *reader) {
+    DvrRing *ring = reader->ring;
+    if (!g_atomic_int_get(&reader->wants)) return;
+
+    /* appsrc flush hàng đợi sau seek-data: frame đẩy trước need-data kế tiếp bị bỏ */
+    if (reader->seek_pending) return;
+
+    GstAppSrc *appsrc = g_weak_ref_get(&reader->appsrc);
+    if (!appsrc) return;
+
+    /* Session chậm hơn cửa sổ: nhảy tới GOP cũ nhất còn giữ */
+    if (reader->next_seq < ring->head) {
+        g_print("[dvr] %s: session fell behind the window, skipping ahead\n", ring->key);
+        reader->next_seq = ring->head;
+    }
+
+    while (g_atomic_int_get(&reader->wants) && reader->next_seq < ring->tail) {
+        DvrFrame *frame = ring_frame(ring, reader->next_seq++);
+
+        if (frame->caps != reader->caps) {
+            gst_caps_replace(&reader->caps, frame->caps);
+            gst_app_src_set_caps(appsrc, frame->caps);
+        }
+
+        /* Chỉ copy metadata, memory dùng chung với ring */
+        GstBuffer *out = gst_buffer_copy(frame->buffer);
+        gint64 npt = frame->ts - reader->origin + reader->shift;
+        GST_BUFFER_DTS(out) = npt;
+        GST_BUFFER_PTS(out) = npt + frame->pts_delta;
+
+        if (!reader->started) {
+            /* Segment đầu bắt đầu tại vị trí này: sink không chờ từ npt 0 */
+            GstSegment segment;
+            gst_segment_init(&segment, GST_FORMAT_TIME);
+            segment.start = npt;
+            segment.time = npt;
+            segment.position = npt;
+            GstSample *sample = gst_sample_new(out, frame->caps, &segment, NULL);
+            gst_app_src_push_sample(appsrc, sample);
+            gst_sample_unref(sample);
+            gst_buffer_unref(out);
+            reader->started = TRUE;
+        } else {
+            gst_app_src_push_buffer(appsrc, out);
+        }
+    }
+
+    gst_object_unref(appsrc);
+}
+
+/* PLAY Range: npt=X -> keyframe gần nhất trước X; quá live edge thì keyframe mới nhất
+ * (gọi với dvr_lock) */
+static void reader_apply_seek(DvrReader *reader) {
+    DvrRing *ring = reader->ring;
+    gint64 offset = (gint64)reader->seek_offset;
+    gint64 target = reader->origin + offset;
+    guint64 seq = ring_seek(ring, target);
+
+    reader->seek_pending = FALSE;
+    reader->next_seq = seq;
+    if (seq < ring->tail) {
+        /* Keyframe mang đúng vị trí seek để không bị sink cắt bỏ (lệch tối đa một GOP) */
+        reader->shift = offset - (ring_frame(ring, seq)->ts - reader->origin);
+    }
+    g_print("[dvr] %s: seek to npt %.3f%s\n", ring->key, (gdouble)offset / GST_SECOND,
+            seq < ring->tail && target >= ring->last_ts ? " (live)" : "");
+}
+
+static void on_need_data(GstAppSrc *appsrc, guint length, gpointer user_data) {
+    DvrReader *reader = user_data;
+    g_atomic_int_set(&reader->wants, 1);
+
+    g_mutex_lock(&dvr_lock);
+    if (reader->seek_pending) reader_apply_seek(reader);
+    reader_fill(reader);
+    g_mutex_unlock(&dvr_lock);
+}
+
+static void on_enough_data(GstAppSrc *appsrc, gpointer user_data) {
+    g_atomic_int_set(&((DvrReader *)user_data)->wants, 0);
+}
+
+/* Chỉ ghi nhận vị trí: appsrc flush hàng đợi sau khi callback này trả về, frame đẩy ngay
+ * bây giờ (từ tap) sẽ mất. Seek áp dụng ở need-data kế tiếp */
+static gboolean on_seek_data(GstAppSrc *appsrc, guint64 offset, gpointer user_data) {
+    DvrReader *reader = user_data;
+
+    g_mutex_lock(&dvr_lock);
+    reader->seek_pending = TRUE;
+    reader->seek_offset = offset;
+    g_mutex_unlock(&dvr_lock);
+    return TRUE;
+}
+
+static gboolean reader_free_idle(gpointer data) {
+    DvrReader *reader = data;
+
+    g_mutex_lock(&dvr_lock);
+    reader->ring->readers = g_list_remove(reader->ring->readers, reader);
+    g_mutex_unlock(&dvr_lock);
+
+    ring_unref(reader->ring);
+    if (reader->caps) gst_caps_unref(reader->caps);
+    g_weak_ref_clear(&reader->appsrc);
+    g_free(reader);
+    return G_SOURCE_REMOVE;
+}
+
+/* Destroy notify của appsrc: unref cuối có thể xảy ra trong reader_fill/ring_close khi đang
+ * giữ dvr_lock (streaming thread của recording) - gỡ reader ở main loop, không lock tại đây.
+ * Weak ref đã NULL nên reader còn trong danh sách chỉ bị bỏ qua */
+static void reader_free(gpointer data) {
+    g_idle_add(reader_free_idle, data);
+}
+
+/* ===== Recording tap ===== */
+
+static void ring_append(DvrRing *ring, GstBuffer *buffer, gint64 ts, gint64 pts_delta, gboolean keyframe) {
+    /* Ring luôn bắt đầu bằng keyframe */
+    if (ring->head == ring->tail && !keyframe) return;
+    if (!ring->caps) return;
+
+    if (ring->tail - ring->head >= ring->capacity) {
+        ring_grow(ring);
+    }
+
+    DvrFrame *frame = ring_frame(ring, ring->tail++);
+    frame->buffer = gst_buffer_ref(buffer);
+    frame->caps = gst_caps_ref(ring->caps);
+    frame->ts = ts;
+    frame->pts_delta = pts_delta;
+    frame->keyframe = keyframe;
+
+    gsize size = gst_buffer_get_size(buffer);
+    ring->bytes += size;
+    dvr_total += size;
+    ring->last_ts = ts;
+
+    gint64 window = (gint64)ring->window_sec * GST_SECOND;
+    while (ts - ring_frame(ring, ring->head)->ts > window || ring->bytes > ring->max_bytes) {
+        if (!ring_evict_gop(ring)) break;
+    }
+    enforce_budget();
+
+    for (GList *l = ring->readers; l != NULL; l = l->next) {
+        reader_fill(l->data);
+    }
+}
+
+static GstPadProbeReturn tap_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    DvrTap *tap = user_data;
+    DvrRing *ring = tap->ring;
+
+    if (info->type & GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM) {
+        GstEvent *event = GST_PAD_PROBE_INFO_EVENT(info);
+        if (GST_EVENT_TYPE(event) == GST_EVENT_CAPS) {
+            GstCaps *caps = NULL;
+            gst_event_parse_caps(event, &caps);
+            g_mutex_lock(&dvr_lock);
+            gst_caps_replace(&ring->caps, caps);
+            g_mutex_unlock(&dvr_lock);
+        }
+        return GST_PAD_PROBE_OK;
+    }
+
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    GstClockTime dts = GST_BUFFER_DTS_OR_PTS(buffer);
+    if (!GST_CLOCK_TIME_IS_VALID(dts)) return GST_PAD_PROBE_OK;
+
+    gint64 pts_delta = GST_BUFFER_PTS_IS_VALID(buffer) ? (gint64)GST_BUFFER_PTS(buffer) - (gint64)dts : 0;
+    gboolean keyframe = !GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DELTA_UNIT);
+
+    g_mutex_lock(&dvr_lock);
+    if (!ring->closed) {
+        /* Pipeline mới (rotation): neo theo thời điểm nhận, không lùi so với ring */
+        if (tap->first_dts < 0) {
+            tap->first_dts = (gint64)dts;
+            tap->ts0 = MAX((g_get_monotonic_time() - dvr_epoch_us) * GST_USECOND,
+                           ring->last_ts + GST_MSECOND);
+        }
+        gint64 ts = tap->ts0 + ((gint64)dts - tap->first_dts);
+        if (ts <= ring->last_ts) ts = ring->last_ts + 1;
+        ring_append(ring, buffer, ts, pts_delta, keyframe);
+    }
+    g_mutex_unlock(&dvr_lock);
+
+    return GST_PAD_PROBE_OK;
+}
+
+/* Báo EOS cho mọi session và bỏ hết frame (gọi với dvr_lock) */
+static void ring_close(DvrRing *ring) {
+    for (GList *l = ring->readers; l != NULL; l = l->next) {
+        GstAppSrc *appsrc = g_weak_ref_get(&((DvrReader *)l->data)->appsrc);
+        if (appsrc) {
+            gst_app_src_end_of_stream(appsrc);
+            gst_object_unref(appsrc);
+        }
+    }
+    ring->closed = TRUE;
+    ring_drain(ring);
+}
+
+/* Recording không quay lại trong thời gian chờ: đóng ring, lần attach sau tạo ring mới */
+static gboolean ring_close_timeout(gpointer user_data) {
+    DvrRing *ring = user_data;
+
+    g_mutex_lock(&dvr_lock);
+    /* Hẹn này có thể đã bị hủy (tap mới) trong lúc chờ lock */
+    if (ring->close_source == g_source_get_id(g_main_current_source())) {
+        ring->close_source = 0;
+        if (ring->taps == 0 && !ring->closed) {
+            g_print("[dvr] %s: recording stopped, closing buffer\n", ring->key);
+            ring_close(ring);
+            if (rings && g_hash_table_lookup(rings, ring->key) == ring) {
+                g_hash_table_remove(rings, ring->key);
+            }
+        }
+    }
+    g_mutex_unlock(&dvr_lock);
+    return G_SOURCE_REMOVE;
+}
+
+static void tap_free(gpointer data) {
+    DvrTap *tap = data;
+    DvrRing *ring = tap->ring;
+
+    /* Tap cuối đi: rotation sẽ gắn tap mới ngay, chỉ đóng nếu recording đã dừng hẳn */
+    g_mutex_lock(&dvr_lock);
+    if (--ring->taps == 0 && !ring->closed && !ring->close_source) {
+        ring->close_source = g_timeout_add_seconds_full(G_PRIORITY_DEFAULT, DVR_BUFFER_CLOSE_GRACE_SEC,
+                                                        ring_close_timeout,
+                                                        g_atomic_rc_box_acquire(ring), ring_unref);
+    }
+    g_mutex_unlock(&dvr_lock);
+
+    ring_unref(ring);
+    g_free(tap);
+}
+
+/* ===== API ===== */
+
+void dvr_buffer_init(guint64 budget_bytes) {
+    g_mutex_lock(&dvr_lock);
+    dvr_budget = budget_bytes;
+    dvr_epoch_us = g_get_monotonic_time();
+    ensure_tables();
+    g_mutex_unlock(&dvr_lock);
+
+    if (budget_bytes > 0) {
+        g_print("DVR: %u s window per stream, %" G_GUINT64_FORMAT " MB total\n",
+                DVR_BUFFER_DEFAULT_WINDOW_SEC, budget_bytes / (1024 * 1024));
+    }
+}
+
+void dvr_buffer_set_camera_limit(const gchar *camera_name, guint window_sec, guint64 max_bytes) {
+    DvrLimit *limit = g_new0(DvrLimit, 1);
+    limit->window_sec = window_sec;
+    limit->max_bytes = max_bytes;
+
+    g_mutex_lock(&dvr_lock);
+    ensure_tables();
+    g_hash_table_replace(limits, g_strdup(camera_name), limit);
+    g_mutex_unlock(&dvr_lock);
+
+    g_print("Camera %s: DVR %u s, max %" G_GUINT64_FORMAT " MB\n", camera_name, window_sec,
+            max_bytes / (1024 * 1024));
+}
+
+void dvr_buffer_attach(GstElement *parser, const gchar *camera_name, StreamType stream_type) {
+    gchar *key = g_strdup_printf("%s/%s", camera_name, stream_type == STREAM_MAIN ? "main" : "sub");
+    DvrRing *ring = NULL;
+
+    g_mutex_lock(&dvr_lock);
+    if (rings && dvr_budget > 0) {
+        ring = g_hash_table_lookup(rings, key);
+        if (!ring) {
+            DvrLimit *limit = g_hash_table_lookup(limits, camera_name);
+            guint window_sec = limit ? limit->window_sec : DVR_BUFFER_DEFAULT_WINDOW_SEC;
+            if (window_sec > 0) {
+                ring = g_atomic_rc_box_new0(DvrRing);
+                ring->key = g_strdup(key);
+                ring->window_sec = window_sec;
+                ring->max_bytes = limit ? limit->max_bytes : DVR_BUFFER_DEFAULT_CAMERA_MAX;
+                ring_grow(ring);
+                g_hash_table_insert(rings, g_strdup(key), ring);
+            }
+        }
+        if (ring) {
+            g_atomic_rc_box_acquire(ring);
+            ring->taps++;
+            if (ring->close_source) {
+                g_source_remove(ring->close_source);
+                ring->close_source = 0;
+            }
+        }
+    }
+    g_mutex_unlock(&dvr_lock);
+    g_free(key);
+
+    if (!ring) return;
+
+    DvrTap *tap = g_new0(DvrTap, 1);
+    tap->ring = ring;
+    tap->first_dts = -1;
+
+    GstPad *pad = gst_element_get_static_pad(parser, "src");
+    gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+                      tap_probe, tap, tap_free);
+    gst_object_unref(pad);
+}
+
+GstElement* dvr_buffer_create_pipeline(const gchar *camera_name, StreamType stream_type,
+                                       gint64 offset_sec) {
+    gchar *key = g_strdup_printf("%s/%s", camera_name, stream_type == STREAM_MAIN ? "main" : "sub");
+    gboolean h265 = FALSE;
+
+    g_mutex_lock(&dvr_lock);
+    DvrRing *ring = rings ? g_hash_table_lookup(rings, key) : NULL;
+    gboolean ready = ring && !ring->closed && ring->head < ring->tail;
+    if (ready) {
+        const GstStructure *s = gst_caps_get_structure(ring_frame(ring, ring->head)->caps, 0);
+        h265 = gst_structure_has_name(s, "video/x-h265");
+        g_atomic_rc_box_acquire(ring);
+    }
+    g_mutex_unlock(&dvr_lock);
+
+    if (!ready) {
+        g_print("[dvr] %s: no buffered data\n", key);
+        g_free(key);
+        return NULL;
+    }
+
+    /* Không live: sink pace theo timestamp, appsrc seek được theo TIME */
+    gchar *launch = g_strdup_printf(
+        "appsrc name=dvrsrc format=time is-live=false handle-segment-change=true "
+        "max-bytes=0 max-buffers=0 max-time=%" G_GUINT64_FORMAT " ! "
+        "%s ! %s name=pay0 pt=96 config-interval=-1 mtu=1400",
+        (guint64)DVR_BUFFER_SESSION_QUEUE_NS,
+        h265 ? "h265parse" : "h264parse", h265 ? "rtph265pay" : "rtph264pay");
+
+    GError *error = NULL;
+    GstElement *pipeline = gst_parse_launch(launch, &error);
+    g_free(launch);
+    if (error) {
+        g_printerr("Pipeline error: %s\n", error->message);
+        g_error_free(error);
+        if (pipeline) gst_object_unref(pipeline);
+        ring_unref(ring);
+        g_free(key);
+        return NULL;
+    }
+
+    GstElement *appsrc = gst_bin_get_by_name(GST_BIN(pipeline), "dvrsrc");
+    gst_app_src_set_stream_type(GST_APP_SRC(appsrc), GST_APP_STREAM_TYPE_SEEKABLE);
+
+    DvrReader *reader = g_new0(DvrReader, 1);
+    g_weak_ref_init(&reader->appsrc, appsrc);
+
+    g_mutex_lock(&dvr_lock);
+    reader->ring = ring;
+    gint64 target = ring->last_ts + MIN(offset_sec, 0) * GST_SECOND;
+    reader->next_seq = ring_seek(ring, target);
+    reader->origin = ring->head < ring->tail ? ring_frame(ring, ring->head)->ts : ring->last_ts;
+    ring->readers = g_list_prepend(ring->readers, reader);
+    gint64 behind = ring->last_ts - (reader->next_seq < ring->tail ?
+                                     ring_frame(ring, reader->next_seq)->ts : ring->last_ts);
+    g_mutex_unlock(&dvr_lock);
+
+    GstAppSrcCallbacks callbacks = {
+        .need_data = on_need_data,
+        .enough_data = on_enough_data,
+        .seek_data = on_seek_data,
+    };
+    gst_app_src_set_callbacks(GST_APP_SRC(appsrc), &callbacks, reader, reader_free);
+    gst_object_unref(appsrc);
+
+    g_print("[dvr] %s: session starts %.1f s behind live\n", key, (gdouble)behind / GST_SECOND);
+    g_object_set_data(G_OBJECT(pipeline), "dvr-buffer", GINT_TO_POINTER(1));
+    g_free(key);
+    return pipeline;
+}
+
+gboolean dvr_buffer_is_dvr(GstElement *element) {
+    return element && g_object_get_data(G_OBJECT(element), "dvr-buffer") != NULL;
+}
+
+void dvr_buffer_shutdown(void) {
+    g_mutex_lock(&dvr_lock);
+    if (!rings) {
+        g_mutex_unlock(&dvr_lock);
+        return;
+    }
+
+    GHashTableIter iter;
+    gpointer value;
+    g_hash_table_iter_init(&iter, rings);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        ring_close(value);
+    }
+    g_hash_table_destroy(rings);
+    g_hash_table_destroy(limits);
+    rings = NULL;
+    limits = NULL;
+    dvr_budget = 0;
+    g_mutex_unlock(&dvr_lock);
+}
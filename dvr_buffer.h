@@ -0,0 +1,46 @@
+#ifndef DVR_BUFFER_H
+#define DVR_BUFFER_H
+
+#include <gst/gst.h>
+#include "recording_manager.h"
+
+/* Timeshift trên mount live, phục vụ hoàn toàn từ RAM:
+ *   rtsp://host/<camera>?dvr=-30[&stream=1]   bắt đầu sau live 30 giây (?dvr=0: tại live)
+ * Access unit của recording pipeline (đã depay + parse) được giữ nguyên buffer (ref, không
+ * copy) trong ring theo GOP của từng camera/stream. Trong session client seek bằng
+ * PLAY Range: npt=<vị trí>; npt 0 là frame cũ nhất lúc mở session, vị trí vượt quá
+ * live edge thì phát lại từ keyframe mới nhất (về live ngay, không qua disk). */
+#define DVR_BUFFER_PARAM               "dvr"
+#define DVR_BUFFER_DEFAULT_WINDOW_SEC  60
+/* Giới hạn mặc định của một camera/stream và tổng của mọi ring */
+#define DVR_BUFFER_DEFAULT_CAMERA_MAX  (64 * 1024 * 1024)
+#define DVR_BUFFER_DEFAULT_BUDGET      (512 * 1024 * 1024)
+/* Hàng đợi appsrc của mỗi session (sink pace theo clock, phần còn lại nằm trong ring) */
+#define DVR_BUFFER_SESSION_QUEUE_NS    (1 * GST_SECOND)
+/* Recording dừng (không còn pipeline nào đưa AU vào) quá lâu hơn một lần rotation:
+ * ring đóng, session nhận EOS */
+#define DVR_BUFFER_CLOSE_GRACE_SEC     15
+
+/* Bật DVR với tổng bộ nhớ budget_bytes cho mọi ring (0: tắt) */
+void dvr_buffer_init(guint64 budget_bytes);
+
+/* Cửa sổ riêng của camera (cả main và sub): window_sec 0 là tắt DVR cho camera này.
+ * Gọi trước khi recording của camera bắt đầu */
+void dvr_buffer_set_camera_limit(const gchar *camera_name, guint window_sec, guint64 max_bytes);
+
+/* Recording: đưa AU ra từ parser vào ring của camera/stream.
+ * Gọi mỗi lần dựng lại pipeline (rotation): ring giữ timeline liên tục qua các lần.
+ * Không có pipeline nào gắn lại trong DVR_BUFFER_CLOSE_GRACE_SEC: ring đóng và bị bỏ */
+void dvr_buffer_attach(GstElement *parser, const gchar *camera_name, StreamType stream_type);
+
+/* Pipeline phát từ ring (pay0), offset_sec <= 0 tính từ live; NULL nếu ring chưa có dữ liệu */
+GstElement* dvr_buffer_create_pipeline(const gchar *camera_name, StreamType stream_type,
+                                       gint64 offset_sec);
+
+/* Element do dvr_buffer_create_pipeline tạo? */
+gboolean dvr_buffer_is_dvr(GstElement *element);
+
+/* Giải phóng mọi ring (session còn mở nhận EOS) */
+void dvr_buffer_shutdown(void);
+
+#endif // DVR_BUFFER_H
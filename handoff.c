@@ -0,0 +1,565 @@
+#define _GNU_SOURCE   /* accept4, struct ucred */
+#include "handoff.h"
+#include "http_control.h"
+#include <glib-unix.h>
+#include <glib/gstdio.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+#define HANDOFF_URI_KEY  "handoff-uri"
+#define HANDOFF_MSG_MAX  64
+#define HANDOFF_MAX_FDS  (1 + HANDOFF_MAX_HTTP_SOCKETS)
+
+/* Listen socket RTSP (tự tạo hoặc kế thừa) và source accept của process này */
+static GSocket *rtsp_socket = NULL;
+static GSource *accept_source = NULL;
+static GSList *http_sockets = NULL;     /* GSocket* kế thừa */
+
+/* Process mới: kết nối tới process cũ, giữ tới khi process cũ thoát */
+static gboolean successor = FALSE;
+static gint predecessor_fd = -1;
+static guint predecessor_watch = 0;
+
+/* Socket điều khiển nhận takeover */
+static gchar *serve_path = NULL;
+static gint listen_fd = -1;
+static guint listen_watch = 0;
+static gint successor_fd = -1;
+static guint successor_watch = 0;
+static gboolean in_progress = FALSE;
+static GSourceFunc handoff_func = NULL;
+static gpointer handoff_data = NULL;
+
+typedef struct {
+    HandoffReadyFunc ready_func;
+    gpointer ready_data;
+    GSourceFunc done_func;
+    gpointer done_data;
+    gint64 deadline;
+} ReadyWait;
+
+static ReadyWait ready_wait;
+
+/* ===== Message + fd qua socket UNIX (SOCK_SEQPACKET: mỗi message một lần recv) ===== */
+
+static gboolean fill_address(const gchar *path, struct sockaddr_un *addr) {
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr->sun_path)) {
+        g_printerr("[handoff] Socket path too long: %s\n", path);
+        return FALSE;
+    }
+    strcpy(addr->sun_path, path);
+    return TRUE;
+}
+
+/* bind trong thư mục tạm 0700 rồi rename sang path: socket chỉ xuất hiện ở path khi đã có mode */
+static gboolean bind_private(gint fd, const gchar *path, mode_t mode) {
+    gchar *dir_name = g_path_get_dirname(path);
+    gchar *tmp_dir = g_build_filename(dir_name, ".handoff-XXXXXX", NULL);
+    g_free(dir_name);
+    if (!g_mkdtemp_full(tmp_dir, 0700)) {
+        g_free(tmp_dir);
+        return FALSE;
+    }
+    gchar *tmp_path = g_build_filename(tmp_dir, "sock", NULL);
+
+    struct sockaddr_un addr;
+    gboolean ok = FALSE;
+    if (!fill_address(tmp_path, &addr)) {
+        errno = ENAMETOOLONG;
+    } else {
+        ok = bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0 &&
+             chmod(tmp_path, mode) == 0 &&
+             g_rename(tmp_path, path) == 0;
+    }
+
+    gint saved_errno = errno;
+    if (!ok) g_unlink(tmp_path);
+    g_rmdir(tmp_dir);
+    g_free(tmp_path);
+    g_free(tmp_dir);
+    errno = saved_errno;
+    return ok;
+}
+
+static void set_timeout(gint fd, guint timeout_ms) {
+    struct timeval tv = { timeout_ms / 1000, (timeout_ms % 1000) * 1000 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+static gboolean send_message(gint fd, const gchar *text, const gint *fds, guint n_fds) {
+    union {
+        struct cmsghdr align;
+        gchar buf[CMSG_SPACE(sizeof(gint) * HANDOFF_MAX_FDS)];
+    } control;
+    struct iovec iov = { (void *)text, strlen(text) };
+    struct msghdr msg;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+
+    if (n_fds > 0) {
+        memset(&control, 0, sizeof(control));
+        msg.msg_control = control.buf;
+        msg.msg_controllen = CMSG_SPACE(sizeof(gint) * n_fds);
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(gint) * n_fds);
+        memcpy(CMSG_DATA(cmsg), fds, sizeof(gint) * n_fds);
+    }
+
+    gssize sent;
+    do {
+        sent = sendmsg(fd, &msg, MSG_NOSIGNAL);
+    } while (sent < 0 && errno == EINTR);
+    return sent == (gssize)iov.iov_len;
+}
+
+/* Trả về độ dài text (0: peer đã đóng, -1: lỗi); fd nhận thừa được đóng */
+static gssize recv_message(gint fd, gchar *buf, gsize size, gint *fds, guint max_fds, guint *n_fds) {
+    union {
+        struct cmsghdr align;
+        gchar buf[CMSG_SPACE(sizeof(gint) * HANDOFF_MAX_FDS)];
+    } control;
+    struct iovec iov = { buf, size - 1 };
+    struct msghdr msg;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    gssize len;
+    do {
+        len = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC);
+    } while (len < 0 && errno == EINTR);
+
+    if (n_fds) *n_fds = 0;
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); len >= 0 && cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) continue;
+        guint count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(gint);
+        gint *received = (gint *)CMSG_DATA(cmsg);
+        for (guint i = 0; i < count; i++) {
+            if (fds && n_fds && *n_fds < max_fds) {
+                fds[(*n_fds)++] = received[i];
+            } else {
+                close(received[i]);
+            }
+        }
+    }
+
+    buf[len > 0 ? len : 0] = '\0';
+    return len;
+}
+
+/* ===== Process mới ===== */
+
+gboolean handoff_takeover(const gchar *socket_path) {
+    struct sockaddr_un addr;
+    if (!fill_address(socket_path, &addr)) return FALSE;
+
+    gint fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        g_printerr("[handoff] socket: %s\n", g_strerror(errno));
+        return FALSE;
+    }
+    set_timeout(fd, HANDOFF_CONNECT_TIMEOUT_MS);
+
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        g_printerr("[handoff] No running server at %s: %s\n", socket_path, g_strerror(errno));
+        close(fd);
+        return FALSE;
+    }
+
+    gchar *hello = g_strdup_printf("TAKEOVER %d", (gint)getpid());
+    gboolean sent = send_message(fd, hello, NULL, 0);
+    g_free(hello);
+
+    gchar buf[HANDOFF_MSG_MAX];
+    gint fds[HANDOFF_MAX_FDS];
+    guint n_fds = 0;
+    gssize len = sent ? recv_message(fd, buf, sizeof(buf), fds, HANDOFF_MAX_FDS, &n_fds) : -1;
+
+    if (len <= 0 || !g_str_has_prefix(buf, "SOCKETS ") || n_fds == 0) {
+        g_printerr("[handoff] Takeover refused by %s: %s\n", socket_path,
+                   len > 0 ? buf : (len == 0 ? "connection closed" : g_strerror(errno)));
+        for (guint i = 0; i < n_fds; i++) close(fds[i]);
+        close(fd);
+        return FALSE;
+    }
+
+    GError *error = NULL;
+    rtsp_socket = g_socket_new_from_fd(fds[0], &error);
+    if (!rtsp_socket) {
+        g_printerr("[handoff] Inherited RTSP socket unusable: %s\n", error->message);
+        g_error_free(error);
+        for (guint i = 0; i < n_fds; i++) close(fds[i]);
+        close(fd);
+        return FALSE;
+    }
+
+    for (guint i = 1; i < n_fds; i++) {
+        GSocket *socket = g_socket_new_from_fd(fds[i], &error);
+        if (socket) {
+            http_sockets = g_slist_append(http_sockets, socket);
+        } else {
+            g_printerr("[handoff] Inherited HTTP socket unusable: %s\n", error->message);
+            g_clear_error(&error);
+            close(fds[i]);
+        }
+    }
+
+    successor = TRUE;
+    predecessor_fd = fd;
+    g_print("[handoff] Took over listen sockets from %s (RTSP + %u HTTP)\n",
+            socket_path, g_slist_length(http_sockets));
+    return TRUE;
+}
+
+gboolean handoff_is_successor(void) {
+    return successor;
+}
+
+GSList* handoff_http_sockets(void) {
+    return http_sockets;
+}
+
+/* ===== Accept RTSP ===== */
+
+/* URL client đã PLAY, dùng làm Location khi redirect. Playback (?timestamp=) không được
+ * redirect: mở lại URL sẽ phát lại từ đầu khoảng, để client xem hết trên process cũ */
+static void on_play_request(GstRTSPClient *client, GstRTSPContext *ctx, gpointer user_data) {
+    if (!ctx->uri) return;
+    if (ctx->uri->query && strstr(ctx->uri->query, "timestamp=")) return;
+    g_object_set_data_full(G_OBJECT(client), HANDOFF_URI_KEY,
+                           gst_rtsp_url_get_request_uri(ctx->uri), g_free);
+}
+
+static void on_client_connected(GstRTSPServer *server, GstRTSPClient *client, gpointer user_data) {
+    g_signal_connect(client, "play-request", G_CALLBACK(on_play_request), NULL);
+}
+
+gboolean handoff_attach_server(GstRTSPServer *server) {
+    GError *error = NULL;
+
+    if (!rtsp_socket) {
+        rtsp_socket = gst_rtsp_server_create_socket(server, NULL, &error);
+        if (!rtsp_socket) {
+            g_printerr("[handoff] Failed to create RTSP socket: %s\n", error->message);
+            g_error_free(error);
+            return FALSE;
+        }
+    }
+
+    /* Giống gst_rtsp_server_attach, nhưng giữ socket để chuyển cho process sau */
+    accept_source = g_socket_create_source(rtsp_socket, G_IO_IN | G_IO_ERR | G_IO_HUP | G_IO_NVAL, NULL);
+    g_source_set_callback(accept_source, (GSourceFunc)gst_rtsp_server_io_func,
+                          g_object_ref(server), g_object_unref);
+    g_source_attach(accept_source, NULL);
+
+    g_signal_connect(server, "client-connected", G_CALLBACK(on_client_connected), NULL);
+    return TRUE;
+}
+
+static void stop_accepting(void) {
+    if (accept_source) {
+        g_source_destroy(accept_source);
+        g_source_unref(accept_source);
+        accept_source = NULL;
+    }
+}
+
+/* ===== Socket điều khiển ===== */
+
+static void close_listener(void) {
+    if (listen_watch) {
+        g_source_remove(listen_watch);
+        listen_watch = 0;
+    }
+    if (listen_fd >= 0) {
+        close(listen_fd);
+        listen_fd = -1;
+        g_unlink(serve_path);
+    }
+}
+
+static gboolean on_successor_message(gint fd, GIOCondition condition, gpointer user_data) {
+    gchar buf[HANDOFF_MSG_MAX];
+    gssize len = recv_message(fd, buf, sizeof(buf), NULL, 0, NULL);
+
+    if (len > 0 && g_strcmp0(buf, "READY") == 0) {
+        g_print("[handoff] Successor ready: stop accepting, finalize recordings, drain clients\n");
+        in_progress = TRUE;
+        successor_watch = 0;
+        stop_accepting();
+        http_control_stop_listening();
+        /* Process mới mở lại socket điều khiển sau khi process này thoát */
+        close_listener();
+        if (handoff_func) handoff_func(handoff_data);
+        /* Giữ kết nối tới lúc thoát: process mới biết đã xong khi socket đóng */
+        return G_SOURCE_REMOVE;
+    }
+    if (len > 0) {
+        g_printerr("[handoff] Unexpected message from successor: %s\n", buf);
+        return G_SOURCE_CONTINUE;
+    }
+
+    /* Process mới chết trước khi READY: tiếp tục phục vụ như bình thường */
+    g_printerr("[handoff] Successor disconnected before ready, continuing\n");
+    close(successor_fd);
+    successor_fd = -1;
+    successor_watch = 0;
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean on_takeover_request(gint fd, GIOCondition condition, gpointer user_data) {
+    gint peer = accept4(fd, NULL, NULL, SOCK_CLOEXEC);
+    if (peer < 0) return G_SOURCE_CONTINUE;
+
+    /* Listen socket chỉ trao cho process cùng user (quyền file của socket là lớp thứ hai) */
+    struct ucred cred = { 0, (uid_t)-1, (gid_t)-1 };
+    socklen_t cred_len = sizeof(cred);
+    if (getsockopt(peer, SOL_SOCKET, SO_PEERCRED, &cred, &cred_len) < 0 || cred.uid != geteuid()) {
+        g_printerr("[handoff] Rejected takeover request from uid %d\n", (gint)cred.uid);
+        close(peer);
+        return G_SOURCE_CONTINUE;
+    }
+    set_timeout(peer, HANDOFF_CONNECT_TIMEOUT_MS);
+
+    gchar buf[HANDOFF_MSG_MAX];
+    if (recv_message(peer, buf, sizeof(buf), NULL, 0, NULL) <= 0 || !g_str_has_prefix(buf, "TAKEOVER ")) {
+        close(peer);
+        return G_SOURCE_CONTINUE;
+    }
+
+    /* Chỉ một process kế nhiệm tại một thời điểm */
+    if (successor_fd >= 0 || in_progress || !rtsp_socket) {
+        send_message(peer, "BUSY", NULL, 0);
+        close(peer);
+        return G_SOURCE_CONTINUE;
+    }
+
+    gint fds[HANDOFF_MAX_FDS];
+    guint n_fds = 0;
+    fds[n_fds++] = g_socket_get_fd(rtsp_socket);
+    GSList *listeners = http_control_get_sockets();
+    for (GSList *l = listeners; l && n_fds < HANDOFF_MAX_FDS; l = l->next) {
+        fds[n_fds++] = g_socket_get_fd(G_SOCKET(l->data));
+    }
+    g_slist_free(listeners);
+
+    gchar *reply = g_strdup_printf("SOCKETS %u", n_fds - 1);
+    gboolean sent = send_message(peer, reply, fds, n_fds);
+    g_free(reply);
+    if (!sent) {
+        g_printerr("[handoff] Failed to send listen sockets: %s\n", g_strerror(errno));
+        close(peer);
+        return G_SOURCE_CONTINUE;
+    }
+
+    g_print("[handoff] Takeover requested by pid %s, sent %u listen socket(s)\n",
+            buf + strlen("TAKEOVER "), n_fds);
+    successor_fd = peer;
+    successor_watch = g_unix_fd_add(peer, G_IO_IN | G_IO_HUP | G_IO_ERR, on_successor_message, NULL);
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean listen_now(void) {
+    gint fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        g_printerr("[handoff] socket: %s\n", g_strerror(errno));
+        return FALSE;
+    }
+
+    /* Socket còn lại từ lần chạy bị kill: không ai nghe nữa (RTSP port đã bind được),
+     * rename thay thế nó một cách nguyên tử */
+    if (!bind_private(fd, serve_path, 0600) || listen(fd, 1) < 0) {
+        g_printerr("[handoff] Cannot listen on %s: %s\n", serve_path, g_strerror(errno));
+        close(fd);
+        return FALSE;
+    }
+
+    listen_fd = fd;
+    listen_watch = g_unix_fd_add(fd, G_IO_IN, on_takeover_request, NULL);
+    g_print("[handoff] Restart control socket: %s\n", serve_path);
+    return TRUE;
+}
+
+gboolean handoff_serve(const gchar *socket_path, GSourceFunc on_handoff, gpointer user_data) {
+    g_free(serve_path);
+    serve_path = g_strdup(socket_path);
+    handoff_func = on_handoff;
+    handoff_data = user_data;
+
+    /* Process cũ còn giữ path: mở sau khi nó thoát */
+    if (predecessor_fd >= 0) return TRUE;
+    return listen_now();
+}
+
+gboolean handoff_in_progress(void) {
+    return in_progress;
+}
+
+/* ===== READY / kết thúc process cũ ===== */
+
+static gboolean on_predecessor_closed(gint fd, GIOCondition condition, gpointer user_data) {
+    gchar buf[HANDOFF_MSG_MAX];
+    if ((condition & G_IO_IN) && recv_message(fd, buf, sizeof(buf), NULL, 0, NULL) > 0) {
+        return G_SOURCE_CONTINUE;
+    }
+
+    g_print("[handoff] Previous server exited, takeover complete\n");
+    close(predecessor_fd);
+    predecessor_fd = -1;
+    predecessor_watch = 0;
+
+    if (ready_wait.done_func) ready_wait.done_func(ready_wait.done_data);
+    if (serve_path) listen_now();
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean poll_ready(gpointer user_data) {
+    gboolean ready = !ready_wait.ready_func || ready_wait.ready_func(ready_wait.ready_data);
+    if (!ready && g_get_monotonic_time() < ready_wait.deadline) {
+        return G_SOURCE_CONTINUE;
+    }
+
+    if (!ready) {
+        g_printerr("[handoff] Not all recordings writing after %d ms, signaling ready anyway\n",
+                   HANDOFF_READY_TIMEOUT_MS);
+    }
+    /* Gửi lỗi = process cũ đã chết: HUP bên dưới vẫn hoàn tất takeover */
+    if (send_message(predecessor_fd, "READY", NULL, 0)) {
+        g_print("[handoff] Ready, previous server is draining\n");
+    } else {
+        g_printerr("[handoff] Failed to signal ready: %s\n", g_strerror(errno));
+    }
+
+    predecessor_watch = g_unix_fd_add(predecessor_fd, G_IO_IN | G_IO_HUP | G_IO_ERR,
+                                      on_predecessor_closed, NULL);
+    return G_SOURCE_REMOVE;
+}
+
+void handoff_signal_ready(HandoffReadyFunc ready_func, gpointer ready_data,
+                          GSourceFunc done_func, gpointer done_data) {
+    if (predecessor_fd < 0) return;
+
+    ready_wait.ready_func = ready_func;
+    ready_wait.ready_data = ready_data;
+    ready_wait.done_func = done_func;
+    ready_wait.done_data = done_data;
+    ready_wait.deadline = g_get_monotonic_time() + (gint64)HANDOFF_READY_TIMEOUT_MS * 1000;
+    g_timeout_add(HANDOFF_READY_POLL_MS, poll_ready, NULL);
+}
+
+/* ===== Drain client của process cũ ===== */
+
+typedef struct {
+    GstRTSPServer *server;
+    GMainLoop *loop;
+    gint64 deadline;
+} DrainState;
+
+static GstRTSPFilterResult count_client(GstRTSPServer *server, GstRTSPClient *client, gpointer user_data) {
+    (*(guint *)user_data)++;
+    return GST_RTSP_FILTER_KEEP;
+}
+
+static GstRTSPFilterResult redirect_client(GstRTSPServer *server, GstRTSPClient *client, gpointer user_data) {
+    gchar *uri = g_object_dup_data(G_OBJECT(client), HANDOFF_URI_KEY, (GDuplicateFunc)g_strdup, NULL);
+    if (!uri) return GST_RTSP_FILTER_KEEP;
+
+    /* RFC 2326 REDIRECT về chính URL cũ: listen socket giờ do process mới accept.
+     * Client không hỗ trợ REDIRECT vẫn được phục vụ tới khi tự đóng hoặc hết drain */
+    GstRTSPMessage *msg = NULL;
+    if (gst_rtsp_message_new_request(&msg, GST_RTSP_REDIRECT, uri) == GST_RTSP_OK) {
+        gst_rtsp_message_add_header(msg, GST_RTSP_HDR_LOCATION, uri);
+        if (gst_rtsp_client_send_message(client, NULL, msg) == GST_RTSP_OK) {
+            (*(guint *)user_data)++;
+        }
+        gst_rtsp_message_free(msg);
+    }
+    g_free(uri);
+    return GST_RTSP_FILTER_KEEP;
+}
+
+static GstRTSPFilterResult close_client(GstRTSPServer *server, GstRTSPClient *client, gpointer user_data) {
+    return GST_RTSP_FILTER_REMOVE;
+}
+
+static guint count_clients(GstRTSPServer *server) {
+    guint clients = 0;
+    gst_rtsp_server_client_filter(server, count_client, &clients);
+    return clients;
+}
+
+static gboolean drain_check(gpointer user_data) {
+    DrainState *state = user_data;
+    if (count_clients(state->server) == 0 || g_get_monotonic_time() >= state->deadline) {
+        g_main_loop_quit(state->loop);
+        return G_SOURCE_REMOVE;
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+void handoff_drain_clients(GstRTSPServer *server, GMainLoop *loop, guint timeout_ms) {
+    guint redirected = 0;
+    gst_rtsp_server_client_filter(server, redirect_client, &redirected);
+
+    guint clients = count_clients(server);
+    g_print("[handoff] Draining %u client(s), %u redirected\n", clients, redirected);
+    if (clients == 0) return;
+
+    /* Loop chính tiếp tục chạy: HTTP/WebRTC và signal (Ctrl+C lần nữa để dừng ngay) */
+    DrainState state = { server, loop, g_get_monotonic_time() + (gint64)timeout_ms * 1000 };
+    GSource *timer = g_timeout_source_new(500);
+    g_source_set_callback(timer, drain_check, &state, NULL);
+    g_source_attach(timer, NULL);
+    g_main_loop_run(loop);
+    g_source_destroy(timer);
+    g_source_unref(timer);
+
+    clients = count_clients(server);
+    if (clients > 0) {
+        g_print("[handoff] Closing %u remaining client(s)\n", clients);
+        gst_rtsp_server_client_filter(server, close_client, NULL);
+    }
+}
+
+void handoff_stop(void) {
+    stop_accepting();
+    close_listener();
+
+    if (successor_watch) {
+        g_source_remove(successor_watch);
+        successor_watch = 0;
+    }
+    /* Đóng kết nối: process mới nhận HUP và nhận phần việc nền */
+    if (successor_fd >= 0) {
+        close(successor_fd);
+        successor_fd = -1;
+    }
+    if (predecessor_watch) {
+        g_source_remove(predecessor_watch);
+        predecessor_watch = 0;
+    }
+    if (predecessor_fd >= 0) {
+        close(predecessor_fd);
+        predecessor_fd = -1;
+    }
+
+    g_slist_free_full(http_sockets, g_object_unref);
+    http_sockets = NULL;
+    g_clear_object(&rtsp_socket);
+    g_free(serve_path);
+    serve_path = NULL;
+}
@@ -0,0 +1,54 @@
+#ifndef HANDOFF_H
+#define HANDOFF_H
+
+#include <glib.h>
+#include <gio/gio.h>
+#include <gst/rtsp-server/rtsp-server.h>
+
+/* Restart không downtime: process mới (--takeover) nối vào socket UNIX của process cũ,
+ * nhận listen socket RTSP/HTTP qua SCM_RIGHTS, bắt đầu ingest/recording song song rồi
+ * báo READY. Process cũ ngừng accept, finalize segment, redirect/drain client rồi thoát.
+ *   mới -> cũ: "TAKEOVER <pid>"
+ *   cũ -> mới: "SOCKETS <n_http>" + fd [rtsp, http...]
+ *   mới -> cũ: "READY"
+ *   cũ đóng kết nối khi thoát: process mới chạy phần việc nền (recovery, compactor...) */
+#define HANDOFF_SOCKET_NAME          ".handoff.sock"
+#define HANDOFF_CONNECT_TIMEOUT_MS   5000
+/* Chờ mọi recording của process mới ghi được buffer đầu (overlap với process cũ) */
+#define HANDOFF_READY_TIMEOUT_MS     20000
+#define HANDOFF_READY_POLL_MS        200
+/* Client không theo REDIRECT được phục vụ tiếp tối đa chừng này rồi bị đóng */
+#define HANDOFF_DRAIN_TIMEOUT_MS     60000
+#define HANDOFF_MAX_HTTP_SOCKETS     4
+
+/* Process mới đã sẵn sàng nhận thay? (ví dụ mọi recording đã ghi) */
+typedef gboolean (*HandoffReadyFunc)(gpointer user_data);
+
+/* Process mới: lấy listen socket từ process đang chạy (blocking, gọi lúc khởi động) */
+gboolean handoff_takeover(const gchar *socket_path);
+gboolean handoff_is_successor(void);
+/* Listen socket HTTP kế thừa (GSocket*, thuộc module) */
+GSList* handoff_http_sockets(void);
+
+/* Accept RTSP trên listen socket kế thừa, hoặc socket mới tạo theo cấu hình server.
+ * Thay cho gst_rtsp_server_attach để socket có thể chuyển cho process sau */
+gboolean handoff_attach_server(GstRTSPServer *server);
+
+/* Process mới: báo READY khi ready_func TRUE hoặc quá HANDOFF_READY_TIMEOUT_MS.
+ * done_func chạy trong main loop khi process cũ đã thoát hẳn */
+void handoff_signal_ready(HandoffReadyFunc ready_func, gpointer ready_data,
+                          GSourceFunc done_func, gpointer done_data);
+
+/* Nhận yêu cầu takeover trên socket UNIX (process mới: sau khi process cũ thoát).
+ * on_handoff chạy trong main loop khi process kế nhiệm báo READY */
+gboolean handoff_serve(const gchar *socket_path, GSourceFunc on_handoff, gpointer user_data);
+gboolean handoff_in_progress(void);
+
+/* Process cũ: REDIRECT client live về cùng URL (giờ do process mới phục vụ), chạy loop
+ * tới khi hết client hoặc quá timeout, rồi đóng các client còn lại */
+void handoff_drain_clients(GstRTSPServer *server, GMainLoop *loop, guint timeout_ms);
+
+/* Đóng socket điều khiển (unlink nếu chưa handoff) */
+void handoff_stop(void);
+
+#endif // HANDOFF_H
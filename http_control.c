@@ -0,0 +1,95 @@
+#include "http_control.h"
+#include <string.h>
+
+static SoupServer *http_server = NULL;
+
+static SoupServer* get_server(void) {
+    if (!http_server) {
+        http_server = soup_server_new("server-header", "RTSP Recorder", NULL);
+    }
+    return http_server;
+}
+
+gboolean http_control_start(guint port) {
+    GError *error = NULL;
+
+    if (!soup_server_listen_all(get_server(), port, 0, &error)) {
+        g_printerr("[http] Failed to listen on port %u: %s\n", port, error->message);
+        g_error_free(error);
+        return FALSE;
+    }
+
+    g_print("[http] Control endpoint on port %u\n", port);
+    return TRUE;
+}
+
+GSList* http_control_get_sockets(void) {
+    if (!http_server) return NULL;
+    return soup_server_get_listeners(http_server);
+}
+
+gboolean http_control_adopt_sockets(GSList *sockets) {
+    GError *error = NULL;
+    guint adopted = 0;
+
+    for (GSList *l = sockets; l; l = l->next) {
+        if (!soup_server_listen_socket(get_server(), G_SOCKET(l->data), 0, &error)) {
+            g_printerr("[http] Failed to listen on inherited socket: %s\n", error->message);
+            g_clear_error(&error);
+            continue;
+        }
+        adopted++;
+    }
+
+    if (adopted == 0) return FALSE;
+    g_print("[http] Control endpoint on %u inherited socket(s)\n", adopted);
+    return TRUE;
+}
+
+void http_control_stop_listening(void) {
+    if (!http_server) return;
+    /* Đóng fd listen của process này; process mới giữ bản dup nhận qua SCM_RIGHTS */
+    soup_server_disconnect(http_server);
+    g_print("[http] Stopped accepting connections\n");
+}
+
+void http_control_stop(void) {
+    if (!http_server) return;
+    soup_server_disconnect(http_server);
+    g_clear_object(&http_server);
+}
+
+void http_control_add_handler(const gchar *path,
+                              SoupServerCallback callback,
+                              gpointer user_data) {
+    soup_server_add_handler(get_server(), path, callback, user_data, NULL);
+}
+
+void http_control_add_websocket_handler(const gchar *path,
+                                        SoupServerWebsocketCallback callback,
+                                        gpointer user_data) {
+    soup_server_add_websocket_handler(get_server(), path, NULL, NULL, callback, user_data, NULL);
+}
+
+void http_control_respond(SoupServerMessage *msg,
+                          guint status,
+                          const gchar *content_type,
+                          const gchar *body) {
+    soup_server_message_set_status(msg, status, NULL);
+    if (body) {
+        soup_server_message_set_response(msg, content_type ? content_type : "text/plain",
+                                         SOUP_MEMORY_COPY, body, strlen(body));
+    }
+}
+
+gchar* http_control_path_tail(const gchar *path, const gchar *prefix) {
+    gsize len = strlen(prefix);
+
+    if (!path || strncmp(path, prefix, len) != 0) return NULL;
+    path += len;
+    while (*path == '/') path++;
+    if (*path == '\0') return NULL;
+
+    const gchar *end = strchr(path, '/');
+    return end ? g_strndup(path, end - path) : g_strdup(path);
+}
@@ -0,0 +1,36 @@
+#ifndef HTTP_CONTROL_H
+#define HTTP_CONTROL_H
+
+#include <libsoup/soup.h>
+
+/* Endpoint HTTP/WebSocket nội bộ (signaling WebRTC, điều khiển) */
+#define HTTP_CONTROL_PORT 8088
+
+gboolean http_control_start(guint port);
+void http_control_stop(void);
+/* Ngừng accept (handoff: listen socket đã chuyển cho process mới); handler vẫn giữ */
+void http_control_stop_listening(void);
+
+/* Listen socket đang dùng (GSocket*), để chuyển cho process mới khi restart; g_slist_free khi xong */
+GSList* http_control_get_sockets(void);
+/* Như http_control_start nhưng nghe trên socket có sẵn (kế thừa từ process cũ) */
+gboolean http_control_adopt_sockets(GSList *sockets);
+
+/* Đăng ký handler; path là prefix (ví dụ "/webrtc" khớp "/webrtc/cam_1") */
+void http_control_add_handler(const gchar *path,
+                              SoupServerCallback callback,
+                              gpointer user_data);
+void http_control_add_websocket_handler(const gchar *path,
+                                        SoupServerWebsocketCallback callback,
+                                        gpointer user_data);
+
+/* Trả lời nhanh text/plain hoặc application/json */
+void http_control_respond(SoupServerMessage *msg,
+                          guint status,
+                          const gchar *content_type,
+                          const gchar *body);
+
+/* Phần sau prefix của path ("/webrtc/cam_1", "/webrtc" -> "cam_1"), NULL nếu rỗng */
+gchar* http_control_path_tail(const gchar *path, const gchar *prefix);
+
+#endif // HTTP_CONTROL_H
@@ -0,0 +1,188 @@
+#define _GNU_SOURCE   /* sync_file_range */
+#include "io_policy.h"
+#include <glib/gstdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/* Job flush/drop/prefetch chạy trên pool riêng, không chặn streaming thread */
+#define IO_POLICY_THREADS 2
+
+typedef enum {
+    IO_JOB_FLUSH_RANGE,   /* ghi xuống disk rồi bỏ khỏi cache một khoảng của file đang ghi */
+    IO_JOB_DROP_FILE,
+    IO_JOB_PREFETCH
+} IoJobType;
+
+struct _IoWriteTracker {
+    int fd;
+    guint64 written;
+    guint64 flushed;      /* [0, flushed) đã flush + drop */
+    guint64 pending;      /* [flushed, pending) đã bắt đầu ghi xuống disk */
+    gboolean flush_queued;
+    GMutex lock;
+};
+
+typedef struct {
+    IoJobType type;
+    IoWriteTracker *tracker;
+    gchar *path;
+} IoJob;
+
+static GThreadPool *io_pool = NULL;
+static GMutex io_pool_lock;
+
+/* ===== Worker ===== */
+
+static void flush_range(IoWriteTracker *tracker) {
+    g_mutex_lock(&tracker->lock);
+    guint64 flush_from = tracker->flushed;
+    guint64 flush_to = tracker->pending;
+    guint64 start_to = tracker->written;
+    tracker->flushed = flush_to;
+    tracker->pending = start_to;
+    tracker->flush_queued = FALSE;
+    g_mutex_unlock(&tracker->lock);
+
+    /* Window mới: chỉ bắt đầu writeback, không chờ */
+    if (start_to > flush_to) {
+        sync_file_range(tracker->fd, flush_to, start_to - flush_to, SYNC_FILE_RANGE_WRITE);
+    }
+
+    /* Window trước: writeback đã bắt đầu từ lần trước nên chờ ngắn, rồi mới drop được */
+    if (flush_to > flush_from) {
+        sync_file_range(tracker->fd, flush_from, flush_to - flush_from,
+                        SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE |
+                        SYNC_FILE_RANGE_WAIT_AFTER);
+        posix_fadvise(tracker->fd, flush_from, flush_to - flush_from, POSIX_FADV_DONTNEED);
+    }
+}
+
+static void drop_file(const gchar *path) {
+    int fd = g_open(path, O_RDONLY | O_CLOEXEC, 0);
+    if (fd < 0) return;
+
+    sync_file_range(fd, 0, 0, SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE |
+                              SYNC_FILE_RANGE_WAIT_AFTER);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+}
+
+static void prefetch_file(const gchar *path) {
+    int fd = g_open(path, O_RDONLY | O_CLOEXEC, 0);
+    if (fd < 0) return;
+
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+    close(fd);
+}
+
+static void io_job_func(gpointer data, gpointer user_data) {
+    IoJob *job = data;
+
+    switch (job->type) {
+        case IO_JOB_FLUSH_RANGE:
+            flush_range(job->tracker);
+            break;
+        case IO_JOB_DROP_FILE:
+            drop_file(job->path);
+            break;
+        case IO_JOB_PREFETCH:
+            prefetch_file(job->path);
+            break;
+    }
+
+    if (job->tracker) io_write_tracker_unref(job->tracker);
+    g_free(job->path);
+    g_free(job);
+}
+
+static void push_job(IoJobType type, IoWriteTracker *tracker, const gchar *path) {
+    IoJob *job = g_new0(IoJob, 1);
+    job->type = type;
+    job->tracker = tracker ? g_atomic_rc_box_acquire(tracker) : NULL;
+    job->path = g_strdup(path);
+
+    g_mutex_lock(&io_pool_lock);
+    if (!io_pool) {
+        io_pool = g_thread_pool_new(io_job_func, NULL, IO_POLICY_THREADS, FALSE, NULL);
+    }
+    g_mutex_unlock(&io_pool_lock);
+
+    g_thread_pool_push(io_pool, job, NULL);
+}
+
+/* ===== Writer ===== */
+
+IoWriteTracker* io_write_tracker_new(const gchar *path) {
+    int fd = g_open(path, O_WRONLY | O_CLOEXEC, 0);
+    if (fd < 0) return NULL;
+
+    IoWriteTracker *tracker = g_atomic_rc_box_new0(IoWriteTracker);
+    tracker->fd = fd;
+    g_mutex_init(&tracker->lock);
+    return tracker;
+}
+
+void io_write_tracker_advance(IoWriteTracker *tracker, gsize bytes) {
+    gboolean flush = FALSE;
+
+    g_mutex_lock(&tracker->lock);
+    tracker->written += bytes;
+    if (!tracker->flush_queued && tracker->written - tracker->pending >= IO_POLICY_WRITE_WINDOW) {
+        tracker->flush_queued = TRUE;
+        flush = TRUE;
+    }
+    g_mutex_unlock(&tracker->lock);
+
+    if (flush) push_job(IO_JOB_FLUSH_RANGE, tracker, NULL);
+}
+
+static void io_write_tracker_clear(gpointer data) {
+    IoWriteTracker *tracker = data;
+    close(tracker->fd);
+    g_mutex_clear(&tracker->lock);
+}
+
+void io_write_tracker_unref(IoWriteTracker *tracker) {
+    g_atomic_rc_box_release_full(tracker, io_write_tracker_clear);
+}
+
+static GstPadProbeReturn writer_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    IoWriteTracker *tracker = user_data;
+
+    if (info->type & GST_PAD_PROBE_TYPE_BUFFER) {
+        io_write_tracker_advance(tracker, gst_buffer_get_size(GST_PAD_PROBE_INFO_BUFFER(info)));
+    } else if (info->type & GST_PAD_PROBE_TYPE_BUFFER_LIST) {
+        io_write_tracker_advance(tracker,
+                                 gst_buffer_list_calculate_size(GST_PAD_PROBE_INFO_BUFFER_LIST(info)));
+    }
+    return GST_PAD_PROBE_OK;
+}
+
+void io_policy_attach_writer(GstElement *filesink, const gchar *path) {
+    /* filesink mở file khi READY->PAUSED; tạo file trước để có fd riêng ngay */
+    int fd = g_open(path, O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    if (fd >= 0) close(fd);
+
+    IoWriteTracker *tracker = io_write_tracker_new(path);
+    if (!tracker) return;
+
+    GstPad *pad = gst_element_get_static_pad(filesink, "sink");
+    gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST,
+                      writer_probe, tracker, (GDestroyNotify)io_write_tracker_unref);
+    gst_object_unref(pad);
+}
+
+void io_policy_drop_file_async(const gchar *path) {
+    push_job(IO_JOB_DROP_FILE, NULL, path);
+}
+
+/* ===== Reader ===== */
+
+void io_policy_reader_hint(int fd) {
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+}
+
+void io_policy_prefetch_async(const gchar *path) {
+    if (path) push_job(IO_JOB_PREFETCH, NULL, path);
+}
@@ -0,0 +1,31 @@
+#ifndef IO_POLICY_H
+#define IO_POLICY_H
+
+#include <gst/gst.h>
+
+/* Recording: mỗi khi ghi thêm chừng này byte thì đẩy xuống disk và bỏ khỏi page cache */
+#define IO_POLICY_WRITE_WINDOW   (8 * 1024 * 1024)
+/* Playback: đọc qua tỉ lệ này của file thì prefetch segment tiếp theo */
+#define IO_POLICY_PREFETCH_AT_PERCENT 50
+
+/* Theo dõi một file đang ghi (dùng fd riêng, page cache là theo inode) */
+typedef struct _IoWriteTracker IoWriteTracker;
+
+IoWriteTracker* io_write_tracker_new(const gchar *path);
+/* Báo đã ghi thêm bytes; khi qua một window thì flush/drop ở background */
+void io_write_tracker_advance(IoWriteTracker *tracker, gsize bytes);
+void io_write_tracker_unref(IoWriteTracker *tracker);
+
+/* Gắn tracker vào filesink của recording pipeline */
+void io_policy_attach_writer(GstElement *filesink, const gchar *path);
+
+/* Segment đã đóng: flush phần còn lại và bỏ cả file khỏi page cache (background) */
+void io_policy_drop_file_async(const gchar *path);
+
+/* Playback: hint đọc tuần tự cho fd vừa mở */
+void io_policy_reader_hint(int fd);
+
+/* Playback: nạp trước segment tiếp theo vào page cache (background) */
+void io_policy_prefetch_async(const gchar *path);
+
+#endif // IO_POLICY_H
@@ -0,0 +1,244 @@
+#include "latency_measure.h"
+#include "client_congestion.h"
+#include <gst/rtp/gstrtpbuffer.h>
+#include <string.h>
+
+/* Giây giữa epoch NTP (1900) và Unix (1970) */
+#define NTP_UNIX_OFFSET_SEC 2208988800LL
+
+#define LATENCY_CAPS_INGEST   "timestamp/x-g2g-ingest"
+#define LATENCY_CAPS_ARRIVAL  "timestamp/x-g2g-arrival"
+#define LATENCY_CAPS_SENDQ    "timestamp/x-g2g-sendq"
+
+typedef struct {
+    /* Thread của depayloader */
+    gint64 last_ingest_us;
+    gint64 last_arrival_us;
+    guint8 last_source;
+
+    /* Thread của send queue -> payloader */
+    LatencyStamp current;
+    gboolean has_current;
+} LatencyState;
+
+static GstCaps *caps_ingest = NULL;
+static GstCaps *caps_arrival = NULL;
+static GstCaps *caps_sendq = NULL;
+static GstCaps *caps_ntp = NULL;
+
+void latency_stamp_write(const LatencyStamp *stamp, guint8 *data) {
+    data[0] = stamp->source;
+    GST_WRITE_UINT64_BE(data + 1, (guint64)stamp->ingest_us);
+    GST_WRITE_UINT64_BE(data + 9, (guint64)stamp->arrival_us);
+    GST_WRITE_UINT32_BE(data + 17, stamp->sendq_in_us);
+    GST_WRITE_UINT32_BE(data + 21, stamp->pay_in_us);
+    GST_WRITE_UINT32_BE(data + 25, stamp->pay_out_us);
+}
+
+gboolean latency_stamp_read(const guint8 *data, guint size, LatencyStamp *stamp) {
+    if (!data || size < LATENCY_EXT_SIZE) return FALSE;
+
+    stamp->source = data[0];
+    stamp->ingest_us = (gint64)GST_READ_UINT64_BE(data + 1);
+    stamp->arrival_us = (gint64)GST_READ_UINT64_BE(data + 9);
+    stamp->sendq_in_us = GST_READ_UINT32_BE(data + 17);
+    stamp->pay_in_us = GST_READ_UINT32_BE(data + 21);
+    stamp->pay_out_us = GST_READ_UINT32_BE(data + 25);
+    return TRUE;
+}
+
+static gint64 buffer_stamp(GstBuffer *buffer, GstCaps *caps) {
+    GstReferenceTimestampMeta *meta = gst_buffer_get_reference_timestamp_meta(buffer, caps);
+    return meta ? (gint64)(meta->timestamp / GST_USECOND) : -1;
+}
+
+static void buffer_add_stamp(GstBuffer *buffer, GstCaps *caps, gint64 us) {
+    gst_buffer_add_reference_timestamp_meta(buffer, caps, (GstClockTime)us * GST_USECOND,
+                                            GST_CLOCK_TIME_NONE);
+}
+
+/* RTP vào depayloader: lấy thời điểm capture từ NTP meta của jitterbuffer (RTCP SR) */
+static GstPadProbeReturn depay_sink_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    LatencyState *state = user_data;
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    gint64 now = g_get_real_time();
+
+    state->last_arrival_us = now;
+    state->last_ingest_us = now;
+    state->last_source = LATENCY_SOURCE_ARRIVAL;
+
+    GstReferenceTimestampMeta *ntp = gst_buffer_get_reference_timestamp_meta(buffer, caps_ntp);
+    if (ntp) {
+        gint64 unix_us = (gint64)(ntp->timestamp / GST_USECOND) - NTP_UNIX_OFFSET_SEC * G_USEC_PER_SEC;
+        if (unix_us > 0) {
+            state->last_ingest_us = unix_us;
+            state->last_source = LATENCY_SOURCE_NTP;
+        }
+    }
+    return GST_PAD_PROBE_OK;
+}
+
+/* Access unit ra khỏi depayloader (cùng thread, ngay sau gói RTP cuối của AU) */
+static GstPadProbeReturn depay_src_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    LatencyState *state = user_data;
+    if (state->last_arrival_us <= 0) return GST_PAD_PROBE_OK;
+
+    GstBuffer *buffer = gst_buffer_make_writable(GST_PAD_PROBE_INFO_BUFFER(info));
+    /* Chỉ gắn ingest khi có NTP; không có thì ingest = arrival */
+    if (state->last_source == LATENCY_SOURCE_NTP) {
+        buffer_add_stamp(buffer, caps_ingest, state->last_ingest_us);
+    }
+    buffer_add_stamp(buffer, caps_arrival, state->last_arrival_us);
+    GST_PAD_PROBE_INFO_DATA(info) = buffer;
+    return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn sendq_sink_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    GstBuffer *buffer = gst_buffer_make_writable(GST_PAD_PROBE_INFO_BUFFER(info));
+    buffer_add_stamp(buffer, caps_sendq, g_get_real_time());
+    GST_PAD_PROBE_INFO_DATA(info) = buffer;
+    return GST_PAD_PROBE_OK;
+}
+
+/* AU vào payloader: gom các mốc lại cho các gói RTP sắp tạo ra */
+static GstPadProbeReturn pay_sink_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    LatencyState *state = user_data;
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    gint64 now = g_get_real_time();
+    gint64 ingest = buffer_stamp(buffer, caps_ingest);
+    gint64 arrival = buffer_stamp(buffer, caps_arrival);
+    gint64 sendq = buffer_stamp(buffer, caps_sendq);
+
+    /* Không có depayloader (transcode qua decodebin): lấy mốc từ send queue */
+    if (arrival < 0) arrival = sendq >= 0 ? sendq : now;
+    if (sendq < 0) sendq = arrival;
+
+    memset(&state->current, 0, sizeof(LatencyStamp));
+    state->current.source = ingest >= 0 ? LATENCY_SOURCE_NTP : LATENCY_SOURCE_ARRIVAL;
+    state->current.ingest_us = ingest >= 0 ? ingest : arrival;
+    state->current.arrival_us = arrival;
+    state->current.sendq_in_us = (guint32)MAX(sendq - arrival, 0);
+    state->current.pay_in_us = (guint32)MAX(now - arrival, 0);
+    state->has_current = TRUE;
+    return GST_PAD_PROBE_OK;
+}
+
+static gboolean stamp_rtp_packet(GstBuffer **buffer, LatencyState *state) {
+    GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+    guint8 data[LATENCY_EXT_SIZE];
+
+    *buffer = gst_buffer_make_writable(*buffer);
+    if (!gst_rtp_buffer_map(*buffer, GST_MAP_READWRITE, &rtp)) return FALSE;
+
+    state->current.pay_out_us = (guint32)MAX(g_get_real_time() - state->current.arrival_us, 0);
+    latency_stamp_write(&state->current, data);
+    gboolean ok = gst_rtp_buffer_add_extension_twobytes_header(&rtp, 0, LATENCY_EXT_ID,
+                                                               data, sizeof(data));
+    gst_rtp_buffer_unmap(&rtp);
+    return ok;
+}
+
+static gboolean stamp_list_item(GstBuffer **buffer, guint idx, gpointer user_data) {
+    stamp_rtp_packet(buffer, user_data);
+    return TRUE;
+}
+
+static GstPadProbeReturn pay_src_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    LatencyState *state = user_data;
+    if (!state->has_current) return GST_PAD_PROBE_OK;
+
+    if (info->type & GST_PAD_PROBE_TYPE_BUFFER) {
+        GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+        stamp_rtp_packet(&buffer, state);
+        GST_PAD_PROBE_INFO_DATA(info) = buffer;
+    } else if (info->type & GST_PAD_PROBE_TYPE_BUFFER_LIST) {
+        GstBufferList *list = gst_buffer_list_make_writable(GST_PAD_PROBE_INFO_BUFFER_LIST(info));
+        gst_buffer_list_foreach(list, stamp_list_item, state);
+        GST_PAD_PROBE_INFO_DATA(info) = list;
+    }
+    return GST_PAD_PROBE_OK;
+}
+
+static void add_probe(GstElement *element, const gchar *pad_name, GstPadProbeType type,
+                      GstPadProbeCallback callback, gpointer user_data) {
+    GstPad *pad = gst_element_get_static_pad(element, pad_name);
+    if (!pad) return;
+    gst_pad_add_probe(pad, type, callback, user_data, NULL);
+    gst_object_unref(pad);
+}
+
+static GstElement* find_depayloader(GstBin *bin) {
+    GstIterator *it = gst_bin_iterate_recurse(bin);
+    GValue item = G_VALUE_INIT;
+    GstElement *found = NULL;
+
+    while (!found && gst_iterator_next(it, &item) == GST_ITERATOR_OK) {
+        GstElement *element = g_value_get_object(&item);
+        const gchar *klass = gst_element_class_get_metadata(GST_ELEMENT_GET_CLASS(element),
+                                                            GST_ELEMENT_METADATA_KLASS);
+        if (klass && strstr(klass, "Depayloader")) {
+            found = gst_object_ref(element);
+        }
+        g_value_reset(&item);
+    }
+
+    g_value_unset(&item);
+    gst_iterator_free(it);
+    return found;
+}
+
+void latency_measure_attach(GstElement *pipeline) {
+    if (!GST_IS_BIN(pipeline)) return;
+
+    if (!caps_ingest) {
+        caps_ingest = gst_caps_new_empty_simple(LATENCY_CAPS_INGEST);
+        caps_arrival = gst_caps_new_empty_simple(LATENCY_CAPS_ARRIVAL);
+        caps_sendq = gst_caps_new_empty_simple(LATENCY_CAPS_SENDQ);
+        caps_ntp = gst_caps_new_empty_simple("timestamp/x-ntp");
+    }
+
+    LatencyState *state = g_new0(LatencyState, 1);
+    g_object_set_data_full(G_OBJECT(pipeline), "latency-measure", state, g_free);
+
+    /* jitterbuffer gắn NTP meta (từ RTCP SR) lên gói RTP */
+    GstIterator *it = gst_bin_iterate_sources(GST_BIN(pipeline));
+    GValue item = G_VALUE_INIT;
+    while (gst_iterator_next(it, &item) == GST_ITERATOR_OK) {
+        GObject *src = g_value_get_object(&item);
+        if (g_object_class_find_property(G_OBJECT_GET_CLASS(src), "add-reference-timestamp-meta")) {
+            g_object_set(src, "add-reference-timestamp-meta", TRUE, NULL);
+        }
+        g_value_reset(&item);
+    }
+    g_value_unset(&item);
+    gst_iterator_free(it);
+
+    GstElement *depay = find_depayloader(GST_BIN(pipeline));
+    if (depay) {
+        add_probe(depay, "sink", GST_PAD_PROBE_TYPE_BUFFER, depay_sink_probe, state);
+        add_probe(depay, "src", GST_PAD_PROBE_TYPE_BUFFER, depay_src_probe, state);
+        gst_object_unref(depay);
+    }
+
+    GstElement *sendq = gst_bin_get_by_name(GST_BIN(pipeline), CLIENT_SENDQ_NAME);
+    if (sendq) {
+        add_probe(sendq, "sink", GST_PAD_PROBE_TYPE_BUFFER, sendq_sink_probe, state);
+        gst_object_unref(sendq);
+    }
+
+    GstElement *pay = gst_bin_get_by_name(GST_BIN(pipeline), "pay0");
+    if (pay) {
+        /* Extension thêm sau khi payloader đã cắt gói theo mtu: trừ trước để gói không vượt MTU */
+        guint mtu = 0;
+        g_object_get(pay, "mtu", &mtu, NULL);
+        if (mtu > LATENCY_EXT_OVERHEAD) {
+            g_object_set(pay, "mtu", mtu - LATENCY_EXT_OVERHEAD, NULL);
+        }
+        add_probe(pay, "sink", GST_PAD_PROBE_TYPE_BUFFER, pay_sink_probe, state);
+        add_probe(pay, "src", GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST,
+                  pay_src_probe, state);
+        gst_object_unref(pay);
+    }
+
+    g_print("[latency] Measurement mode enabled (RTP header extension id %d)\n", LATENCY_EXT_ID);
+}
@@ -0,0 +1,36 @@
+#ifndef LATENCY_MEASURE_H
+#define LATENCY_MEASURE_H
+
+#include <gst/gst.h>
+
+/* Bật bằng ?measure=latency trên URL live */
+#define LATENCY_MEASURE_PARAM  "measure"
+#define LATENCY_MEASURE_VALUE  "latency"
+
+/* RTP header extension (two-byte header) mang mốc thời gian của access unit */
+#define LATENCY_EXT_ID    7
+#define LATENCY_EXT_SIZE  29
+/* Byte thêm vào gói RTP: header 0x1000 + length, phần tử (id, len, data) làm tròn 4 byte */
+#define LATENCY_EXT_OVERHEAD  (4 + ((2 + LATENCY_EXT_SIZE + 3) & ~3))
+
+#define LATENCY_SOURCE_ARRIVAL  0   /* ingest = lúc server nhận (không có RTCP SR) */
+#define LATENCY_SOURCE_NTP      1   /* ingest = thời điểm capture theo RTCP SR/NTP của camera */
+
+/* Mốc thời gian của một access unit, wallclock micro giây UTC */
+typedef struct {
+    guint8 source;
+    gint64 ingest_us;      /* capture (NTP) hoặc arrival */
+    gint64 arrival_us;     /* ra khỏi jitterbuffer, vào depayloader */
+    guint32 sendq_in_us;   /* offset từ arrival: vào send queue (depay + parse) */
+    guint32 pay_in_us;     /* offset từ arrival: ra khỏi send queue */
+    guint32 pay_out_us;    /* offset từ arrival: gói RTP rời payloader */
+} LatencyStamp;
+
+/* Gắn probe đo latency vào pipeline live (depayloader, sendq, pay0) */
+void latency_measure_attach(GstElement *pipeline);
+
+/* Ghi/đọc payload của header extension (big-endian) */
+void latency_stamp_write(const LatencyStamp *stamp, guint8 *data);
+gboolean latency_stamp_read(const guint8 *data, guint size, LatencyStamp *stamp);
+
+#endif // LATENCY_MEASURE_H
@@ -0,0 +1,69 @@
+#include "latency_profile.h"
+#include "recording_lookup.h"
+
+#define LATENCY_PROFILE_KEY "latency-profile"
+
+static const LatencyProfile profiles[] = {
+    /* PTZ: không buffer, drop frame trễ, send queue ngắn - mục tiêu < 150 ms */
+    { "ultra-low", 50, "none", TRUE,
+      { 512 * 1024, 300000000ULL, 5000 },
+      0, FALSE },
+    /* Mặc định, giống cấu hình cũ */
+    { "balanced", 200, "auto", FALSE,
+      { CLIENT_SENDQ_MAX_BYTES, CLIENT_SENDQ_MAX_TIME_NS, CLIENT_CONGESTION_DISCONNECT_MS },
+      200, TRUE },
+    /* Site WAN: jitterbuffer lớn, không drop, send queue sâu */
+    { "smooth", 2000, "slave", FALSE,
+      { 8 * 1024 * 1024, 3000000000ULL, 30000 },
+      2000, TRUE },
+};
+
+const LatencyProfile* latency_profile_find(const gchar *name) {
+    if (!name) return NULL;
+    for (guint i = 0; i < G_N_ELEMENTS(profiles); i++) {
+        if (g_ascii_strcasecmp(profiles[i].name, name) == 0) return &profiles[i];
+    }
+    return NULL;
+}
+
+const LatencyProfile* latency_profile_resolve(const gchar *query, const gchar *mount_profile) {
+    const LatencyProfile *profile = NULL;
+
+    gchar *name = parse_query_param(query, LATENCY_PROFILE_PARAM);
+    if (name) {
+        profile = latency_profile_find(name);
+        if (!profile) g_printerr("Unknown latency profile '%s', using mount default\n", name);
+        g_free(name);
+    }
+
+    if (!profile) profile = latency_profile_find(mount_profile);
+    if (!profile) profile = latency_profile_find(LATENCY_PROFILE_DEFAULT);
+    return profile;
+}
+
+gchar* latency_profile_source_desc(const LatencyProfile *profile) {
+    return g_strdup_printf("latency=%u buffer-mode=%s drop-on-latency=%s",
+                           profile->jitter_latency_ms, profile->buffer_mode,
+                           profile->drop_on_latency ? "true" : "false");
+}
+
+void latency_profile_attach(GstElement *pipeline, const LatencyProfile *profile) {
+    /* Profile là hằng số tĩnh, không cần giải phóng */
+    g_object_set_data(G_OBJECT(pipeline), LATENCY_PROFILE_KEY, (gpointer)profile);
+}
+
+const LatencyProfile* latency_profile_from_media(GstRTSPMedia *media) {
+    GstElement *element = gst_rtsp_media_get_element(media);
+    const LatencyProfile *profile = NULL;
+
+    if (element) {
+        profile = g_object_get_data(G_OBJECT(element), LATENCY_PROFILE_KEY);
+        gst_object_unref(element);
+    }
+    return profile;
+}
+
+void latency_profile_apply_media(GstRTSPMedia *media, const LatencyProfile *profile) {
+    gst_rtsp_media_set_latency(media, profile->media_latency_ms);
+    gst_rtsp_media_set_do_rate_control(media, profile->rate_control);
+}
@@ -0,0 +1,36 @@
+#ifndef LATENCY_PROFILE_H
+#define LATENCY_PROFILE_H
+
+#include <gst/gst.h>
+#include <gst/rtsp-server/rtsp-server.h>
+#include "client_congestion.h"
+
+#define LATENCY_PROFILE_PARAM   "profile"
+#define LATENCY_PROFILE_DEFAULT "balanced"
+
+/* Một cấu hình latency cho live pipeline */
+typedef struct {
+    const gchar *name;
+    guint jitter_latency_ms;          /* rtspsrc latency */
+    const gchar *buffer_mode;         /* rtspsrc buffer-mode (nick) */
+    gboolean drop_on_latency;
+    ClientCongestionPolicy sendq;     /* giới hạn send queue của mỗi client */
+    guint media_latency_ms;           /* gst_rtsp_media_set_latency */
+    gboolean rate_control;            /* sink sync theo clock (FALSE = gửi ngay khi có) */
+} LatencyProfile;
+
+/* Tìm profile theo tên ("ultra-low", "balanced", "smooth"), NULL nếu không có */
+const LatencyProfile* latency_profile_find(const gchar *name);
+
+/* Profile cho request: ?profile= > profile của mount > mặc định */
+const LatencyProfile* latency_profile_resolve(const gchar *query, const gchar *mount_profile);
+
+/* Phần rtspsrc của launch string: "latency=.. buffer-mode=.. drop-on-latency=.." */
+gchar* latency_profile_source_desc(const LatencyProfile *profile);
+
+/* Gắn profile vào pipeline (create_element) và áp dụng lên media (media-configure) */
+void latency_profile_attach(GstElement *pipeline, const LatencyProfile *profile);
+const LatencyProfile* latency_profile_from_media(GstRTSPMedia *media);
+void latency_profile_apply_media(GstRTSPMedia *media, const LatencyProfile *profile);
+
+#endif // LATENCY_PROFILE_H
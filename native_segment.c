@@ -0,0 +1,897 @@
+#include "native_segment.h"
+#include "io_policy.h"
+#include <glib/gstdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+#define HEADER_FIXED_SIZE  16
+#define FRAME_HEADER_SIZE  24
+#define INDEX_ENTRY_SIZE   32
+#define FOOTER_SIZE        32
+
+/* ===== Little-endian ===== */
+
+static void put_u16(guint8 *p, guint16 v) { v = GUINT16_TO_LE(v); memcpy(p, &v, 2); }
+static void put_u32(guint8 *p, guint32 v) { v = GUINT32_TO_LE(v); memcpy(p, &v, 4); }
+static void put_u64(guint8 *p, guint64 v) { v = GUINT64_TO_LE(v); memcpy(p, &v, 8); }
+
+static guint16 get_u16(const guint8 *p) { guint16 v; memcpy(&v, p, 2); return GUINT16_FROM_LE(v); }
+static guint32 get_u32(const guint8 *p) { guint32 v; memcpy(&v, p, 4); return GUINT32_FROM_LE(v); }
+static guint64 get_u64(const guint8 *p) { guint64 v; memcpy(&v, p, 8); return GUINT64_FROM_LE(v); }
+
+static gboolean write_full(int fd, const guint8 *data, gsize len) {
+    while (len > 0) {
+        gssize n = write(fd, data, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return FALSE;
+        data += n;
+        len -= n;
+    }
+    return TRUE;
+}
+
+/* writev, phần còn lại (ghi thiếu) ghi tiếp bằng write */
+static gboolean writev_full(int fd, struct iovec *iov, gint count) {
+    gsize total = 0;
+    for (gint i = 0; i < count; i++) total += iov[i].iov_len;
+
+    gssize n;
+    do {
+        n = writev(fd, iov, count);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0) return FALSE;
+    if ((gsize)n == total) return TRUE;
+
+    gsize skip = n;
+    for (gint i = 0; i < count; i++) {
+        if (skip >= iov[i].iov_len) {
+            skip -= iov[i].iov_len;
+            continue;
+        }
+        if (!write_full(fd, (const guint8 *)iov[i].iov_base + skip, iov[i].iov_len - skip)) return FALSE;
+        skip = 0;
+    }
+    return TRUE;
+}
+
+static gint64 frames_duration(GArray *frames) {
+    if (frames->len == 0) return 0;
+
+    gint64 first = g_array_index(frames, NativeFrame, 0).pts;
+    gint64 last = first;
+    for (guint i = 1; i < frames->len; i++) {
+        gint64 pts = g_array_index(frames, NativeFrame, i).pts;
+        if (pts > last) last = pts;
+    }
+    if (first < 0 || last <= first) return 0;
+
+    /* Cộng thêm thời lượng trung bình của một frame (frame cuối) */
+    return (last - first) + (last - first) / MAX(frames->len - 1, 1);
+}
+
+/* Trailer: một entry mỗi frame + footer, ghi tại offset (cuối dữ liệu frame) */
+static gboolean write_trailer(int fd, guint64 index_offset, GArray *frames) {
+    gsize len = (gsize)frames->len * INDEX_ENTRY_SIZE + FOOTER_SIZE;
+    guint8 *buf = g_malloc(len);
+    guint8 *p = buf;
+    guint32 keyframes = 0;
+
+    for (guint i = 0; i < frames->len; i++, p += INDEX_ENTRY_SIZE) {
+        const NativeFrame *frame = &g_array_index(frames, NativeFrame, i);
+        put_u64(p, (guint64)frame->pts);
+        put_u64(p + 8, (guint64)frame->dts);
+        put_u64(p + 16, frame->offset);
+        put_u32(p + 24, frame->size);
+        put_u32(p + 28, frame->flags);
+        if (frame->flags & NATIVE_FRAME_KEYFRAME) keyframes++;
+    }
+
+    put_u64(p, index_offset);
+    put_u32(p + 8, frames->len);
+    put_u32(p + 12, keyframes);
+    put_u64(p + 16, (guint64)frames_duration(frames));
+    memcpy(p + 24, NATIVE_SEGMENT_INDEX_MAGIC, 4);
+    put_u32(p + 28, 0);
+
+    gboolean ok = lseek(fd, (off_t)index_offset, SEEK_SET) == (off_t)index_offset &&
+                  write_full(fd, buf, len) &&
+                  ftruncate(fd, (off_t)(index_offset + len)) == 0;
+    g_free(buf);
+    return ok;
+}
+
+gboolean native_segment_is_native_path(const gchar *path) {
+    return path && g_str_has_suffix(path, NATIVE_SEGMENT_EXT);
+}
+
+/* ===== Writer ===== */
+
+struct _NativeSegmentWriter {
+    int fd;
+    guint64 offset;
+    GArray *frames;      /* NativeFrame */
+    gboolean failed;
+};
+
+NativeSegmentWriter* native_segment_writer_new(const gchar *path,
+                                               NativeCodec codec,
+                                               const guint8 *config,
+                                               gsize config_size,
+                                               GError **error) {
+    int fd = g_open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errno),
+                    "Could not open %s: %s", path, g_strerror(errno));
+        return NULL;
+    }
+
+    guint8 header[HEADER_FIXED_SIZE];
+    memcpy(header, NATIVE_SEGMENT_MAGIC, 4);
+    put_u16(header + 4, NATIVE_SEGMENT_VERSION);
+    put_u16(header + 6, codec);
+    put_u32(header + 8, (guint32)(HEADER_FIXED_SIZE + config_size));
+    put_u32(header + 12, (guint32)config_size);
+
+    struct iovec iov[2] = {
+        { header, HEADER_FIXED_SIZE },
+        { (void *)config, config_size }
+    };
+    if (!writev_full(fd, iov, config_size > 0 ? 2 : 1)) {
+        g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errno),
+                    "Could not write %s: %s", path, g_strerror(errno));
+        close(fd);
+        return NULL;
+    }
+
+    NativeSegmentWriter *writer = g_new0(NativeSegmentWriter, 1);
+    writer->fd = fd;
+    writer->offset = HEADER_FIXED_SIZE + config_size;
+    writer->frames = g_array_new(FALSE, FALSE, sizeof(NativeFrame));
+    return writer;
+}
+
+gboolean native_segment_writer_add(NativeSegmentWriter *writer,
+                                   const guint8 *data,
+                                   gsize size,
+                                   gint64 pts,
+                                   gint64 dts,
+                                   gboolean keyframe) {
+    if (writer->failed) return FALSE;
+
+    guint32 flags = keyframe ? NATIVE_FRAME_KEYFRAME : 0;
+    guint8 header[FRAME_HEADER_SIZE];
+    put_u32(header, (guint32)size);
+    put_u32(header + 4, flags);
+    put_u64(header + 8, (guint64)pts);
+    put_u64(header + 16, (guint64)dts);
+
+    /* Header frame + AU trong một syscall, không copy AU */
+    struct iovec iov[2] = {
+        { header, FRAME_HEADER_SIZE },
+        { (void *)data, size }
+    };
+    if (!writev_full(writer->fd, iov, 2)) {
+        writer->failed = TRUE;
+        return FALSE;
+    }
+
+    NativeFrame frame = { pts, dts, writer->offset + FRAME_HEADER_SIZE, (guint32)size, flags };
+    g_array_append_val(writer->frames, frame);
+    writer->offset += FRAME_HEADER_SIZE + size;
+    return TRUE;
+}
+
+static void writer_free(NativeSegmentWriter *writer) {
+    if (writer->fd >= 0) close(writer->fd);
+    g_array_unref(writer->frames);
+    g_free(writer);
+}
+
+gboolean native_segment_writer_finish(NativeSegmentWriter *writer) {
+    gboolean ok = !writer->failed &&
+                  write_trailer(writer->fd, writer->offset, writer->frames) &&
+                  fdatasync(writer->fd) == 0;
+    writer_free(writer);
+    return ok;
+}
+
+void native_segment_writer_abort(NativeSegmentWriter *writer) {
+    writer_free(writer);
+}
+
+/* ===== Reader (mmap) ===== */
+
+struct _NativeSegment {
+    gint ref_count;
+    guint8 *map;
+    gsize size;
+    NativeCodec codec;
+    guint32 header_size;
+    guint32 config_size;
+    GArray *frames;          /* NativeFrame */
+    guint64 data_end;        /* cuối frame hoàn chỉnh cuối cùng */
+    gboolean complete;       /* có trailer hợp lệ */
+};
+
+/* Index trong trailer; FALSE nếu không có footer hoặc footer không khớp file */
+static gboolean load_trailer(NativeSegment *segment) {
+    if (segment->size < (gsize)segment->header_size + FOOTER_SIZE) return FALSE;
+
+    const guint8 *footer = segment->map + segment->size - FOOTER_SIZE;
+    if (memcmp(footer + 24, NATIVE_SEGMENT_INDEX_MAGIC, 4) != 0) return FALSE;
+
+    guint64 index_offset = get_u64(footer);
+    guint32 count = get_u32(footer + 8);
+    if (index_offset < segment->header_size ||
+        index_offset + (guint64)count * INDEX_ENTRY_SIZE + FOOTER_SIZE != segment->size) {
+        return FALSE;
+    }
+
+    const guint8 *p = segment->map + index_offset;
+    g_array_set_size(segment->frames, 0);
+    for (guint32 i = 0; i < count; i++, p += INDEX_ENTRY_SIZE) {
+        NativeFrame frame;
+        frame.pts = (gint64)get_u64(p);
+        frame.dts = (gint64)get_u64(p + 8);
+        frame.offset = get_u64(p + 16);
+        frame.size = get_u32(p + 24);
+        frame.flags = get_u32(p + 28);
+        if (frame.offset + frame.size > index_offset) return FALSE;
+        g_array_append_val(segment->frames, frame);
+    }
+
+    segment->data_end = index_offset;
+    return TRUE;
+}
+
+/* Không có trailer: duyệt header từng frame, dừng ở frame dở dang */
+static void scan_frames(NativeSegment *segment) {
+    guint64 pos = segment->header_size;
+
+    g_array_set_size(segment->frames, 0);
+    while (pos + FRAME_HEADER_SIZE <= segment->size) {
+        const guint8 *p = segment->map + pos;
+        NativeFrame frame;
+        frame.size = get_u32(p);
+        frame.flags = get_u32(p + 4);
+        frame.pts = (gint64)get_u64(p + 8);
+        frame.dts = (gint64)get_u64(p + 16);
+        frame.offset = pos + FRAME_HEADER_SIZE;
+
+        if (frame.offset + frame.size > segment->size) break;
+        g_array_append_val(segment->frames, frame);
+        pos = frame.offset + frame.size;
+    }
+    segment->data_end = pos;
+}
+
+NativeSegment* native_segment_open(const gchar *path, GError **error) {
+    struct stat st;
+    int fd = g_open(path, O_RDONLY | O_CLOEXEC, 0);
+
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errno),
+                    "Could not open %s: %s", path, g_strerror(errno));
+        if (fd >= 0) close(fd);
+        return NULL;
+    }
+
+    if (st.st_size < HEADER_FIXED_SIZE) {
+        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "%s: file too short", path);
+        close(fd);
+        return NULL;
+    }
+
+    guint8 *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errno),
+                    "Could not map %s: %s", path, g_strerror(errno));
+        return NULL;
+    }
+
+    guint32 header_size = get_u32(map + 8);
+    guint32 config_size = get_u32(map + 12);
+    if (memcmp(map, NATIVE_SEGMENT_MAGIC, 4) != 0 ||
+        get_u16(map + 4) != NATIVE_SEGMENT_VERSION ||
+        header_size != HEADER_FIXED_SIZE + config_size ||
+        header_size > (guint64)st.st_size) {
+        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "%s: not a native segment", path);
+        munmap(map, st.st_size);
+        return NULL;
+    }
+
+    /* Playback đọc tuần tự: kernel readahead lớn hơn */
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+    NativeSegment *segment = g_new0(NativeSegment, 1);
+    segment->ref_count = 1;
+    segment->map = map;
+    segment->size = st.st_size;
+    segment->codec = (NativeCodec)get_u16(map + 6);
+    segment->header_size = header_size;
+    segment->config_size = config_size;
+    segment->frames = g_array_new(FALSE, FALSE, sizeof(NativeFrame));
+
+    segment->complete = load_trailer(segment);
+    if (!segment->complete) {
+        scan_frames(segment);
+    }
+    return segment;
+}
+
+NativeSegment* native_segment_ref(NativeSegment *segment) {
+    g_atomic_int_inc(&segment->ref_count);
+    return segment;
+}
+
+void native_segment_unref(NativeSegment *segment) {
+    if (!g_atomic_int_dec_and_test(&segment->ref_count)) return;
+    munmap(segment->map, segment->size);
+    g_array_unref(segment->frames);
+    g_free(segment);
+}
+
+NativeCodec native_segment_codec(const NativeSegment *segment) {
+    return segment->codec;
+}
+
+const guint8* native_segment_config(const NativeSegment *segment, gsize *size) {
+    *size = segment->config_size;
+    return segment->map + HEADER_FIXED_SIZE;
+}
+
+guint native_segment_frame_count(const NativeSegment *segment) {
+    return segment->frames->len;
+}
+
+const NativeFrame* native_segment_frame(const NativeSegment *segment, guint index) {
+    return index < segment->frames->len ? &g_array_index(segment->frames, NativeFrame, index) : NULL;
+}
+
+const guint8* native_segment_frame_data(const NativeSegment *segment, const NativeFrame *frame) {
+    return segment->map + frame->offset;
+}
+
+gint64 native_segment_duration(const NativeSegment *segment) {
+    return frames_duration(segment->frames);
+}
+
+guint native_segment_seek(const NativeSegment *segment, gint64 position) {
+    guint best = 0;
+
+    for (guint i = 0; i < segment->frames->len; i++) {
+        const NativeFrame *frame = &g_array_index(segment->frames, NativeFrame, i);
+        if (!(frame->flags & NATIVE_FRAME_KEYFRAME)) continue;
+        if (frame->pts > position) break;
+        best = i;
+    }
+    return best;
+}
+
+/* ===== Repair / compact ===== */
+
+gboolean native_segment_repair(const gchar *path, gint64 *duration_us) {
+    GError *error = NULL;
+    NativeSegment *segment = native_segment_open(path, &error);
+
+    if (!segment) {
+        g_printerr("[native] %s\n", error->message);
+        g_error_free(error);
+        return FALSE;
+    }
+
+    gboolean ok = segment->frames->len > 0;
+    if (ok && !segment->complete) {
+        /* Không cắt file tại chỗ: reader khác có thể đang mmap (SIGBUS khi file ngắn đi).
+         * Ghi bản sửa ra file tạm rồi rename đè, reader cũ giữ inode cũ. */
+        gchar *tmp_path = g_strdup_printf("%s.repair", path);
+        int fd = g_open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        ok = fd >= 0 &&
+             write_full(fd, segment->map, segment->data_end) &&
+             write_trailer(fd, segment->data_end, segment->frames) &&
+             fdatasync(fd) == 0;
+        if (fd >= 0) close(fd);
+        ok = ok && g_rename(tmp_path, path) == 0;
+        if (!ok) {
+            g_printerr("[native] Cannot repair %s: %s\n", path, g_strerror(errno));
+            g_unlink(tmp_path);
+        }
+        g_free(tmp_path);
+    }
+
+    if (duration_us) *duration_us = native_segment_duration(segment) / GST_USECOND;
+    native_segment_unref(segment);
+    return ok;
+}
+
+gboolean native_segment_compact(const gchar *path, const gchar *out_path) {
+    NativeSegment *segment = native_segment_open(path, NULL);
+    if (!segment) return FALSE;
+
+    gsize config_size;
+    const guint8 *config = native_segment_config(segment, &config_size);
+    NativeSegmentWriter *writer = native_segment_writer_new(out_path, segment->codec,
+                                                            config, config_size, NULL);
+    guint kept = 0;
+    gboolean ok = writer != NULL;
+
+    for (guint i = 0; ok && i < segment->frames->len; i++) {
+        const NativeFrame *frame = &g_array_index(segment->frames, NativeFrame, i);
+        if (!(frame->flags & NATIVE_FRAME_KEYFRAME)) continue;
+        ok = native_segment_writer_add(writer, segment->map + frame->offset, frame->size,
+                                       frame->pts, frame->dts, TRUE);
+        kept++;
+    }
+
+    if (writer) {
+        ok = native_segment_writer_finish(writer) && ok;
+    }
+    native_segment_unref(segment);
+    return ok && kept > 0;
+}
+
+/* ===== Codec config ===== */
+
+/* NAL tiếp theo bắt đầu từ pos: trả về vị trí byte đầu của NAL, *end = cuối NAL */
+static gssize next_nal(const guint8 *data, gsize size, gsize pos, gsize *end) {
+    gsize start = G_MAXSIZE;
+
+    for (gsize i = pos; i + 3 <= size; i++) {
+        if (data[i] == 0 && data[i + 1] == 0 && data[i + 2] == 1) {
+            start = i + 3;
+            break;
+        }
+    }
+    if (start == G_MAXSIZE) return -1;
+
+    gsize i = start;
+    for (; i + 3 <= size; i++) {
+        if (data[i] == 0 && data[i + 1] == 0 && (data[i + 2] == 1 || data[i + 2] == 0)) break;
+    }
+    *end = i + 3 <= size ? i : size;
+    return (gssize)start;
+}
+
+GBytes* native_segment_extract_config(NativeCodec codec, const guint8 *data, gsize size) {
+    static const guint8 start_code[4] = { 0, 0, 0, 1 };
+    GByteArray *config = g_byte_array_new();
+    gsize pos = 0;
+    gsize end = 0;
+    gssize nal;
+
+    while ((nal = next_nal(data, size, pos, &end)) >= 0) {
+        if ((gsize)nal < end) {
+            guint type = codec == NATIVE_CODEC_H265 ? (data[nal] >> 1) & 0x3f : data[nal] & 0x1f;
+            gboolean param_set = codec == NATIVE_CODEC_H265 ? (type >= 32 && type <= 34)
+                                                            : (type == 7 || type == 8);
+            if (param_set) {
+                g_byte_array_append(config, start_code, sizeof(start_code));
+                g_byte_array_append(config, data + nal, (guint)(end - nal));
+            }
+        }
+        pos = end;
+    }
+
+    if (config->len == 0) {
+        g_byte_array_unref(config);
+        return NULL;
+    }
+    return g_byte_array_free_to_bytes(config);
+}
+
+/* ===== Caps ===== */
+
+#define NATIVE_SEGMENT_CAPS \
+    "video/x-h264, stream-format = (string) byte-stream, alignment = (string) au; " \
+    "video/x-h265, stream-format = (string) byte-stream, alignment = (string) au"
+
+static GstCaps* codec_caps(NativeCodec codec) {
+    return gst_caps_new_simple(codec == NATIVE_CODEC_H265 ? "video/x-h265" : "video/x-h264",
+                               "stream-format", G_TYPE_STRING, "byte-stream",
+                               "alignment", G_TYPE_STRING, "au",
+                               NULL);
+}
+
+/* ===== nativesegmentsrc ===== */
+
+struct _NativeSegmentSrc {
+    GstBaseSrc parent;
+    gchar *location;
+    gchar *next_location;   /* segment tiếp theo trong chuỗi playback, để prefetch */
+    gboolean prefetched;
+    NativeSegment *segment;
+    guint next_frame;
+    gboolean discont;
+};
+
+G_DEFINE_TYPE(NativeSegmentSrc, native_segment_src, GST_TYPE_BASE_SRC)
+
+enum {
+    PROP_0,
+    PROP_LOCATION,
+    PROP_NEXT_LOCATION
+};
+
+static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE(
+    "src", GST_PAD_SRC, GST_PAD_ALWAYS, GST_STATIC_CAPS(NATIVE_SEGMENT_CAPS));
+
+static void native_segment_src_set_property(GObject *object, guint prop_id,
+                                            const GValue *value, GParamSpec *pspec) {
+    NativeSegmentSrc *src = NATIVE_SEGMENT_SRC(object);
+
+    switch (prop_id) {
+        case PROP_LOCATION:
+            g_free(src->location);
+            src->location = g_value_dup_string(value);
+            break;
+        case PROP_NEXT_LOCATION:
+            g_free(src->next_location);
+            src->next_location = g_value_dup_string(value);
+            break;
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+            break;
+    }
+}
+
+static void native_segment_src_get_property(GObject *object, guint prop_id,
+                                            GValue *value, GParamSpec *pspec) {
+    NativeSegmentSrc *src = NATIVE_SEGMENT_SRC(object);
+
+    switch (prop_id) {
+        case PROP_LOCATION:
+            g_value_set_string(value, src->location);
+            break;
+        case PROP_NEXT_LOCATION:
+            g_value_set_string(value, src->next_location);
+            break;
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+            break;
+    }
+}
+
+static gboolean native_segment_src_start(GstBaseSrc *base) {
+    NativeSegmentSrc *src = NATIVE_SEGMENT_SRC(base);
+    GError *error = NULL;
+
+    if (!src->location) {
+        GST_ELEMENT_ERROR(src, RESOURCE, NOT_FOUND, ("No location set"), (NULL));
+        return FALSE;
+    }
+
+    src->segment = native_segment_open(src->location, &error);
+    if (!src->segment) {
+        GST_ELEMENT_ERROR(src, RESOURCE, OPEN_READ, ("%s", error->message), (NULL));
+        g_error_free(error);
+        return FALSE;
+    }
+
+    src->next_frame = 0;
+    src->prefetched = FALSE;
+    src->discont = TRUE;
+    return TRUE;
+}
+
+static gboolean native_segment_src_stop(GstBaseSrc *base) {
+    NativeSegmentSrc *src = NATIVE_SEGMENT_SRC(base);
+
+    /* Buffer còn nằm ở downstream giữ ref riêng, vùng map chỉ unmap khi chúng được trả */
+    g_clear_pointer(&src->segment, native_segment_unref);
+    return TRUE;
+}
+
+static GstCaps* native_segment_src_get_caps(GstBaseSrc *base, GstCaps *filter) {
+    NativeSegmentSrc *src = NATIVE_SEGMENT_SRC(base);
+    GstCaps *caps = src->segment ? codec_caps(src->segment->codec)
+                                 : gst_pad_get_pad_template_caps(GST_BASE_SRC_PAD(base));
+
+    if (filter) {
+        GstCaps *intersection = gst_caps_intersect_full(filter, caps, GST_CAPS_INTERSECT_FIRST);
+        gst_caps_unref(caps);
+        caps = intersection;
+    }
+    return caps;
+}
+
+static gboolean native_segment_src_is_seekable(GstBaseSrc *base) {
+    return TRUE;
+}
+
+/* Seek theo TIME: bắt đầu từ keyframe trước vị trí; segment giữ start chính xác để
+ * downstream bỏ phần trước đó (như matroskademux với ACCURATE) */
+static gboolean native_segment_src_do_seek(GstBaseSrc *base, GstSegment *segment) {
+    NativeSegmentSrc *src = NATIVE_SEGMENT_SRC(base);
+
+    if (!src->segment) return FALSE;
+
+    src->next_frame = native_segment_seek(src->segment, (gint64)segment->start);
+    src->discont = TRUE;
+    segment->time = segment->start;
+    return TRUE;
+}
+
+static gboolean native_segment_src_query(GstBaseSrc *base, GstQuery *query) {
+    NativeSegmentSrc *src = NATIVE_SEGMENT_SRC(base);
+
+    if (GST_QUERY_TYPE(query) == GST_QUERY_DURATION && src->segment) {
+        GstFormat format;
+        gst_query_parse_duration(query, &format, NULL);
+        if (format == GST_FORMAT_TIME) {
+            const NativeFrame *first = native_segment_frame(src->segment, 0);
+            gint64 duration = native_segment_duration(src->segment);
+            gst_query_set_duration(query, GST_FORMAT_TIME,
+                                   first && first->pts > 0 ? first->pts + duration : duration);
+            return TRUE;
+        }
+    }
+
+    return GST_BASE_SRC_CLASS(native_segment_src_parent_class)->query(base, query);
+}
+
+static GstFlowReturn native_segment_src_create(GstBaseSrc *base, guint64 offset,
+                                               guint length, GstBuffer **out) {
+    NativeSegmentSrc *src = NATIVE_SEGMENT_SRC(base);
+    NativeSegment *segment = src->segment;
+    guint count = native_segment_frame_count(segment);
+
+    if (src->next_frame >= count) return GST_FLOW_EOS;
+
+    const NativeFrame *frame = native_segment_frame(segment, src->next_frame);
+
+    GST_OBJECT_LOCK(src);
+    guint64 stop = base->segment.stop;
+    GST_OBJECT_UNLOCK(src);
+    if (GST_CLOCK_TIME_IS_VALID(stop) && frame->pts >= 0 && (guint64)frame->pts >= stop) {
+        return GST_FLOW_EOS;
+    }
+
+    if (!src->prefetched && src->next_location && src->next_location[0] &&
+        (guint64)src->next_frame * 100 >= (guint64)count * IO_POLICY_PREFETCH_AT_PERCENT) {
+        src->prefetched = TRUE;
+        io_policy_prefetch_async(src->next_location);
+    }
+
+    /* Buffer trỏ vào vùng map, giữ ref tới segment thay vì copy dữ liệu */
+    GstBuffer *buf = gst_buffer_new_wrapped_full(GST_MEMORY_FLAG_READONLY,
+                                                 (gpointer)native_segment_frame_data(segment, frame),
+                                                 frame->size, 0, frame->size,
+                                                 native_segment_ref(segment),
+                                                 (GDestroyNotify)native_segment_unref);
+
+    GST_BUFFER_PTS(buf) = frame->pts >= 0 ? (GstClockTime)frame->pts : GST_CLOCK_TIME_NONE;
+    GST_BUFFER_DTS(buf) = frame->dts >= 0 ? (GstClockTime)frame->dts : GST_CLOCK_TIME_NONE;
+    GST_BUFFER_OFFSET(buf) = src->next_frame;
+    if (!(frame->flags & NATIVE_FRAME_KEYFRAME)) {
+        GST_BUFFER_FLAG_SET(buf, GST_BUFFER_FLAG_DELTA_UNIT);
+    }
+    if (src->discont) {
+        GST_BUFFER_FLAG_SET(buf, GST_BUFFER_FLAG_DISCONT);
+        src->discont = FALSE;
+    }
+
+    src->next_frame++;
+    *out = buf;
+    return GST_FLOW_OK;
+}
+
+static void native_segment_src_finalize(GObject *object) {
+    NativeSegmentSrc *src = NATIVE_SEGMENT_SRC(object);
+    g_free(src->location);
+    g_free(src->next_location);
+    g_clear_pointer(&src->segment, native_segment_unref);
+    G_OBJECT_CLASS(native_segment_src_parent_class)->finalize(object);
+}
+
+static void native_segment_src_class_init(NativeSegmentSrcClass *klass) {
+    GObjectClass *object_class = G_OBJECT_CLASS(klass);
+    GstElementClass *element_class = GST_ELEMENT_CLASS(klass);
+    GstBaseSrcClass *base_class = GST_BASE_SRC_CLASS(klass);
+
+    object_class->set_property = native_segment_src_set_property;
+    object_class->get_property = native_segment_src_get_property;
+    object_class->finalize = native_segment_src_finalize;
+
+    g_object_class_install_property(object_class, PROP_LOCATION,
+        g_param_spec_string("location", "Location", "Native segment file to read", NULL,
+                            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+    g_object_class_install_property(object_class, PROP_NEXT_LOCATION,
+        g_param_spec_string("next-location", "Next location",
+                            "Next segment in the playback chain, prefetched while reading", NULL,
+                            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+    gst_element_class_add_static_pad_template(element_class, &src_template);
+    gst_element_class_set_static_metadata(element_class,
+        "Native segment source", "Source/File",
+        "Pushes access units straight from a memory-mapped native segment", "RTSP Recorder");
+
+    base_class->start = native_segment_src_start;
+    base_class->stop = native_segment_src_stop;
+    base_class->get_caps = native_segment_src_get_caps;
+    base_class->is_seekable = native_segment_src_is_seekable;
+    base_class->do_seek = native_segment_src_do_seek;
+    base_class->query = native_segment_src_query;
+    base_class->create = native_segment_src_create;
+}
+
+static void native_segment_src_init(NativeSegmentSrc *src) {
+    gst_base_src_set_format(GST_BASE_SRC(src), GST_FORMAT_TIME);
+}
+
+/* ===== nativesegmentsink ===== */
+
+struct _NativeSegmentSink {
+    GstBaseSink parent;
+    gchar *location;
+    NativeCodec codec;
+    NativeSegmentWriter *writer;
+};
+
+G_DEFINE_TYPE(NativeSegmentSink, native_segment_sink, GST_TYPE_BASE_SINK)
+
+enum {
+    SINK_PROP_0,
+    SINK_PROP_LOCATION
+};
+
+static GstStaticPadTemplate sink_template = GST_STATIC_PAD_TEMPLATE(
+    "sink", GST_PAD_SINK, GST_PAD_ALWAYS, GST_STATIC_CAPS(NATIVE_SEGMENT_CAPS));
+
+static void native_segment_sink_set_property(GObject *object, guint prop_id,
+                                             const GValue *value, GParamSpec *pspec) {
+    NativeSegmentSink *sink = NATIVE_SEGMENT_SINK(object);
+
+    switch (prop_id) {
+        case SINK_PROP_LOCATION:
+            g_free(sink->location);
+            sink->location = g_value_dup_string(value);
+            break;
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+            break;
+    }
+}
+
+static void native_segment_sink_get_property(GObject *object, guint prop_id,
+                                             GValue *value, GParamSpec *pspec) {
+    NativeSegmentSink *sink = NATIVE_SEGMENT_SINK(object);
+
+    switch (prop_id) {
+        case SINK_PROP_LOCATION:
+            g_value_set_string(value, sink->location);
+            break;
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+            break;
+    }
+}
+
+static gboolean native_segment_sink_set_caps(GstBaseSink *base, GstCaps *caps) {
+    NativeSegmentSink *sink = NATIVE_SEGMENT_SINK(base);
+    const gchar *name = gst_structure_get_name(gst_caps_get_structure(caps, 0));
+
+    sink->codec = g_str_equal(name, "video/x-h265") ? NATIVE_CODEC_H265 : NATIVE_CODEC_H264;
+    return TRUE;
+}
+
+static gint64 to_running_time(GstBaseSink *base, GstClockTime ts) {
+    if (!GST_CLOCK_TIME_IS_VALID(ts)) return -1;
+    GstClockTime running = gst_segment_to_running_time(&base->segment, GST_FORMAT_TIME, ts);
+    return GST_CLOCK_TIME_IS_VALID(running) ? (gint64)running : -1;
+}
+
+static GstFlowReturn native_segment_sink_render(GstBaseSink *base, GstBuffer *buf) {
+    NativeSegmentSink *sink = NATIVE_SEGMENT_SINK(base);
+    gboolean keyframe = !GST_BUFFER_FLAG_IS_SET(buf, GST_BUFFER_FLAG_DELTA_UNIT);
+    GstMapInfo map;
+
+    /* File bắt đầu ở keyframe đầu tiên (frame trước đó không giải mã được) */
+    if (!sink->writer && !keyframe) return GST_FLOW_OK;
+
+    if (!gst_buffer_map(buf, &map, GST_MAP_READ)) return GST_FLOW_ERROR;
+
+    if (!sink->writer) {
+        GError *error = NULL;
+        GBytes *config = native_segment_extract_config(sink->codec, map.data, map.size);
+        gsize config_size = 0;
+        const guint8 *config_data = config ? g_bytes_get_data(config, &config_size) : NULL;
+
+        sink->writer = native_segment_writer_new(sink->location, sink->codec,
+                                                 config_data, config_size, &error);
+        if (config) g_bytes_unref(config);
+        if (!sink->writer) {
+            gst_buffer_unmap(buf, &map);
+            GST_ELEMENT_ERROR(sink, RESOURCE, OPEN_WRITE, ("%s", error->message), (NULL));
+            g_error_free(error);
+            return GST_FLOW_ERROR;
+        }
+    }
+
+    gint64 pts = to_running_time(base, GST_BUFFER_PTS(buf));
+    gint64 dts = to_running_time(base, GST_BUFFER_DTS(buf));
+    gboolean ok = native_segment_writer_add(sink->writer, map.data, map.size,
+                                            pts >= 0 ? pts : dts, dts, keyframe);
+    gst_buffer_unmap(buf, &map);
+
+    if (!ok) {
+        GST_ELEMENT_ERROR(sink, RESOURCE, WRITE, ("Error writing %s", sink->location), GST_ERROR_SYSTEM);
+        return GST_FLOW_ERROR;
+    }
+    return GST_FLOW_OK;
+}
+
+/* EOS: ghi trailer trước khi basesink post EOS (recording chờ EOS mới coi segment hoàn tất) */
+static gboolean native_segment_sink_event(GstBaseSink *base, GstEvent *event) {
+    NativeSegmentSink *sink = NATIVE_SEGMENT_SINK(base);
+
+    if (GST_EVENT_TYPE(event) == GST_EVENT_EOS && sink->writer) {
+        NativeSegmentWriter *writer = sink->writer;
+        sink->writer = NULL;
+        if (!native_segment_writer_finish(writer)) {
+            GST_ELEMENT_ERROR(sink, RESOURCE, WRITE,
+                              ("Error finishing %s", sink->location), GST_ERROR_SYSTEM);
+            gst_event_unref(event);
+            return FALSE;
+        }
+    }
+
+    return GST_BASE_SINK_CLASS(native_segment_sink_parent_class)->event(base, event);
+}
+
+static gboolean native_segment_sink_stop(GstBaseSink *base) {
+    NativeSegmentSink *sink = NATIVE_SEGMENT_SINK(base);
+
+    /* Dừng không qua EOS: file không có trailer, recovery sẽ sửa */
+    if (sink->writer) {
+        native_segment_writer_abort(sink->writer);
+        sink->writer = NULL;
+    }
+    return TRUE;
+}
+
+static void native_segment_sink_finalize(GObject *object) {
+    NativeSegmentSink *sink = NATIVE_SEGMENT_SINK(object);
+    if (sink->writer) native_segment_writer_abort(sink->writer);
+    g_free(sink->location);
+    G_OBJECT_CLASS(native_segment_sink_parent_class)->finalize(object);
+}
+
+static void native_segment_sink_class_init(NativeSegmentSinkClass *klass) {
+    GObjectClass *object_class = G_OBJECT_CLASS(klass);
+    GstElementClass *element_class = GST_ELEMENT_CLASS(klass);
+    GstBaseSinkClass *base_class = GST_BASE_SINK_CLASS(klass);
+
+    object_class->set_property = native_segment_sink_set_property;
+    object_class->get_property = native_segment_sink_get_property;
+    object_class->finalize = native_segment_sink_finalize;
+
+    g_object_class_install_property(object_class, SINK_PROP_LOCATION,
+        g_param_spec_string("location", "Location", "Native segment file to write", NULL,
+                            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+    gst_element_class_add_static_pad_template(element_class, &sink_template);
+    gst_element_class_set_static_metadata(element_class,
+        "Native segment sink", "Sink/File",
+        "Writes length-prefixed access units with a trailing frame index", "RTSP Recorder");
+
+    base_class->set_caps = native_segment_sink_set_caps;
+    base_class->render = native_segment_sink_render;
+    base_class->event = native_segment_sink_event;
+    base_class->stop = native_segment_sink_stop;
+}
+
+static void native_segment_sink_init(NativeSegmentSink *sink) {
+    gst_base_sink_set_sync(GST_BASE_SINK(sink), FALSE);
+    gst_base_sink_set_async_enabled(GST_BASE_SINK(sink), FALSE);
+}
+
+gboolean native_segment_init(void) {
+    return gst_element_register(NULL, NATIVE_SEGMENT_SRC_NAME, GST_RANK_NONE, TYPE_NATIVE_SEGMENT_SRC) &&
+           gst_element_register(NULL, NATIVE_SEGMENT_SINK_NAME, GST_RANK_NONE, TYPE_NATIVE_SEGMENT_SINK);
+}
@@ -0,0 +1,100 @@
+#ifndef NATIVE_SEGMENT_H
+#define NATIVE_SEGMENT_H
+
+#include <gst/gst.h>
+#include <gst/base/gstbasesrc.h>
+#include <gst/base/gstbasesink.h>
+
+/* Định dạng segment riêng (thay cho Matroska khi bật):
+ *   header:  "NSEG" | version u16 | codec u16 | header_size u32 | config_size u32 | codec config
+ *   frame:   size u32 | flags u32 | pts i64 | dts i64 | access unit Annex-B
+ *   trailer: entry {pts i64, dts i64, offset u64, size u32, flags u32} cho mỗi frame
+ *   footer:  index_offset u64 | frame_count u32 | keyframe_count u32 | duration i64 | "NIDX" u32 | 0 u32
+ * Số little-endian; pts/dts là running time lúc ghi (cùng thang với SegmentClock), -1 nếu không có.
+ * File không có footer (crash) vẫn đọc được bằng cách duyệt các frame. */
+#define NATIVE_SEGMENT_EXT          ".nseg"
+#define NATIVE_SEGMENT_MAGIC        "NSEG"
+#define NATIVE_SEGMENT_INDEX_MAGIC  "NIDX"
+#define NATIVE_SEGMENT_VERSION      1
+
+#define NATIVE_SEGMENT_SRC_NAME  "nativesegmentsrc"
+#define NATIVE_SEGMENT_SINK_NAME "nativesegmentsink"
+
+typedef enum {
+    NATIVE_CODEC_H264 = 0,
+    NATIVE_CODEC_H265 = 1
+} NativeCodec;
+
+#define NATIVE_FRAME_KEYFRAME (1 << 0)
+
+/* Một access unit trong file đã mmap */
+typedef struct {
+    gint64 pts;
+    gint64 dts;
+    guint64 offset;     /* vị trí dữ liệu AU (sau header frame) */
+    guint32 size;
+    guint32 flags;
+} NativeFrame;
+
+/* File segment đã mmap (refcounted: buffer playback giữ ref tới khi downstream trả lại) */
+typedef struct _NativeSegment NativeSegment;
+
+NativeSegment* native_segment_open(const gchar *path, GError **error);
+NativeSegment* native_segment_ref(NativeSegment *segment);
+void native_segment_unref(NativeSegment *segment);
+
+NativeCodec native_segment_codec(const NativeSegment *segment);
+const guint8* native_segment_config(const NativeSegment *segment, gsize *size);
+guint native_segment_frame_count(const NativeSegment *segment);
+const NativeFrame* native_segment_frame(const NativeSegment *segment, guint index);
+const guint8* native_segment_frame_data(const NativeSegment *segment, const NativeFrame *frame);
+gint64 native_segment_duration(const NativeSegment *segment);
+
+/* Keyframe cuối cùng có pts <= position (frame đầu nếu position trước mọi keyframe) */
+guint native_segment_seek(const NativeSegment *segment, gint64 position);
+
+/* Ghi segment (dùng bởi nativesegmentsink, compactor, converter) */
+typedef struct _NativeSegmentWriter NativeSegmentWriter;
+
+NativeSegmentWriter* native_segment_writer_new(const gchar *path,
+                                               NativeCodec codec,
+                                               const guint8 *config,
+                                               gsize config_size,
+                                               GError **error);
+gboolean native_segment_writer_add(NativeSegmentWriter *writer,
+                                   const guint8 *data,
+                                   gsize size,
+                                   gint64 pts,
+                                   gint64 dts,
+                                   gboolean keyframe);
+/* Ghi trailer + footer và fdatasync; FALSE nếu có lỗi ghi ở bất kỳ đâu */
+gboolean native_segment_writer_finish(NativeSegmentWriter *writer);
+/* Đóng không ghi trailer (pipeline dừng không có EOS - để recovery sửa) */
+void native_segment_writer_abort(NativeSegmentWriter *writer);
+
+/* Segment bị ngắt giữa chừng: bỏ frame dở cuối file và ghi lại trailer (qua file tạm
+ * <path>.repair rồi rename, không đụng file reader đang mmap).
+ * duration_us nhận thời lượng của các frame còn lại. */
+gboolean native_segment_repair(const gchar *path, gint64 *duration_us);
+
+/* Viết lại segment chỉ giữ keyframe (compactor) */
+gboolean native_segment_compact(const gchar *path, const gchar *out_path);
+
+/* Parameter set (SPS/PPS, VPS) trong access unit Annex-B, NULL nếu không có */
+GBytes* native_segment_extract_config(NativeCodec codec, const guint8 *data, gsize size);
+
+/* nativesegmentsrc: mmap file, đẩy buffer trỏ thẳng vào vùng map (không copy), seek theo TIME */
+#define TYPE_NATIVE_SEGMENT_SRC (native_segment_src_get_type())
+G_DECLARE_FINAL_TYPE(NativeSegmentSrc, native_segment_src, NATIVE, SEGMENT_SRC, GstBaseSrc)
+
+/* nativesegmentsink: nhận H.264/H.265 byte-stream/au từ parser, ghi định dạng trên */
+#define TYPE_NATIVE_SEGMENT_SINK (native_segment_sink_get_type())
+G_DECLARE_FINAL_TYPE(NativeSegmentSink, native_segment_sink, NATIVE, SEGMENT_SINK, GstBaseSink)
+
+/* Đăng ký hai element (gọi sau gst_init) */
+gboolean native_segment_init(void);
+
+/* Path là segment định dạng riêng (theo phần mở rộng)? */
+gboolean native_segment_is_native_path(const gchar *path);
+
+#endif // NATIVE_SEGMENT_H
@@ -3,9 +3,11 @@
 #include <dirent.h>
 #include <string.h>
 #include "recording_manager.h"
+#include "segment_index.h"
+#include "storage_tiers.h"
 
 /* Recursive search for a recording file that contains the given timestamp and camera name
- * We search under RECORD_BASE_PATH (used by recording_manager) for any file that contains
+ * We search under the primary storage tier root (used by recording_manager) for any file that contains
  * the timestamp string in its filename and belongs to the camera directory.
  */
 static gchar* search_recordings_recursive(const gchar *dirpath,
@@ -49,8 +51,30 @@ gchar* find_recording_file(const gchar *camera_name,
     gchar tbuf[64];
     g_snprintf(tbuf, sizeof(tbuf), "%ld", (long)timestamp);
 
-    /* Search under RECORD_BASE_PATH */
-    return search_recordings_recursive(RECORD_BASE_PATH, camera_name, tbuf);
+    /* Search under the primary tier (RECORD_BASE_PATH when no tiers are configured) */
+    return search_recordings_recursive(storage_tiers_primary_root(), camera_name, tbuf);
+}
+
+/* Files covering [start_time, end_time) (unix seconds), resolved through the segment
+ * index instead of walking the recordings tree. Returned paths are sorted by start time.
+ */
+GList* find_recording_files_range(const gchar *camera_name,
+                                  gint64 start_time,
+                                  gint64 end_time,
+                                  gint stream_type) {
+    GList *files = NULL;
+    GPtrArray *records = segment_index_query(camera_name, (StreamType)stream_type,
+                                             start_time * G_USEC_PER_SEC,
+                                             end_time * G_USEC_PER_SEC);
+
+    for (guint i = 0; i < records->len; i++) {
+        SegmentRecord *record = g_ptr_array_index(records, i);
+        if (record->end_us <= start_time * G_USEC_PER_SEC) continue;
+        files = g_list_prepend(files, g_strdup(record->path));
+    }
+
+    g_ptr_array_unref(records);
+    return g_list_reverse(files);
 }
 
 /* Create a GstRTSPMediaFactory that serves the file at file_path.
@@ -0,0 +1,1028 @@
+#define _GNU_SOURCE   /* dladdr, SIGEV_THREAD_ID */
+#include "profiling.h"
+#include "http_control.h"
+#include <json-glib/json-glib.h>
+#include <glib/gstdio.h>
+#include <dirent.h>
+#include <dlfcn.h>
+#include <errno.h>
+#include <execinfo.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PROFILING_SIGNAL        SIGPROF
+#define PROFILING_ENTER_MARKS   16
+#define PROFILING_RESCAN_MS     200
+
+static gchar *profile_root = NULL;
+static gchar *last_bundle = NULL;
+
+/* ===== Pipeline được theo dõi (chỉ ghi nhận khi tạo, không chạm luồng dữ liệu) ===== */
+
+typedef struct {
+    GWeakRef pipeline;
+    const gchar *label;     /* interned */
+    gint64 tracked_us;
+} TrackedPipeline;
+
+static GMutex tracked_lock;
+static GPtrArray *tracked = NULL;   /* TrackedPipeline* */
+
+static void tracked_pipeline_free(gpointer data) {
+    TrackedPipeline *tp = data;
+    g_weak_ref_clear(&tp->pipeline);
+    g_free(tp);
+}
+
+/* ===== Thống kê trong cửa sổ ===== */
+
+/* Refcounted: mỗi probe giữ một ref, giải phóng khi probe cuối được gỡ */
+typedef struct {
+    gint refs;
+    const gchar *pipeline;  /* interned: so sánh con trỏ được */
+    gchar *element;
+    gchar *factory;
+    GMutex lock;
+    guint64 buffers;
+    guint64 total_ns;
+    guint64 max_ns;
+    guint64 late_buffers;   /* sink: độ trễ running time so với clock */
+    gint64 late_total_ns;
+    gint64 late_max_ns;
+} ElementStats;
+
+typedef struct {
+    GstElement *queue;
+    const gchar *pipeline;
+    guint samples;
+    guint64 sum_buffers, sum_bytes, sum_time;
+    guint max_buffers, max_bytes;
+    guint64 max_time;
+} QueueStats;
+
+typedef struct {
+    GstPad *pad;
+    gulong id;
+} ProbeRef;
+
+typedef struct {
+    gchar *dir;
+    guint seconds;
+    gint64 start_us;
+    GPtrArray *probes;          /* ProbeRef* */
+    GPtrArray *elements;        /* ElementStats* */
+    GPtrArray *queues;          /* QueueStats* */
+    GHashTable *instrumented;   /* GstElement* đã gắn probe */
+    GHashTable *cpu_start;      /* tid -> ThreadCpu* */
+    guint poll_id;
+} ProfileWindow;
+
+static GMutex window_lock;
+static ProfileWindow *window = NULL;
+static gint generation = 0;
+
+/* Streaming thread -> pipeline, ghi từ probe */
+static GMutex thread_map_lock;
+static GHashTable *thread_pipeline = NULL;  /* tid -> const gchar* (interned) */
+
+static ElementStats* element_stats_ref(ElementStats *stats) {
+    g_atomic_int_inc(&stats->refs);
+    return stats;
+}
+
+static void element_stats_unref(gpointer data) {
+    ElementStats *stats = data;
+    if (!g_atomic_int_dec_and_test(&stats->refs)) return;
+    g_free(stats->element);
+    g_free(stats->factory);
+    g_mutex_clear(&stats->lock);
+    g_free(stats);
+}
+
+static void queue_stats_free(gpointer data) {
+    QueueStats *q = data;
+    gst_object_unref(q->queue);
+    g_free(q);
+}
+
+static void probe_ref_free(gpointer data) {
+    ProbeRef *ref = data;
+    gst_pad_remove_probe(ref->pad, ref->id);
+    gst_object_unref(ref->pad);
+    g_free(ref);
+}
+
+/* ===== Probe (chỉ tồn tại trong cửa sổ) ===== */
+
+/* Thời điểm buffer vào element trên thread hiện tại, theo kiểu proctime tracer */
+typedef struct {
+    ElementStats *stats;
+    guint64 t;
+} EnterMark;
+
+typedef struct {
+    gint generation;
+    guint n;
+    EnterMark marks[PROFILING_ENTER_MARKS];
+    const gchar *last_pipeline;
+} ThreadMarks;
+
+static GPrivate thread_marks_key = G_PRIVATE_INIT(g_free);
+
+static pid_t current_tid(void) {
+    return (pid_t)syscall(SYS_gettid);
+}
+
+static ThreadMarks* current_marks(void) {
+    ThreadMarks *marks = g_private_get(&thread_marks_key);
+    if (!marks) {
+        marks = g_new0(ThreadMarks, 1);
+        g_private_set(&thread_marks_key, marks);
+    }
+    gint gen = g_atomic_int_get(&generation);
+    if (marks->generation != gen) {
+        marks->generation = gen;
+        marks->n = 0;
+        marks->last_pipeline = NULL;
+    }
+    return marks;
+}
+
+static void note_thread(ThreadMarks *marks, const gchar *pipeline) {
+    if (marks->last_pipeline == pipeline) return;
+    marks->last_pipeline = pipeline;
+
+    g_mutex_lock(&thread_map_lock);
+    if (thread_pipeline) {
+        g_hash_table_replace(thread_pipeline, GINT_TO_POINTER(current_tid()), (gpointer)pipeline);
+    }
+    g_mutex_unlock(&thread_map_lock);
+}
+
+static GstPadProbeReturn enter_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    ElementStats *stats = user_data;
+    ThreadMarks *marks = current_marks();
+    guint64 now = gst_util_get_timestamp();
+
+    note_thread(marks, stats->pipeline);
+    for (guint i = 0; i < marks->n; i++) {
+        if (marks->marks[i].stats == stats) {
+            marks->marks[i].t = now;
+            return GST_PAD_PROBE_OK;
+        }
+    }
+    /* Đầy: bỏ mark cũ nhất (element nhận mà không đẩy ra trên thread này) */
+    if (marks->n == PROFILING_ENTER_MARKS) {
+        memmove(&marks->marks[0], &marks->marks[1], sizeof(EnterMark) * (PROFILING_ENTER_MARKS - 1));
+        marks->n--;
+    }
+    marks->marks[marks->n].stats = stats;
+    marks->marks[marks->n].t = now;
+    marks->n++;
+    return GST_PAD_PROBE_OK;
+}
+
+/* Buffer ra khỏi element trên cùng thread: thời gian xử lý = ra - vào.
+ * Element có thread riêng (queue) không khớp mark nên không được tính */
+static GstPadProbeReturn exit_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    ElementStats *stats = user_data;
+    ThreadMarks *marks = current_marks();
+
+    for (guint i = marks->n; i-- > 0;) {
+        if (marks->marks[i].stats != stats) continue;
+
+        guint64 elapsed = gst_util_get_timestamp() - marks->marks[i].t;
+        marks->marks[i] = marks->marks[--marks->n];
+
+        g_mutex_lock(&stats->lock);
+        stats->buffers++;
+        stats->total_ns += elapsed;
+        if (elapsed > stats->max_ns) stats->max_ns = elapsed;
+        g_mutex_unlock(&stats->lock);
+        break;
+    }
+    return GST_PAD_PROBE_OK;
+}
+
+/* Sink: buffer tới muộn bao nhiêu so với clock pipeline (latency end-to-end của live) */
+static GstPadProbeReturn sink_latency_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    ElementStats *stats = user_data;
+    GstBuffer *buffer = NULL;
+
+    note_thread(current_marks(), stats->pipeline);
+
+    if (info->type & GST_PAD_PROBE_TYPE_BUFFER) {
+        buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    } else if (info->type & GST_PAD_PROBE_TYPE_BUFFER_LIST) {
+        GstBufferList *list = GST_PAD_PROBE_INFO_BUFFER_LIST(info);
+        buffer = gst_buffer_list_length(list) > 0 ? gst_buffer_list_get(list, 0) : NULL;
+    }
+    if (!buffer || !GST_BUFFER_PTS_IS_VALID(buffer)) return GST_PAD_PROBE_OK;
+
+    GstElement *element = GST_ELEMENT(GST_PAD_PARENT(pad));
+    GstClock *clock = element ? gst_element_get_clock(element) : NULL;
+    if (!clock) return GST_PAD_PROBE_OK;
+
+    GstEvent *event = gst_pad_get_sticky_event(pad, GST_EVENT_SEGMENT, 0);
+    if (event) {
+        const GstSegment *segment = NULL;
+        gst_event_parse_segment(event, &segment);
+        guint64 running = gst_segment_to_running_time(segment, GST_FORMAT_TIME, GST_BUFFER_PTS(buffer));
+        if (GST_CLOCK_TIME_IS_VALID(running)) {
+            gint64 now = (gint64)(gst_clock_get_time(clock) - gst_element_get_base_time(element));
+            gint64 late = now - (gint64)running;
+
+            g_mutex_lock(&stats->lock);
+            stats->late_buffers++;
+            stats->late_total_ns += late;
+            if (stats->late_buffers == 1 || late > stats->late_max_ns) stats->late_max_ns = late;
+            g_mutex_unlock(&stats->lock);
+        }
+        gst_event_unref(event);
+    }
+    gst_object_unref(clock);
+    return GST_PAD_PROBE_OK;
+}
+
+typedef struct {
+    ProfileWindow *window;
+    ElementStats *stats;
+    gboolean is_sink;
+} PadVisit;
+
+static gboolean instrument_pad(GstElement *element, GstPad *pad, gpointer user_data) {
+    PadVisit *visit = user_data;
+    GstPadProbeCallback callback = NULL;
+
+    if (GST_PAD_IS_SINK(pad)) {
+        callback = visit->is_sink ? sink_latency_probe : enter_probe;
+    } else if (!visit->is_sink) {
+        callback = exit_probe;
+    }
+    if (!callback) return TRUE;
+
+    ProbeRef *ref = g_new0(ProbeRef, 1);
+    ref->pad = gst_object_ref(pad);
+    ref->id = gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST,
+                                callback, element_stats_ref(visit->stats), element_stats_unref);
+    g_ptr_array_add(visit->window->probes, ref);
+    return TRUE;
+}
+
+static void instrument_element(ProfileWindow *w, GstElement *element, const gchar *label) {
+    if (GST_IS_BIN(element) || g_hash_table_contains(w->instrumented, element)) return;
+    g_hash_table_add(w->instrumented, element);
+
+    GstElementFactory *factory = gst_element_get_factory(element);
+    ElementStats *stats = g_new0(ElementStats, 1);
+    stats->refs = 1;
+    stats->pipeline = label;
+    stats->element = gst_element_get_name(element);
+    stats->factory = g_strdup(factory ? GST_OBJECT_NAME(factory) : "?");
+    g_mutex_init(&stats->lock);
+    g_ptr_array_add(w->elements, stats);
+
+    PadVisit visit = { w, stats, GST_OBJECT_FLAG_IS_SET(element, GST_ELEMENT_FLAG_SINK) };
+    gst_element_foreach_pad(element, instrument_pad, &visit);
+
+    /* Mức đầy của queue/queue2 (lấy mẫu theo PROFILING_QUEUE_POLL_MS) */
+    if (g_object_class_find_property(G_OBJECT_GET_CLASS(element), "current-level-time")) {
+        QueueStats *q = g_new0(QueueStats, 1);
+        q->queue = gst_object_ref(element);
+        q->pipeline = label;
+        g_ptr_array_add(w->queues, q);
+    }
+}
+
+/* window_lock đang giữ */
+static void instrument_pipeline(ProfileWindow *w, GstElement *pipeline, const gchar *label) {
+    GstIterator *it = gst_bin_iterate_recurse(GST_BIN(pipeline));
+    GValue item = G_VALUE_INIT;
+    gboolean done = FALSE;
+
+    while (!done) {
+        switch (gst_iterator_next(it, &item)) {
+            case GST_ITERATOR_OK:
+                instrument_element(w, g_value_get_object(&item), label);
+                g_value_reset(&item);
+                break;
+            case GST_ITERATOR_RESYNC:
+                /* Element đã gắn được bỏ qua nhờ bảng instrumented */
+                gst_iterator_resync(it);
+                break;
+            default:
+                done = TRUE;
+                break;
+        }
+    }
+    g_value_unset(&item);
+    gst_iterator_free(it);
+}
+
+void profiling_track_pipeline(GstElement *pipeline, const gchar *label) {
+    if (!GST_IS_BIN(pipeline)) return;
+
+    const gchar *interned = g_intern_string(label);
+    TrackedPipeline *tp = g_new0(TrackedPipeline, 1);
+    g_weak_ref_init(&tp->pipeline, pipeline);
+    tp->label = interned;
+    tp->tracked_us = g_get_monotonic_time();
+
+    g_mutex_lock(&tracked_lock);
+    if (!tracked) tracked = g_ptr_array_new_with_free_func(tracked_pipeline_free);
+    /* Dọn entry của pipeline đã giải phóng */
+    for (guint i = tracked->len; i-- > 0;) {
+        GObject *alive = g_weak_ref_get(&((TrackedPipeline *)g_ptr_array_index(tracked, i))->pipeline);
+        if (alive) {
+            g_object_unref(alive);
+        } else {
+            g_ptr_array_remove_index_fast(tracked, i);
+        }
+    }
+    g_ptr_array_add(tracked, tp);
+    g_mutex_unlock(&tracked_lock);
+
+    /* Pipeline tạo ra giữa cửa sổ cũng được đo */
+    g_mutex_lock(&window_lock);
+    if (window) instrument_pipeline(window, pipeline, interned);
+    g_mutex_unlock(&window_lock);
+}
+
+/* ===== CPU từng thread (/proc/self/task) ===== */
+
+typedef struct {
+    gchar name[32];
+    guint64 ticks;
+} ThreadCpu;
+
+static GHashTable* read_thread_cpu(void) {
+    GHashTable *threads = g_hash_table_new_full(NULL, NULL, NULL, g_free);
+    DIR *dir = opendir("/proc/self/task");
+    if (!dir) return threads;
+
+    struct dirent *entry;
+    while ((entry = readdir(dir))) {
+        gint tid = atoi(entry->d_name);
+        if (tid <= 0) continue;
+
+        gchar *path = g_strdup_printf("/proc/self/task/%d/stat", tid);
+        gchar *stat = NULL;
+        if (g_file_get_contents(path, &stat, NULL, NULL)) {
+            /* "tid (comm) state ..." - comm có thể chứa khoảng trắng, utime/stime là trường 14/15 */
+            gchar *open = strchr(stat, '(');
+            gchar *close = strrchr(stat, ')');
+            if (open && close && close > open) {
+                gchar **fields = g_strsplit(close + 2, " ", 14);
+                if (g_strv_length(fields) >= 14) {
+                    ThreadCpu *cpu = g_new0(ThreadCpu, 1);
+                    g_strlcpy(cpu->name, open + 1, MIN(sizeof(cpu->name), (gsize)(close - open)));
+                    cpu->ticks = g_ascii_strtoull(fields[11], NULL, 10) + g_ascii_strtoull(fields[12], NULL, 10);
+                    g_hash_table_insert(threads, GINT_TO_POINTER(tid), cpu);
+                }
+                g_strfreev(fields);
+            }
+            g_free(stat);
+        }
+        g_free(path);
+    }
+    closedir(dir);
+    return threads;
+}
+
+/* Tên thread do rtsp_threads/recording_manager đặt */
+static const gchar* thread_role(const gchar *name) {
+    if (g_str_has_prefix(name, "rtsp-")) return "rtsp";
+    if (g_str_has_prefix(name, "ing:")) return "ingest";
+    if (g_str_has_prefix(name, "rec")) return "recording";
+    return "other";
+}
+
+/* ===== Stack mẫu: timer CPU-time từng thread -> SIGPROF -> backtrace() ===== */
+
+typedef struct {
+    pid_t tid;
+    gint depth;
+    gpointer frames[PROFILING_STACK_DEPTH];
+} StackSample;
+
+static StackSample *samples = NULL;
+static gint n_samples = 0;
+static gint sampler_running = 0;
+static GThread *sampler_thread = NULL;
+
+static void sample_handler(int signo, siginfo_t *info, void *context) {
+    gint saved_errno = errno;
+    StackSample *buffer = g_atomic_pointer_get(&samples);
+    gint index = g_atomic_int_add(&n_samples, 1);
+    if (buffer && index < PROFILING_MAX_SAMPLES) {
+        buffer[index].tid = (pid_t)syscall(SYS_gettid);
+        buffer[index].depth = backtrace(buffer[index].frames, PROFILING_STACK_DEPTH);
+    }
+    errno = saved_errno;
+}
+
+/* clockid CPU-time của thread bất kỳ trong process (như pthread_getcpuclockid, theo tid) */
+static clockid_t thread_cpu_clock(pid_t tid) {
+    return (~(clockid_t)tid << 3) | 6;
+}
+
+/* Mỗi thread một timer đếm theo CPU time của chính nó: thread đang ngủ không sinh mẫu.
+ * Thread mới tạo trong cửa sổ được thêm ở lượt quét kế tiếp */
+static gpointer sampler_func(gpointer data) {
+    GHashTable *timers = g_hash_table_new(NULL, NULL);   /* tid -> timer_t */
+    pid_t self = current_tid();
+    struct itimerspec spec;
+
+    memset(&spec, 0, sizeof(spec));
+    spec.it_interval.tv_nsec = 1000000000L / PROFILING_SAMPLE_HZ;
+    spec.it_value = spec.it_interval;
+
+    while (g_atomic_int_get(&sampler_running)) {
+        DIR *dir = opendir("/proc/self/task");
+        struct dirent *entry;
+        while (dir && (entry = readdir(dir))) {
+            pid_t tid = atoi(entry->d_name);
+            if (tid <= 0 || tid == self || g_hash_table_contains(timers, GINT_TO_POINTER(tid))) continue;
+
+            struct sigevent event;
+            timer_t timer = NULL;
+            memset(&event, 0, sizeof(event));
+            event.sigev_notify = SIGEV_THREAD_ID;
+            event.sigev_signo = PROFILING_SIGNAL;
+            event._sigev_un._tid = tid;
+            if (timer_create(thread_cpu_clock(tid), &event, &timer) == 0) {
+                timer_settime(timer, 0, &spec, NULL);
+            } else {
+                timer = NULL;   /* thread vừa thoát */
+            }
+            g_hash_table_insert(timers, GINT_TO_POINTER(tid), timer);
+        }
+        if (dir) closedir(dir);
+        g_usleep(PROFILING_RESCAN_MS * 1000);
+    }
+
+    GHashTableIter iter;
+    gpointer timer;
+    g_hash_table_iter_init(&iter, timers);
+    while (g_hash_table_iter_next(&iter, NULL, &timer)) {
+        if (timer) timer_delete((timer_t)timer);
+    }
+    g_hash_table_unref(timers);
+    return NULL;
+}
+
+static void sampler_start(void) {
+    void *warmup[2];
+    struct sigaction action;
+
+    /* Lần gọi đầu của backtrace() nạp libgcc (malloc) - không được xảy ra trong handler */
+    backtrace(warmup, G_N_ELEMENTS(warmup));
+
+    g_atomic_int_set(&n_samples, 0);
+    g_atomic_pointer_set(&samples, g_new0(StackSample, PROFILING_MAX_SAMPLES));
+
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = sample_handler;
+    action.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(PROFILING_SIGNAL, &action, NULL);
+
+    g_atomic_int_set(&sampler_running, 1);
+    sampler_thread = g_thread_new("profile-sampler", sampler_func, NULL);
+}
+
+static void sampler_stop(void) {
+    struct sigaction action;
+
+    g_atomic_int_set(&sampler_running, 0);
+    if (sampler_thread) {
+        g_thread_join(sampler_thread);
+        sampler_thread = NULL;
+    }
+
+    /* Tín hiệu còn treo bị bỏ qua (mặc định của SIGPROF là kết thúc process) */
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = SIG_IGN;
+    sigemptyset(&action.sa_mask);
+    sigaction(PROFILING_SIGNAL, &action, NULL);
+    /* Handler đang chạy dở trên thread khác */
+    g_usleep(20 * 1000);
+}
+
+/* ===== GStreamer tracer (chỉ khi process chạy với GST_TRACERS) ===== */
+
+/* Tracer của GStreamer chỉ nạp được lúc gst_init và không gỡ hook được, nên không bật
+ * ở runtime: với GST_TRACERS=latency;proctime;leaks... record của chúng được ghi trong cửa sổ */
+static GMutex tracer_log_lock;
+static FILE *tracer_log = NULL;
+static GstDebugCategory *tracer_category = NULL;
+static GstDebugLevel tracer_saved_level = GST_LEVEL_NONE;
+static gboolean tracer_saved_active = FALSE;
+
+static void tracer_log_func(GstDebugCategory *category, GstDebugLevel level,
+                            const gchar *file, const gchar *function, gint line,
+                            GObject *object, GstDebugMessage *message, gpointer user_data) {
+    if (category != tracer_category) {
+        gst_debug_log_default(category, level, file, function, line, object, message, NULL);
+        return;
+    }
+
+    g_mutex_lock(&tracer_log_lock);
+    if (tracer_log) {
+        fprintf(tracer_log, "%" GST_TIME_FORMAT " %s\n",
+                GST_TIME_ARGS(gst_util_get_timestamp()), gst_debug_message_get(message));
+    }
+    g_mutex_unlock(&tracer_log_lock);
+}
+
+static void tracer_capture_start(const gchar *dir) {
+    if (!g_getenv("GST_TRACERS")) return;
+
+    gchar *path = g_build_filename(dir, "tracers.log", NULL);
+    g_mutex_lock(&tracer_log_lock);
+    tracer_log = fopen(path, "w");
+    g_mutex_unlock(&tracer_log_lock);
+    g_free(path);
+    if (!tracer_log) return;
+
+    GST_DEBUG_CATEGORY_GET(tracer_category, "GST_TRACER");
+    if (!tracer_category) return;
+    tracer_saved_level = gst_debug_category_get_threshold(tracer_category);
+    tracer_saved_active = gst_debug_is_active();
+
+    /* Log khác vẫn đi qua handler mặc định */
+    gst_debug_remove_log_function(gst_debug_log_default);
+    gst_debug_add_log_function(tracer_log_func, NULL, NULL);
+    gst_debug_set_active(TRUE);
+    gst_debug_category_set_threshold(tracer_category, GST_LEVEL_TRACE);
+}
+
+static void tracer_capture_stop(void) {
+    if (tracer_category) {
+        gst_debug_category_set_threshold(tracer_category, tracer_saved_level);
+        gst_debug_set_active(tracer_saved_active);
+        gst_debug_remove_log_function(tracer_log_func);
+        gst_debug_add_log_function(gst_debug_log_default, NULL, NULL);
+        tracer_category = NULL;
+    }
+
+    g_mutex_lock(&tracer_log_lock);
+    if (tracer_log) {
+        fclose(tracer_log);
+        tracer_log = NULL;
+    }
+    g_mutex_unlock(&tracer_log_lock);
+}
+
+/* ===== Bundle ===== */
+
+static void write_file(const gchar *dir, const gchar *name, GString *content) {
+    gchar *path = g_build_filename(dir, name, NULL);
+    GError *error = NULL;
+    if (!g_file_set_contents(path, content->str, content->len, &error)) {
+        g_printerr("[profile] Failed to write %s: %s\n", path, error->message);
+        g_error_free(error);
+    }
+    g_free(path);
+}
+
+static gint compare_element_total(gconstpointer a, gconstpointer b) {
+    const ElementStats *x = *(ElementStats * const *)a;
+    const ElementStats *y = *(ElementStats * const *)b;
+    return x->total_ns < y->total_ns ? 1 : (x->total_ns > y->total_ns ? -1 : 0);
+}
+
+static void append_symbol(GString *out, gpointer address, GHashTable *symbols) {
+    const gchar *cached = g_hash_table_lookup(symbols, address);
+    if (!cached) {
+        Dl_info info;
+        gchar *symbol;
+        if (dladdr(address, &info) && info.dli_sname) {
+            symbol = g_strdup(info.dli_sname);
+        } else if (info.dli_fname) {
+            gchar *base = g_path_get_basename(info.dli_fname);
+            symbol = g_strdup_printf("%s+0x%" G_GINTPTR_MODIFIER "x", base,
+                                     (guintptr)address - (guintptr)info.dli_fbase);
+            g_free(base);
+        } else {
+            symbol = g_strdup_printf("0x%" G_GINTPTR_MODIFIER "x", (guintptr)address);
+        }
+        g_hash_table_insert(symbols, address, symbol);
+        cached = symbol;
+    }
+    g_string_append(out, cached);
+}
+
+/* Định dạng folded của flamegraph.pl / speedscope: "thread;gốc;...;lá count" */
+static guint write_folded(const gchar *dir, GHashTable *cpu_end) {
+    GHashTable *stacks = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    GHashTable *symbols = g_hash_table_new_full(NULL, NULL, NULL, g_free);
+    gint count = MIN(g_atomic_int_get(&n_samples), PROFILING_MAX_SAMPLES);
+    guint used = 0;
+
+    for (gint i = 0; i < count; i++) {
+        StackSample *sample = &samples[i];
+        /* frames[0] là handler, frames[1] là trampoline signal */
+        if (sample->depth <= 2) continue;
+
+        ThreadCpu *cpu = g_hash_table_lookup(cpu_end, GINT_TO_POINTER(sample->tid));
+        GString *line = g_string_new(NULL);
+        if (cpu) {
+            for (const gchar *c = cpu->name; *c; c++) {
+                g_string_append_c(line, (*c == ';' || *c == ' ') ? '_' : *c);
+            }
+        } else {
+            g_string_append_printf(line, "tid-%d", sample->tid);
+        }
+        for (gint f = sample->depth - 1; f >= 2; f--) {
+            g_string_append_c(line, ';');
+            append_symbol(line, sample->frames[f], symbols);
+        }
+
+        gchar *key = g_string_free(line, FALSE);
+        guint n = GPOINTER_TO_UINT(g_hash_table_lookup(stacks, key));
+        g_hash_table_replace(stacks, key, GUINT_TO_POINTER(n + 1));
+        used++;
+    }
+
+    GString *out = g_string_new(NULL);
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, stacks);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        g_string_append_printf(out, "%s %u\n", (const gchar *)key, GPOINTER_TO_UINT(value));
+    }
+    write_file(dir, "stacks.folded", out);
+
+    g_string_free(out, TRUE);
+    g_hash_table_unref(symbols);
+    g_hash_table_unref(stacks);
+    return used;
+}
+
+static void write_bundle(ProfileWindow *w, gdouble elapsed_s) {
+    GString *out = g_string_new(NULL);
+    GString *summary = g_string_new(NULL);
+
+    g_string_append_printf(summary, "window_s\t%.1f\n", elapsed_s);
+
+    /* Thời gian xử lý từng element */
+    g_ptr_array_sort(w->elements, compare_element_total);
+    g_string_append(out, "pipeline\telement\tfactory\tbuffers\tmean_us\tmax_us\ttotal_ms\n");
+    for (guint i = 0; i < w->elements->len; i++) {
+        ElementStats *s = g_ptr_array_index(w->elements, i);
+        g_mutex_lock(&s->lock);
+        if (s->buffers > 0) {
+            g_string_append_printf(out, "%s\t%s\t%s\t%" G_GUINT64_FORMAT "\t%.1f\t%.1f\t%.1f\n",
+                                   s->pipeline, s->element, s->factory, s->buffers,
+                                   s->total_ns / 1000.0 / s->buffers, s->max_ns / 1000.0,
+                                   s->total_ns / 1e6);
+        }
+        g_mutex_unlock(&s->lock);
+    }
+    write_file(w->dir, "elements.tsv", out);
+    g_string_truncate(out, 0);
+
+    /* Độ trễ tới sink */
+    g_string_append(out, "pipeline\tsink\tbuffers\tmean_ms\tmax_ms\n");
+    for (guint i = 0; i < w->elements->len; i++) {
+        ElementStats *s = g_ptr_array_index(w->elements, i);
+        g_mutex_lock(&s->lock);
+        if (s->late_buffers > 0) {
+            g_string_append_printf(out, "%s\t%s\t%" G_GUINT64_FORMAT "\t%.2f\t%.2f\n",
+                                   s->pipeline, s->element, s->late_buffers,
+                                   s->late_total_ns / 1e6 / s->late_buffers, s->late_max_ns / 1e6);
+        }
+        g_mutex_unlock(&s->lock);
+    }
+    write_file(w->dir, "latency.tsv", out);
+    g_string_truncate(out, 0);
+
+    /* Mức queue */
+    g_string_append(out, "pipeline\tqueue\tsamples\tavg_buffers\tmax_buffers\tavg_kbytes\tmax_kbytes\tavg_ms\tmax_ms\n");
+    for (guint i = 0; i < w->queues->len; i++) {
+        QueueStats *q = g_ptr_array_index(w->queues, i);
+        if (q->samples == 0) continue;
+        gchar *name = gst_element_get_name(q->queue);
+        g_string_append_printf(out, "%s\t%s\t%u\t%.1f\t%u\t%.1f\t%.1f\t%.1f\t%.1f\n",
+                               q->pipeline, name, q->samples,
+                               (gdouble)q->sum_buffers / q->samples, q->max_buffers,
+                               q->sum_bytes / 1024.0 / q->samples, q->max_bytes / 1024.0,
+                               q->sum_time / 1e6 / q->samples, q->max_time / 1e6);
+        g_free(name);
+    }
+    write_file(w->dir, "queues.tsv", out);
+    g_string_truncate(out, 0);
+
+    /* CPU từng thread, gộp theo nhóm và theo pipeline */
+    GHashTable *cpu_end = read_thread_cpu();
+    GHashTable *by_pipeline = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, g_free);
+    gdouble role_ms[4] = { 0 };
+    const gchar *roles[4] = { "rtsp", "ingest", "recording", "other" };
+    gdouble ticks_per_ms = sysconf(_SC_CLK_TCK) / 1000.0;
+    gdouble window_ms = MAX(elapsed_s * 1000.0, 1.0);
+
+    g_string_append(out, "tid\tname\trole\tpipeline\tcpu_ms\tcpu_pct\n");
+    g_mutex_lock(&thread_map_lock);
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, cpu_end);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        ThreadCpu *end = value;
+        ThreadCpu *start = g_hash_table_lookup(w->cpu_start, key);
+        guint64 ticks = end->ticks - (start && start->ticks <= end->ticks ? start->ticks : 0);
+        gdouble ms = ticks / ticks_per_ms;
+        if (ms <= 0) continue;
+
+        const gchar *role = thread_role(end->name);
+        const gchar *pipeline = thread_pipeline ? g_hash_table_lookup(thread_pipeline, key) : NULL;
+        g_string_append_printf(out, "%d\t%s\t%s\t%s\t%.0f\t%.1f\n", GPOINTER_TO_INT(key), end->name,
+                               role, pipeline ? pipeline : "-", ms, ms * 100.0 / window_ms);
+
+        for (guint r = 0; r < G_N_ELEMENTS(roles); r++) {
+            if (g_strcmp0(role, roles[r]) == 0) role_ms[r] += ms;
+        }
+        if (pipeline) {
+            gdouble *total = g_hash_table_lookup(by_pipeline, pipeline);
+            if (!total) {
+                total = g_new0(gdouble, 2);
+                g_hash_table_insert(by_pipeline, (gpointer)pipeline, total);
+            }
+            total[0] += ms;
+            total[1] += 1;
+        }
+    }
+    g_mutex_unlock(&thread_map_lock);
+    write_file(w->dir, "threads.tsv", out);
+    g_string_truncate(out, 0);
+
+    g_string_append(out, "pipeline\tthreads\tcpu_ms\tcpu_pct\n");
+    g_hash_table_iter_init(&iter, by_pipeline);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        gdouble *total = value;
+        g_string_append_printf(out, "%s\t%.0f\t%.0f\t%.1f\n", (const gchar *)key,
+                               total[1], total[0], total[0] * 100.0 / window_ms);
+    }
+    write_file(w->dir, "pipelines.tsv", out);
+    g_string_truncate(out, 0);
+
+    for (guint r = 0; r < G_N_ELEMENTS(roles); r++) {
+        g_string_append_printf(summary, "cpu_%s_pct\t%.1f\n", roles[r], role_ms[r] * 100.0 / window_ms);
+    }
+
+    /* Pipeline đã về NULL mà vẫn còn sống: ai đó giữ ref sau teardown */
+    guint alive = 0, leaked = 0;
+    gint64 now = g_get_monotonic_time();
+    g_string_append(out, "pipeline\tage_s\trefcount\n");
+    g_mutex_lock(&tracked_lock);
+    for (guint i = 0; tracked && i < tracked->len; i++) {
+        TrackedPipeline *tp = g_ptr_array_index(tracked, i);
+        GstElement *pipeline = g_weak_ref_get(&tp->pipeline);
+        if (!pipeline) continue;
+        alive++;
+        gint64 age_s = (now - tp->tracked_us) / G_USEC_PER_SEC;
+        if (GST_STATE(pipeline) == GST_STATE_NULL && GST_STATE_PENDING(pipeline) == GST_STATE_VOID_PENDING &&
+            age_s > PROFILING_LEAK_AGE_SEC) {
+            g_string_append_printf(out, "%s\t%" G_GINT64_FORMAT "\t%d\n", tp->label, age_s,
+                                   GST_OBJECT_REFCOUNT_VALUE(pipeline) - 1);
+            leaked++;
+        }
+        gst_object_unref(pipeline);
+    }
+    g_mutex_unlock(&tracked_lock);
+    write_file(w->dir, "leaks.tsv", out);
+    g_string_truncate(out, 0);
+
+    guint used = write_folded(w->dir, cpu_end);
+
+    g_string_append_printf(summary, "pipelines_alive\t%u\npipelines_leaked\t%u\n", alive, leaked);
+    g_string_append_printf(summary, "elements\t%u\nqueues\t%u\nstack_samples\t%u\n",
+                           w->elements->len, w->queues->len, used);
+    g_string_append_printf(summary, "tracers\t%s\n", g_getenv("GST_TRACERS") ? g_getenv("GST_TRACERS") : "-");
+    write_file(w->dir, "summary.tsv", summary);
+
+    g_hash_table_unref(by_pipeline);
+    g_hash_table_unref(cpu_end);
+    g_string_free(summary, TRUE);
+    g_string_free(out, TRUE);
+}
+
+/* ===== Cửa sổ ===== */
+
+static void window_free(ProfileWindow *w) {
+    g_ptr_array_unref(w->probes);
+    g_ptr_array_unref(w->queues);
+    g_ptr_array_unref(w->elements);
+    g_hash_table_unref(w->instrumented);
+    g_hash_table_unref(w->cpu_start);
+    g_free(w->dir);
+    g_free(w);
+}
+
+static void profiling_finish(gboolean write) {
+    g_mutex_lock(&window_lock);
+    ProfileWindow *w = window;
+    window = NULL;
+    g_mutex_unlock(&window_lock);
+    if (!w) return;
+
+    if (w->poll_id) g_source_remove(w->poll_id);
+
+    /* Gỡ probe trước: từ đây luồng dữ liệu trở lại như khi không profiling */
+    g_ptr_array_set_size(w->probes, 0);
+    sampler_stop();
+    tracer_capture_stop();
+    g_atomic_int_inc(&generation);
+
+    gdouble elapsed_s = (g_get_monotonic_time() - w->start_us) / 1e6;
+    if (write) {
+        write_bundle(w, elapsed_s);
+        g_print("[profile] Bundle written to %s (%.1f s, %u elements)\n",
+                w->dir, elapsed_s, w->elements->len);
+    }
+
+    g_free(g_atomic_pointer_get(&samples));
+    g_atomic_pointer_set(&samples, NULL);
+    window_free(w);
+}
+
+static gboolean window_poll(gpointer user_data) {
+    g_mutex_lock(&window_lock);
+    ProfileWindow *w = window;
+    gboolean expired = !w || g_get_monotonic_time() - w->start_us >= (gint64)w->seconds * G_USEC_PER_SEC;
+
+    for (guint i = 0; w && !expired && i < w->queues->len; i++) {
+        QueueStats *q = g_ptr_array_index(w->queues, i);
+        guint buffers = 0, bytes = 0;
+        guint64 time = 0;
+        g_object_get(q->queue, "current-level-buffers", &buffers, "current-level-bytes", &bytes,
+                     "current-level-time", &time, NULL);
+        q->samples++;
+        q->sum_buffers += buffers;
+        q->sum_bytes += bytes;
+        q->sum_time += time;
+        q->max_buffers = MAX(q->max_buffers, buffers);
+        q->max_bytes = MAX(q->max_bytes, bytes);
+        q->max_time = MAX(q->max_time, time);
+    }
+    if (w && expired) w->poll_id = 0;
+    g_mutex_unlock(&window_lock);
+
+    if (!expired) return G_SOURCE_CONTINUE;
+    profiling_finish(TRUE);
+    return G_SOURCE_REMOVE;
+}
+
+gboolean profiling_start(guint seconds) {
+    if (!profile_root) return FALSE;
+
+    g_mutex_lock(&window_lock);
+    if (window) {
+        g_mutex_unlock(&window_lock);
+        return FALSE;
+    }
+
+    GDateTime *now = g_date_time_new_now_local();
+    gchar *stamp = g_date_time_format(now, "%Y%m%d-%H%M%S");
+    g_date_time_unref(now);
+
+    ProfileWindow *w = g_new0(ProfileWindow, 1);
+    w->dir = g_build_filename(profile_root, stamp, NULL);
+    w->seconds = CLAMP(seconds, 1, PROFILING_MAX_SEC);
+    g_free(stamp);
+
+    if (g_mkdir_with_parents(w->dir, 0755) != 0) {
+        g_printerr("[profile] Cannot create %s: %s\n", w->dir, g_strerror(errno));
+        g_mutex_unlock(&window_lock);
+        g_free(w->dir);
+        g_free(w);
+        return FALSE;
+    }
+
+    w->probes = g_ptr_array_new_with_free_func(probe_ref_free);
+    w->elements = g_ptr_array_new_with_free_func(element_stats_unref);
+    w->queues = g_ptr_array_new_with_free_func(queue_stats_free);
+    w->instrumented = g_hash_table_new(NULL, NULL);
+    w->cpu_start = read_thread_cpu();
+
+    g_atomic_int_inc(&generation);
+    g_mutex_lock(&thread_map_lock);
+    if (thread_pipeline) g_hash_table_remove_all(thread_pipeline);
+    else thread_pipeline = g_hash_table_new(NULL, NULL);
+    g_mutex_unlock(&thread_map_lock);
+
+    /* Lấy ref mạnh dưới tracked_lock rồi mới gắn probe */
+    GPtrArray *pipelines = g_ptr_array_new_with_free_func(gst_object_unref);
+    GPtrArray *labels = g_ptr_array_new();
+    g_mutex_lock(&tracked_lock);
+    for (guint i = 0; tracked && i < tracked->len; i++) {
+        TrackedPipeline *tp = g_ptr_array_index(tracked, i);
+        GstElement *pipeline = g_weak_ref_get(&tp->pipeline);
+        if (!pipeline) continue;
+        g_ptr_array_add(pipelines, pipeline);
+        g_ptr_array_add(labels, (gpointer)tp->label);
+    }
+    g_mutex_unlock(&tracked_lock);
+    for (guint i = 0; i < pipelines->len; i++) {
+        instrument_pipeline(w, g_ptr_array_index(pipelines, i), g_ptr_array_index(labels, i));
+    }
+    g_ptr_array_unref(labels);
+    g_ptr_array_unref(pipelines);
+
+    w->start_us = g_get_monotonic_time();
+    window = w;
+    g_free(last_bundle);
+    last_bundle = g_strdup(w->dir);
+
+    tracer_capture_start(w->dir);
+    sampler_start();
+    w->poll_id = g_timeout_add(PROFILING_QUEUE_POLL_MS, window_poll, NULL);
+    g_mutex_unlock(&window_lock);
+
+    g_print("[profile] Capturing %u s into %s (%u elements)\n", w->seconds, w->dir, w->elements->len);
+    return TRUE;
+}
+
+gboolean profiling_running(void) {
+    g_mutex_lock(&window_lock);
+    gboolean running = window != NULL;
+    g_mutex_unlock(&window_lock);
+    return running;
+}
+
+gboolean profiling_trigger(gpointer user_data) {
+    if (!profiling_start(PROFILING_DEFAULT_SEC)) {
+        g_printerr("[profile] Already running or not initialized\n");
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+/* ===== HTTP ===== */
+
+static void respond_status(SoupServerMessage *msg, guint status, guint seconds) {
+    JsonBuilder *builder = json_builder_new();
+    json_builder_begin_object(builder);
+    json_builder_set_member_name(builder, "running");
+    json_builder_add_boolean_value(builder, profiling_running());
+    if (seconds > 0) {
+        json_builder_set_member_name(builder, "seconds");
+        json_builder_add_int_value(builder, seconds);
+    }
+    g_mutex_lock(&window_lock);
+    if (last_bundle) {
+        json_builder_set_member_name(builder, "bundle");
+        json_builder_add_string_value(builder, last_bundle);
+    }
+    g_mutex_unlock(&window_lock);
+    json_builder_end_object(builder);
+
+    JsonGenerator *generator = json_generator_new();
+    JsonNode *root = json_builder_get_root(builder);
+    json_generator_set_root(generator, root);
+    gchar *body = json_generator_to_data(generator, NULL);
+    http_control_respond(msg, status, "application/json", body);
+
+    g_free(body);
+    json_node_unref(root);
+    g_object_unref(generator);
+    g_object_unref(builder);
+}
+
+/* GET /profile: trạng thái + bundle gần nhất; POST /profile?seconds=N: bắt đầu cửa sổ */
+static void profiling_http_handler(SoupServer *server, SoupServerMessage *msg, const char *path,
+                                   GHashTable *query, gpointer user_data) {
+    const char *method = soup_server_message_get_method(msg);
+
+    if (method == SOUP_METHOD_GET) {
+        respond_status(msg, SOUP_STATUS_OK, 0);
+        return;
+    }
+    if (method != SOUP_METHOD_POST) {
+        http_control_respond(msg, SOUP_STATUS_METHOD_NOT_ALLOWED, NULL, "GET or POST only\n");
+        return;
+    }
+
+    const gchar *value = query ? g_hash_table_lookup(query, "seconds") : NULL;
+    guint seconds = value ? (guint)g_ascii_strtoull(value, NULL, 10) : PROFILING_DEFAULT_SEC;
+    seconds = CLAMP(seconds, 1, PROFILING_MAX_SEC);
+
+    if (!profiling_start(seconds)) {
+        http_control_respond(msg, SOUP_STATUS_CONFLICT, NULL, "profiling already running\n");
+        return;
+    }
+    respond_status(msg, SOUP_STATUS_ACCEPTED, seconds);
+}
+
+void profiling_init(const gchar *base_path) {
+    g_free(profile_root);
+    profile_root = g_build_filename(base_path, PROFILING_DIR, NULL);
+    http_control_add_handler(PROFILING_PATH, profiling_http_handler, NULL);
+}
+
+void profiling_shutdown(void) {
+    profiling_finish(FALSE);
+}
@@ -0,0 +1,37 @@
+#ifndef PROFILING_H
+#define PROFILING_H
+
+#include <gst/gst.h>
+
+/* Profiling theo yêu cầu lúc đang chạy: kill -USR2 <pid> hoặc POST /profile?seconds=N.
+ * Trong cửa sổ: thời gian xử lý từng element, độ trễ tới sink, mức queue, CPU từng thread
+ * và stack mẫu; hết cửa sổ ghi bundle vào <record-dir>/.profile/<thời điểm>/.
+ * Khi không profiling không có probe, timer hay signal handler nào được cài. */
+#define PROFILING_PATH              "/profile"
+#define PROFILING_DIR               ".profile"
+#define PROFILING_DEFAULT_SEC       10
+#define PROFILING_MAX_SEC           60
+#define PROFILING_SAMPLE_HZ         99
+#define PROFILING_STACK_DEPTH       32
+#define PROFILING_MAX_SAMPLES       65536
+#define PROFILING_QUEUE_POLL_MS     100
+/* Pipeline còn sống ở state NULL lâu hơn chừng này được liệt kê là nghi leak */
+#define PROFILING_LEAK_AGE_SEC      30
+
+/* Thư mục bundle và endpoint HTTP */
+void profiling_init(const gchar *base_path);
+
+/* Pipeline được đo khi có cửa sổ profiling (label ví dụ "live:cam_1", "rec:cam_1-main") */
+void profiling_track_pipeline(GstElement *pipeline, const gchar *label);
+
+/* Bắt đầu cửa sổ profiling; FALSE nếu đang có cửa sổ khác */
+gboolean profiling_start(guint seconds);
+gboolean profiling_running(void);
+
+/* GSourceFunc: cửa sổ mặc định (dùng cho SIGUSR2) */
+gboolean profiling_trigger(gpointer user_data);
+
+/* Hủy cửa sổ đang chạy (không ghi bundle) khi thoát */
+void profiling_shutdown(void);
+
+#endif // PROFILING_H
@@ -0,0 +1,297 @@
+#include "recording_coverage.h"
+#include "recording_lookup.h"
+#include "http_control.h"
+#include <json-glib/json-glib.h>
+
+#define USEC_PER_DAY (86400LL * G_USEC_PER_SEC)
+/* Segment vắt qua nửa đêm nằm trong ngày của start_us */
+#define COVERAGE_LOOKBACK_DAYS 1
+
+/* Cache: "stream/camera/day" -> GArray of SegmentSpan đã gộp.
+ * Vài khoảng mỗi ngày thay vì hàng nghìn record, nên giữ được cả tháng cho mọi camera. */
+static GMutex coverage_lock;
+static GHashTable *coverage_cache = NULL;
+
+static gint64 day_of(gint64 ts_us) {
+    return ts_us >= 0 ? ts_us / USEC_PER_DAY : (ts_us - USEC_PER_DAY + 1) / USEC_PER_DAY;
+}
+
+static gchar* coverage_key(const gchar *camera_name, StreamType stream_type, gint64 day) {
+    return g_strdup_printf("%d/%s/%" G_GINT64_FORMAT, stream_type, camera_name, day);
+}
+
+static gint compare_span_start(gconstpointer a, gconstpointer b) {
+    const SegmentSpan *sa = a;
+    const SegmentSpan *sb = b;
+    if (sa->start_us < sb->start_us) return -1;
+    if (sa->start_us > sb->start_us) return 1;
+    return 0;
+}
+
+/* Sắp xếp và gộp các khoảng chồng nhau hoặc sát nhau (tại chỗ) */
+static void spans_normalize(GArray *spans) {
+    if (spans->len < 2) return;
+
+    g_array_sort(spans, compare_span_start);
+
+    guint out = 0;
+    for (guint i = 1; i < spans->len; i++) {
+        SegmentSpan *last = &g_array_index(spans, SegmentSpan, out);
+        SegmentSpan *cur = &g_array_index(spans, SegmentSpan, i);
+        if (cur->start_us <= last->end_us + COVERAGE_MERGE_GAP_US) {
+            if (cur->end_us > last->end_us) last->end_us = cur->end_us;
+        } else {
+            g_array_index(spans, SegmentSpan, ++out) = *cur;
+        }
+    }
+    g_array_set_size(spans, out + 1);
+}
+
+/* Chèn một khoảng vào tập đã gộp. Segment mới hầu như luôn nằm ở cuối nên thường O(1). */
+static void spans_insert(GArray *spans, gint64 start_us, gint64 end_us) {
+    SegmentSpan span = { start_us, end_us };
+
+    if (spans->len > 0) {
+        SegmentSpan *last = &g_array_index(spans, SegmentSpan, spans->len - 1);
+        if (start_us >= last->start_us && start_us <= last->end_us + COVERAGE_MERGE_GAP_US) {
+            if (end_us > last->end_us) last->end_us = end_us;
+            return;
+        }
+        if (start_us > last->end_us) {
+            g_array_append_val(spans, span);
+            return;
+        }
+    }
+
+    g_array_append_val(spans, span);
+    spans_normalize(spans);
+}
+
+/* Lấy coverage của một ngày, dựng từ index nếu chưa có (gọi khi giữ coverage_lock) */
+static GArray* coverage_day_get(const gchar *camera_name, StreamType stream_type, gint64 day) {
+    gchar *key = coverage_key(camera_name, stream_type, day);
+    GArray *spans = g_hash_table_lookup(coverage_cache, key);
+    if (spans) {
+        g_free(key);
+        return spans;
+    }
+
+    spans = segment_index_get_day_spans(camera_name, stream_type, day);
+    spans_normalize(spans);
+    g_hash_table_insert(coverage_cache, key, spans);
+    return spans;
+}
+
+static void on_segment_changed(const gchar *camera_name, StreamType stream_type,
+                               gint64 start_us, gint64 end_us, gboolean removed) {
+    gchar *key = coverage_key(camera_name, stream_type, day_of(start_us));
+
+    g_mutex_lock(&coverage_lock);
+    GArray *spans = g_hash_table_lookup(coverage_cache, key);
+    if (spans) {
+        if (removed) {
+            /* Xóa khỏi tập đã gộp không làm được tại chỗ - dựng lại ngày này ở lần query sau */
+            g_hash_table_remove(coverage_cache, key);
+        } else {
+            spans_insert(spans, start_us, end_us);
+        }
+    }
+    g_mutex_unlock(&coverage_lock);
+
+    g_free(key);
+}
+
+void recording_coverage_init(void) {
+    g_mutex_lock(&coverage_lock);
+    if (!coverage_cache) {
+        coverage_cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                               (GDestroyNotify)g_array_unref);
+    } else {
+        g_hash_table_remove_all(coverage_cache);
+    }
+    g_mutex_unlock(&coverage_lock);
+
+    segment_index_set_change_func(on_segment_changed);
+}
+
+/* Gọi khi giữ coverage_lock */
+static RecordingCoverage* coverage_build(const gchar *camera_name, StreamType stream_type,
+                                         gint64 start_us, gint64 end_us) {
+    RecordingCoverage *coverage = g_new0(RecordingCoverage, 1);
+    coverage->camera_name = g_strdup(camera_name);
+    coverage->recorded = g_array_new(FALSE, FALSE, sizeof(SegmentSpan));
+    coverage->gaps = g_array_new(FALSE, FALSE, sizeof(SegmentSpan));
+
+    if (end_us <= start_us) return coverage;
+
+    gint64 first_day = day_of(start_us) - COVERAGE_LOOKBACK_DAYS;
+    gint64 last_day = day_of(end_us - 1);
+
+    for (gint64 d = first_day; d <= last_day; d++) {
+        GArray *spans = coverage_day_get(camera_name, stream_type, d);
+        for (guint i = 0; i < spans->len; i++) {
+            SegmentSpan span = g_array_index(spans, SegmentSpan, i);
+            if (span.start_us >= end_us) break;
+            if (span.end_us <= start_us) continue;
+            span.start_us = MAX(span.start_us, start_us);
+            span.end_us = MIN(span.end_us, end_us);
+            g_array_append_val(coverage->recorded, span);
+        }
+    }
+
+    /* Segment đang ghi chỉ vào index khi finalize: tính là có recording tới hiện tại */
+    gint64 open_start = segment_index_current(camera_name, stream_type, NULL);
+    if (open_start >= 0) {
+        SegmentSpan span = { MAX(open_start, start_us), MIN(g_get_real_time(), end_us) };
+        if (span.start_us < span.end_us) g_array_append_val(coverage->recorded, span);
+    }
+    spans_normalize(coverage->recorded);
+
+    gint64 cursor = start_us;
+    for (guint i = 0; i < coverage->recorded->len; i++) {
+        SegmentSpan *span = &g_array_index(coverage->recorded, SegmentSpan, i);
+        if (span->start_us > cursor) {
+            SegmentSpan gap = { cursor, span->start_us };
+            g_array_append_val(coverage->gaps, gap);
+        }
+        cursor = MAX(cursor, span->end_us);
+    }
+    if (cursor < end_us) {
+        SegmentSpan gap = { cursor, end_us };
+        g_array_append_val(coverage->gaps, gap);
+    }
+
+    return coverage;
+}
+
+RecordingCoverage* recording_coverage_query(const gchar *camera_name,
+                                            StreamType stream_type,
+                                            gint64 start_us,
+                                            gint64 end_us) {
+    const gchar *names[] = { camera_name };
+    GPtrArray *result = recording_coverage_query_many(names, 1, stream_type, start_us, end_us);
+    RecordingCoverage *coverage = g_ptr_array_steal_index(result, 0);
+    g_ptr_array_unref(result);
+    return coverage;
+}
+
+GPtrArray* recording_coverage_query_many(const gchar * const *camera_names,
+                                         guint count,
+                                         StreamType stream_type,
+                                         gint64 start_us,
+                                         gint64 end_us) {
+    GPtrArray *result = g_ptr_array_new_full(count, (GDestroyNotify)recording_coverage_free);
+
+    g_mutex_lock(&coverage_lock);
+    if (!coverage_cache) {
+        coverage_cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                               (GDestroyNotify)g_array_unref);
+    }
+    for (guint i = 0; i < count; i++) {
+        g_ptr_array_add(result, coverage_build(camera_names[i], stream_type, start_us, end_us));
+    }
+    g_mutex_unlock(&coverage_lock);
+
+    return result;
+}
+
+void recording_coverage_free(RecordingCoverage *coverage) {
+    if (!coverage) return;
+    g_free(coverage->camera_name);
+    g_array_unref(coverage->recorded);
+    g_array_unref(coverage->gaps);
+    g_free(coverage);
+}
+
+/* ===== HTTP ===== */
+
+static void add_spans(JsonBuilder *builder, const gchar *name, GArray *spans) {
+    json_builder_set_member_name(builder, name);
+    json_builder_begin_array(builder);
+    for (guint i = 0; i < spans->len; i++) {
+        SegmentSpan *span = &g_array_index(spans, SegmentSpan, i);
+        json_builder_begin_object(builder);
+        json_builder_set_member_name(builder, "start_us");
+        json_builder_add_int_value(builder, span->start_us);
+        json_builder_set_member_name(builder, "end_us");
+        json_builder_add_int_value(builder, span->end_us);
+        json_builder_end_object(builder);
+    }
+    json_builder_end_array(builder);
+}
+
+static gchar* coverage_json(GPtrArray *result, gint64 start_us, gint64 end_us) {
+    JsonBuilder *builder = json_builder_new();
+
+    json_builder_begin_object(builder);
+    json_builder_set_member_name(builder, "start_us");
+    json_builder_add_int_value(builder, start_us);
+    json_builder_set_member_name(builder, "end_us");
+    json_builder_add_int_value(builder, end_us);
+    json_builder_set_member_name(builder, "cameras");
+    json_builder_begin_array(builder);
+    for (guint i = 0; i < result->len; i++) {
+        RecordingCoverage *coverage = g_ptr_array_index(result, i);
+        json_builder_begin_object(builder);
+        json_builder_set_member_name(builder, "camera");
+        json_builder_add_string_value(builder, coverage->camera_name);
+        add_spans(builder, "recorded", coverage->recorded);
+        add_spans(builder, "gaps", coverage->gaps);
+        json_builder_end_object(builder);
+    }
+    json_builder_end_array(builder);
+    json_builder_end_object(builder);
+
+    JsonGenerator *generator = json_generator_new();
+    JsonNode *root = json_builder_get_root(builder);
+    json_generator_set_root(generator, root);
+    gchar *json = json_generator_to_data(generator, NULL);
+
+    json_node_unref(root);
+    g_object_unref(generator);
+    g_object_unref(builder);
+    return json;
+}
+
+static void coverage_http_handler(SoupServer *server, SoupServerMessage *msg, const char *path,
+                                  GHashTable *query, gpointer user_data) {
+    if (soup_server_message_get_method(msg) != SOUP_METHOD_GET) {
+        http_control_respond(msg, SOUP_STATUS_METHOD_NOT_ALLOWED, NULL, "GET only\n");
+        return;
+    }
+
+    const gchar *cameras = query ? g_hash_table_lookup(query, "camera") : NULL;
+    const gchar *start = query ? g_hash_table_lookup(query, "start") : NULL;
+    const gchar *end = query ? g_hash_table_lookup(query, "end") : NULL;
+    const gchar *stream = query ? g_hash_table_lookup(query, "stream") : NULL;
+    if (!cameras || !cameras[0] || !start || !end) {
+        http_control_respond(msg, SOUP_STATUS_BAD_REQUEST, NULL,
+                             "usage: /coverage?camera=<name>[,<name>...]&start=<epoch>&end=<epoch>[&stream=1]\n");
+        return;
+    }
+
+    gint64 start_us = parse_timestamp_us(start);
+    gint64 end_us = parse_timestamp_us(end);
+    gchar **names = g_strsplit(cameras, ",", COVERAGE_MAX_CAMERAS + 1);
+    guint count = g_strv_length(names);
+    if (end_us <= start_us || count > COVERAGE_MAX_CAMERAS) {
+        http_control_respond(msg, SOUP_STATUS_BAD_REQUEST, NULL,
+                             count > COVERAGE_MAX_CAMERAS ? "too many cameras\n" : "end must be after start\n");
+        g_strfreev(names);
+        return;
+    }
+
+    StreamType stream_type = g_strcmp0(stream, "1") == 0 ? STREAM_SUB : STREAM_MAIN;
+    GPtrArray *result = recording_coverage_query_many((const gchar * const *)names, count,
+                                                      stream_type, start_us, end_us);
+    gchar *json = coverage_json(result, start_us, end_us);
+    http_control_respond(msg, SOUP_STATUS_OK, "application/json", json);
+
+    g_free(json);
+    g_ptr_array_unref(result);
+    g_strfreev(names);
+}
+
+void recording_coverage_http_init(void) {
+    http_control_add_handler(COVERAGE_HTTP_PATH, coverage_http_handler, NULL);
+}
@@ -0,0 +1,43 @@
+#ifndef RECORDING_COVERAGE_H
+#define RECORDING_COVERAGE_H
+
+#include <glib.h>
+#include "recording_manager.h"
+#include "segment_index.h"
+
+/* GET /coverage?camera=cam_1[,cam_2...]&start=<epoch>&end=<epoch>[&stream=1] -> JSON */
+#define COVERAGE_HTTP_PATH    "/coverage"
+#define COVERAGE_MAX_CAMERAS  256
+
+/* Hai segment cách nhau ít hơn ngưỡng này (thời gian rotate) coi như liên tục */
+#define COVERAGE_MERGE_GAP_US (2 * G_USEC_PER_SEC)
+
+/* Kết quả cho một camera: các khoảng có recording và khoảng trống trong [start, end) */
+typedef struct {
+    gchar *camera_name;
+    GArray *recorded;   /* SegmentSpan, đã gộp, tăng dần */
+    GArray *gaps;       /* SegmentSpan, phần bù của recorded */
+} RecordingCoverage;
+
+/* Đăng ký nhận thay đổi từ segment index (gọi sau segment_index_init) */
+void recording_coverage_init(void);
+
+/* Coverage của một camera, thời gian tính bằng micro giây UTC */
+RecordingCoverage* recording_coverage_query(const gchar *camera_name,
+                                            StreamType stream_type,
+                                            gint64 start_us,
+                                            gint64 end_us);
+
+/* Coverage của nhiều camera trong một lần gọi (GPtrArray of RecordingCoverage*) */
+GPtrArray* recording_coverage_query_many(const gchar * const *camera_names,
+                                         guint count,
+                                         StreamType stream_type,
+                                         gint64 start_us,
+                                         gint64 end_us);
+
+void recording_coverage_free(RecordingCoverage *coverage);
+
+/* Đăng ký route trên http_control */
+void recording_coverage_http_init(void);
+
+#endif // RECORDING_COVERAGE_H
@@ -0,0 +1,281 @@
+#include "recording_lookup.h"
+#include "storage_tiers.h"
+#include "native_segment.h"
+#include <stdio.h>
+#include <string.h>
+
+gchar* parse_query_param(const gchar *query, const gchar *param) {
+    if (!query) return NULL;
+    gchar *search = g_strdup_printf("%s=", param);
+    /* Chỉ khớp nguyên key: đầu query hoặc sau '&' (?xprofile= không phải profile=) */
+    const gchar *pos = strstr(query, search);
+    while (pos && pos != query && pos[-1] != '&' && pos[-1] != '?') {
+        pos = strstr(pos + 1, search);
+    }
+    g_free(search);
+    if (!pos) return NULL;
+    pos += strlen(param) + 1;
+    const gchar *end = strchr(pos, '&');
+    if (end) return g_strndup(pos, end - pos);
+    return g_strdup(pos);
+}
+
+/* Thư mục giờ theo giờ local: giờ lặp lại khi hết DST có hai nghĩa, lấy nghĩa sớm hơn
+ * (không bỏ sót segment); giờ không tồn tại khi vào DST để mktime tự chuẩn hóa */
+static time_t local_hour_to_timestamp(gint year, gint mon, gint day, gint hour) {
+    time_t best = (time_t)-1;
+
+    for (gint isdst = 0; isdst <= 1; isdst++) {
+        struct tm tm = {0};
+        tm.tm_year = year - 1900;
+        tm.tm_mon  = mon - 1;
+        tm.tm_mday = day;
+        tm.tm_hour = hour;
+        tm.tm_isdst = isdst;
+
+        time_t ts = mktime(&tm);
+        struct tm check;
+        if (ts == (time_t)-1 || !localtime_r(&ts, &check)) continue;
+        if (check.tm_year != year - 1900 || check.tm_mon != mon - 1 ||
+            check.tm_mday != day || check.tm_hour != hour) continue;
+        if (best == (time_t)-1 || ts < best) best = ts;
+    }
+
+    if (best == (time_t)-1) {
+        struct tm tm = {0};
+        tm.tm_year = year - 1900;
+        tm.tm_mon  = mon - 1;
+        tm.tm_mday = day;
+        tm.tm_hour = hour;
+        tm.tm_isdst = -1;
+        best = mktime(&tm);
+    }
+    return best;
+}
+
+gboolean path_to_timestamp(const gchar *path, time_t *out_ts) {
+    const gchar *base = strrchr(path, '/');
+    base = base ? base + 1 : path;
+
+    long ts = 0;
+    if (sscanf(base, "%ld", &ts) == 1 &&
+        ts > 1500000000 && ts < 2000000000) {
+        *out_ts = (time_t)ts;
+        return TRUE;
+    }
+
+    const gchar *p = path;
+    gint year, mon, day, hour;
+
+    while ((p = strchr(p, '/')) != NULL) {
+        p++;
+        if (sscanf(p, "%4d/%2d/%2d/%2d",
+                   &year, &mon, &day, &hour) == 4) {
+            *out_ts = local_hour_to_timestamp(year, mon, day, hour);
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+void scan_recordings_recursive(const gchar *base_dir, GList **files) {
+    GDir *dir = g_dir_open(base_dir, 0, NULL);
+    if (!dir) return;
+
+    const gchar *name;
+    while ((name = g_dir_read_name(dir))) {
+        gchar *full = g_build_filename(base_dir, name, NULL);
+
+        if (g_file_test(full, G_FILE_TEST_IS_DIR)) {
+            scan_recordings_recursive(full, files);
+            g_free(full);
+            continue;
+        }
+
+        if (!g_str_has_suffix(name, ".mp4") && !g_str_has_suffix(name, ".mkv") &&
+            !g_str_has_suffix(name, NATIVE_SEGMENT_EXT)) {
+            g_free(full);
+            continue;
+        }
+
+        time_t file_ts = 0;
+        if (!path_to_timestamp(full, &file_ts)) {
+            g_free(full);
+            continue;
+        }
+
+        *files = g_list_insert_sorted(*files, full, (GCompareFunc)g_strcmp0);
+    }
+
+    g_dir_close(dir);
+}
+
+static gint compare_recording_basename(gconstpointer a, gconstpointer b) {
+    const gchar *name_a = strrchr((const gchar *)a, '/');
+    const gchar *name_b = strrchr((const gchar *)b, '/');
+    return g_strcmp0(name_a ? name_a : a, name_b ? name_b : b);
+}
+
+/* Tra cứu qua segment index - path luôn đúng kể cả khi segment đã bị migrate sang tier khác.
+ * clocks nhận SegmentClock của từng file theo cùng thứ tự. */
+GList* get_recording_files_from_index(const gchar *camera_name,
+                                      gint64 start_us,
+                                      StreamType stream_type,
+                                      gint64 duration,
+                                      GArray *clocks) {
+    gint64 end_us = duration > 0 ? start_us + duration * G_USEC_PER_SEC : g_get_real_time();
+    GList *result = NULL;
+
+    /* Lùi 1 giờ để lấy segment bắt đầu trước start_us */
+    GPtrArray *records = segment_index_query(camera_name, stream_type,
+                                             start_us - 3600 * G_USEC_PER_SEC,
+                                             MAX(end_us, start_us + 1));
+
+    gint first = -1;
+    for (guint i = 0; i < records->len; i++) {
+        SegmentRecord *record = g_ptr_array_index(records, i);
+        if (record->start_us <= start_us) first = (gint)i;
+    }
+
+    if (first >= 0) {
+        for (guint i = first; i < records->len; i++) {
+            SegmentRecord *record = g_ptr_array_index(records, i);
+            result = g_list_append(result, g_strdup(record->path));
+            g_array_append_val(clocks, record->clock);
+            if (duration > 0 && record->start_us >= end_us) break;
+        }
+    }
+
+    /* Segment đang ghi chỉ vào index khi finalize: khoảng yêu cầu kéo qua segment cuối trong
+     * index thì phát tiếp vào segment đang ghi thay vì dừng ở segment trước */
+    gchar *open_path = NULL;
+    gint64 open_start = segment_index_current(camera_name, stream_type, &open_path);
+    gint64 last_start = records->len > 0 ?
+        ((SegmentRecord *)g_ptr_array_index(records, records->len - 1))->start_us : G_MININT64;
+    if (open_start >= 0 && open_start > last_start && open_start < end_us &&
+        (first >= 0 || open_start <= start_us)) {
+        SegmentClock none = {0};
+        result = g_list_append(result, open_path);
+        g_array_append_val(clocks, none);
+        open_path = NULL;
+    }
+    g_free(open_path);
+
+    if (result) {
+        g_print("Index lookup: %d files for %s\n", g_list_length(result), camera_name);
+    }
+
+    g_ptr_array_unref(records);
+    return result;
+}
+
+GList* get_recording_files_from_timestamp(const gchar *camera_name,
+                                          gint64 start_us,
+                                          StreamType stream_type,
+                                          gint64 duration,
+                                          GArray *clocks) {
+    gint64 start_ts = start_us / G_USEC_PER_SEC;
+    GList *all_files = NULL;
+    GList *result = get_recording_files_from_index(camera_name, start_us, stream_type,
+                                                   duration, clocks);
+
+    if (result) {
+        return result;
+    }
+    g_array_set_size(clocks, 0);
+
+    /* Fallback: quét thư mục trên tất cả tier (segment chưa có trong index) */
+    const gchar *quality = stream_type == STREAM_MAIN ? RECORD_HI_QUALITY : RECORD_LOW_QUALITY;
+    gint tier_count = MAX(storage_tiers_count(), 1);
+    gchar *base_dir = NULL;
+
+    g_print("DEBUG: Scanning for files at timestamp %ld (%s)\n", (long)start_ts,
+            g_date_time_format(g_date_time_new_from_unix_local(start_ts), "%Y-%m-%d %H:%M:%S"));
+
+    for (gint t = 0; t < tier_count; t++) {
+        const StorageTier *tier = storage_tiers_get(t);
+        g_free(base_dir);
+        base_dir = g_strdup_printf("%s/%s/%s",
+                                   tier ? tier->root : storage_tiers_primary_root(),
+                                   quality, camera_name);
+        scan_recordings_recursive(base_dir, &all_files);
+    }
+
+    if (!all_files) {
+        g_print("ERROR: No recording files found in %s\n", base_dir);
+        g_free(base_dir);
+        return NULL;
+    }
+
+    g_print("DEBUG: Found %d total files\n", g_list_length(all_files));
+
+    /* Sắp xếp theo tên file (timestamp), không theo full path - các tier có root khác nhau */
+    all_files = g_list_sort(all_files, compare_recording_basename);
+
+    GList *start_file = NULL;
+    time_t best_ts = 0;
+
+    for (GList *l = all_files; l != NULL; l = l->next) {
+        gchar *file = (gchar *)l->data;
+        time_t file_ts = 0;
+
+        if (!path_to_timestamp(file, &file_ts)) continue;
+
+        g_print("  File: %s (ts=%ld, time=%s)\n",
+                file, (long)file_ts,
+                g_date_time_format(g_date_time_new_from_unix_local(file_ts), "%H:%M:%S"));
+
+        if (file_ts <= start_ts) {
+            if (file_ts > best_ts || best_ts == 0) {
+                best_ts = file_ts;
+                start_file = l;
+            }
+        }
+    }
+
+    if (!start_file) {
+        g_print("ERROR: No file found with timestamp <= %ld\n", (long)start_ts);
+        g_list_free_full(all_files, g_free);
+        g_free(base_dir);
+        return NULL;
+    }
+
+    g_print("  ✓ START FILE: %s (ts=%ld)\n", (gchar *)start_file->data, (long)best_ts);
+
+    /* Only include files needed for the duration */
+    gint64 end_ts = start_ts + duration;
+    gboolean found_end = FALSE;
+
+    for (GList *l = start_file; l != NULL; l = l->next) {
+        gchar *file = (gchar *)l->data;
+        SegmentClock none = {0};
+        result = g_list_append(result, g_strdup(file));
+        g_array_append_val(clocks, none);
+
+        /* If duration specified, stop when we have enough files */
+        if (duration > 0) {
+            time_t file_ts = 0;
+            if (path_to_timestamp(file, &file_ts) && file_ts >= end_ts) {
+                found_end = TRUE;
+                break;
+            }
+        }
+    }
+
+    g_list_free_full(all_files, g_free);
+    g_free(base_dir);
+
+    g_print("Selected %d files for playback", g_list_length(result));
+    if (duration > 0) {
+        g_print(" (covering %ld seconds)\n", (long)duration);
+    } else {
+        g_print("\n");
+    }
+
+    return result;
+}
+
+/* ?timestamp= tính bằng giây, cho phép phần lẻ (1731556800.250) để chọn đúng frame */
+gint64 parse_timestamp_us(const gchar *str) {
+    return (gint64)(g_ascii_strtod(str, NULL) * G_USEC_PER_SEC);
+}
@@ -0,0 +1,35 @@
+#ifndef RECORDING_LOOKUP_H
+#define RECORDING_LOOKUP_H
+
+#include <glib.h>
+#include <time.h>
+#include "recording_manager.h"
+#include "segment_index.h"
+
+/* Giá trị của param trong query string (?a=1&b=2), khớp nguyên tên key; NULL nếu không có */
+gchar* parse_query_param(const gchar *query, const gchar *param);
+
+/* ?timestamp= tính bằng giây (cho phép phần lẻ) -> micro giây */
+gint64 parse_timestamp_us(const gchar *str);
+
+/* Thời điểm bắt đầu của file recording theo tên file (<epoch>.mkv) hoặc thư mục Y/m/d/H */
+gboolean path_to_timestamp(const gchar *path, time_t *out_ts);
+
+/* Quét cây thư mục, thêm file .mp4/.mkv có timestamp hợp lệ vào files (sắp xếp theo path) */
+void scan_recordings_recursive(const gchar *base_dir, GList **files);
+
+/* Danh sách file cho playback từ start_us, chỉ qua segment index (NULL nếu index không có) */
+GList* get_recording_files_from_index(const gchar *camera_name,
+                                      gint64 start_us,
+                                      StreamType stream_type,
+                                      gint64 duration,
+                                      GArray *clocks);
+
+/* Như trên, fallback quét thư mục trên tất cả tier khi index không có segment */
+GList* get_recording_files_from_timestamp(const gchar *camera_name,
+                                          gint64 start_us,
+                                          StreamType stream_type,
+                                          gint64 duration,
+                                          GArray *clocks);
+
+#endif // RECORDING_LOOKUP_H
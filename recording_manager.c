@@ -1,10 +1,28 @@
 #include "recording_manager.h"
+#include "segment_index.h"
+#include "segment_clock.h"
+#include "segment_recovery.h"
+#include "storage_tiers.h"
+#include "io_policy.h"
+#include "rtsp_threads.h"
+#include "native_segment.h"
+#include "profiling.h"
+#include "dvr_buffer.h"
+#include "snapshot.h"
+#include "camera_probe.h"
+#include <glib/gstdio.h>
 #include <sys/stat.h>
 #include <sys/statvfs.h>
 #include <time.h>
 #include <dirent.h>
 #include <string.h>
 
+static RecordFormat record_format = RECORD_FORMAT_MKV;
+
+void recording_manager_set_format(RecordFormat format) {
+    record_format = format;
+}
+
 /* Tạo đường dẫn thư mục theo thời gian */
 static gchar* get_recording_directory(const gchar *camera_name, StreamType stream_type) {
     time_t now = time(NULL);
@@ -12,8 +30,9 @@ static gchar* get_recording_directory(const gchar *camera_name, StreamType strea
 
     const gchar *quality = (stream_type == STREAM_MAIN) ? RECORD_HI_QUALITY : RECORD_LOW_QUALITY;
 
+    /* Segment mới luôn ghi vào tier nhanh nhất */
     return g_strdup_printf("%s/%s/%s/%04d/%02d/%02d/%02d",
-                          RECORD_BASE_PATH, quality, camera_name,
+                          storage_tiers_primary_root(), quality, camera_name,
                           tm_info->tm_year + 1900,
                           tm_info->tm_mon + 1,
                           tm_info->tm_mday,
@@ -127,6 +146,12 @@ static gboolean bus_call(GstBus *bus, GstMessage *msg, gpointer data) {
     return TRUE;
 }
 
+/* Buffer đầu tới sink: segment đã thực sự có dữ liệu */
+static GstPadProbeReturn first_buffer_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    g_atomic_int_set((gint *)user_data, 1);
+    return GST_PAD_PROBE_REMOVE;
+}
+
 /* Tạo recording pipeline - Version 4: splitmuxsink FIXED */
 static gboolean create_recording_pipeline(RecordingPipeline *rec) {
     GstBus *bus;
@@ -146,10 +171,12 @@ static gboolean create_recording_pipeline(RecordingPipeline *rec) {
     rec->depay = gst_element_factory_make(rec->is_h265 ? "rtph265depay" : "rtph264depay", NULL);
     rec->parser = gst_element_factory_make(rec->is_h265 ? "h265parse" : "h264parse", NULL);
     GstElement *queue = gst_element_factory_make("queue", NULL);
-    GstElement *muxer = gst_element_factory_make("matroskamux", NULL);
-    GstElement *filesink = gst_element_factory_make("filesink", NULL);
+    gboolean native = record_format == RECORD_FORMAT_NATIVE;
+    /* Native: parser ghi thẳng AU ra file, không qua muxer */
+    GstElement *muxer = native ? NULL : gst_element_factory_make("matroskamux", NULL);
+    GstElement *filesink = gst_element_factory_make(native ? NATIVE_SEGMENT_SINK_NAME : "filesink", NULL);
 
-    if (!rec->source || !rec->depay || !rec->parser || !queue || !muxer || !filesink) {
+    if (!rec->source || !rec->depay || !rec->parser || !queue || (!native && !muxer) || !filesink) {
         g_printerr("Failed to create elements\n");
         goto error;
     }
@@ -163,7 +190,7 @@ static gboolean create_recording_pipeline(RecordingPipeline *rec) {
                  "retry", 5,
                  "timeout", 5000000,
                  "tcp-timeout", 5000000,
-                 "do-rtcp", FALSE,
+                 "do-rtcp", TRUE,
                  "drop-on-latency", TRUE,
                  NULL);
 
@@ -180,11 +207,13 @@ static gboolean create_recording_pipeline(RecordingPipeline *rec) {
                  "leaky", 2,
                  NULL);
 
-    /* Cấu hình muxer */
-    g_object_set(muxer,
-                 "streamable", TRUE,
-                 "writing-app", "RTSP Recorder",
-                 NULL);
+    /* Cấu hình muxer - không streamable để EOS ghi được Duration/Cues */
+    if (muxer) {
+        g_object_set(muxer,
+                     "streamable", FALSE,
+                     "writing-app", "RTSP Recorder",
+                     NULL);
+    }
 
     /* Tạo thư mục và file đầu tiên */
     gchar *dir = get_recording_directory(rec->camera_name, rec->stream_type);
@@ -200,14 +229,37 @@ static gboolean create_recording_pipeline(RecordingPipeline *rec) {
     g_free(temp);
 
     time_t now = time(NULL);
-    gchar *filename = g_strdup_printf("%s/%ld.mkv", dir, now);
+    gchar *filename = g_strdup_printf("%s/%ld%s", dir, now, native ? NATIVE_SEGMENT_EXT : ".mkv");
+
+    /* Marker journal: segment chưa finalize cho tới khi EOS xong */
+    g_free(rec->segment_path);
+    rec->segment_path = g_strdup(filename);
+    rec->segment_start_us = (gint64)now * G_USEC_PER_SEC;
+    segment_journal_open(rec->camera_name, rec->stream_type,
+                         rec->segment_start_us, rec->segment_path);
+
+    /* Cấu hình filesink (nativesegmentsink tự tắt sync/async) */
+    g_object_set(filesink, "location", filename, NULL);
+    if (!native) {
+        g_object_set(filesink,
+                     "async", FALSE,
+                     "sync", FALSE,
+                     NULL);
+    }
 
-    /* Cấu hình filesink */
-    g_object_set(filesink,
-                 "location", filename,
-                 "async", FALSE,
-                 "sync", FALSE,
-                 NULL);
+    /* Mapping thời gian trong file <-> wallclock từ RTCP SR (playback chính xác tới frame).
+     * Heap: mảng pipelines có thể realloc trong khi probe còn giữ con trỏ */
+    if (!rec->segment_clock) rec->segment_clock = g_new0(SegmentClock, 1);
+    segment_clock_capture(rec->source, rec->depay, rec->segment_clock);
+
+    if (!rec->writing) rec->writing = g_new0(gint, 1);
+    g_atomic_int_set(rec->writing, 0);
+    GstPad *sink_pad = gst_element_get_static_pad(filesink, "sink");
+    gst_pad_add_probe(sink_pad, GST_PAD_PROBE_TYPE_BUFFER, first_buffer_probe, rec->writing, NULL);
+    gst_object_unref(sink_pad);
+
+    /* Dữ liệu recording không ai đọc ngay - đẩy xuống disk và bỏ khỏi page cache theo window */
+    io_policy_attach_writer(filesink, filename);
 
     g_print("[%s-%s] Recording to: %s\n",
            rec->camera_name,
@@ -224,11 +276,14 @@ static gboolean create_recording_pipeline(RecordingPipeline *rec) {
 
     /* Add elements */
     gst_bin_add_many(GST_BIN(rec->pipeline),
-                     rec->source, rec->depay, rec->parser, queue, muxer, filesink,
+                     rec->source, rec->depay, rec->parser, queue, filesink,
                      NULL);
+    if (muxer) gst_bin_add(GST_BIN(rec->pipeline), muxer);
 
-    /* Link: depay -> parser -> queue -> muxer -> filesink */
-    if (!gst_element_link_many(rec->depay, rec->parser, queue, muxer, filesink, NULL)) {
+    /* Link: depay -> parser -> queue -> [muxer] -> filesink */
+    gboolean linked = muxer ? gst_element_link_many(rec->depay, rec->parser, queue, muxer, filesink, NULL)
+                            : gst_element_link_many(rec->depay, rec->parser, queue, filesink, NULL);
+    if (!linked) {
         g_printerr("Failed to link elements\n");
         goto error;
     }
@@ -241,6 +296,18 @@ static gboolean create_recording_pipeline(RecordingPipeline *rec) {
     gst_bus_add_watch(bus, bus_call, rec);
     gst_object_unref(bus);
 
+    /* Streaming thread của recording tách khỏi core phục vụ client */
+    rtsp_threads_pin_pipeline(rec->pipeline, THREAD_ROLE_RECORDING);
+    gchar *label = g_strdup_printf("rec:%s-%s", rec->camera_name,
+                                   rec->stream_type == STREAM_MAIN ? "main" : "sub");
+    profiling_track_pipeline(rec->pipeline, label);
+    g_free(label);
+
+    /* Timeshift trên mount live: AU sau parser vào ring trong RAM (?dvr=) */
+    dvr_buffer_attach(rec->parser, rec->camera_name, rec->stream_type);
+    /* Ảnh tĩnh cho /snapshot từ keyframe gần nhất, không mở kết nối riêng tới camera */
+    snapshot_attach(rec->parser, rec->camera_name, rec->stream_type);
+
     return TRUE;
 
 error:
@@ -248,6 +315,11 @@ error:
         gst_object_unref(rec->pipeline);
         rec->pipeline = NULL;
     }
+    if (rec->segment_path) {
+        segment_journal_close(rec->camera_name, rec->stream_type, rec->segment_start_us);
+        g_free(rec->segment_path);
+        rec->segment_path = NULL;
+    }
     return FALSE;
 }
 
@@ -296,11 +368,79 @@ static void on_pad_added(GstElement *src, GstPad *new_pad, gpointer data) {
     g_object_unref(sink_pad);
 }
 
+/* Kết thúc segment: gửi EOS để matroskamux ghi Duration/Cues rồi mới set NULL.
+ * Segment không nhận được EOS kịp thời sẽ được sửa ở background. */
+static void finalize_recording_segment(RecordingPipeline *rec) {
+    if (!rec->pipeline) return;
+
+    GstBus *bus = gst_pipeline_get_bus(GST_PIPELINE(rec->pipeline));
+    gst_bus_remove_watch(bus);
+
+    gboolean finalized = FALSE;
+    if (gst_element_send_event(rec->pipeline, gst_event_new_eos())) {
+        GstMessage *msg = gst_bus_timed_pop_filtered(bus, RECORD_EOS_TIMEOUT_NS,
+                                                     GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+        finalized = msg && GST_MESSAGE_TYPE(msg) == GST_MESSAGE_EOS;
+        if (msg) gst_message_unref(msg);
+    }
+    gst_object_unref(bus);
+
+    gst_element_set_state(rec->pipeline, GST_STATE_NULL);
+    gst_element_get_state(rec->pipeline, NULL, NULL, 2 * GST_SECOND);
+    gst_object_unref(rec->pipeline);
+    rec->pipeline = NULL;
+
+    if (!rec->segment_path) return;
+
+    if (finalized && !g_file_test(rec->segment_path, G_FILE_TEST_EXISTS)) {
+        /* nativesegmentsink chỉ tạo file ở keyframe đầu: EOS trước đó thì không có gì để index */
+        g_print("[%s-%s] No keyframe before EOS, %s not written\n",
+                rec->camera_name,
+                rec->stream_type == STREAM_MAIN ? "MAIN" : "SUB",
+                rec->segment_path);
+        segment_journal_close(rec->camera_name, rec->stream_type, rec->segment_start_us);
+    } else if (finalized) {
+        segment_index_add(rec->camera_name, rec->stream_type,
+                          rec->segment_start_us, g_get_real_time(),
+                          rec->segment_path, 0);
+        if (rec->segment_clock && rec->segment_clock->source != SEGMENT_CLOCK_NONE) {
+            segment_index_set_clock(rec->camera_name, rec->stream_type,
+                                    rec->segment_start_us, rec->segment_path, rec->segment_clock);
+        }
+        segment_journal_close(rec->camera_name, rec->stream_type, rec->segment_start_us);
+        io_policy_drop_file_async(rec->segment_path);
+    } else {
+        g_printerr("[%s-%s] EOS not received, repairing %s in background\n",
+                   rec->camera_name,
+                   rec->stream_type == STREAM_MAIN ? "MAIN" : "SUB",
+                   rec->segment_path);
+        segment_recovery_repair_async(rec->camera_name, rec->stream_type,
+                                      rec->segment_start_us, rec->segment_path);
+    }
+
+    g_free(rec->segment_path);
+    rec->segment_path = NULL;
+}
+
+static void set_running(RecordingPipeline *rec, gboolean running) {
+    g_mutex_lock(&rec->state_lock);
+    rec->is_running = running;
+    g_cond_broadcast(&rec->state_cond);
+    g_mutex_unlock(&rec->state_lock);
+}
+
+static gboolean pipeline_running(RecordingPipeline *rec) {
+    g_mutex_lock(&rec->state_lock);
+    gboolean running = rec->is_running;
+    g_mutex_unlock(&rec->state_lock);
+    return running;
+}
+
 /* Rotate recording file bằng cách recreate pipeline */
 static gboolean rotate_recording_pipeline(gpointer user_data) {
     RecordingPipeline *rec = (RecordingPipeline *)user_data;
 
-    if (!rec->is_running || !rec->pipeline) {
+    if (!pipeline_running(rec) || !rec->pipeline) {
         return G_SOURCE_REMOVE;
     }
 
@@ -325,20 +465,8 @@ static gboolean rotate_recording_pipeline(gpointer user_data) {
             g_free(old_location);
         }
 
-    /* ===== QUAN TRỌNG: Remove bus watch trước ===== */
-    GstBus *old_bus = gst_pipeline_get_bus(GST_PIPELINE(rec->pipeline));
-    gst_bus_remove_watch(old_bus);
-    gst_object_unref(old_bus);
-
-    /* Stop current pipeline - KHÔNG gửi EOS */
-    gst_element_set_state(rec->pipeline, GST_STATE_NULL);
-
-    /* Wait for NULL state */
-    gst_element_get_state(rec->pipeline, NULL, NULL, 2 * GST_SECOND);
-
-    /* Unref pipeline */
-    gst_object_unref(rec->pipeline);
-    rec->pipeline = NULL;
+    /* Finalize segment hiện tại (EOS) rồi mới dừng pipeline */
+    finalize_recording_segment(rec);
 
     /* Small delay để đảm bảo cleanup hoàn toàn */
     g_usleep(100000);  // 100ms
@@ -348,7 +476,7 @@ static gboolean rotate_recording_pipeline(gpointer user_data) {
         g_printerr("[%s-%s] Failed to recreate pipeline\n",
                   rec->camera_name,
                   rec->stream_type == STREAM_MAIN ? "MAIN" : "SUB");
-        rec->is_running = FALSE;
+        set_running(rec, FALSE);
         return G_SOURCE_REMOVE;
     }
 
@@ -361,9 +489,8 @@ static gboolean rotate_recording_pipeline(gpointer user_data) {
         g_printerr("[%s-%s] Failed to start new pipeline\n",
                   rec->camera_name,
                   rec->stream_type == STREAM_MAIN ? "MAIN" : "SUB");
-        gst_object_unref(rec->pipeline);
-        rec->pipeline = NULL;
-        rec->is_running = FALSE;
+        finalize_recording_segment(rec);
+        set_running(rec, FALSE);
         return G_SOURCE_REMOVE;
     }
 
@@ -373,10 +500,8 @@ static gboolean rotate_recording_pipeline(gpointer user_data) {
         g_printerr("[%s-%s] Pipeline failed to reach PLAYING state after rotation\n",
                   rec->camera_name,
                   rec->stream_type == STREAM_MAIN ? "MAIN" : "SUB");
-        gst_element_set_state(rec->pipeline, GST_STATE_NULL);
-        gst_object_unref(rec->pipeline);
-        rec->pipeline = NULL;
-        rec->is_running = FALSE;
+        finalize_recording_segment(rec);
+        set_running(rec, FALSE);
         return G_SOURCE_REMOVE;
     }
 
@@ -387,6 +512,37 @@ static gboolean rotate_recording_pipeline(gpointer user_data) {
     return G_SOURCE_CONTINUE;
 }
 
+/* Probe lại SDP của stream; FALSE nếu vẫn không biết codec (stream không được ghi) */
+static gboolean resolve_pending_codec(RecordingPipeline *rec) {
+    for (gint attempt = 1; attempt <= RECORD_CODEC_PROBE_ATTEMPTS; attempt++) {
+        if (g_atomic_int_get(&rec->stop_requested)) return FALSE;
+
+        StreamProbeInfo info = { 0 };
+        gboolean probed = camera_probe_stream(rec->rtsp_url, CAMERA_PROBE_TIMEOUT_MS, &info);
+        CodecType codec = info.codec;
+        camera_probe_info_clear(&info);
+
+        if (probed) {
+            rec->is_h265 = (codec == CODEC_H265);
+            rec->codec_pending = FALSE;
+            g_print("[%s-%s] Codec detected: %s\n",
+                    rec->camera_name,
+                    rec->stream_type == STREAM_MAIN ? "MAIN" : "SUB",
+                    rec->is_h265 ? "H265" : "H264");
+            return TRUE;
+        }
+
+        g_printerr("[%s-%s] Codec probe failed (attempt %d/%d)\n",
+                   rec->camera_name,
+                   rec->stream_type == STREAM_MAIN ? "MAIN" : "SUB",
+                   attempt, RECORD_CODEC_PROBE_ATTEMPTS);
+        if (attempt < RECORD_CODEC_PROBE_ATTEMPTS) {
+            g_usleep(RECORD_CODEC_PROBE_RETRY_SEC * G_USEC_PER_SEC);
+        }
+    }
+    return FALSE;
+}
+
 static gpointer recording_thread_func(gpointer data) {
     RecordingPipeline *rec = (RecordingPipeline *)data;
 
@@ -394,13 +550,24 @@ static gpointer recording_thread_func(gpointer data) {
            rec->camera_name,
            rec->stream_type == STREAM_MAIN ? "MAIN" : "SUB");
 
+    /* Context riêng cho thread: bus watch và timer rotate chạy trên thread này */
+    GMainContext *context = g_main_context_new();
+    g_main_context_push_thread_default(context);
+
+    /* Ghi sai codec thì file không dùng được: không đoán, bỏ stream tới lần start sau */
+    if (rec->codec_pending && !resolve_pending_codec(rec)) {
+        g_printerr("[%s-%s] Codec unknown, stream not recorded\n",
+                  rec->camera_name,
+                  rec->stream_type == STREAM_MAIN ? "MAIN" : "SUB");
+        goto out;
+    }
+
     /* Create pipeline */
     if (!create_recording_pipeline(rec)) {
         g_printerr("[%s-%s] Failed to create recording pipeline\n",
                   rec->camera_name,
                   rec->stream_type == STREAM_MAIN ? "MAIN" : "SUB");
-        rec->is_running = FALSE;
-        return NULL;
+        goto out;
     }
 
     /* Connect pad-added signal */
@@ -416,9 +583,8 @@ static gpointer recording_thread_func(gpointer data) {
         g_printerr("[%s-%s] Failed to start recording pipeline\n",
                   rec->camera_name,
                   rec->stream_type == STREAM_MAIN ? "MAIN" : "SUB");
-        gst_object_unref(rec->pipeline);
-        rec->is_running = FALSE;
-        return NULL;
+        finalize_recording_segment(rec);
+        goto out;
     }
 
     /* Wait for state change */
@@ -428,37 +594,49 @@ static gpointer recording_thread_func(gpointer data) {
         g_printerr("[%s-%s] Pipeline failed to reach PLAYING state\n",
                   rec->camera_name,
                   rec->stream_type == STREAM_MAIN ? "MAIN" : "SUB");
-        gst_element_set_state(rec->pipeline, GST_STATE_NULL);
-        gst_object_unref(rec->pipeline);
-        rec->is_running = FALSE;
-        return NULL;
+        finalize_recording_segment(rec);
+        goto out;
     }
 
     /* Create main loop */
-    rec->loop = g_main_loop_new(NULL, FALSE);
+    GMainLoop *loop = g_main_loop_new(context, FALSE);
+    g_mutex_lock(&rec->state_lock);
+    rec->context = context;
+    rec->loop = loop;
+    g_cond_broadcast(&rec->state_cond);
+    g_mutex_unlock(&rec->state_lock);
 
     /* Thêm timer để rotate file mỗi 2 phút (120 giây) */
-    g_timeout_add_seconds(80, rotate_recording_pipeline, rec);
+    GSource *timer = g_timeout_source_new_seconds(80);
+    g_source_set_callback(timer, rotate_recording_pipeline, rec, NULL);
+    g_source_attach(timer, context);
+    g_source_unref(timer);
 
     g_print("[%s-%s] Recording loop started successfully\n",
            rec->camera_name,
            rec->stream_type == STREAM_MAIN ? "MAIN" : "SUB");
 
-    g_main_loop_run(rec->loop);
+    g_main_loop_run(loop);
 
     /* Cleanup */
     g_print("[%s-%s] Stopping recording...\n",
            rec->camera_name,
            rec->stream_type == STREAM_MAIN ? "MAIN" : "SUB");
 
-    if (rec->pipeline) {
-        gst_element_set_state(rec->pipeline, GST_STATE_NULL);
-        gst_object_unref(rec->pipeline);
-    }
+    /* Finalize segment cuối trước khi thoát */
+    finalize_recording_segment(rec);
+
+    g_mutex_lock(&rec->state_lock);
+    rec->loop = NULL;
+    rec->context = NULL;
+    g_mutex_unlock(&rec->state_lock);
+    g_main_loop_unref(loop);
 
-    g_main_loop_unref(rec->loop);
+out:
+    g_main_context_pop_thread_default(context);
+    g_main_context_unref(context);
 
-    rec->is_running = FALSE;
+    set_running(rec, FALSE);
     return NULL;
 }
 /* ===== PUBLIC API ===== */
@@ -475,8 +653,15 @@ gboolean recording_manager_add_camera(RecordingManager *manager,
                                       const gchar *camera_name,
                                       const gchar *rtsp_url_main,
                                       const gchar *rtsp_url_sub,
-                                      gboolean is_h265_main,
-                                      gboolean is_h265_sub) {
+                                      CodecType codec_main,
+                                      CodecType codec_sub) {
+    /* CODEC_AUTO chưa probe được: thread recording probe lại khi start */
+    if (codec_main == CODEC_AUTO || codec_sub == CODEC_AUTO) {
+        g_printerr("Camera %s: codec not detected yet, probing again when recording starts\n", camera_name);
+    }
+    gboolean is_h265_main = (codec_main == CODEC_H265);
+    gboolean is_h265_sub = (codec_sub == CODEC_H265);
+
     if (manager->count + 2 > manager->capacity) {
         manager->capacity *= 2;
         manager->pipelines = g_renew(RecordingPipeline, manager->pipelines, manager->capacity);
@@ -489,6 +674,9 @@ gboolean recording_manager_add_camera(RecordingManager *manager,
     main_rec->rtsp_url = g_strdup(rtsp_url_main);
     main_rec->stream_type = STREAM_MAIN;
     main_rec->is_h265 = is_h265_main;
+    main_rec->codec_pending = (codec_main == CODEC_AUTO);
+    g_mutex_init(&main_rec->state_lock);
+    g_cond_init(&main_rec->state_cond);
 
     /* Sub stream */
     RecordingPipeline *sub_rec = &manager->pipelines[manager->count++];
@@ -497,34 +685,77 @@ gboolean recording_manager_add_camera(RecordingManager *manager,
     sub_rec->rtsp_url = g_strdup(rtsp_url_sub);
     sub_rec->stream_type = STREAM_SUB;
     sub_rec->is_h265 = is_h265_sub;
+    sub_rec->codec_pending = (codec_sub == CODEC_AUTO);
+    g_mutex_init(&sub_rec->state_lock);
+    g_cond_init(&sub_rec->state_cond);
 
     g_print("Added camera: %s (Main: %s, Sub: %s)\n",
             camera_name,
-            is_h265_main ? "H265" : "H264",
-            is_h265_sub ? "H265" : "H264");
+            codec_main == CODEC_AUTO ? "?" : is_h265_main ? "H265" : "H264",
+            codec_sub == CODEC_AUTO ? "?" : is_h265_sub ? "H265" : "H264");
 
     return TRUE;
 }
 
-void recording_manager_start_all(RecordingManager *manager) {
+static void start_pipeline(RecordingPipeline *rec) {
+    if (pipeline_running(rec)) return;
+
+    /* Thread của lần chạy trước đã kết thúc (is_running = FALSE) nhưng chưa join */
+    if (rec->thread) {
+        g_thread_join(rec->thread);
+        rec->thread = NULL;
+    }
+
+    set_running(rec, TRUE);
+    g_atomic_int_set(&rec->stop_requested, FALSE);
+    /* Tên thread tối đa 15 byte */
+    gchar *name = g_strdup_printf("rec-%s-%c", rec->camera_name, rec->stream_type == STREAM_MAIN ? 'M' : 'S');
+    if (strlen(name) > 15) {
+        memmove(name + 4, name + strlen(name) - 11, 12);
+    }
+    rec->thread = g_thread_new(name, recording_thread_func, rec);
+    g_free(name);
+    g_print("Started recording: %s (%s)\n",
+            rec->camera_name,
+            rec->stream_type == STREAM_MAIN ? "MAIN" : "SUB");
+}
+
+static gboolean quit_recording_loop(gpointer data) {
+    g_main_loop_quit((GMainLoop *)data);
+    return G_SOURCE_REMOVE;
+}
+
+/* Quit loop của các pipeline được chọn trước, rồi join - các thread finalize segment (EOS) song song */
+static void stop_pipelines(RecordingManager *manager, const gchar *camera_name) {
     for (gint i = 0; i < manager->count; i++) {
         RecordingPipeline *rec = &manager->pipelines[i];
-        if (!rec->is_running) {
-            rec->is_running = TRUE;
-            rec->thread = g_thread_new(NULL, recording_thread_func, rec);
-            g_print("Started recording: %s (%s)\n",
-                    rec->camera_name,
-                    rec->stream_type == STREAM_MAIN ? "MAIN" : "SUB");
+        if (camera_name && g_strcmp0(rec->camera_name, camera_name) != 0) continue;
+        g_atomic_int_set(&rec->stop_requested, TRUE);
+
+        /* Thread còn đang chờ pipeline PLAYING (tối đa 5 giây): chờ loop được tạo */
+        g_mutex_lock(&rec->state_lock);
+        while (rec->is_running && !rec->loop) {
+            g_cond_wait(&rec->state_cond, &rec->state_lock);
         }
+
+        /* Quit qua context của thread: có hiệu lực cả khi loop chưa kịp chạy.
+         * Loop còn khi rotation lỗi (is_running đã FALSE) - vẫn phải quit để join được */
+        if (rec->loop) {
+            GSource *source = g_idle_source_new();
+            g_source_set_callback(source, quit_recording_loop,
+                                  g_main_loop_ref(rec->loop), (GDestroyNotify)g_main_loop_unref);
+            g_source_attach(source, rec->context);
+            g_source_unref(source);
+        }
+        g_mutex_unlock(&rec->state_lock);
     }
-}
 
-void recording_manager_stop_all(RecordingManager *manager) {
     for (gint i = 0; i < manager->count; i++) {
         RecordingPipeline *rec = &manager->pipelines[i];
-        if (rec->is_running && rec->loop) {
-            g_main_loop_quit(rec->loop);
+        if (camera_name && g_strcmp0(rec->camera_name, camera_name) != 0) continue;
+        if (rec->thread) {
             g_thread_join(rec->thread);
+            rec->thread = NULL;
             g_print("Stopped recording: %s (%s)\n",
                     rec->camera_name,
                     rec->stream_type == STREAM_MAIN ? "MAIN" : "SUB");
@@ -532,6 +763,38 @@ void recording_manager_stop_all(RecordingManager *manager) {
     }
 }
 
+void recording_manager_start_all(RecordingManager *manager) {
+    for (gint i = 0; i < manager->count; i++) {
+        start_pipeline(&manager->pipelines[i]);
+    }
+}
+
+void recording_manager_stop_all(RecordingManager *manager) {
+    stop_pipelines(manager, NULL);
+}
+
+void recording_manager_start_camera(RecordingManager *manager, const gchar *camera_name) {
+    for (gint i = 0; i < manager->count; i++) {
+        RecordingPipeline *rec = &manager->pipelines[i];
+        if (g_strcmp0(rec->camera_name, camera_name) == 0) {
+            start_pipeline(rec);
+        }
+    }
+}
+
+void recording_manager_stop_camera(RecordingManager *manager, const gchar *camera_name) {
+    stop_pipelines(manager, camera_name);
+}
+
+gboolean recording_manager_all_writing(RecordingManager *manager) {
+    for (gint i = 0; i < manager->count; i++) {
+        RecordingPipeline *rec = &manager->pipelines[i];
+        if (!pipeline_running(rec)) continue;
+        if (!rec->writing || !g_atomic_int_get(rec->writing)) return FALSE;
+    }
+    return TRUE;
+}
+
 void recording_manager_free(RecordingManager *manager) {
     recording_manager_stop_all(manager);
 
@@ -539,12 +802,40 @@ void recording_manager_free(RecordingManager *manager) {
         RecordingPipeline *rec = &manager->pipelines[i];
         g_free(rec->camera_name);
         g_free(rec->rtsp_url);
+        g_free(rec->segment_path);
+        g_free(rec->segment_clock);
+        g_free(rec->writing);
+        g_mutex_clear(&rec->state_lock);
+        g_cond_clear(&rec->state_cond);
     }
 
     g_free(manager->pipelines);
     g_free(manager);
 }
 
+typedef struct {
+    gchar *camera_name;
+    StreamType stream_type;
+    GArray *days;
+    guint next_day;
+} RetentionStream;
+
+static void retention_stream_free(gpointer data) {
+    RetentionStream *rs = data;
+    g_free(rs->camera_name);
+    g_array_unref(rs->days);
+    g_free(rs);
+}
+
+static void retention_collect_stream(const gchar *camera_name, StreamType stream_type,
+                                     gpointer user_data) {
+    RetentionStream *rs = g_new0(RetentionStream, 1);
+    rs->camera_name = g_strdup(camera_name);
+    rs->stream_type = stream_type;
+    rs->days = segment_index_list_days(camera_name, stream_type);
+    g_ptr_array_add(user_data, rs);
+}
+
 /* Cleanup old recordings */
 void cleanup_old_recordings(const gchar *base_path, guint64 max_size_gb) {
     struct statvfs stat;
@@ -561,9 +852,56 @@ void cleanup_old_recordings(const gchar *base_path, guint64 max_size_gb) {
 
     g_print("Low disk space (%lu GB), cleaning old recordings...\n", available_gb);
 
-    /* TODO: Implement logic xóa file cũ nhất
-     * - Duyệt thư mục đệ quy
-     * - Sắp xếp theo thời gian
-     * - Xóa file cũ nhất cho đến khi đủ dung lượng
-     */
+    /* Chỉ xóa segment nằm trên tier của base_path (theo vị trí trong index),
+     * ngày cũ nhất trước, cho tới khi đủ dung lượng */
+    gint tier = storage_tier_for_path(base_path);
+    gsize base_len = strlen(base_path);
+    GPtrArray *streams = g_ptr_array_new_with_free_func(retention_stream_free);
+    segment_index_foreach_stream(retention_collect_stream, streams);
+
+    guint removed = 0;
+    gboolean enough = FALSE;
+
+    while (!enough) {
+        /* Ngày cũ nhất còn lại trong tất cả stream */
+        gint64 oldest = G_MAXINT64;
+        for (guint s = 0; s < streams->len; s++) {
+            RetentionStream *rs = g_ptr_array_index(streams, s);
+            if (rs->next_day < rs->days->len) {
+                oldest = MIN(oldest, g_array_index(rs->days, gint64, rs->next_day));
+            }
+        }
+        if (oldest == G_MAXINT64) break;
+
+        for (guint s = 0; s < streams->len; s++) {
+            RetentionStream *rs = g_ptr_array_index(streams, s);
+            if (rs->next_day >= rs->days->len ||
+                g_array_index(rs->days, gint64, rs->next_day) != oldest) continue;
+            rs->next_day++;
+
+            GPtrArray *records = segment_index_get_day(rs->camera_name, rs->stream_type, oldest);
+            for (guint i = 0; i < records->len; i++) {
+                SegmentRecord *record = g_ptr_array_index(records, i);
+                gboolean on_tier = tier >= 0 ? storage_tier_for_path(record->path) == tier
+                                             : strncmp(record->path, base_path, base_len) == 0;
+                if (!on_tier) continue;
+
+                /* Index trước, file sau: compactor kiểm tra segment dưới index lock
+                 * trước khi rename nên không tạo lại file vừa xóa */
+                segment_index_remove(rs->camera_name, rs->stream_type,
+                                     record->start_us, record->path);
+                g_unlink(record->path);
+                removed++;
+            }
+            g_ptr_array_unref(records);
+        }
+
+        if (statvfs(base_path, &stat) == 0) {
+            available_gb = (stat.f_bavail * stat.f_frsize) / (1024 * 1024 * 1024);
+            enough = available_gb > max_size_gb;
+        }
+    }
+
+    g_ptr_array_unref(streams);
+    g_print("Removed %u old segment(s), %lu GB available\n", removed, available_gb);
 }
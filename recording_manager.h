@@ -3,17 +3,27 @@
 
 #include <gst/gst.h>
 #include <glib.h>
+#include "camera_config.h"
 
 #define RECORD_BASE_PATH "/home/oryza/Oryza/recordings"
 #define RECORD_HI_QUALITY "hi_quality"
 #define RECORD_LOW_QUALITY "low_quality"
 #define MAX_FILE_DURATION_NS 120000000000ULL
+/* CODEC_AUTO chưa probe được lúc khởi động: số lần probe lại trước khi bỏ stream */
+#define RECORD_CODEC_PROBE_ATTEMPTS   3
+#define RECORD_CODEC_PROBE_RETRY_SEC  2
 
 typedef enum {
     STREAM_MAIN,
     STREAM_SUB
 } StreamType;
 
+/* Định dạng file segment khi ghi */
+typedef enum {
+    RECORD_FORMAT_MKV,
+    RECORD_FORMAT_NATIVE    /* native_segment.h: AU length-prefixed + index, playback mmap */
+} RecordFormat;
+
 typedef struct {
     gchar *camera_name;
     gchar *rtsp_url;
@@ -25,9 +35,18 @@ typedef struct {
     GstElement *tee;
     GstElement *splitmux;
     gboolean is_h265;
+    gboolean codec_pending;   /* CODEC_AUTO chưa xác định: probe lại khi start, không đoán codec */
     gboolean is_running;
+    gint stop_requested;      /* atomic: stop trong lúc thread còn probe codec */
     GThread *thread;
+    GMainContext *context;
     GMainLoop *loop;
+    GMutex state_lock;        /* is_running/context/loop giữa thread recording và stop */
+    GCond state_cond;
+    gchar *segment_path;      /* segment đang ghi */
+    gint64 segment_start_us;  /* wallclock lúc mở segment */
+    struct SegmentClock *segment_clock;  /* mapping PTS <-> wallclock của segment đang ghi */
+    gint *writing;            /* heap như segment_clock: 1 khi pipeline hiện tại đã ghi buffer đầu */
 } RecordingPipeline;
 
 typedef struct {
@@ -44,8 +63,11 @@ gboolean recording_manager_add_camera(RecordingManager *manager,
                                       const gchar *camera_name,
                                       const gchar *rtsp_url_main,
                                       const gchar *rtsp_url_sub,
-                                      gboolean is_h265_main,
-                                      gboolean is_h265_sub);
+                                      CodecType codec_main,
+                                      CodecType codec_sub);
+
+/* Định dạng cho segment mới (mặc định MKV); gọi trước khi start */
+void recording_manager_set_format(RecordFormat format);
 
 /* Bắt đầu record tất cả cameras */
 void recording_manager_start_all(RecordingManager *manager);
@@ -53,6 +75,14 @@ void recording_manager_start_all(RecordingManager *manager);
 /* Dừng record tất cả cameras */
 void recording_manager_stop_all(RecordingManager *manager);
 
+/* Bắt đầu/dừng record một camera (cả main và sub), dừng thì chờ finalize segment cuối */
+void recording_manager_start_camera(RecordingManager *manager, const gchar *camera_name);
+void recording_manager_stop_camera(RecordingManager *manager, const gchar *camera_name);
+
+/* Mọi recording đang chạy đã ghi được dữ liệu? (TRUE nếu không có recording nào).
+ * Dùng khi restart không downtime: process cũ chỉ dừng ghi sau khi process mới đã ghi */
+gboolean recording_manager_all_writing(RecordingManager *manager);
+
 /* Giải phóng resources */
 void recording_manager_free(RecordingManager *manager);
 
@@ -0,0 +1,150 @@
+#define _GNU_SOURCE
+#include "rtsp_threads.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+
+static const gchar *role_names[THREAD_ROLE_COUNT] = { "rtsp", "ingest", "recording" };
+/* Tiền tố tên streaming thread (top -H, profiling gộp CPU theo nhóm) */
+static const gchar *role_prefixes[THREAD_ROLE_COUNT] = { "rtsp", "ing", "rec" };
+
+static cpu_set_t role_cpus[THREAD_ROLE_COUNT];
+static gboolean role_pinned[THREAD_ROLE_COUNT];
+
+/* ===== Thread pool pin thread khi vào vòng lặp ===== */
+
+typedef struct {
+    GstRTSPThreadPool parent;
+} PinnedThreadPool;
+
+typedef struct {
+    GstRTSPThreadPoolClass parent_class;
+} PinnedThreadPoolClass;
+
+G_DEFINE_TYPE(PinnedThreadPool, pinned_thread_pool, GST_TYPE_RTSP_THREAD_POOL)
+
+/* Chạy trên chính worker thread, trước g_main_loop_run() của thread đó */
+static void pinned_thread_pool_thread_enter(GstRTSPThreadPool *pool, GstRTSPThread *thread) {
+    pthread_setname_np(pthread_self(),
+                       thread->type == GST_RTSP_THREAD_TYPE_CLIENT ? "rtsp-client" : "rtsp-media");
+    rtsp_threads_pin_current(THREAD_ROLE_RTSP);
+}
+
+static void pinned_thread_pool_class_init(PinnedThreadPoolClass *klass) {
+    GstRTSPThreadPoolClass *pool_class = GST_RTSP_THREAD_POOL_CLASS(klass);
+    pool_class->thread_enter = pinned_thread_pool_thread_enter;
+}
+
+static void pinned_thread_pool_init(PinnedThreadPool *pool) {
+}
+
+/* ===== CPU set ===== */
+
+static gboolean parse_cpu_list(const gchar *cpu_list, cpu_set_t *set) {
+    gchar **parts = g_strsplit(cpu_list, ",", -1);
+    gboolean ok = TRUE;
+
+    CPU_ZERO(set);
+    for (gint i = 0; parts[i] && ok; i++) {
+        gchar *part = g_strstrip(parts[i]);
+        gchar *end = NULL;
+
+        if (part[0] == '\0') continue;
+
+        glong first = strtol(part, &end, 10);
+        glong last = first;
+        if (end == part) {
+            ok = FALSE;
+            break;
+        }
+        if (*end == '-') {
+            gchar *range = end + 1;
+            last = strtol(range, &end, 10);
+            if (end == range) ok = FALSE;
+        }
+        if (*end != '\0' || first < 0 || last < first || last >= CPU_SETSIZE) {
+            ok = FALSE;
+            break;
+        }
+
+        for (glong cpu = first; cpu <= last; cpu++) {
+            CPU_SET(cpu, set);
+        }
+    }
+
+    g_strfreev(parts);
+    return ok && CPU_COUNT(set) > 0;
+}
+
+gboolean rtsp_threads_set_cpus(ThreadRole role, const gchar *cpu_list) {
+    if (role < 0 || role >= THREAD_ROLE_COUNT) return FALSE;
+
+    if (!cpu_list || cpu_list[0] == '\0') {
+        role_pinned[role] = FALSE;
+        return TRUE;
+    }
+
+    cpu_set_t set;
+    if (!parse_cpu_list(cpu_list, &set)) {
+        g_printerr("[threads] Invalid CPU list for %s: %s\n", role_names[role], cpu_list);
+        return FALSE;
+    }
+
+    role_cpus[role] = set;
+    role_pinned[role] = TRUE;
+    g_print("[threads] %s threads pinned to CPUs %s\n", role_names[role], cpu_list);
+    return TRUE;
+}
+
+void rtsp_threads_pin_current(ThreadRole role) {
+    if (role < 0 || role >= THREAD_ROLE_COUNT || !role_pinned[role]) return;
+
+    int err = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &role_cpus[role]);
+    if (err != 0) {
+        g_printerr("[threads] Failed to pin %s thread: %s\n", role_names[role], g_strerror(err));
+    }
+}
+
+/* "<nhóm>:<element>", cắt còn 15 byte (giới hạn tên thread của kernel) */
+static void name_current_thread(ThreadRole role, GstElement *owner) {
+    gchar name[16];
+    g_snprintf(name, sizeof(name), "%s:%s", role_prefixes[role], owner ? GST_ELEMENT_NAME(owner) : "?");
+    pthread_setname_np(pthread_self(), name);
+}
+
+/* ENTER được post từ chính streaming thread vừa tạo */
+static GstBusSyncReply pin_sync_handler(GstBus *bus, GstMessage *msg, gpointer user_data) {
+    if (GST_MESSAGE_TYPE(msg) == GST_MESSAGE_STREAM_STATUS) {
+        GstStreamStatusType type;
+        GstElement *owner = NULL;
+        gst_message_parse_stream_status(msg, &type, &owner);
+        if (type == GST_STREAM_STATUS_TYPE_ENTER) {
+            name_current_thread(GPOINTER_TO_INT(user_data), owner);
+            rtsp_threads_pin_current(GPOINTER_TO_INT(user_data));
+        }
+    }
+    return GST_BUS_PASS;
+}
+
+void rtsp_threads_pin_pipeline(GstElement *pipeline, ThreadRole role) {
+    if (!GST_IS_PIPELINE(pipeline) || role < 0 || role >= THREAD_ROLE_COUNT) {
+        return;
+    }
+
+    GstBus *bus = gst_pipeline_get_bus(GST_PIPELINE(pipeline));
+    gst_bus_set_sync_handler(bus, pin_sync_handler, GINT_TO_POINTER(role), NULL);
+    gst_object_unref(bus);
+}
+
+void rtsp_threads_setup(GstRTSPServer *server, gint max_threads) {
+    GstRTSPThreadPool *pool = g_object_new(pinned_thread_pool_get_type(), NULL);
+
+    /* max_threads > 0: mỗi client được một GstRTSPThread với GMainContext riêng,
+     * thay vì xử lý protocol trên context của server (main loop) */
+    gst_rtsp_thread_pool_set_max_threads(pool, max_threads);
+    gst_rtsp_server_set_thread_pool(server, pool);
+    g_object_unref(pool);
+
+    g_print("[threads] RTSP thread pool: %d thread(s)%s\n",
+            max_threads, max_threads == 0 ? " (main context)" : "");
+}
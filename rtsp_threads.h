@@ -0,0 +1,33 @@
+#ifndef RTSP_THREADS_H
+#define RTSP_THREADS_H
+
+#include <gst/gst.h>
+#include <gst/rtsp-server/rtsp-server.h>
+
+/* Số thread xử lý RTSP tối đa, 0 = tất cả client chạy trên main context */
+#define RTSP_THREAD_POOL_MAX 4
+
+/* Nhóm thread có thể pin vào tập core riêng */
+typedef enum {
+    THREAD_ROLE_RTSP = 0,     /* thread của pool RTSP (protocol client + bus của media) */
+    THREAD_ROLE_INGEST,       /* streaming thread của pipeline live/playback */
+    THREAD_ROLE_RECORDING,    /* streaming thread của pipeline recording */
+    THREAD_ROLE_COUNT
+} ThreadRole;
+
+/* Tập core cho một nhóm thread, dạng "0-3,6". NULL hoặc "" = không pin.
+ * Gọi trước rtsp_threads_setup() và trước khi pipeline khởi động. */
+gboolean rtsp_threads_set_cpus(ThreadRole role, const gchar *cpu_list);
+
+/* Gắn thread pool vào server: mỗi client có GMainContext riêng trên một trong
+ * max_threads thread (client mới dùng lại thread khi pool đã đủ) */
+void rtsp_threads_setup(GstRTSPServer *server, gint max_threads);
+
+/* Pin thread hiện tại theo nhóm (không làm gì nếu nhóm không cấu hình core) */
+void rtsp_threads_pin_current(ThreadRole role);
+
+/* Đặt tên theo nhóm ("ing:<element>", "rec:<element>") và pin các streaming thread
+ * của pipeline khi chúng được tạo (STREAM_STATUS ENTER) */
+void rtsp_threads_pin_pipeline(GstElement *pipeline, ThreadRole role);
+
+#endif // RTSP_THREADS_H
@@ -0,0 +1,309 @@
+#include "segment_cache.h"
+#include "io_policy.h"
+#include <glib/gstdio.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+
+/* ===== Chunk cache (LRU) ===== */
+
+typedef struct {
+    gchar *key;
+    GBytes *data;
+    GList *lru_link;     /* trong cache_lru, đầu = mới dùng nhất */
+} CacheEntry;
+
+static GMutex cache_lock;
+static GHashTable *cache_entries = NULL;   /* key -> CacheEntry* */
+static GQueue cache_lru = G_QUEUE_INIT;
+static guint64 cache_bytes = 0;
+static guint64 cache_max_bytes = SEGMENT_CACHE_MAX_BYTES;
+static guint64 stat_hit_bytes = 0;
+static guint64 stat_miss_bytes = 0;
+
+static void cache_entry_free(gpointer data) {
+    CacheEntry *entry = data;
+    g_free(entry->key);
+    g_bytes_unref(entry->data);
+    g_free(entry);
+}
+
+/* Gọi khi giữ cache_lock */
+static void cache_evict(void) {
+    while (cache_bytes > cache_max_bytes && cache_lru.tail) {
+        CacheEntry *entry = g_queue_pop_tail(&cache_lru);
+        cache_bytes -= g_bytes_get_size(entry->data);
+        g_hash_table_remove(cache_entries, entry->key);
+    }
+}
+
+static GBytes* cache_lookup(const gchar *key) {
+    GBytes *data = NULL;
+
+    g_mutex_lock(&cache_lock);
+    CacheEntry *entry = g_hash_table_lookup(cache_entries, key);
+    if (entry) {
+        g_queue_unlink(&cache_lru, entry->lru_link);
+        g_queue_push_head_link(&cache_lru, entry->lru_link);
+        data = g_bytes_ref(entry->data);
+        stat_hit_bytes += g_bytes_get_size(data);
+    }
+    g_mutex_unlock(&cache_lock);
+
+    return data;
+}
+
+static void cache_insert(const gchar *key, GBytes *data) {
+    g_mutex_lock(&cache_lock);
+    stat_miss_bytes += g_bytes_get_size(data);
+    if (!g_hash_table_contains(cache_entries, key)) {
+        CacheEntry *entry = g_new0(CacheEntry, 1);
+        entry->key = g_strdup(key);
+        entry->data = g_bytes_ref(data);
+        g_queue_push_head(&cache_lru, entry);
+        entry->lru_link = cache_lru.head;
+        g_hash_table_insert(cache_entries, entry->key, entry);
+        cache_bytes += g_bytes_get_size(data);
+        cache_evict();
+    }
+    g_mutex_unlock(&cache_lock);
+}
+
+void segment_cache_get_stats(guint64 *hit_bytes, guint64 *miss_bytes, guint64 *cached_bytes) {
+    g_mutex_lock(&cache_lock);
+    if (hit_bytes) *hit_bytes = stat_hit_bytes;
+    if (miss_bytes) *miss_bytes = stat_miss_bytes;
+    if (cached_bytes) *cached_bytes = cache_bytes;
+    g_mutex_unlock(&cache_lock);
+}
+
+/* ===== segmentcachesrc ===== */
+
+struct _SegmentCacheSrc {
+    GstBaseSrc parent;
+    gchar *location;
+    gchar *next_location;   /* segment tiếp theo trong chuỗi playback, để prefetch */
+    gboolean prefetched;
+    int fd;
+    guint64 size;
+    gchar *file_id;      /* dev:ino:mtime - file bị compact/ghi lại sẽ có id mới */
+};
+
+G_DEFINE_TYPE(SegmentCacheSrc, segment_cache_src, GST_TYPE_BASE_SRC)
+
+enum {
+    PROP_0,
+    PROP_LOCATION,
+    PROP_NEXT_LOCATION
+};
+
+static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE(
+    "src", GST_PAD_SRC, GST_PAD_ALWAYS, GST_STATIC_CAPS_ANY);
+
+static void segment_cache_src_set_property(GObject *object, guint prop_id,
+                                           const GValue *value, GParamSpec *pspec) {
+    SegmentCacheSrc *src = SEGMENT_CACHE_SRC(object);
+
+    switch (prop_id) {
+        case PROP_LOCATION:
+            g_free(src->location);
+            src->location = g_value_dup_string(value);
+            break;
+        case PROP_NEXT_LOCATION:
+            g_free(src->next_location);
+            src->next_location = g_value_dup_string(value);
+            break;
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+            break;
+    }
+}
+
+static void segment_cache_src_get_property(GObject *object, guint prop_id,
+                                           GValue *value, GParamSpec *pspec) {
+    SegmentCacheSrc *src = SEGMENT_CACHE_SRC(object);
+
+    switch (prop_id) {
+        case PROP_LOCATION:
+            g_value_set_string(value, src->location);
+            break;
+        case PROP_NEXT_LOCATION:
+            g_value_set_string(value, src->next_location);
+            break;
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+            break;
+    }
+}
+
+static gboolean segment_cache_src_start(GstBaseSrc *base) {
+    SegmentCacheSrc *src = SEGMENT_CACHE_SRC(base);
+    struct stat st;
+
+    if (!src->location) {
+        GST_ELEMENT_ERROR(src, RESOURCE, NOT_FOUND, ("No location set"), (NULL));
+        return FALSE;
+    }
+
+    src->fd = g_open(src->location, O_RDONLY | O_CLOEXEC, 0);
+    if (src->fd < 0 || fstat(src->fd, &st) != 0) {
+        GST_ELEMENT_ERROR(src, RESOURCE, OPEN_READ,
+                          ("Could not open %s", src->location), GST_ERROR_SYSTEM);
+        if (src->fd >= 0) close(src->fd);
+        src->fd = -1;
+        return FALSE;
+    }
+
+    src->size = st.st_size;
+    src->prefetched = FALSE;
+    io_policy_reader_hint(src->fd);
+    src->file_id = g_strdup_printf("%lu:%lu:%ld.%09ld", (gulong)st.st_dev, (gulong)st.st_ino,
+                                   (long)st.st_mtim.tv_sec, (long)st.st_mtim.tv_nsec);
+    return TRUE;
+}
+
+static gboolean segment_cache_src_stop(GstBaseSrc *base) {
+    SegmentCacheSrc *src = SEGMENT_CACHE_SRC(base);
+
+    if (src->fd >= 0) close(src->fd);
+    src->fd = -1;
+    g_clear_pointer(&src->file_id, g_free);
+    return TRUE;
+}
+
+static gboolean segment_cache_src_get_size(GstBaseSrc *base, guint64 *size) {
+    SegmentCacheSrc *src = SEGMENT_CACHE_SRC(base);
+    if (src->fd < 0) return FALSE;
+    *size = src->size;
+    return TRUE;
+}
+
+static gboolean segment_cache_src_is_seekable(GstBaseSrc *base) {
+    return TRUE;
+}
+
+/* Chunk của file từ cache, đọc từ disk nếu chưa có */
+static GBytes* segment_cache_src_chunk(SegmentCacheSrc *src, guint64 index) {
+    gchar *key = g_strdup_printf("%s:%" G_GUINT64_FORMAT, src->file_id, index);
+    GBytes *data = cache_lookup(key);
+
+    if (!data) {
+        guint64 offset = index * SEGMENT_CACHE_CHUNK_SIZE;
+        gsize len = (gsize)MIN((guint64)SEGMENT_CACHE_CHUNK_SIZE, src->size - offset);
+        guint8 *buf = g_malloc(len);
+        gsize done = 0;
+
+        while (done < len) {
+            gssize n = pread(src->fd, buf + done, len - done, (off_t)(offset + done));
+            if (n <= 0) break;
+            done += n;
+        }
+
+        if (done == len) {
+            data = g_bytes_new_take(buf, len);
+            cache_insert(key, data);
+        } else {
+            g_free(buf);
+        }
+    }
+
+    g_free(key);
+    return data;
+}
+
+static GstFlowReturn segment_cache_src_fill(GstBaseSrc *base, guint64 offset,
+                                            guint length, GstBuffer *buf) {
+    SegmentCacheSrc *src = SEGMENT_CACHE_SRC(base);
+    GstMapInfo map;
+
+    if (offset >= src->size) return GST_FLOW_EOS;
+    if (offset + length > src->size) length = (guint)(src->size - offset);
+
+    if (!src->prefetched && src->next_location && src->next_location[0] &&
+        offset * 100 >= src->size * IO_POLICY_PREFETCH_AT_PERCENT) {
+        src->prefetched = TRUE;
+        io_policy_prefetch_async(src->next_location);
+    }
+
+    if (!gst_buffer_map(buf, &map, GST_MAP_WRITE)) return GST_FLOW_ERROR;
+
+    guint copied = 0;
+    while (copied < length) {
+        guint64 pos = offset + copied;
+        guint64 index = pos / SEGMENT_CACHE_CHUNK_SIZE;
+        GBytes *chunk = segment_cache_src_chunk(src, index);
+        if (!chunk) {
+            gst_buffer_unmap(buf, &map);
+            GST_ELEMENT_ERROR(src, RESOURCE, READ, (NULL), GST_ERROR_SYSTEM);
+            return GST_FLOW_ERROR;
+        }
+
+        gsize chunk_size;
+        const guint8 *chunk_data = g_bytes_get_data(chunk, &chunk_size);
+        gsize in_chunk = pos - index * SEGMENT_CACHE_CHUNK_SIZE;
+        gsize n = MIN(chunk_size - in_chunk, (gsize)(length - copied));
+        memcpy(map.data + copied, chunk_data + in_chunk, n);
+        copied += n;
+        g_bytes_unref(chunk);
+    }
+
+    gst_buffer_unmap(buf, &map);
+    gst_buffer_set_size(buf, length);
+    GST_BUFFER_OFFSET(buf) = offset;
+    GST_BUFFER_OFFSET_END(buf) = offset + length;
+    return GST_FLOW_OK;
+}
+
+static void segment_cache_src_finalize(GObject *object) {
+    SegmentCacheSrc *src = SEGMENT_CACHE_SRC(object);
+    g_free(src->location);
+    g_free(src->next_location);
+    g_free(src->file_id);
+    G_OBJECT_CLASS(segment_cache_src_parent_class)->finalize(object);
+}
+
+static void segment_cache_src_class_init(SegmentCacheSrcClass *klass) {
+    GObjectClass *object_class = G_OBJECT_CLASS(klass);
+    GstElementClass *element_class = GST_ELEMENT_CLASS(klass);
+    GstBaseSrcClass *base_class = GST_BASE_SRC_CLASS(klass);
+
+    object_class->set_property = segment_cache_src_set_property;
+    object_class->get_property = segment_cache_src_get_property;
+    object_class->finalize = segment_cache_src_finalize;
+
+    g_object_class_install_property(object_class, PROP_LOCATION,
+        g_param_spec_string("location", "Location", "Segment file to read", NULL,
+                            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+    g_object_class_install_property(object_class, PROP_NEXT_LOCATION,
+        g_param_spec_string("next-location", "Next location",
+                            "Next segment in the playback chain, prefetched while reading", NULL,
+                            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+    gst_element_class_add_static_pad_template(element_class, &src_template);
+    gst_element_class_set_static_metadata(element_class,
+        "Segment cache source", "Source/File",
+        "Reads recording segments through a shared chunk cache", "RTSP Recorder");
+
+    base_class->start = segment_cache_src_start;
+    base_class->stop = segment_cache_src_stop;
+    base_class->get_size = segment_cache_src_get_size;
+    base_class->is_seekable = segment_cache_src_is_seekable;
+    base_class->fill = segment_cache_src_fill;
+}
+
+static void segment_cache_src_init(SegmentCacheSrc *src) {
+    src->fd = -1;
+    gst_base_src_set_blocksize(GST_BASE_SRC(src), 64 * 1024);
+}
+
+gboolean segment_cache_init(guint64 max_bytes) {
+    g_mutex_lock(&cache_lock);
+    if (!cache_entries) {
+        cache_entries = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, cache_entry_free);
+    }
+    cache_max_bytes = max_bytes;
+    g_mutex_unlock(&cache_lock);
+
+    return gst_element_register(NULL, SEGMENT_CACHE_SRC_NAME, GST_RANK_NONE, TYPE_SEGMENT_CACHE_SRC);
+}
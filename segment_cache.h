@@ -0,0 +1,23 @@
+#ifndef SEGMENT_CACHE_H
+#define SEGMENT_CACHE_H
+
+#include <gst/gst.h>
+#include <gst/base/gstbasesrc.h>
+
+/* Cache đọc segment theo chunk, dùng chung cho mọi playback pipeline */
+#define SEGMENT_CACHE_CHUNK_SIZE  (512 * 1024)
+#define SEGMENT_CACHE_MAX_BYTES   (64 * 1024 * 1024)
+
+/* Element thay cho filesrc trong playback: đọc qua cache, hỗ trợ pull mode */
+#define SEGMENT_CACHE_SRC_NAME "segmentcachesrc"
+
+#define TYPE_SEGMENT_CACHE_SRC (segment_cache_src_get_type())
+G_DECLARE_FINAL_TYPE(SegmentCacheSrc, segment_cache_src, SEGMENT, CACHE_SRC, GstBaseSrc)
+
+/* Đăng ký element segmentcachesrc (gọi sau gst_init) */
+gboolean segment_cache_init(guint64 max_bytes);
+
+/* Thống kê hit/miss (bytes) */
+void segment_cache_get_stats(guint64 *hit_bytes, guint64 *miss_bytes, guint64 *cached_bytes);
+
+#endif // SEGMENT_CACHE_H
@@ -0,0 +1,215 @@
+#include "segment_clock.h"
+#include <gst/rtp/gstrtpbuffer.h>
+
+/* Giây giữa epoch NTP (1900) và Unix (1970) */
+#define NTP_UNIX_OFFSET_SEC 2208988800LL
+
+#define SEGMENT_CLOCK_CAPS_WALL "timestamp/x-unix"
+
+/* Trạng thái payloader: wallclock của access unit đang được packetize */
+typedef struct {
+    gint64 wall_us;
+    gboolean keyframe;
+    gboolean discont;
+    gboolean has_current;
+} PayloaderState;
+
+static GstCaps *caps_ntp = NULL;
+static GstCaps *caps_wall = NULL;
+
+static void ensure_caps(void) {
+    if (!caps_ntp) {
+        caps_ntp = gst_caps_new_empty_simple("timestamp/x-ntp");
+        caps_wall = gst_caps_new_empty_simple(SEGMENT_CLOCK_CAPS_WALL);
+    }
+}
+
+gint64 segment_clock_to_wall(const SegmentClock *clock, gint64 pts_ns) {
+    return clock->wall_us + (pts_ns - clock->pts_ns) / GST_USECOND;
+}
+
+gint64 segment_clock_to_pts(const SegmentClock *clock, gint64 wall_us) {
+    return clock->pts_ns + (wall_us - clock->wall_us) * GST_USECOND;
+}
+
+static gint64 buffer_running_time(GstPad *pad, GstBuffer *buffer) {
+    GstClockTime pts = GST_BUFFER_PTS(buffer);
+    if (!GST_CLOCK_TIME_IS_VALID(pts)) return -1;
+
+    GstEvent *event = gst_pad_get_sticky_event(pad, GST_EVENT_SEGMENT, 0);
+    if (!event) return (gint64)pts;
+
+    const GstSegment *segment = NULL;
+    gst_event_parse_segment(event, &segment);
+    GstClockTime running = gst_segment_to_running_time(segment, GST_FORMAT_TIME, pts);
+    gst_event_unref(event);
+    return GST_CLOCK_TIME_IS_VALID(running) ? (gint64)running : -1;
+}
+
+/* Wallclock lúc gói vào jitterbuffer: lùi từ "bây giờ" một khoảng bằng độ trễ running time */
+static gint64 arrival_wall_us(GstPad *pad, gint64 running_ns) {
+    gint64 now = g_get_real_time();
+    GstElement *element = gst_pad_get_parent_element(pad);
+    if (!element) return now;
+
+    GstClock *clock = gst_element_get_clock(element);
+    if (clock) {
+        GstClockTime now_rt = gst_clock_get_time(clock) - gst_element_get_base_time(element);
+        if ((gint64)now_rt > running_ns) now -= ((gint64)now_rt - running_ns) / GST_USECOND;
+        gst_object_unref(clock);
+    }
+    gst_object_unref(element);
+    return now;
+}
+
+/* Gói RTP vào depayloader: PTS của access unit lấy từ PTS của gói */
+static GstPadProbeReturn capture_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    SegmentClock *clock = user_data;
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+
+    if (clock->source == SEGMENT_CLOCK_NTP) return GST_PAD_PROBE_REMOVE;
+
+    gint64 running = buffer_running_time(pad, buffer);
+    if (running < 0) return GST_PAD_PROBE_OK;
+
+    GstReferenceTimestampMeta *ntp = gst_buffer_get_reference_timestamp_meta(buffer, caps_ntp);
+    gint64 arrival = clock->source == SEGMENT_CLOCK_NONE || ntp ? arrival_wall_us(pad, running) : 0;
+
+    if (ntp) {
+        gint64 unix_us = (gint64)(ntp->timestamp / GST_USECOND) - NTP_UNIX_OFFSET_SEC * G_USEC_PER_SEC;
+        /* Đồng hồ camera lệch quá xa server: giữ arrival để khớp với index/tên file */
+        if (ABS(unix_us - arrival) <= SEGMENT_CLOCK_MAX_SKEW_US) {
+            clock->pts_ns = running;
+            clock->wall_us = unix_us;
+            clock->source = SEGMENT_CLOCK_NTP;
+            return GST_PAD_PROBE_REMOVE;
+        }
+    }
+
+    if (clock->source == SEGMENT_CLOCK_NONE) {
+        clock->pts_ns = running;
+        clock->wall_us = arrival;
+        clock->source = SEGMENT_CLOCK_ARRIVAL;
+    }
+    return GST_PAD_PROBE_OK;
+}
+
+void segment_clock_capture(GstElement *rtspsrc, GstElement *depay, SegmentClock *clock) {
+    ensure_caps();
+    clock->pts_ns = 0;
+    clock->wall_us = 0;
+    clock->source = SEGMENT_CLOCK_NONE;
+
+    /* jitterbuffer gắn NTP meta sau khi nhận RTCP SR */
+    if (g_object_class_find_property(G_OBJECT_GET_CLASS(rtspsrc), "add-reference-timestamp-meta")) {
+        g_object_set(rtspsrc, "add-reference-timestamp-meta", TRUE, NULL);
+    }
+
+    GstPad *pad = gst_element_get_static_pad(depay, "sink");
+    gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, capture_probe, clock, NULL);
+    gst_object_unref(pad);
+}
+
+/* Frame ra khỏi parser của một segment: timestamp vẫn là timestamp trong file */
+static GstPadProbeReturn stamp_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    const SegmentClock *clock = user_data;
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+
+    if (!GST_BUFFER_PTS_IS_VALID(buffer)) return GST_PAD_PROBE_OK;
+
+    gint64 wall_us = segment_clock_to_wall(clock, (gint64)GST_BUFFER_PTS(buffer));
+    buffer = gst_buffer_make_writable(buffer);
+    gst_buffer_add_reference_timestamp_meta(buffer, caps_wall, (GstClockTime)wall_us * GST_USECOND,
+                                            GST_CLOCK_TIME_NONE);
+    GST_PAD_PROBE_INFO_DATA(info) = buffer;
+    return GST_PAD_PROBE_OK;
+}
+
+void segment_clock_stamp_frames(GstElement *parser, const SegmentClock *clock) {
+    if (!parser || !clock || clock->source == SEGMENT_CLOCK_NONE) return;
+    ensure_caps();
+
+    SegmentClock *copy = g_memdup2(clock, sizeof(SegmentClock));
+    GstPad *pad = gst_element_get_static_pad(parser, "src");
+    gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, stamp_probe, copy, g_free);
+    gst_object_unref(pad);
+}
+
+static GstPadProbeReturn pay_sink_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    PayloaderState *state = user_data;
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    GstReferenceTimestampMeta *meta = gst_buffer_get_reference_timestamp_meta(buffer, caps_wall);
+
+    state->has_current = meta != NULL;
+    if (meta) {
+        state->wall_us = (gint64)(meta->timestamp / GST_USECOND);
+        state->keyframe = !GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DELTA_UNIT);
+        state->discont = GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DISCONT);
+    }
+    return GST_PAD_PROBE_OK;
+}
+
+static void write_replay_ext(GstBuffer **buffer, PayloaderState *state) {
+    GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+
+    *buffer = gst_buffer_make_writable(*buffer);
+    if (!gst_rtp_buffer_map(*buffer, GST_MAP_READWRITE, &rtp)) return;
+
+    if (gst_rtp_buffer_set_extension_data(&rtp, ONVIF_REPLAY_EXT_PROFILE, ONVIF_REPLAY_EXT_WORDS)) {
+        guint16 bits;
+        gpointer data;
+        guint words;
+        gst_rtp_buffer_get_extension_data(&rtp, &bits, &data, &words);
+
+        /* NTP 32.32 */
+        guint64 us = (guint64)state->wall_us + (guint64)NTP_UNIX_OFFSET_SEC * G_USEC_PER_SEC;
+        guint64 ntp = ((us / G_USEC_PER_SEC) << 32) | (((us % G_USEC_PER_SEC) << 32) / G_USEC_PER_SEC);
+        guint8 *p = data;
+        GST_WRITE_UINT64_BE(p, ntp);
+        p[8] = (state->keyframe ? 0x80 : 0) | (state->discont ? 0x20 : 0);
+        p[9] = 0;
+        p[10] = 0;
+        p[11] = 0;
+    }
+    gst_rtp_buffer_unmap(&rtp);
+}
+
+static gboolean replay_list_item(GstBuffer **buffer, guint idx, gpointer user_data) {
+    write_replay_ext(buffer, user_data);
+    return TRUE;
+}
+
+static GstPadProbeReturn pay_src_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    PayloaderState *state = user_data;
+    if (!state->has_current) return GST_PAD_PROBE_OK;
+
+    if (info->type & GST_PAD_PROBE_TYPE_BUFFER) {
+        GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+        write_replay_ext(&buffer, state);
+        GST_PAD_PROBE_INFO_DATA(info) = buffer;
+    } else if (info->type & GST_PAD_PROBE_TYPE_BUFFER_LIST) {
+        GstBufferList *list = gst_buffer_list_make_writable(GST_PAD_PROBE_INFO_BUFFER_LIST(info));
+        gst_buffer_list_foreach(list, replay_list_item, state);
+        GST_PAD_PROBE_INFO_DATA(info) = list;
+    }
+    /* Chỉ gói đầu của AU mang cờ discontinuity */
+    state->discont = FALSE;
+    return GST_PAD_PROBE_OK;
+}
+
+void segment_clock_attach_payloader(GstElement *pay) {
+    if (!pay) return;
+    ensure_caps();
+
+    PayloaderState *state = g_new0(PayloaderState, 1);
+    g_object_set_data_full(G_OBJECT(pay), "segment-clock", state, g_free);
+
+    GstPad *sink = gst_element_get_static_pad(pay, "sink");
+    gst_pad_add_probe(sink, GST_PAD_PROBE_TYPE_BUFFER, pay_sink_probe, state, NULL);
+    gst_object_unref(sink);
+
+    GstPad *src = gst_element_get_static_pad(pay, "src");
+    gst_pad_add_probe(src, GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST,
+                      pay_src_probe, state, NULL);
+    gst_object_unref(src);
+}
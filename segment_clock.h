@@ -0,0 +1,28 @@
+#ifndef SEGMENT_CLOCK_H
+#define SEGMENT_CLOCK_H
+
+#include <gst/gst.h>
+#include "segment_index.h"
+
+/* Lệch tối đa giữa đồng hồ camera (RTCP SR) và server; lệch hơn thì dùng arrival */
+#define SEGMENT_CLOCK_MAX_SKEW_US (2 * G_USEC_PER_SEC)
+
+/* ONVIF replay header extension (RFC 3550 extension, 3 word):
+ * NTP 64-bit | C E D T mbz | CSeq | padding */
+#define ONVIF_REPLAY_EXT_PROFILE 0xABAC
+#define ONVIF_REPLAY_EXT_WORDS   3
+
+gint64 segment_clock_to_wall(const SegmentClock *clock, gint64 pts_ns);
+gint64 segment_clock_to_pts(const SegmentClock *clock, gint64 wall_us);
+
+/* Recording: bắt mapping PTS <-> wallclock từ RTCP SR (NTP meta của jitterbuffer),
+ * fallback thời điểm nhận gói. clock phải sống tới khi pipeline về NULL. */
+void segment_clock_capture(GstElement *rtspsrc, GstElement *depay, SegmentClock *clock);
+
+/* Playback: gắn wallclock thật vào từng frame của một segment (parser sau demux) */
+void segment_clock_stamp_frames(GstElement *parser, const SegmentClock *clock);
+
+/* Playback: ghi wallclock của frame vào ONVIF replay extension trên mọi gói RTP */
+void segment_clock_attach_payloader(GstElement *pay);
+
+#endif // SEGMENT_CLOCK_H
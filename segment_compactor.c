@@ -0,0 +1,226 @@
+#include "segment_compactor.h"
+#include "segment_index.h"
+#include "storage_tiers.h"
+#include "native_segment.h"
+#include <gst/gst.h>
+#include <glib/gstdio.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+static GThread *compactor_thread = NULL;
+static GMutex compactor_lock;
+static GCond compactor_cond;
+static gboolean compactor_running = FALSE;
+static gint64 compact_after_sec = SEGMENT_COMPACT_AFTER_SEC;
+
+typedef struct {
+    gchar *camera_name;
+    StreamType stream_type;
+} CompactStream;
+
+static gboolean compactor_should_run(void) {
+    g_mutex_lock(&compactor_lock);
+    gboolean running = compactor_running;
+    g_mutex_unlock(&compactor_lock);
+    return running;
+}
+
+static goffset file_size(const gchar *path) {
+    struct stat st;
+    return g_stat(path, &st) == 0 ? (goffset)st.st_size : -1;
+}
+
+/* Bỏ dữ liệu vừa đọc/ghi khỏi page cache để không đẩy dữ liệu live ra ngoài */
+static void drop_page_cache(const gchar *path) {
+    int fd = g_open(path, O_RDONLY | O_CLOEXEC, 0);
+    if (fd < 0) return;
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+}
+
+gboolean segment_compact_file(const gchar *path, const gchar *tmp_path) {
+    /* Native segment: chép thẳng các keyframe từ vùng map, không qua pipeline */
+    if (native_segment_is_native_path(path)) {
+        gboolean ok = native_segment_compact(path, tmp_path);
+        drop_page_cache(path);
+        drop_page_cache(tmp_path);
+        if (!ok) g_unlink(tmp_path);
+        return ok;
+    }
+
+    /* matroskademux đặt DELTA_UNIT theo cờ keyframe của SimpleBlock,
+     * identity bỏ các buffer đó - chỉ còn IDR, timestamp không đổi */
+    gchar *launch = g_strdup_printf(
+        "filesrc location=\"%s\" ! matroskademux ! "
+        "identity drop-buffer-flags=delta-unit ! queue ! "
+        "matroskamux writing-app=\"RTSP Recorder\" ! filesink location=\"%s\"",
+        path, tmp_path);
+    GError *error = NULL;
+    gboolean ok = FALSE;
+
+    GstElement *pipeline = gst_parse_launch(launch, &error);
+    g_free(launch);
+    if (error) {
+        g_printerr("[compactor] Pipeline error: %s\n", error->message);
+        g_error_free(error);
+        if (pipeline) gst_object_unref(pipeline);
+        return FALSE;
+    }
+
+    gst_element_set_state(pipeline, GST_STATE_PLAYING);
+    GstBus *bus = gst_element_get_bus(pipeline);
+    GstMessage *msg = gst_bus_timed_pop_filtered(bus, GST_CLOCK_TIME_NONE,
+                                                 GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+    ok = msg && GST_MESSAGE_TYPE(msg) == GST_MESSAGE_EOS;
+    if (msg) gst_message_unref(msg);
+    gst_object_unref(bus);
+
+    gst_element_set_state(pipeline, GST_STATE_NULL);
+    gst_object_unref(pipeline);
+
+    drop_page_cache(path);
+    drop_page_cache(tmp_path);
+
+    /* Segment không có keyframe nào thì giữ nguyên bản gốc */
+    if (ok && file_size(tmp_path) <= 0) {
+        ok = FALSE;
+    }
+    if (!ok) {
+        g_unlink(tmp_path);
+    }
+    return ok;
+}
+
+static gboolean compact_record(const gchar *camera_name, StreamType stream_type,
+                               const SegmentRecord *record, goffset *saved) {
+    goffset before = file_size(record->path);
+    if (before < 0) return FALSE;
+
+    gchar *tmp_path = g_strdup_printf("%s.compact", record->path);
+    if (!segment_compact_file(record->path, tmp_path)) {
+        g_printerr("[compactor] Failed to compact %s\n", record->path);
+        g_free(tmp_path);
+        return FALSE;
+    }
+
+    /* Kiểm tra segment còn và rename dưới index lock: retention xóa segment trong lúc
+     * compact thì chỉ bỏ bản compact, không tạo lại file đã bị xóa */
+    gboolean renamed = segment_index_replace_file(camera_name, stream_type, record->start_us, record->path,
+                                                  tmp_path, record->flags | SEGMENT_FLAG_COMPACTED);
+    if (!renamed) {
+        g_printerr("[compactor] Not replacing %s (removed or index/rename failed)\n", record->path);
+        g_unlink(tmp_path);
+    }
+    g_free(tmp_path);
+    if (!renamed) return FALSE;
+
+    goffset after = file_size(record->path);
+    if (after >= 0 && after < before) *saved += before - after;
+    return TRUE;
+}
+
+/* Chỉ compact trên tier cuối cùng: migrator không còn di chuyển các segment này nữa */
+static gboolean on_compactable_tier(const gchar *path) {
+    gint count = storage_tiers_count();
+    return count <= 1 || storage_tier_for_path(path) == count - 1;
+}
+
+static void collect_stream(const gchar *camera_name, StreamType stream_type, gpointer user_data) {
+    GPtrArray *streams = user_data;
+    CompactStream *stream = g_new0(CompactStream, 1);
+    stream->camera_name = g_strdup(camera_name);
+    stream->stream_type = stream_type;
+    g_ptr_array_add(streams, stream);
+}
+
+static void compact_stream_free(gpointer data) {
+    CompactStream *stream = data;
+    g_free(stream->camera_name);
+    g_free(stream);
+}
+
+static void compact_pass(void) {
+    gint64 cutoff_us = g_get_real_time() - compact_after_sec * G_USEC_PER_SEC;
+    gint64 cutoff_day = cutoff_us / (G_USEC_PER_SEC * 86400LL);
+    guint compacted = 0;
+    goffset saved = 0;
+
+    GPtrArray *streams = g_ptr_array_new_with_free_func(compact_stream_free);
+    segment_index_foreach_stream(collect_stream, streams);
+
+    for (guint s = 0; s < streams->len && compactor_should_run(); s++) {
+        CompactStream *stream = g_ptr_array_index(streams, s);
+        GArray *days = segment_index_list_days(stream->camera_name, stream->stream_type);
+
+        for (guint d = 0; d < days->len && compactor_should_run(); d++) {
+            gint64 day = g_array_index(days, gint64, d);
+            if (day > cutoff_day) break;
+
+            GPtrArray *records = segment_index_get_day(stream->camera_name, stream->stream_type, day);
+            for (guint i = 0; i < records->len && compactor_should_run(); i++) {
+                SegmentRecord *record = g_ptr_array_index(records, i);
+                if (record->flags & SEGMENT_FLAG_COMPACTED) continue;
+                if (record->end_us > cutoff_us) break;
+                if (!on_compactable_tier(record->path)) continue;
+
+                if (compact_record(stream->camera_name, stream->stream_type, record, &saved)) {
+                    compacted++;
+                }
+            }
+            g_ptr_array_unref(records);
+        }
+        g_array_unref(days);
+    }
+
+    g_ptr_array_unref(streams);
+
+    if (compacted > 0) {
+        g_print("[compactor] Compacted %u segment(s), saved %.1f MB\n",
+                compacted, saved / (1024.0 * 1024.0));
+    }
+}
+
+static gpointer compactor_thread_func(gpointer data) {
+    storage_io_priority_idle();
+
+    while (compactor_should_run()) {
+        compact_pass();
+
+        g_mutex_lock(&compactor_lock);
+        if (compactor_running) {
+            gint64 deadline = g_get_monotonic_time() + SEGMENT_COMPACT_INTERVAL_SEC * G_USEC_PER_SEC;
+            g_cond_wait_until(&compactor_cond, &compactor_lock, deadline);
+        }
+        g_mutex_unlock(&compactor_lock);
+    }
+
+    return NULL;
+}
+
+void segment_compactor_start(gint64 older_than_sec) {
+    g_mutex_lock(&compactor_lock);
+    if (compactor_running) {
+        g_mutex_unlock(&compactor_lock);
+        return;
+    }
+    compactor_running = TRUE;
+    compact_after_sec = older_than_sec;
+    g_mutex_unlock(&compactor_lock);
+
+    compactor_thread = g_thread_new("segment-compactor", compactor_thread_func, NULL);
+    g_print("Segment compactor started (keyframe-only after %ld days)\n",
+            (long)(older_than_sec / 86400));
+}
+
+void segment_compactor_stop(void) {
+    g_mutex_lock(&compactor_lock);
+    compactor_running = FALSE;
+    g_cond_signal(&compactor_cond);
+    g_mutex_unlock(&compactor_lock);
+
+    if (compactor_thread) {
+        g_thread_join(compactor_thread);
+        compactor_thread = NULL;
+    }
+}
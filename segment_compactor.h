@@ -0,0 +1,18 @@
+#ifndef SEGMENT_COMPACTOR_H
+#define SEGMENT_COMPACTOR_H
+
+#include <glib.h>
+
+#define SEGMENT_COMPACT_AFTER_SEC     (7 * 24 * 3600)   /* sau 1 tuần chỉ giữ keyframe */
+#define SEGMENT_COMPACT_INTERVAL_SEC  3600
+
+/* Ghi bản chỉ giữ keyframe của segment ra tmp_path (bỏ frame delta, không decode/encode).
+ * Timestamp của frame giữ nguyên nên segment vẫn khớp wallclock. File gốc không bị đụng tới;
+ * lỗi thì tmp_path bị xóa. */
+gboolean segment_compact_file(const gchar *path, const gchar *tmp_path);
+
+/* Job nền: compact các segment kết thúc trước now - older_than_sec */
+void segment_compactor_start(gint64 older_than_sec);
+void segment_compactor_stop(void);
+
+#endif // SEGMENT_COMPACTOR_H
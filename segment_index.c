@@ -0,0 +1,539 @@
+#include "segment_index.h"
+#include <glib/gstdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+
+#define USEC_PER_DAY (86400LL * G_USEC_PER_SEC)
+/* Segment dài tối đa 1 ngày lookback khi query (segment vắt qua nửa đêm) */
+#define QUERY_LOOKBACK_DAYS 1
+
+/* Segment của một (quality, camera, ngày UTC) */
+typedef struct {
+    GPtrArray *records;   /* SegmentRecord*, sắp xếp theo start_us */
+} SegmentDay;
+
+static GMutex index_lock;
+static gchar *index_root = NULL;
+static GHashTable *day_cache = NULL;   /* "quality/camera/day" -> SegmentDay* */
+static SegmentChangeFunc change_func = NULL;
+static GHashTable *current_segments = NULL;   /* "quality/camera" -> SegmentRecord* đang ghi */
+
+static const gchar* quality_name(StreamType stream_type) {
+    return stream_type == STREAM_MAIN ? RECORD_HI_QUALITY : RECORD_LOW_QUALITY;
+}
+
+static gint64 day_of(gint64 ts_us) {
+    return ts_us >= 0 ? ts_us / USEC_PER_DAY : (ts_us - USEC_PER_DAY + 1) / USEC_PER_DAY;
+}
+
+static gchar* day_log_path(const gchar *camera_name, StreamType stream_type, gint64 day) {
+    GDateTime *dt = g_date_time_new_from_unix_utc(day * 86400);
+    gchar *date = g_date_time_format(dt, "%Y%m%d");
+    gchar *path = g_strdup_printf("%s/%s/%s/%s.log",
+                                  index_root, quality_name(stream_type), camera_name, date);
+    g_free(date);
+    g_date_time_unref(dt);
+    return path;
+}
+
+SegmentRecord* segment_record_copy(const SegmentRecord *record) {
+    SegmentRecord *copy = g_new0(SegmentRecord, 1);
+    copy->start_us = record->start_us;
+    copy->end_us = record->end_us;
+    copy->path = g_strdup(record->path);
+    copy->flags = record->flags;
+    copy->clock = record->clock;
+    return copy;
+}
+
+void segment_record_free(SegmentRecord *record) {
+    if (!record) return;
+    g_free(record->path);
+    g_free(record);
+}
+
+static void segment_day_free(gpointer data) {
+    SegmentDay *day = data;
+    g_ptr_array_unref(day->records);
+    g_free(day);
+}
+
+static gint compare_record_start(gconstpointer a, gconstpointer b) {
+    const SegmentRecord *ra = *(const SegmentRecord **)a;
+    const SegmentRecord *rb = *(const SegmentRecord **)b;
+    if (ra->start_us < rb->start_us) return -1;
+    if (ra->start_us > rb->start_us) return 1;
+    return 0;
+}
+
+/* Chèn giữ thứ tự start_us (thường là append cuối) */
+static void day_insert(SegmentDay *day, SegmentRecord *record) {
+    guint pos = day->records->len;
+    while (pos > 0) {
+        SegmentRecord *prev = g_ptr_array_index(day->records, pos - 1);
+        if (prev->start_us <= record->start_us) break;
+        pos--;
+    }
+    g_ptr_array_insert(day->records, pos, record);
+}
+
+static gint day_find(SegmentDay *day, gint64 start_us, const gchar *path) {
+    for (guint i = 0; i < day->records->len; i++) {
+        SegmentRecord *record = g_ptr_array_index(day->records, i);
+        if (record->start_us == start_us && g_strcmp0(record->path, path) == 0) {
+            return (gint)i;
+        }
+    }
+    return -1;
+}
+
+/* Áp dụng một dòng log lên SegmentDay:
+ *   S <start_us> <end_us> <flags> <path>
+ *   M <start_us> <old_path>\t<new_path>
+ *   D <start_us> <path>
+ *   C <start_us> <pts_ns> <wall_us> <source> <path>
+ */
+static void day_apply_line(SegmentDay *day, const gchar *line) {
+    gint64 start_us = 0, end_us = 0;
+    gint64 pts_ns = 0, wall_us = 0;
+    guint flags = 0, source = 0;
+    gint offset = 0;
+
+    if (line[0] == 'S' &&
+        sscanf(line, "S %" G_GINT64_FORMAT " %" G_GINT64_FORMAT " %u %n",
+               &start_us, &end_us, &flags, &offset) == 3 && offset > 0) {
+        gint i = day_find(day, start_us, line + offset);
+        if (i >= 0) {
+            /* Ghi lại cùng segment (ví dụ sau khi sửa) - cập nhật tại chỗ */
+            SegmentRecord *existing = g_ptr_array_index(day->records, i);
+            existing->end_us = end_us;
+            existing->flags = flags;
+            return;
+        }
+
+        SegmentRecord *record = g_new0(SegmentRecord, 1);
+        record->start_us = start_us;
+        record->end_us = end_us;
+        record->flags = flags;
+        record->path = g_strdup(line + offset);
+        day_insert(day, record);
+    } else if (line[0] == 'M' &&
+               sscanf(line, "M %" G_GINT64_FORMAT " %n", &start_us, &offset) == 1 && offset > 0) {
+        gchar **paths = g_strsplit(line + offset, "\t", 2);
+        if (paths[0] && paths[1]) {
+            gint i = day_find(day, start_us, paths[0]);
+            if (i >= 0) {
+                SegmentRecord *record = g_ptr_array_index(day->records, i);
+                g_free(record->path);
+                record->path = g_strdup(paths[1]);
+            }
+        }
+        g_strfreev(paths);
+    } else if (line[0] == 'D' &&
+               sscanf(line, "D %" G_GINT64_FORMAT " %n", &start_us, &offset) == 1 && offset > 0) {
+        gint i = day_find(day, start_us, line + offset);
+        if (i >= 0) {
+            g_ptr_array_remove_index(day->records, i);
+        }
+    } else if (line[0] == 'C' &&
+               sscanf(line, "C %" G_GINT64_FORMAT " %" G_GINT64_FORMAT " %" G_GINT64_FORMAT " %u %n",
+                      &start_us, &pts_ns, &wall_us, &source, &offset) == 4 && offset > 0) {
+        gint i = day_find(day, start_us, line + offset);
+        if (i >= 0) {
+            SegmentRecord *record = g_ptr_array_index(day->records, i);
+            record->clock.pts_ns = pts_ns;
+            record->clock.wall_us = wall_us;
+            record->clock.source = source;
+        }
+    }
+}
+
+/* Đọc log của ngày thành SegmentDay mới (không đưa vào cache) */
+static SegmentDay* day_load(const gchar *camera_name, StreamType stream_type, gint64 day_index) {
+    SegmentDay *day = g_new0(SegmentDay, 1);
+    day->records = g_ptr_array_new_with_free_func((GDestroyNotify)segment_record_free);
+
+    gchar *log_path = day_log_path(camera_name, stream_type, day_index);
+    gchar *contents = NULL;
+    if (g_file_get_contents(log_path, &contents, NULL, NULL)) {
+        gchar **lines = g_strsplit(contents, "\n", -1);
+        for (gint i = 0; lines[i]; i++) {
+            if (lines[i][0]) day_apply_line(day, lines[i]);
+        }
+        g_strfreev(lines);
+        g_free(contents);
+        g_ptr_array_sort(day->records, compare_record_start);
+    }
+    g_free(log_path);
+    return day;
+}
+
+/* Lấy SegmentDay từ cache, load từ log nếu chưa có (gọi khi giữ index_lock) */
+static SegmentDay* day_get(const gchar *camera_name, StreamType stream_type, gint64 day_index) {
+    gchar *key = g_strdup_printf("%s/%s/%" G_GINT64_FORMAT,
+                                 quality_name(stream_type), camera_name, day_index);
+    SegmentDay *day = g_hash_table_lookup(day_cache, key);
+    if (day) {
+        g_free(key);
+        return day;
+    }
+
+    day = day_load(camera_name, stream_type, day_index);
+    g_hash_table_insert(day_cache, key, day);
+    return day;
+}
+
+/* Append một dòng vào log của ngày (gọi khi giữ index_lock) */
+static gboolean day_append_line(const gchar *camera_name, StreamType stream_type,
+                                gint64 day_index, const gchar *line) {
+    gchar *log_path = day_log_path(camera_name, stream_type, day_index);
+    gchar *dir = g_path_get_dirname(log_path);
+    g_mkdir_with_parents(dir, 0755);
+    g_free(dir);
+
+    int fd = g_open(log_path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        g_printerr("Failed to open segment index %s\n", log_path);
+        g_free(log_path);
+        return FALSE;
+    }
+
+    gsize len = strlen(line);
+    gboolean ok = write(fd, line, len) == (gssize)len;
+    fdatasync(fd);
+    close(fd);
+
+    if (!ok) {
+        g_printerr("Failed to write segment index %s\n", log_path);
+    }
+    g_free(log_path);
+    return ok;
+}
+
+void segment_index_init(const gchar *base_path) {
+    g_mutex_lock(&index_lock);
+    g_free(index_root);
+    index_root = g_build_filename(base_path, SEGMENT_INDEX_DIR, NULL);
+    g_mkdir_with_parents(index_root, 0755);
+    if (!day_cache) {
+        day_cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, segment_day_free);
+    } else {
+        g_hash_table_remove_all(day_cache);
+    }
+    g_mutex_unlock(&index_lock);
+}
+
+void segment_index_set_current(const gchar *camera_name,
+                               StreamType stream_type,
+                               gint64 start_us,
+                               const gchar *path) {
+    SegmentRecord *record = g_new0(SegmentRecord, 1);
+    record->start_us = start_us;
+    record->end_us = start_us;
+    record->path = g_strdup(path);
+
+    g_mutex_lock(&index_lock);
+    if (!current_segments) {
+        current_segments = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                                 (GDestroyNotify)segment_record_free);
+    }
+    g_hash_table_replace(current_segments,
+                         g_strdup_printf("%s/%s", quality_name(stream_type), camera_name), record);
+    g_mutex_unlock(&index_lock);
+}
+
+void segment_index_clear_current(const gchar *camera_name,
+                                 StreamType stream_type,
+                                 gint64 start_us) {
+    gchar *key = g_strdup_printf("%s/%s", quality_name(stream_type), camera_name);
+    g_mutex_lock(&index_lock);
+    SegmentRecord *record = current_segments ? g_hash_table_lookup(current_segments, key) : NULL;
+    if (record && record->start_us == start_us) g_hash_table_remove(current_segments, key);
+    g_mutex_unlock(&index_lock);
+    g_free(key);
+}
+
+gint64 segment_index_current(const gchar *camera_name,
+                             StreamType stream_type,
+                             gchar **path) {
+    gchar *key = g_strdup_printf("%s/%s", quality_name(stream_type), camera_name);
+    g_mutex_lock(&index_lock);
+    SegmentRecord *record = current_segments ? g_hash_table_lookup(current_segments, key) : NULL;
+    gint64 start_us = record ? record->start_us : -1;
+    if (path) *path = record ? g_strdup(record->path) : NULL;
+    g_mutex_unlock(&index_lock);
+    g_free(key);
+    return start_us;
+}
+
+void segment_index_invalidate(void) {
+    g_mutex_lock(&index_lock);
+    if (day_cache) g_hash_table_remove_all(day_cache);
+    g_mutex_unlock(&index_lock);
+}
+
+gboolean segment_index_add(const gchar *camera_name,
+                           StreamType stream_type,
+                           gint64 start_us,
+                           gint64 end_us,
+                           const gchar *path,
+                           guint flags) {
+    gboolean ok;
+
+    if (!index_root || !camera_name || !path) return FALSE;
+    if (end_us < start_us) end_us = start_us;
+
+    gint64 day_index = day_of(start_us);
+    gchar *line = g_strdup_printf("S %" G_GINT64_FORMAT " %" G_GINT64_FORMAT " %u %s\n",
+                                  start_us, end_us, flags, path);
+
+    g_mutex_lock(&index_lock);
+    SegmentDay *day = day_get(camera_name, stream_type, day_index);
+    gboolean replaced = day_find(day, start_us, path) >= 0;
+    ok = day_append_line(camera_name, stream_type, day_index, line);
+    if (ok) {
+        gchar *stripped = g_strndup(line, strlen(line) - 1);
+        day_apply_line(day, stripped);
+        g_free(stripped);
+    }
+    SegmentChangeFunc notify = change_func;
+    g_mutex_unlock(&index_lock);
+
+    /* Ghi lại segment đã có (end có thể ngắn đi) - báo như xóa để người nghe tính lại */
+    if (ok && notify) notify(camera_name, stream_type, start_us, end_us, replaced);
+
+    g_free(line);
+    return ok;
+}
+
+/* Ghi một dòng log và áp dụng lên cache (gọi khi giữ index_lock) */
+static gboolean day_log_and_apply(const gchar *camera_name, StreamType stream_type,
+                                  gint64 start_us, const gchar *line) {
+    gint64 day_index = day_of(start_us);
+    SegmentDay *day = day_get(camera_name, stream_type, day_index);
+
+    if (!day_append_line(camera_name, stream_type, day_index, line)) return FALSE;
+
+    gchar *stripped = g_strndup(line, strlen(line) - 1);
+    day_apply_line(day, stripped);
+    g_free(stripped);
+    return TRUE;
+}
+
+gboolean segment_index_relocate(const gchar *camera_name,
+                                StreamType stream_type,
+                                gint64 start_us,
+                                const gchar *old_path,
+                                const gchar *new_path) {
+    if (!index_root || !camera_name || !old_path || !new_path) return FALSE;
+
+    gchar *line = g_strdup_printf("M %" G_GINT64_FORMAT " %s\t%s\n", start_us, old_path, new_path);
+
+    g_mutex_lock(&index_lock);
+    gboolean ok = day_log_and_apply(camera_name, stream_type, start_us, line);
+    g_mutex_unlock(&index_lock);
+
+    g_free(line);
+    return ok;
+}
+
+gboolean segment_index_remove(const gchar *camera_name,
+                              StreamType stream_type,
+                              gint64 start_us,
+                              const gchar *path) {
+    if (!index_root || !camera_name || !path) return FALSE;
+
+    gchar *line = g_strdup_printf("D %" G_GINT64_FORMAT " %s\n", start_us, path);
+
+    g_mutex_lock(&index_lock);
+    gboolean ok = day_log_and_apply(camera_name, stream_type, start_us, line);
+    SegmentChangeFunc notify = change_func;
+    g_mutex_unlock(&index_lock);
+
+    if (ok && notify) notify(camera_name, stream_type, start_us, start_us, TRUE);
+
+    g_free(line);
+    return ok;
+}
+
+void segment_index_set_change_func(SegmentChangeFunc func) {
+    g_mutex_lock(&index_lock);
+    change_func = func;
+    g_mutex_unlock(&index_lock);
+}
+
+GArray* segment_index_get_day_spans(const gchar *camera_name,
+                                    StreamType stream_type,
+                                    gint64 day) {
+    GArray *spans = g_array_new(FALSE, FALSE, sizeof(SegmentSpan));
+
+    if (!index_root || !camera_name) return spans;
+
+    g_mutex_lock(&index_lock);
+    gchar *key = g_strdup_printf("%s/%s/%" G_GINT64_FORMAT,
+                                 quality_name(stream_type), camera_name, day);
+    SegmentDay *segment_day = g_hash_table_lookup(day_cache, key);
+    /* Ngày chưa có trong cache: đọc log nhưng không giữ record (tránh giữ path của cả tháng) */
+    SegmentDay *loaded = segment_day ? NULL : day_load(camera_name, stream_type, day);
+    if (loaded) segment_day = loaded;
+
+    for (guint i = 0; i < segment_day->records->len; i++) {
+        SegmentRecord *record = g_ptr_array_index(segment_day->records, i);
+        SegmentSpan span = { record->start_us, record->end_us };
+        g_array_append_val(spans, span);
+    }
+
+    if (loaded) segment_day_free(loaded);
+    g_free(key);
+    g_mutex_unlock(&index_lock);
+
+    return spans;
+}
+
+gboolean segment_index_replace_file(const gchar *camera_name,
+                                    StreamType stream_type,
+                                    gint64 start_us,
+                                    const gchar *path,
+                                    const gchar *new_file,
+                                    guint flags) {
+    gboolean ok = FALSE;
+
+    if (!index_root || !camera_name || !path || !new_file) return FALSE;
+
+    g_mutex_lock(&index_lock);
+    SegmentDay *day = day_get(camera_name, stream_type, day_of(start_us));
+    gint i = day_find(day, start_us, path);
+    /* Index trước, rename sau: rename lỗi thì bản gốc còn nguyên, cờ chỉ làm pass sau bỏ qua */
+    if (i >= 0 && g_file_test(path, G_FILE_TEST_EXISTS)) {
+        SegmentRecord *record = g_ptr_array_index(day->records, i);
+        gchar *line = g_strdup_printf("S %" G_GINT64_FORMAT " %" G_GINT64_FORMAT " %u %s\n",
+                                      start_us, record->end_us, flags, path);
+        ok = day_log_and_apply(camera_name, stream_type, start_us, line) &&
+             g_rename(new_file, path) == 0;
+        g_free(line);
+    }
+    g_mutex_unlock(&index_lock);
+
+    return ok;
+}
+
+gboolean segment_index_set_clock(const gchar *camera_name,
+                                 StreamType stream_type,
+                                 gint64 start_us,
+                                 const gchar *path,
+                                 const SegmentClock *clock) {
+    gboolean ok = FALSE;
+
+    if (!index_root || !camera_name || !path || !clock) return FALSE;
+
+    gchar *line = g_strdup_printf("C %" G_GINT64_FORMAT " %" G_GINT64_FORMAT " %" G_GINT64_FORMAT " %u %s\n",
+                                  start_us, clock->pts_ns, clock->wall_us, clock->source, path);
+
+    g_mutex_lock(&index_lock);
+    SegmentDay *day = day_get(camera_name, stream_type, day_of(start_us));
+    if (day_find(day, start_us, path) >= 0) {
+        ok = day_log_and_apply(camera_name, stream_type, start_us, line);
+    }
+    g_mutex_unlock(&index_lock);
+
+    g_free(line);
+    return ok;
+}
+
+GPtrArray* segment_index_get_day(const gchar *camera_name,
+                                 StreamType stream_type,
+                                 gint64 day) {
+    GPtrArray *result = g_ptr_array_new_with_free_func((GDestroyNotify)segment_record_free);
+
+    if (!index_root || !camera_name) return result;
+
+    g_mutex_lock(&index_lock);
+    SegmentDay *segment_day = day_get(camera_name, stream_type, day);
+    for (guint i = 0; i < segment_day->records->len; i++) {
+        g_ptr_array_add(result, segment_record_copy(g_ptr_array_index(segment_day->records, i)));
+    }
+    g_mutex_unlock(&index_lock);
+
+    return result;
+}
+
+static gint compare_day(gconstpointer a, gconstpointer b) {
+    gint64 da = *(const gint64 *)a;
+    gint64 db = *(const gint64 *)b;
+    return da < db ? -1 : (da > db ? 1 : 0);
+}
+
+GArray* segment_index_list_days(const gchar *camera_name, StreamType stream_type) {
+    GArray *days = g_array_new(FALSE, FALSE, sizeof(gint64));
+
+    if (!index_root || !camera_name) return days;
+
+    gchar *dir_path = g_build_filename(index_root, quality_name(stream_type), camera_name, NULL);
+    GDir *dir = g_dir_open(dir_path, 0, NULL);
+    g_free(dir_path);
+    if (!dir) return days;
+
+    const gchar *name;
+    while ((name = g_dir_read_name(dir)) != NULL) {
+        gint year, mon, mday;
+        if (!g_str_has_suffix(name, ".log") ||
+            sscanf(name, "%4d%2d%2d", &year, &mon, &mday) != 3) continue;
+
+        GDateTime *dt = g_date_time_new_utc(year, mon, mday, 0, 0, 0);
+        if (!dt) continue;
+        gint64 day = g_date_time_to_unix(dt) / 86400;
+        g_date_time_unref(dt);
+        g_array_append_val(days, day);
+    }
+    g_dir_close(dir);
+
+    g_array_sort(days, compare_day);
+    return days;
+}
+
+void segment_index_foreach_stream(SegmentStreamFunc func, gpointer user_data) {
+    if (!index_root) return;
+
+    for (gint s = 0; s < 2; s++) {
+        StreamType stream_type = s == 0 ? STREAM_MAIN : STREAM_SUB;
+        gchar *dir_path = g_build_filename(index_root, quality_name(stream_type), NULL);
+        GDir *dir = g_dir_open(dir_path, 0, NULL);
+        g_free(dir_path);
+        if (!dir) continue;
+
+        const gchar *name;
+        while ((name = g_dir_read_name(dir)) != NULL) {
+            func(name, stream_type, user_data);
+        }
+        g_dir_close(dir);
+    }
+}
+
+GPtrArray* segment_index_query(const gchar *camera_name,
+                               StreamType stream_type,
+                               gint64 start_us,
+                               gint64 end_us) {
+    GPtrArray *result = g_ptr_array_new_with_free_func((GDestroyNotify)segment_record_free);
+
+    if (!index_root || !camera_name || end_us <= start_us) return result;
+
+    gint64 first_day = day_of(start_us) - QUERY_LOOKBACK_DAYS;
+    gint64 last_day = day_of(end_us - 1);
+
+    g_mutex_lock(&index_lock);
+    for (gint64 d = first_day; d <= last_day; d++) {
+        SegmentDay *day = day_get(camera_name, stream_type, d);
+        for (guint i = 0; i < day->records->len; i++) {
+            SegmentRecord *record = g_ptr_array_index(day->records, i);
+            if (record->start_us >= end_us) break;
+            if (record->end_us > start_us || record->start_us >= start_us) {
+                g_ptr_array_add(result, segment_record_copy(record));
+            }
+        }
+    }
+    g_mutex_unlock(&index_lock);
+
+    return result;
+}
@@ -0,0 +1,139 @@
+#ifndef SEGMENT_INDEX_H
+#define SEGMENT_INDEX_H
+
+#include <glib.h>
+#include "recording_manager.h"
+
+#define SEGMENT_INDEX_DIR ".index"
+
+/* Cờ của segment */
+#define SEGMENT_FLAG_RECOVERED  (1 << 0)   /* được sửa lại sau crash */
+#define SEGMENT_FLAG_COMPACTED  (1 << 1)   /* chỉ còn keyframe (time-lapse) */
+
+/* Nguồn của mapping thời gian trong file <-> wallclock */
+typedef enum {
+    SEGMENT_CLOCK_NONE = 0,     /* chỉ có thời gian theo tên file (giây) */
+    SEGMENT_CLOCK_ARRIVAL,      /* thời điểm server nhận gói */
+    SEGMENT_CLOCK_NTP           /* RTCP sender report của camera */
+} SegmentClockSource;
+
+/* Một điểm neo: timestamp trong file (running time lúc ghi) ứng với wallclock */
+typedef struct SegmentClock {
+    gint64 pts_ns;
+    gint64 wall_us;
+    guint source;               /* SegmentClockSource */
+} SegmentClock;
+
+/* Một segment đã hoàn tất (metadata recording) */
+typedef struct {
+    gint64 start_us;    /* wallclock UTC lúc mở segment (tên file), micro giây */
+    gint64 end_us;      /* wallclock UTC của frame cuối */
+    gchar *path;
+    guint flags;
+    SegmentClock clock; /* mapping chính xác tới frame, source NONE nếu chưa có */
+} SegmentRecord;
+
+/* Khoảng thời gian [start_us, end_us) */
+typedef struct {
+    gint64 start_us;
+    gint64 end_us;
+} SegmentSpan;
+
+/* Khởi tạo index dưới <base_path>/.index */
+void segment_index_init(const gchar *base_path);
+
+/* Bỏ mọi ngày đã cache: lần đọc sau load lại từ log (log được process khác ghi thêm,
+ * ví dụ process cũ finalize segment trong lúc handoff) */
+void segment_index_invalidate(void);
+
+/* Ghi nhận segment đã hoàn tất (append vào log theo ngày UTC) */
+gboolean segment_index_add(const gchar *camera_name,
+                           StreamType stream_type,
+                           gint64 start_us,
+                           gint64 end_us,
+                           const gchar *path,
+                           guint flags);
+
+/* Các segment giao với [start_us, end_us), sắp xếp theo start_us.
+ * Trả về GPtrArray của SegmentRecord* (tự giải phóng khi unref). */
+GPtrArray* segment_index_query(const gchar *camera_name,
+                               StreamType stream_type,
+                               gint64 start_us,
+                               gint64 end_us);
+
+/* Các segment thuộc một ngày UTC (day = unix_time / 86400) */
+GPtrArray* segment_index_get_day(const gchar *camera_name,
+                                 StreamType stream_type,
+                                 gint64 day);
+
+/* Danh sách ngày có log index của stream, tăng dần (GArray of gint64) */
+GArray* segment_index_list_days(const gchar *camera_name, StreamType stream_type);
+
+/* Duyệt tất cả (camera, stream) có trong index */
+typedef void (*SegmentStreamFunc)(const gchar *camera_name,
+                                  StreamType stream_type,
+                                  gpointer user_data);
+void segment_index_foreach_stream(SegmentStreamFunc func, gpointer user_data);
+
+/* Đổi vị trí file của segment (một dòng log - atomic với người đọc index) */
+gboolean segment_index_relocate(const gchar *camera_name,
+                                StreamType stream_type,
+                                gint64 start_us,
+                                const gchar *old_path,
+                                const gchar *new_path);
+
+/* Xóa segment khỏi index (retention) */
+gboolean segment_index_remove(const gchar *camera_name,
+                              StreamType stream_type,
+                              gint64 start_us,
+                              const gchar *path);
+
+/* Thay file của segment bằng new_file (rename) và đặt flags, cả hai dưới index lock:
+ * retention xóa segment khỏi index trước khi xóa file nên không thể chen giữa.
+ * FALSE nếu segment không còn trong index, file gốc đã mất, hoặc ghi index/rename lỗi;
+ * new_file còn lại thì caller dọn */
+gboolean segment_index_replace_file(const gchar *camera_name,
+                                    StreamType stream_type,
+                                    gint64 start_us,
+                                    const gchar *path,
+                                    const gchar *new_file,
+                                    guint flags);
+
+/* Lưu mapping PTS <-> wallclock của segment, FALSE nếu segment không còn */
+gboolean segment_index_set_clock(const gchar *camera_name,
+                                 StreamType stream_type,
+                                 gint64 start_us,
+                                 const gchar *path,
+                                 const SegmentClock *clock);
+
+/* Khoảng thời gian của các segment trong một ngày UTC, theo start_us (GArray of SegmentSpan) */
+GArray* segment_index_get_day_spans(const gchar *camera_name,
+                                    StreamType stream_type,
+                                    gint64 day);
+
+/* Được gọi (ngoài lock của index) khi thêm segment hoặc khi segment bị xóa/ghi lại */
+typedef void (*SegmentChangeFunc)(const gchar *camera_name,
+                                  StreamType stream_type,
+                                  gint64 start_us,
+                                  gint64 end_us,
+                                  gboolean removed);
+void segment_index_set_change_func(SegmentChangeFunc func);
+
+/* Segment đang ghi trong process này (chưa finalize nên chưa có trong log), do journal đặt.
+ * segment_index_current trả start_us (-1 nếu không có), path nhận bản copy nếu khác NULL */
+void segment_index_set_current(const gchar *camera_name,
+                               StreamType stream_type,
+                               gint64 start_us,
+                               const gchar *path);
+/* Chỉ bỏ nếu segment đang ghi đúng là start_us */
+void segment_index_clear_current(const gchar *camera_name,
+                                 StreamType stream_type,
+                                 gint64 start_us);
+gint64 segment_index_current(const gchar *camera_name,
+                             StreamType stream_type,
+                             gchar **path);
+
+SegmentRecord* segment_record_copy(const SegmentRecord *record);
+void segment_record_free(SegmentRecord *record);
+
+#endif // SEGMENT_INDEX_H
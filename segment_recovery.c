@@ -0,0 +1,521 @@
+#include "segment_recovery.h"
+#include "segment_index.h"
+#include "native_segment.h"
+#include <gst/gst.h>
+#include <glib/gstdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Matroska/EBML element IDs */
+#define EBML_ID_HEADER          0x1A45DFA3
+#define MKV_ID_SEGMENT          0x18538067
+#define MKV_ID_SEEKHEAD         0x114D9B74
+#define MKV_ID_INFO             0x1549A966
+#define MKV_ID_TIMECODESCALE    0x2AD7B1
+#define MKV_ID_TRACKS           0x1654AE6B
+#define MKV_ID_CLUSTER          0x1F43B675
+#define MKV_ID_CLUSTERTIMECODE  0xE7
+#define MKV_ID_SIMPLEBLOCK      0xA3
+#define MKV_ID_BLOCKGROUP       0xA0
+#define MKV_ID_BLOCK            0xA1
+#define MKV_ID_CUES             0x1C53BB6B
+#define MKV_ID_CHAPTERS         0x1043A770
+#define MKV_ID_TAGS             0x1254C367
+#define MKV_ID_ATTACHMENTS      0x1941A469
+
+typedef struct {
+    guint64 timecode_scale;     /* ns mỗi đơn vị timecode */
+    gint64 first_cluster_tc;    /* -1 nếu chưa có cluster nào */
+    gint64 last_block_tc;
+    goffset good_end;           /* cuối cluster hoàn chỉnh cuối cùng */
+    guint clusters;
+} MkvScan;
+
+typedef struct {
+    gchar *camera_name;
+    StreamType stream_type;
+    gint64 start_us;
+    gchar *path;
+    gboolean repair;            /* FALSE = chỉ remux (đã sửa + đăng ký rồi) */
+} RepairJob;
+
+static gchar *journal_root = NULL;
+static GThreadPool *repair_pool = NULL;
+static GMutex repair_lock;
+
+/* ===== Journal ===== */
+
+static gchar* journal_marker_path(const gchar *camera_name, StreamType stream_type, gint64 start_us) {
+    gchar *name = g_strdup_printf("%s_%s_%" G_GINT64_FORMAT ".open",
+                                  stream_type == STREAM_MAIN ? RECORD_HI_QUALITY : RECORD_LOW_QUALITY,
+                                  camera_name, start_us);
+    gchar *path = g_build_filename(journal_root, name, NULL);
+    g_free(name);
+    return path;
+}
+
+void segment_journal_init(const gchar *base_path) {
+    g_free(journal_root);
+    journal_root = g_build_filename(base_path, SEGMENT_JOURNAL_DIR, NULL);
+    g_mkdir_with_parents(journal_root, 0755);
+}
+
+gboolean segment_journal_open(const gchar *camera_name,
+                              StreamType stream_type,
+                              gint64 start_us,
+                              const gchar *path) {
+    if (!journal_root) return FALSE;
+
+    segment_index_set_current(camera_name, stream_type, start_us, path);
+
+    gchar *marker = journal_marker_path(camera_name, stream_type, start_us);
+    gchar *contents = g_strdup_printf("%s\n%d\n%" G_GINT64_FORMAT "\n%s\n",
+                                      camera_name, (gint)stream_type, start_us, path);
+    GError *error = NULL;
+    gboolean ok = g_file_set_contents(marker, contents, -1, &error);
+    if (!ok) {
+        g_printerr("Failed to write journal marker %s: %s\n", marker, error->message);
+        g_error_free(error);
+    }
+
+    g_free(contents);
+    g_free(marker);
+    return ok;
+}
+
+void segment_journal_close(const gchar *camera_name,
+                           StreamType stream_type,
+                           gint64 start_us) {
+    if (!journal_root) return;
+
+    /* Marker của lần chạy trước (recovery) không phải segment đang ghi: index chỉ bỏ đúng start_us */
+    segment_index_clear_current(camera_name, stream_type, start_us);
+
+    gchar *marker = journal_marker_path(camera_name, stream_type, start_us);
+    g_unlink(marker);
+    g_free(marker);
+}
+
+/* ===== EBML scan ===== */
+
+static gboolean ebml_read_id(FILE *f, guint32 *id) {
+    gint c = fgetc(f);
+    if (c == EOF || c == 0) return FALSE;
+
+    gint len = 1;
+    guint32 mask = 0x80;
+    while (!(c & mask)) {
+        mask >>= 1;
+        len++;
+    }
+    if (len > 4) return FALSE;
+
+    guint32 value = c;
+    for (gint i = 1; i < len; i++) {
+        if ((c = fgetc(f)) == EOF) return FALSE;
+        value = (value << 8) | c;
+    }
+    *id = value;
+    return TRUE;
+}
+
+static gboolean ebml_read_size(FILE *f, guint64 *size, gboolean *unknown) {
+    gint c = fgetc(f);
+    if (c == EOF || c == 0) return FALSE;
+
+    gint len = 1;
+    guint32 mask = 0x80;
+    while (!(c & mask)) {
+        mask >>= 1;
+        len++;
+    }
+
+    guint64 value = c & (mask - 1);
+    gboolean all_ones = (value == mask - 1);
+    for (gint i = 1; i < len; i++) {
+        if ((c = fgetc(f)) == EOF) return FALSE;
+        value = (value << 8) | c;
+        if (c != 0xff) all_ones = FALSE;
+    }
+    *size = value;
+    *unknown = all_ones;
+    return TRUE;
+}
+
+static gboolean ebml_read_uint(FILE *f, guint64 size, guint64 *value) {
+    guint64 v = 0;
+    if (size > 8) return FALSE;
+    for (guint64 i = 0; i < size; i++) {
+        gint c = fgetc(f);
+        if (c == EOF) return FALSE;
+        v = (v << 8) | c;
+    }
+    *value = v;
+    return TRUE;
+}
+
+static gboolean is_top_level_id(guint32 id) {
+    return id == MKV_ID_CLUSTER || id == MKV_ID_CUES || id == MKV_ID_TAGS ||
+           id == MKV_ID_INFO || id == MKV_ID_TRACKS || id == MKV_ID_SEEKHEAD ||
+           id == MKV_ID_CHAPTERS || id == MKV_ID_ATTACHMENTS;
+}
+
+/* Timecode tương đối (int16) nằm sau track number trong header của block */
+static gboolean read_block_timecode(FILE *f, guint64 size, gint16 *rel_tc) {
+    gint c = fgetc(f);
+    if (c == EOF || c == 0) return FALSE;
+
+    gint len = 1;
+    while (!(c & (0x80 >> (len - 1)))) len++;
+    if ((guint64)len + 2 > size) return FALSE;
+    for (gint i = 1; i < len; i++) {
+        if (fgetc(f) == EOF) return FALSE;
+    }
+
+    gint hi = fgetc(f);
+    gint lo = fgetc(f);
+    if (hi == EOF || lo == EOF) return FALSE;
+    *rel_tc = (gint16)((hi << 8) | lo);
+    return TRUE;
+}
+
+/* Đọc một cluster; trả về FALSE nếu cluster bị cắt ngang */
+static gboolean scan_cluster(FILE *f, goffset data_start, guint64 size, gboolean unknown,
+                             goffset file_size, MkvScan *scan, goffset *cluster_end) {
+    goffset end = unknown ? file_size : data_start + (goffset)size;
+    gint64 cluster_tc = -1;
+    gint64 last_tc = -1;
+
+    if (end > file_size) return FALSE;
+
+    goffset pos = data_start;
+    while (pos < end) {
+        guint32 id;
+        guint64 child_size;
+        gboolean child_unknown;
+
+        if (fseeko(f, pos, SEEK_SET) != 0) return FALSE;
+        if (!ebml_read_id(f, &id)) {
+            if (unknown) break;
+            return FALSE;
+        }
+        if (unknown && is_top_level_id(id)) break;
+
+        /* Cluster không biết size kết thúc ở child hoàn chỉnh cuối cùng */
+        if (!ebml_read_size(f, &child_size, &child_unknown) || child_unknown) {
+            if (unknown) break;
+            return FALSE;
+        }
+
+        goffset child_start = ftello(f);
+        goffset child_end = child_start + (goffset)child_size;
+        if (child_end > end) {
+            if (unknown) break;
+            return FALSE;
+        }
+
+        if (id == MKV_ID_CLUSTERTIMECODE) {
+            guint64 tc;
+            if (!ebml_read_uint(f, child_size, &tc)) return FALSE;
+            cluster_tc = (gint64)tc;
+        } else if (id == MKV_ID_SIMPLEBLOCK || id == MKV_ID_BLOCKGROUP) {
+            gint16 rel_tc = 0;
+            gboolean ok;
+            if (id == MKV_ID_BLOCKGROUP) {
+                /* Block nằm bên trong BlockGroup */
+                guint32 inner_id;
+                guint64 inner_size;
+                gboolean inner_unknown;
+                ok = ebml_read_id(f, &inner_id) && inner_id == MKV_ID_BLOCK &&
+                     ebml_read_size(f, &inner_size, &inner_unknown) &&
+                     read_block_timecode(f, inner_size, &rel_tc);
+            } else {
+                ok = read_block_timecode(f, child_size, &rel_tc);
+            }
+            if (ok && cluster_tc >= 0 && cluster_tc + rel_tc > last_tc) {
+                last_tc = cluster_tc + rel_tc;
+            }
+        }
+
+        pos = child_end;
+    }
+
+    if (cluster_tc < 0) return FALSE;
+
+    if (scan->first_cluster_tc < 0) scan->first_cluster_tc = cluster_tc;
+    if (last_tc > scan->last_block_tc) scan->last_block_tc = last_tc;
+    scan->clusters++;
+    *cluster_end = pos;
+    return TRUE;
+}
+
+/* Duyệt top-level, dừng ở cluster hỏng đầu tiên */
+static gboolean scan_matroska(const gchar *path, MkvScan *scan) {
+    struct stat st;
+    guint32 id;
+    guint64 size;
+    gboolean unknown;
+
+    memset(scan, 0, sizeof(MkvScan));
+    scan->timecode_scale = 1000000;
+    scan->first_cluster_tc = -1;
+    scan->last_block_tc = -1;
+
+    if (g_stat(path, &st) != 0) return FALSE;
+    goffset file_size = st.st_size;
+
+    FILE *f = g_fopen(path, "rb");
+    if (!f) return FALSE;
+
+    /* EBML header */
+    if (!ebml_read_id(f, &id) || id != EBML_ID_HEADER ||
+        !ebml_read_size(f, &size, &unknown) || unknown ||
+        fseeko(f, (off_t)size, SEEK_CUR) != 0) {
+        fclose(f);
+        return FALSE;
+    }
+
+    /* Segment */
+    if (!ebml_read_id(f, &id) || id != MKV_ID_SEGMENT ||
+        !ebml_read_size(f, &size, &unknown)) {
+        fclose(f);
+        return FALSE;
+    }
+
+    goffset pos = ftello(f);
+    scan->good_end = pos;
+
+    while (pos < file_size) {
+        if (fseeko(f, pos, SEEK_SET) != 0) break;
+        if (!ebml_read_id(f, &id) || !ebml_read_size(f, &size, &unknown)) break;
+
+        goffset data_start = ftello(f);
+
+        if (id == MKV_ID_CLUSTER) {
+            goffset cluster_end = 0;
+            if (!scan_cluster(f, data_start, size, unknown, file_size, scan, &cluster_end)) break;
+            scan->good_end = cluster_end;
+            pos = cluster_end;
+            continue;
+        }
+
+        if (unknown || data_start + (goffset)size > file_size) break;
+
+        if (id == MKV_ID_INFO) {
+            goffset info_end = data_start + (goffset)size;
+            goffset child = data_start;
+            while (child < info_end) {
+                guint32 child_id;
+                guint64 child_size;
+                gboolean child_unknown;
+                if (fseeko(f, child, SEEK_SET) != 0 ||
+                    !ebml_read_id(f, &child_id) ||
+                    !ebml_read_size(f, &child_size, &child_unknown)) break;
+                goffset child_data = ftello(f);
+                if (child_id == MKV_ID_TIMECODESCALE) {
+                    guint64 scale;
+                    if (ebml_read_uint(f, child_size, &scale) && scale > 0) {
+                        scan->timecode_scale = scale;
+                    }
+                }
+                child = child_data + (goffset)child_size;
+            }
+        }
+
+        pos = data_start + (goffset)size;
+        if (scan->clusters == 0) scan->good_end = pos;
+    }
+
+    fclose(f);
+    return scan->clusters > 0;
+}
+
+/* ===== Repair ===== */
+
+/* Remux để matroskamux ghi lại Duration/Cues, thay file gốc bằng rename */
+static gboolean remux_segment(const gchar *path) {
+    gchar *tmp_path = g_strdup_printf("%s.remux", path);
+    gchar *launch = g_strdup_printf(
+        "filesrc location=\"%s\" ! matroskademux ! queue ! "
+        "matroskamux writing-app=\"RTSP Recorder\" ! filesink location=\"%s\"",
+        path, tmp_path);
+    GError *error = NULL;
+    gboolean ok = FALSE;
+
+    GstElement *pipeline = gst_parse_launch(launch, &error);
+    g_free(launch);
+    if (error) {
+        g_printerr("[recovery] Remux pipeline error: %s\n", error->message);
+        g_error_free(error);
+        if (pipeline) gst_object_unref(pipeline);
+        g_free(tmp_path);
+        return FALSE;
+    }
+
+    gst_element_set_state(pipeline, GST_STATE_PLAYING);
+    GstBus *bus = gst_element_get_bus(pipeline);
+    GstMessage *msg = gst_bus_timed_pop_filtered(bus, GST_CLOCK_TIME_NONE,
+                                                 GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+    ok = msg && GST_MESSAGE_TYPE(msg) == GST_MESSAGE_EOS;
+    if (msg) gst_message_unref(msg);
+    gst_object_unref(bus);
+
+    gst_element_set_state(pipeline, GST_STATE_NULL);
+    gst_object_unref(pipeline);
+
+    if (ok) {
+        ok = g_rename(tmp_path, path) == 0;
+    }
+    if (!ok) {
+        g_unlink(tmp_path);
+    }
+
+    g_free(tmp_path);
+    return ok;
+}
+
+/* Cắt phần cuối hỏng, đăng ký segment vào index và xóa marker */
+static gboolean repair_segment(const gchar *camera_name, StreamType stream_type,
+                               gint64 start_us, const gchar *path) {
+    MkvScan scan;
+    struct stat st;
+
+    if (g_stat(path, &st) != 0) {
+        g_printerr("[recovery] %s missing, dropping journal entry\n", path);
+        segment_journal_close(camera_name, stream_type, start_us);
+        return FALSE;
+    }
+
+    /* Native segment: cắt frame dở và ghi lại trailer, không cần remux */
+    if (native_segment_is_native_path(path)) {
+        gint64 duration_us = 0;
+        if (!native_segment_repair(path, &duration_us)) {
+            g_printerr("[recovery] %s has no complete frame, dropping journal entry\n", path);
+            segment_journal_close(camera_name, stream_type, start_us);
+            return FALSE;
+        }
+        segment_index_add(camera_name, stream_type, start_us, start_us + duration_us,
+                          path, SEGMENT_FLAG_RECOVERED);
+        segment_journal_close(camera_name, stream_type, start_us);
+        g_print("[recovery] Recovered %s (%.1f s)\n", path, duration_us / 1e6);
+        return TRUE;
+    }
+
+    if (!scan_matroska(path, &scan)) {
+        g_printerr("[recovery] %s has no complete cluster, dropping journal entry\n", path);
+        segment_journal_close(camera_name, stream_type, start_us);
+        return FALSE;
+    }
+
+    if (scan.good_end < st.st_size) {
+        g_print("[recovery] Truncating %s: %ld -> %ld bytes\n",
+                path, (long)st.st_size, (long)scan.good_end);
+        if (truncate(path, scan.good_end) != 0) {
+            g_printerr("[recovery] Failed to truncate %s\n", path);
+        }
+    }
+
+    gint64 duration_us = 0;
+    if (scan.last_block_tc > scan.first_cluster_tc) {
+        duration_us = (gint64)((scan.last_block_tc - scan.first_cluster_tc) *
+                               scan.timecode_scale / 1000);
+    }
+
+    segment_index_add(camera_name, stream_type, start_us, start_us + duration_us,
+                      path, SEGMENT_FLAG_RECOVERED);
+    segment_journal_close(camera_name, stream_type, start_us);
+
+    g_print("[recovery] Recovered %s (%u clusters, %.1f s)\n",
+            path, scan.clusters, duration_us / 1e6);
+    return TRUE;
+}
+
+static void repair_job_free(RepairJob *job) {
+    g_free(job->camera_name);
+    g_free(job->path);
+    g_free(job);
+}
+
+static void repair_job_func(gpointer data, gpointer user_data) {
+    RepairJob *job = data;
+
+    if (!job->repair ||
+        repair_segment(job->camera_name, job->stream_type, job->start_us, job->path)) {
+        if (!native_segment_is_native_path(job->path) && !remux_segment(job->path)) {
+            g_printerr("[recovery] Remux failed for %s, keeping truncated file\n", job->path);
+        }
+    }
+
+    repair_job_free(job);
+}
+
+static void push_repair_job(const gchar *camera_name, StreamType stream_type,
+                            gint64 start_us, const gchar *path, gboolean repair) {
+    RepairJob *job = g_new0(RepairJob, 1);
+    job->camera_name = g_strdup(camera_name);
+    job->stream_type = stream_type;
+    job->start_us = start_us;
+    job->path = g_strdup(path);
+    job->repair = repair;
+
+    g_mutex_lock(&repair_lock);
+    if (!repair_pool) {
+        /* Một thread để remux không tranh I/O với recording */
+        repair_pool = g_thread_pool_new(repair_job_func, NULL, 1, FALSE, NULL);
+    }
+    g_thread_pool_push(repair_pool, job, NULL);
+    g_mutex_unlock(&repair_lock);
+}
+
+void segment_recovery_repair_async(const gchar *camera_name,
+                                   StreamType stream_type,
+                                   gint64 start_us,
+                                   const gchar *path) {
+    push_repair_job(camera_name, stream_type, start_us, path, TRUE);
+}
+
+guint segment_recovery_run(void) {
+    guint recovered = 0;
+    gint64 start = g_get_monotonic_time();
+
+    if (!journal_root) return 0;
+
+    GDir *dir = g_dir_open(journal_root, 0, NULL);
+    if (!dir) return 0;
+
+    const gchar *name;
+    while ((name = g_dir_read_name(dir)) != NULL) {
+        if (!g_str_has_suffix(name, ".open")) continue;
+
+        gchar *marker = g_build_filename(journal_root, name, NULL);
+        gchar *contents = NULL;
+
+        if (g_file_get_contents(marker, &contents, NULL, NULL)) {
+            gchar **lines = g_strsplit(contents, "\n", 5);
+            if (g_strv_length(lines) >= 4 && lines[0][0] && lines[3][0]) {
+                StreamType stream_type = (StreamType)atoi(lines[1]);
+                gint64 start_us = g_ascii_strtoll(lines[2], NULL, 10);
+
+                /* Sửa đồng bộ (chỉ đọc header cluster), remux ở background */
+                if (repair_segment(lines[0], stream_type, start_us, lines[3])) {
+                    push_repair_job(lines[0], stream_type, start_us, lines[3], FALSE);
+                    recovered++;
+                }
+            } else {
+                g_printerr("[recovery] Invalid journal entry %s\n", marker);
+                g_unlink(marker);
+            }
+            g_strfreev(lines);
+            g_free(contents);
+        }
+        g_free(marker);
+    }
+    g_dir_close(dir);
+
+    g_print("[recovery] %u unfinalized segment(s) recovered in %ld ms\n",
+            recovered, (long)((g_get_monotonic_time() - start) / 1000));
+    return recovered;
+}
@@ -0,0 +1,34 @@
+#ifndef SEGMENT_RECOVERY_H
+#define SEGMENT_RECOVERY_H
+
+#include <glib.h>
+#include "recording_manager.h"
+
+#define SEGMENT_JOURNAL_DIR ".journal"
+#define RECORD_EOS_TIMEOUT_NS (5 * GST_SECOND)
+
+/* Khởi tạo journal dưới <base_path>/.journal */
+void segment_journal_init(const gchar *base_path);
+
+/* Đánh dấu segment đang ghi (chưa finalize); index biết segment này qua segment_index_current */
+gboolean segment_journal_open(const gchar *camera_name,
+                              StreamType stream_type,
+                              gint64 start_us,
+                              const gchar *path);
+
+/* Segment đã finalize xong - xóa marker */
+void segment_journal_close(const gchar *camera_name,
+                           StreamType stream_type,
+                           gint64 start_us);
+
+/* Sửa một segment chưa finalize ở background rồi đăng ký vào index và xóa marker */
+void segment_recovery_repair_async(const gchar *camera_name,
+                                   StreamType stream_type,
+                                   gint64 start_us,
+                                   const gchar *path);
+
+/* Quét journal lúc khởi động, sửa các segment chưa finalize.
+ * Chỉ đọc thư mục journal nên thời gian không phụ thuộc kích thước archive. */
+guint segment_recovery_run(void);
+
+#endif // SEGMENT_RECOVERY_H
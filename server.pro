@@ -13,11 +13,38 @@ TEMPLATE = app
 
 
 SOURCES += \
+    adaptive_stream.c \
+    analytics_tap.c \
     camera_media_factory.c \
+    camera_probe.c \
+    client_congestion.c \
+    clip_playback.c \
+    cluster.c \
+    dvr_buffer.c \
+    handoff.c \
+    http_control.c \
+    io_policy.c \
+    latency_measure.c \
+    latency_profile.c \
+    native_segment.c \
     main.c \
     playback_factory.c \
+    profiling.c \
+    recording_coverage.c \
+    recording_lookup.c \
     recording_manager.c \
-    server_context.c
+    rtsp_threads.c \
+    segment_cache.c \
+    segment_clock.c \
+    segment_compactor.c \
+    segment_index.c \
+    segment_recovery.c \
+    server_context.c \
+    session_trace.c \
+    snapshot.c \
+    storage_tiers.c \
+    udp_egress.c \
+    webrtc_egress.c
 
 
 INCLUDEPATH += /usr/include/
@@ -25,15 +52,48 @@ LIBS += -L/usr/lib/aarch64-linux-gnu -lpthread -lavcodec -lavformat -lavutil -ls
 
 INCLUDEPATH += /usr/include/gstreamer-1.0 \
                /usr/include/glib-2.0 \
-               /usr/lib/x86_64-linux-gnu/glib-2.0/include
+               /usr/lib/x86_64-linux-gnu/glib-2.0/include \
+               /usr/include/libsoup-3.0 \
+               /usr/include/json-glib-1.0
 
 
 LIBS += -L/usr/lib/x86_64-linux-gnu \
-        -lgstrtspserver-1.0 -lgstreamer-1.0 -lgobject-2.0 -lglib-2.0
+        -lgstrtspserver-1.0 -lgstrtsp-1.0 -lgstsdp-1.0 -lgstcodecparsers-1.0 -lgstrtp-1.0 -lgstbase-1.0 -lgstapp-1.0 -lgstvideo-1.0 -lgstwebrtc-1.0 -lgstreamer-1.0 -lsoup-3.0 -ljson-glib-1.0 -lgio-2.0 -lgobject-2.0 -lglib-2.0 -ldl
+
+# Profiling: tên hàm trong stacks.folded (dladdr cần symbol động của binary chính)
+QMAKE_LFLAGS += -rdynamic
 
 HEADERS += \
+    adaptive_stream.h \
+    analytics_shm.h \
+    analytics_tap.h \
     camera_config.h \
     camera_media_factory.h \
+    camera_probe.h \
+    client_congestion.h \
+    clip_playback.h \
+    cluster.h \
+    dvr_buffer.h \
+    handoff.h \
+    http_control.h \
+    io_policy.h \
+    latency_measure.h \
+    latency_profile.h \
+    native_segment.h \
     playback_factory.h \
+    profiling.h \
+    recording_coverage.h \
+    recording_lookup.h \
     recording_manager.h \
-    server_context.h
+    rtsp_threads.h \
+    segment_cache.h \
+    segment_clock.h \
+    segment_compactor.h \
+    segment_index.h \
+    segment_recovery.h \
+    server_context.h \
+    session_trace.h \
+    snapshot.h \
+    storage_tiers.h \
+    udp_egress.h \
+    webrtc_egress.h
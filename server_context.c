@@ -2,6 +2,7 @@
 #include "camera_media_factory.h"
 #include "playback_factory.h"
 #include "recording_manager.h"
+#include "latency_profile.h"
 #include <sys/stat.h>
 #include <string.h>
 #include <time.h>
@@ -60,6 +61,28 @@ CameraConfig* find_camera(const gchar *name) {
     return NULL;
 }
 
+gboolean set_camera_latency_profile(ServerContext *ctx,
+                                    const gchar *name,
+                                    const gchar *profile) {
+    if (!latency_profile_find(profile)) {
+        g_printerr("Unknown latency profile: %s\n", profile);
+        return FALSE;
+    }
+
+    for (gint i = 0; i < ctx->camera_count; i++) {
+        CameraConfig *cam = &ctx->cameras[i];
+        if (g_strcmp0(cam->name, name) == 0) {
+            g_free(cam->latency_profile);
+            cam->latency_profile = g_strdup(profile);
+            g_print("Camera %s: latency profile %s\n", name, profile);
+            return TRUE;
+        }
+    }
+
+    g_printerr("Camera not found: %s\n", name);
+    return FALSE;
+}
+
 static void mount_camera(GstRTSPMountPoints *mounts, CameraConfig *cam) {
     gchar *path = g_strdup_printf("/%s", cam->name);
     CameraMediaFactory *factory = camera_media_factory_new(cam);
@@ -103,5 +126,7 @@ gboolean rotate_recording(gpointer user_data) {
 }
 
 void setup_server_latency_profile(GstRTSPServer *server) {
-    g_object_set(server, "backlog", 5, NULL);
+    /* Latency của từng stream nằm trong LatencyProfile (latency_profile.h), ở đây chỉ
+     * cấu hình listen socket để client mở đồng loạt không phải chờ accept */
+    g_object_set(server, "backlog", SERVER_LISTEN_BACKLOG, NULL);
 }
@@ -7,6 +7,7 @@
 
 #define MAX_CAMERAS 10
 #define RECORD_PATH "/home/oryza/Oryza/recordings"
+#define SERVER_LISTEN_BACKLOG 128
 
 typedef struct {
     GstRTSPServer *server;
@@ -31,6 +32,11 @@ void add_camera(ServerContext *ctx,
 
 CameraConfig* find_camera(const gchar *name);
 
+/* Latency profile mặc định của mount ("ultra-low", "balanced", "smooth") */
+gboolean set_camera_latency_profile(ServerContext *ctx,
+                                    const gchar *name,
+                                    const gchar *profile);
+
 /* Mount endpoints */
 void remount_all_cameras(ServerContext *ctx);
 void mount_playback_endpoint(GstRTSPMountPoints *mounts,
@@ -40,7 +46,7 @@ void mount_playback_endpoint(GstRTSPMountPoints *mounts,
 /* Recording rotation */
 gboolean rotate_recording(gpointer user_data);
 
-/* Setup server optimizations */
+/* Setup server optimizations (backlog cho nhiều client kết nối cùng lúc) */
 void setup_server_latency_profile(GstRTSPServer *server);
 
 /* Utils */
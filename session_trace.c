@@ -0,0 +1,306 @@
+#include "session_trace.h"
+#include <string.h>
+
+/* Bucket theo lũy thừa 2 của mili giây: <1ms, <2ms, ..., <32s, còn lại */
+#define TRACE_HIST_BUCKETS 17
+
+#define TRACE_CLIENT_REQUEST_KEY "trace-request-us"
+#define TRACE_PIPELINE_KEY       "session-trace"
+
+struct _SessionTrace {
+    gint64 start_us;                      /* monotonic lúc nhận request */
+    gint64 start_wall_us;
+    gint64 stage_us[TRACE_STAGE_COUNT];
+    gint marked;                          /* bitmask mốc đã ghi (atomic) */
+    gint committed;
+    gchar camera[SESSION_TRACE_CAMERA_LEN];
+    gboolean playback;
+};
+
+/* Ring lock-free: writer lấy slot bằng atomic add, seq lẻ trong lúc ghi (seqlock) */
+typedef struct {
+    gint seq;
+    SessionTraceRecord record;
+} TraceSlot;
+
+static TraceSlot ring[SESSION_TRACE_RING_SIZE];
+static gint ring_head = 0;
+static gint histogram[TRACE_STAGE_COUNT][TRACE_HIST_BUCKETS];
+
+static const gchar *stage_names[TRACE_STAGE_COUNT] = {
+    "request",
+    "create_element",
+    "segment_lookup",
+    "pipeline_build",
+    "prepared",
+    "seek_done",
+    "first_rtp",
+    "first_keyframe"
+};
+
+/* ===== Client request ===== */
+
+static void on_request(GstRTSPClient *client, GstRTSPContext *ctx, gpointer user_data) {
+    gint64 *request_us = g_new(gint64, 1);
+    *request_us = g_get_monotonic_time();
+    g_object_set_data_full(G_OBJECT(client), TRACE_CLIENT_REQUEST_KEY, request_us, g_free);
+}
+
+static void on_client_connected(GstRTSPServer *server, GstRTSPClient *client, gpointer user_data) {
+    /* Media được tạo trong DESCRIBE, hoặc SETUP nếu client bỏ qua DESCRIBE */
+    g_signal_connect(client, "describe-request", G_CALLBACK(on_request), NULL);
+    g_signal_connect(client, "setup-request", G_CALLBACK(on_request), NULL);
+}
+
+void session_trace_init(GstRTSPServer *server) {
+    g_signal_connect(server, "client-connected", G_CALLBACK(on_client_connected), NULL);
+}
+
+/* ===== Ring + histogram ===== */
+
+static guint hist_bucket(gint64 us) {
+    gint64 ms = us / 1000;
+    guint bucket = 0;
+    while (ms > 0 && bucket < TRACE_HIST_BUCKETS - 1) {
+        ms >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+static void session_trace_commit(SessionTrace *trace) {
+    if (!g_atomic_int_compare_and_exchange(&trace->committed, 0, 1)) return;
+
+    SessionTraceRecord record;
+    memset(&record, 0, sizeof(record));
+    record.start_wall_us = trace->start_wall_us;
+    record.playback = trace->playback;
+    g_strlcpy(record.camera, trace->camera, sizeof(record.camera));
+
+    gint marked = g_atomic_int_get(&trace->marked);
+    for (gint i = 0; i < TRACE_STAGE_COUNT; i++) {
+        record.stage_us[i] = (marked & (1 << i)) ? trace->stage_us[i] : -1;
+        if (record.stage_us[i] >= 0) {
+            g_atomic_int_inc(&histogram[i][hist_bucket(record.stage_us[i])]);
+        }
+    }
+
+    guint pos = (guint)g_atomic_int_add(&ring_head, 1) % SESSION_TRACE_RING_SIZE;
+    TraceSlot *slot = &ring[pos];
+    g_atomic_int_inc(&slot->seq);
+    memcpy(&slot->record, &record, sizeof(record));
+    g_atomic_int_inc(&slot->seq);
+}
+
+/* ===== Trace ===== */
+
+SessionTrace* session_trace_begin(const gchar *camera_name, gboolean playback) {
+    SessionTrace *trace = g_atomic_rc_box_new0(SessionTrace);
+    gint64 now = g_get_monotonic_time();
+
+    trace->start_us = now;
+    GstRTSPContext *ctx = gst_rtsp_context_get_current();
+    if (ctx && ctx->client) {
+        gint64 *request_us = g_object_get_data(G_OBJECT(ctx->client), TRACE_CLIENT_REQUEST_KEY);
+        if (request_us && *request_us <= now) trace->start_us = *request_us;
+    }
+    trace->start_wall_us = g_get_real_time() - (now - trace->start_us);
+    trace->playback = playback;
+    g_strlcpy(trace->camera, camera_name ? camera_name : "", sizeof(trace->camera));
+
+    trace->stage_us[TRACE_STAGE_REQUEST] = 0;
+    trace->marked = 1 << TRACE_STAGE_REQUEST;
+    session_trace_mark(trace, TRACE_STAGE_CREATE_ELEMENT);
+    return trace;
+}
+
+SessionTrace* session_trace_ref(SessionTrace *trace) {
+    return g_atomic_rc_box_acquire(trace);
+}
+
+static void session_trace_clear(gpointer data) {
+    /* Session kết thúc trước khi đủ mốc RTP/keyframe đầu tiên vẫn được ghi lại */
+    session_trace_commit(data);
+}
+
+void session_trace_unref(SessionTrace *trace) {
+    if (trace) g_atomic_rc_box_release_full(trace, session_trace_clear);
+}
+
+void session_trace_mark(SessionTrace *trace, SessionTraceStage stage) {
+    if (!trace || stage >= TRACE_STAGE_COUNT) return;
+
+    gint bit = 1 << stage;
+    if (g_atomic_int_get(&trace->marked) & bit) return;
+
+    trace->stage_us[stage] = g_get_monotonic_time() - trace->start_us;
+    gint marked = g_atomic_int_or(&trace->marked, bit) | bit;
+
+    /* Ghi khi đủ cả hai mốc cuối: keyframe vào payloader trước gói RTP đầu tiên ra khỏi nó
+     * (playback), còn live có thể ra RTP của delta frame trước keyframe */
+    gint last = (1 << TRACE_STAGE_FIRST_RTP) | (1 << TRACE_STAGE_FIRST_KEYFRAME);
+    if ((marked & last) == last) {
+        session_trace_commit(trace);
+    }
+}
+
+/* ===== Pipeline / media hooks ===== */
+
+static GstPadProbeReturn first_rtp_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    session_trace_mark(user_data, TRACE_STAGE_FIRST_RTP);
+    return GST_PAD_PROBE_REMOVE;
+}
+
+static GstPadProbeReturn first_keyframe_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    if (GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DELTA_UNIT)) {
+        return GST_PAD_PROBE_OK;
+    }
+    session_trace_mark(user_data, TRACE_STAGE_FIRST_KEYFRAME);
+    return GST_PAD_PROBE_REMOVE;
+}
+
+void session_trace_attach(SessionTrace *trace, GstElement *pipeline) {
+    g_object_set_data_full(G_OBJECT(pipeline), TRACE_PIPELINE_KEY,
+                           session_trace_ref(trace), (GDestroyNotify)session_trace_unref);
+
+    GstElement *pay = GST_IS_BIN(pipeline) ? gst_bin_get_by_name(GST_BIN(pipeline), "pay0") : NULL;
+    if (!pay) return;
+
+    GstPad *src = gst_element_get_static_pad(pay, "src");
+    if (src) {
+        gst_pad_add_probe(src, GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST,
+                          first_rtp_probe, session_trace_ref(trace),
+                          (GDestroyNotify)session_trace_unref);
+        gst_object_unref(src);
+    }
+
+    GstPad *sink = gst_element_get_static_pad(pay, "sink");
+    if (sink) {
+        gst_pad_add_probe(sink, GST_PAD_PROBE_TYPE_BUFFER,
+                          first_keyframe_probe, session_trace_ref(trace),
+                          (GDestroyNotify)session_trace_unref);
+        gst_object_unref(sink);
+    }
+
+    gst_object_unref(pay);
+}
+
+SessionTrace* session_trace_from_pipeline(GstElement *pipeline) {
+    return pipeline ? g_object_get_data(G_OBJECT(pipeline), TRACE_PIPELINE_KEY) : NULL;
+}
+
+static void on_media_prepared_trace(GstRTSPMedia *media, gpointer user_data) {
+    session_trace_mark(user_data, TRACE_STAGE_PREPARED);
+}
+
+static void trace_closure_notify(gpointer data, GClosure *closure) {
+    session_trace_unref(data);
+}
+
+void session_trace_watch_media(GstRTSPMedia *media) {
+    GstElement *element = gst_rtsp_media_get_element(media);
+    SessionTrace *trace = session_trace_from_pipeline(element);
+
+    if (trace) {
+        g_signal_connect_data(media, "prepared", G_CALLBACK(on_media_prepared_trace),
+                              session_trace_ref(trace), trace_closure_notify, 0);
+    }
+    if (element) gst_object_unref(element);
+}
+
+/* ===== Report ===== */
+
+static gint64 record_total(const SessionTraceRecord *record) {
+    gint64 total = 0;
+    for (gint i = 0; i < TRACE_STAGE_COUNT; i++) {
+        if (record->stage_us[i] > total) total = record->stage_us[i];
+    }
+    return total;
+}
+
+static gint compare_record_total_desc(gconstpointer a, gconstpointer b) {
+    gint64 ta = record_total(a);
+    gint64 tb = record_total(b);
+    return ta < tb ? 1 : (ta > tb ? -1 : 0);
+}
+
+/* Percentile gần đúng: cận trên của bucket chứa percentile */
+static gint64 hist_percentile_ms(const gint *counts, gint total, gdouble p) {
+    gint target = (gint)(total * p + 0.5);
+    gint seen = 0;
+    for (gint b = 0; b < TRACE_HIST_BUCKETS; b++) {
+        seen += counts[b];
+        if (seen >= target && seen > 0) return (gint64)1 << b;
+    }
+    return -1;
+}
+
+gchar* session_trace_report(guint slowest_n) {
+    GString *out = g_string_new("");
+
+    g_string_append(out, "[trace] Time to first frame (ms, bucket upper bound)\n");
+    for (gint s = 0; s < TRACE_STAGE_COUNT; s++) {
+        gint counts[TRACE_HIST_BUCKETS];
+        gint total = 0;
+        for (gint b = 0; b < TRACE_HIST_BUCKETS; b++) {
+            counts[b] = g_atomic_int_get(&histogram[s][b]);
+            total += counts[b];
+        }
+        if (total == 0) continue;
+
+        g_string_append_printf(out, "  %-15s n=%-6d p50<=%-6" G_GINT64_FORMAT
+                               " p95<=%-6" G_GINT64_FORMAT " p99<=%-6" G_GINT64_FORMAT " |",
+                               stage_names[s], total,
+                               hist_percentile_ms(counts, total, 0.50),
+                               hist_percentile_ms(counts, total, 0.95),
+                               hist_percentile_ms(counts, total, 0.99));
+        for (gint b = 0; b < TRACE_HIST_BUCKETS; b++) {
+            g_string_append_printf(out, " %d", counts[b]);
+        }
+        g_string_append_c(out, '\n');
+    }
+
+    /* Snapshot ring, bỏ slot đang được ghi */
+    GArray *records = g_array_new(FALSE, FALSE, sizeof(SessionTraceRecord));
+    for (guint i = 0; i < SESSION_TRACE_RING_SIZE; i++) {
+        TraceSlot *slot = &ring[i];
+        gint seq = g_atomic_int_get(&slot->seq);
+        if (seq == 0 || (seq & 1)) continue;
+
+        SessionTraceRecord record;
+        memcpy(&record, &slot->record, sizeof(record));
+        if (g_atomic_int_get(&slot->seq) != seq) continue;
+        g_array_append_val(records, record);
+    }
+    g_array_sort(records, compare_record_total_desc);
+
+    g_string_append_printf(out, "[trace] Slowest %u of %u sessions (ms from request)\n",
+                           MIN(slowest_n, records->len), records->len);
+    for (guint i = 0; i < records->len && i < slowest_n; i++) {
+        SessionTraceRecord *record = &g_array_index(records, SessionTraceRecord, i);
+        GDateTime *dt = g_date_time_new_from_unix_local(record->start_wall_us / G_USEC_PER_SEC);
+        gchar *when = g_date_time_format(dt, "%Y-%m-%d %H:%M:%S");
+
+        g_string_append_printf(out, "  %s %-12s %-8s", when, record->camera,
+                               record->playback ? "playback" : "live");
+        for (gint s = 1; s < TRACE_STAGE_COUNT; s++) {
+            if (record->stage_us[s] < 0) continue;
+            g_string_append_printf(out, " %s=%.1f", stage_names[s], record->stage_us[s] / 1000.0);
+        }
+        g_string_append_c(out, '\n');
+
+        g_free(when);
+        g_date_time_unref(dt);
+    }
+
+    g_array_unref(records);
+    return g_string_free(out, FALSE);
+}
+
+gboolean session_trace_dump(gpointer user_data) {
+    gchar *report = session_trace_report(SESSION_TRACE_SLOWEST_N);
+    g_print("%s", report);
+    g_free(report);
+    return G_SOURCE_CONTINUE;
+}
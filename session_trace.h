@@ -0,0 +1,57 @@
+#ifndef SESSION_TRACE_H
+#define SESSION_TRACE_H
+
+#include <gst/gst.h>
+#include <gst/rtsp-server/rtsp-server.h>
+
+#define SESSION_TRACE_RING_SIZE   1024
+#define SESSION_TRACE_SLOWEST_N   10
+#define SESSION_TRACE_CAMERA_LEN  32
+
+/* Các mốc thời gian của một session, tính từ lúc nhận request RTSP */
+typedef enum {
+    TRACE_STAGE_REQUEST = 0,       /* nhận DESCRIBE/SETUP */
+    TRACE_STAGE_CREATE_ELEMENT,    /* vào camera_media_factory_create_element() */
+    TRACE_STAGE_SEGMENT_LOOKUP,    /* tìm xong file recording (playback) */
+    TRACE_STAGE_PIPELINE_BUILD,    /* gst_parse_launch xong */
+    TRACE_STAGE_PREPARED,
+    TRACE_STAGE_SEEK_DONE,         /* playback: seek hoàn tất (ASYNC_DONE sau seek) */
+    TRACE_STAGE_FIRST_RTP,         /* gói RTP đầu tiên ra khỏi payloader */
+    TRACE_STAGE_FIRST_KEYFRAME,    /* keyframe đầu tiên vào payloader */
+    TRACE_STAGE_COUNT
+} SessionTraceStage;
+
+/* Bản ghi đã hoàn tất trong ring */
+typedef struct {
+    gint64 start_wall_us;
+    gint64 stage_us[TRACE_STAGE_COUNT];   /* offset từ REQUEST, -1 nếu chưa tới */
+    gchar camera[SESSION_TRACE_CAMERA_LEN];
+    gboolean playback;
+} SessionTraceRecord;
+
+/* Trace của session đang mở (refcounted, dùng từ nhiều thread) */
+typedef struct _SessionTrace SessionTrace;
+
+/* Ghi lại thời điểm nhận request của mỗi client */
+void session_trace_init(GstRTSPServer *server);
+
+/* Bắt đầu trace từ request RTSP hiện tại (gst_rtsp_context_get_current) */
+SessionTrace* session_trace_begin(const gchar *camera_name, gboolean playback);
+SessionTrace* session_trace_ref(SessionTrace *trace);
+void session_trace_unref(SessionTrace *trace);
+
+/* Đánh dấu mốc (chỉ lần đầu có hiệu lực) */
+void session_trace_mark(SessionTrace *trace, SessionTraceStage stage);
+
+/* Gắn trace vào pipeline và media: PREPARED, RTP/keyframe đầu tiên qua "pay0" */
+void session_trace_attach(SessionTrace *trace, GstElement *pipeline);
+void session_trace_watch_media(GstRTSPMedia *media);
+SessionTrace* session_trace_from_pipeline(GstElement *pipeline);
+
+/* Histogram từng mốc và N session chậm nhất */
+gchar* session_trace_report(guint slowest_n);
+
+/* GSourceFunc: in report (dùng cho SIGUSR1) */
+gboolean session_trace_dump(gpointer user_data);
+
+#endif // SESSION_TRACE_H
@@ -0,0 +1,400 @@
+#include "snapshot.h"
+#include "http_control.h"
+#include "server_context.h"
+#include <gst/gst.h>
+#include <gst/app/gstappsrc.h>
+#include <stdlib.h>
+
+/* Keyframe gần nhất của một camera/stream, lấy từ parser của recording pipeline */
+typedef struct {
+    GstBuffer *buffer;           /* ref buffer của recording, không copy */
+    GstCaps *caps;               /* caps lúc nhận buffer */
+    GstCaps *stream_caps;        /* caps hiện tại của parser (có thể chưa có keyframe) */
+    gint64 captured_us;          /* monotonic lúc nhận keyframe */
+} SnapshotKeyframe;
+
+/* Ảnh cache của một camera ở một kích thước; chỉ truy cập trên main context */
+typedef struct {
+    gchar *key;                  /* "<camera>/<w>x<h>" */
+    GBytes *jpeg;
+    gint64 taken_us;             /* monotonic lúc nhận keyframe đã giải mã */
+    gint64 decoded_us;           /* monotonic lúc giải mã xong */
+    gint64 last_request_us;
+    gboolean in_flight;
+    GPtrArray *waiters;          /* SoupServerMessage* đang pause chờ lần giải mã này */
+} SnapshotEntry;
+
+/* Việc giải mã trên thread pool: mang bản copy, không chạm vào entry */
+typedef struct {
+    gchar *key;
+    GstBuffer *keyframe;
+    GstCaps *caps;
+    gint64 captured_us;
+    gint width;
+    gint height;
+    GBytes *jpeg;
+    gchar *error;
+} SnapshotJob;
+
+static GMutex keyframe_lock;
+static GHashTable *keyframes = NULL; /* "<camera>/<main|sub>" -> SnapshotKeyframe* */
+static GHashTable *entries = NULL;   /* key -> SnapshotEntry* */
+static GThreadPool *decode_pool = NULL;
+
+static void keyframe_free(gpointer data) {
+    SnapshotKeyframe *keyframe = data;
+    if (keyframe->buffer) gst_buffer_unref(keyframe->buffer);
+    if (keyframe->caps) gst_caps_unref(keyframe->caps);
+    if (keyframe->stream_caps) gst_caps_unref(keyframe->stream_caps);
+    g_free(keyframe);
+}
+
+static void entry_free(gpointer data) {
+    SnapshotEntry *entry = data;
+
+    /* Request còn chờ (shutdown): trả lỗi để libsoup đóng gọn */
+    for (guint i = 0; i < entry->waiters->len; i++) {
+        SoupServerMessage *msg = g_ptr_array_index(entry->waiters, i);
+        http_control_respond(msg, SOUP_STATUS_SERVICE_UNAVAILABLE, NULL, "shutting down\n");
+        soup_server_message_unpause(msg);
+    }
+    g_ptr_array_unref(entry->waiters);
+    if (entry->jpeg) g_bytes_unref(entry->jpeg);
+    g_free(entry->key);
+    g_free(entry);
+}
+
+static void job_free(SnapshotJob *job) {
+    g_free(job->key);
+    if (job->keyframe) gst_buffer_unref(job->keyframe);
+    if (job->caps) gst_caps_unref(job->caps);
+    if (job->jpeg) g_bytes_unref(job->jpeg);
+    g_free(job->error);
+    g_free(job);
+}
+
+/* ===== Keyframe từ recording ===== */
+
+/* Streaming thread của recording: chỉ keyframe và caps mới lấy lock, delta frame đi thẳng */
+static GstPadProbeReturn keyframe_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    const gchar *stream_key = user_data;
+
+    if (info->type & GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM) {
+        GstEvent *event = GST_PAD_PROBE_INFO_EVENT(info);
+        if (GST_EVENT_TYPE(event) != GST_EVENT_CAPS) return GST_PAD_PROBE_OK;
+
+        GstCaps *caps = NULL;
+        gst_event_parse_caps(event, &caps);
+        g_mutex_lock(&keyframe_lock);
+        SnapshotKeyframe *keyframe = keyframes ? g_hash_table_lookup(keyframes, stream_key) : NULL;
+        if (keyframe) gst_caps_replace(&keyframe->stream_caps, caps);
+        g_mutex_unlock(&keyframe_lock);
+        return GST_PAD_PROBE_OK;
+    }
+
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    if (GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DELTA_UNIT)) return GST_PAD_PROBE_OK;
+
+    g_mutex_lock(&keyframe_lock);
+    SnapshotKeyframe *keyframe = keyframes ? g_hash_table_lookup(keyframes, stream_key) : NULL;
+    if (keyframe && keyframe->stream_caps) {
+        gst_buffer_replace(&keyframe->buffer, buffer);
+        gst_caps_replace(&keyframe->caps, keyframe->stream_caps);
+        keyframe->captured_us = g_get_monotonic_time();
+    }
+    g_mutex_unlock(&keyframe_lock);
+    return GST_PAD_PROBE_OK;
+}
+
+/* Keyframe mới nhất của camera (ưu tiên sub: giải mã rẻ hơn, đủ cho ảnh dashboard) */
+static gboolean keyframe_latest(const gchar *camera_name, SnapshotJob *job) {
+    gboolean found = FALSE;
+
+    g_mutex_lock(&keyframe_lock);
+    for (gint i = 0; i < 2 && !found && keyframes; i++) {
+        gchar *stream_key = g_strdup_printf("%s/%s", camera_name, i == 0 ? "sub" : "main");
+        SnapshotKeyframe *keyframe = g_hash_table_lookup(keyframes, stream_key);
+        g_free(stream_key);
+        if (keyframe && keyframe->buffer) {
+            job->keyframe = gst_buffer_ref(keyframe->buffer);
+            job->caps = gst_caps_ref(keyframe->caps);
+            job->captured_us = keyframe->captured_us;
+            found = TRUE;
+        }
+    }
+    g_mutex_unlock(&keyframe_lock);
+    return found;
+}
+
+/* ===== Giải mã (thread pool) ===== */
+
+static GstPadProbeReturn sink_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    SnapshotJob *job = user_data;
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+
+    if (!job->jpeg) {
+        GstMapInfo map;
+        if (gst_buffer_map(buffer, &map, GST_MAP_READ)) {
+            job->jpeg = g_bytes_new(map.data, map.size);
+            gst_buffer_unmap(buffer, &map);
+        }
+    }
+    return GST_PAD_PROBE_OK;
+}
+
+static void attach_probe(GstElement *pipeline, const gchar *name, const gchar *pad_name,
+                         GstPadProbeCallback callback, SnapshotJob *job) {
+    GstElement *element = gst_bin_get_by_name(GST_BIN(pipeline), name);
+    GstPad *pad = gst_element_get_static_pad(element, pad_name);
+    gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, callback, job, NULL);
+    gst_object_unref(pad);
+    gst_object_unref(element);
+}
+
+static void decode_snapshot(SnapshotJob *job) {
+    gchar *scale_caps = job->width > 0 && job->height > 0
+        ? g_strdup_printf("video/x-raw,width=%d,height=%d", job->width, job->height)
+        : job->width > 0 ? g_strdup_printf("video/x-raw,width=%d", job->width)
+        : job->height > 0 ? g_strdup_printf("video/x-raw,height=%d", job->height)
+        : g_strdup("video/x-raw");
+
+    /* Một keyframe rồi EOS: decoder xả đúng frame đó; jpegenc snapshot=true gửi EOS sau frame đầu */
+    gchar *launch = g_strdup_printf(
+        "appsrc name=src format=time ! decodebin ! videoconvert ! videoscale ! %s ! "
+        "jpegenc quality=%d snapshot=true ! fakesink name=sink sync=false",
+        scale_caps, SNAPSHOT_JPEG_QUALITY);
+    g_free(scale_caps);
+
+    GError *error = NULL;
+    GstElement *pipeline = gst_parse_launch(launch, &error);
+    g_free(launch);
+    if (error) {
+        job->error = g_strdup(error->message);
+        g_error_free(error);
+        if (pipeline) gst_object_unref(pipeline);
+        return;
+    }
+
+    attach_probe(pipeline, "sink", "sink", sink_probe, job);
+
+    /* Chỉ copy metadata, memory dùng chung với buffer của recording */
+    GstElement *src = gst_bin_get_by_name(GST_BIN(pipeline), "src");
+    GstBuffer *buffer = gst_buffer_copy(job->keyframe);
+    GST_BUFFER_PTS(buffer) = 0;
+    GST_BUFFER_DTS(buffer) = 0;
+    GST_BUFFER_DURATION(buffer) = GST_CLOCK_TIME_NONE;
+    GST_BUFFER_FLAG_SET(buffer, GST_BUFFER_FLAG_DISCONT);
+    gst_app_src_set_caps(GST_APP_SRC(src), job->caps);
+    gst_app_src_push_buffer(GST_APP_SRC(src), buffer);
+    gst_app_src_end_of_stream(GST_APP_SRC(src));
+    gst_object_unref(src);
+
+    gst_element_set_state(pipeline, GST_STATE_PLAYING);
+    GstBus *bus = gst_element_get_bus(pipeline);
+    GstMessage *msg = gst_bus_timed_pop_filtered(bus, SNAPSHOT_TIMEOUT_MS * GST_MSECOND,
+                                                 GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+    if (!msg) {
+        job->error = g_strdup("timeout decoding the keyframe");
+    } else if (GST_MESSAGE_TYPE(msg) == GST_MESSAGE_ERROR) {
+        GError *err = NULL;
+        gst_message_parse_error(msg, &err, NULL);
+        job->error = g_strdup(err->message);
+        g_error_free(err);
+    }
+    if (msg) gst_message_unref(msg);
+    gst_object_unref(bus);
+
+    gst_element_set_state(pipeline, GST_STATE_NULL);
+    gst_object_unref(pipeline);
+
+    if (!job->jpeg && !job->error) job->error = g_strdup("no frame decoded");
+}
+
+static void respond_jpeg(SoupServerMessage *msg, GBytes *jpeg, gint64 age_ms) {
+    SoupMessageHeaders *headers = soup_server_message_get_response_headers(msg);
+    gchar *cache_control = g_strdup_printf("max-age=%d", SNAPSHOT_TTL_MS / 1000);
+    gchar *age = g_strdup_printf("%ld", (long)age_ms);
+    gsize size;
+    const gchar *data = g_bytes_get_data(jpeg, &size);
+
+    soup_message_headers_replace(headers, "Cache-Control", cache_control);
+    soup_message_headers_replace(headers, "X-Snapshot-Age-Ms", age);
+    soup_server_message_set_status(msg, SOUP_STATUS_OK, NULL);
+    soup_server_message_set_response(msg, "image/jpeg", SOUP_MEMORY_COPY, data, size);
+    g_free(cache_control);
+    g_free(age);
+}
+
+/* Main context: cập nhật cache và trả lời mọi request đang chờ */
+static gboolean decode_done_idle(gpointer data) {
+    SnapshotJob *job = data;
+    SnapshotEntry *entry = entries ? g_hash_table_lookup(entries, job->key) : NULL;
+
+    if (!entry) {
+        job_free(job);
+        return G_SOURCE_REMOVE;
+    }
+
+    gint64 now = g_get_monotonic_time();
+    entry->in_flight = FALSE;
+    if (job->jpeg) {
+        if (entry->jpeg) g_bytes_unref(entry->jpeg);
+        entry->jpeg = g_bytes_ref(job->jpeg);
+        entry->taken_us = job->captured_us;
+        entry->decoded_us = now;
+    } else {
+        g_printerr("[snapshot] %s: %s\n", job->key, job->error);
+    }
+
+    for (guint i = 0; i < entry->waiters->len; i++) {
+        SoupServerMessage *msg = g_ptr_array_index(entry->waiters, i);
+        if (entry->jpeg) {
+            /* Giải mã lỗi nhưng còn ảnh cũ: trả ảnh cũ kèm tuổi */
+            respond_jpeg(msg, entry->jpeg, (now - entry->taken_us) / 1000);
+        } else {
+            http_control_respond(msg, SOUP_STATUS_GATEWAY_TIMEOUT, NULL, job->error);
+        }
+        soup_server_message_unpause(msg);
+    }
+    g_ptr_array_set_size(entry->waiters, 0);
+
+    job_free(job);
+    return G_SOURCE_REMOVE;
+}
+
+static void decode_job_func(gpointer data, gpointer user_data) {
+    SnapshotJob *job = data;
+    gint64 start = g_get_monotonic_time();
+
+    decode_snapshot(job);
+    if (job->jpeg) {
+        g_print("[snapshot] %s: %zu bytes in %ld ms\n", job->key, g_bytes_get_size(job->jpeg),
+                (long)((g_get_monotonic_time() - start) / 1000));
+    }
+    g_main_context_invoke(NULL, decode_done_idle, job);
+}
+
+/* ===== HTTP ===== */
+
+static gint parse_dimension(GHashTable *query, const gchar *name) {
+    const gchar *value = query ? g_hash_table_lookup(query, name) : NULL;
+    if (!value) return 0;
+
+    gint v = atoi(value);
+    if (v <= 0) return 0;
+    /* Chẵn: encoder/scaler 4:2:0 */
+    return CLAMP(v, 16, SNAPSHOT_MAX_DIMENSION) & ~1;
+}
+
+static gboolean evict_stale(gpointer key, gpointer value, gpointer user_data) {
+    SnapshotEntry *entry = value;
+    gint64 now = *(gint64 *)user_data;
+    return !entry->in_flight && now - entry->last_request_us > SNAPSHOT_EVICT_SEC * G_USEC_PER_SEC;
+}
+
+static void snapshot_http_handler(SoupServer *server, SoupServerMessage *msg, const char *path,
+                                  GHashTable *query, gpointer user_data) {
+    if (soup_server_message_get_method(msg) != SOUP_METHOD_GET) {
+        http_control_respond(msg, SOUP_STATUS_METHOD_NOT_ALLOWED, NULL, "GET only\n");
+        return;
+    }
+
+    gchar *camera_name = http_control_path_tail(path, SNAPSHOT_PATH);
+    CameraConfig *cam = camera_name ? find_camera(camera_name) : NULL;
+    if (!cam) {
+        http_control_respond(msg, SOUP_STATUS_NOT_FOUND, NULL, "unknown camera\n");
+        g_free(camera_name);
+        return;
+    }
+    g_free(camera_name);
+
+    gint width = parse_dimension(query, "width");
+    gint height = parse_dimension(query, "height");
+    gint64 now = g_get_monotonic_time();
+    g_hash_table_foreach_remove(entries, evict_stale, &now);
+
+    SnapshotJob *job = g_new0(SnapshotJob, 1);
+    if (!keyframe_latest(cam->name, job)) {
+        /* Không mở kết nối riêng tới camera: ảnh chỉ có khi camera đang được ghi */
+        http_control_respond(msg, SOUP_STATUS_SERVICE_UNAVAILABLE, NULL, "camera is not recording\n");
+        job_free(job);
+        return;
+    }
+
+    gchar *key = g_strdup_printf("%s/%dx%d", cam->name, width, height);
+    SnapshotEntry *entry = g_hash_table_lookup(entries, key);
+    if (!entry) {
+        entry = g_new0(SnapshotEntry, 1);
+        entry->key = g_strdup(key);
+        entry->waiters = g_ptr_array_new_with_free_func(g_object_unref);
+        g_hash_table_insert(entries, entry->key, entry);
+    }
+    entry->last_request_us = now;
+    g_free(key);
+
+    /* Ảnh cache đã từ keyframe mới nhất, hoặc mới giải mã trong TTL: không giải mã lại */
+    if (entry->jpeg && (entry->taken_us >= job->captured_us ||
+                        now - entry->decoded_us < SNAPSHOT_TTL_MS * 1000)) {
+        respond_jpeg(msg, entry->jpeg, (now - entry->taken_us) / 1000);
+        job_free(job);
+        return;
+    }
+
+    /* Chờ lần giải mã đang chạy, hoặc bắt đầu một lần mới; mọi request chung một kết quả */
+    soup_server_message_pause(msg);
+    g_ptr_array_add(entry->waiters, g_object_ref(msg));
+    if (entry->in_flight) {
+        job_free(job);
+        return;
+    }
+
+    job->key = g_strdup(entry->key);
+    job->width = width;
+    job->height = height;
+
+    entry->in_flight = TRUE;
+    g_thread_pool_push(decode_pool, job, NULL);
+}
+
+void snapshot_attach(GstElement *parser, const gchar *camera_name, StreamType stream_type) {
+    gchar *stream_key = g_strdup_printf("%s/%s", camera_name, stream_type == STREAM_MAIN ? "main" : "sub");
+
+    /* Entry giữ qua các lần rotation: keyframe cũ còn dùng được tới khi pipeline mới có keyframe */
+    g_mutex_lock(&keyframe_lock);
+    if (!keyframes) keyframes = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, keyframe_free);
+    if (!g_hash_table_contains(keyframes, stream_key)) {
+        g_hash_table_insert(keyframes, g_strdup(stream_key), g_new0(SnapshotKeyframe, 1));
+    }
+    g_mutex_unlock(&keyframe_lock);
+
+    GstPad *pad = gst_element_get_static_pad(parser, "src");
+    gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+                      keyframe_probe, stream_key, g_free);
+    gst_object_unref(pad);
+}
+
+void snapshot_init(void) {
+    if (!entries) {
+        entries = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, entry_free);
+    }
+    if (!decode_pool) {
+        decode_pool = g_thread_pool_new(decode_job_func, NULL, SNAPSHOT_MAX_CONCURRENT, FALSE, NULL);
+    }
+    http_control_add_handler(SNAPSHOT_PATH, snapshot_http_handler, NULL);
+}
+
+void snapshot_shutdown(void) {
+    if (decode_pool) {
+        /* Job đang chạy tự kết thúc trong SNAPSHOT_TIMEOUT_MS; job chưa chạy bị bỏ */
+        g_thread_pool_free(decode_pool, TRUE, TRUE);
+        decode_pool = NULL;
+    }
+    if (entries) {
+        g_hash_table_destroy(entries);
+        entries = NULL;
+    }
+    /* Recording có thể còn chạy: probe thấy bảng NULL thì bỏ qua */
+    g_mutex_lock(&keyframe_lock);
+    g_clear_pointer(&keyframes, g_hash_table_destroy);
+    g_mutex_unlock(&keyframe_lock);
+}
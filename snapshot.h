@@ -0,0 +1,31 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <gst/gst.h>
+#include "recording_manager.h"
+
+/* GET /snapshot/<camera>[?width=W&height=H] -> image/jpeg
+ * Giải mã keyframe gần nhất mà recording pipeline của camera đã nhận (ưu tiên sub),
+ * scale và encode JPEG; không mở kết nối RTSP riêng tới camera, camera không được ghi
+ * thì trả 503. Kết quả cache theo camera + kích thước: chỉ giải mã lại khi có keyframe mới
+ * và ảnh cũ đã quá SNAPSHOT_TTL_MS; các request tới trong lúc đang giải mã chờ chung
+ * một lần giải mã. X-Snapshot-Age-Ms là tuổi của keyframe. */
+#define SNAPSHOT_PATH            "/snapshot"
+#define SNAPSHOT_TTL_MS          2000
+#define SNAPSHOT_TIMEOUT_MS      3000   /* giải mã một keyframe */
+#define SNAPSHOT_MAX_CONCURRENT  4      /* số camera giải mã cùng lúc */
+#define SNAPSHOT_EVICT_SEC       120    /* bỏ ảnh cache không ai hỏi */
+#define SNAPSHOT_MAX_DIMENSION   3840
+#define SNAPSHOT_JPEG_QUALITY    85
+
+/* Recording: giữ keyframe gần nhất ra từ parser của camera/stream.
+ * Gọi mỗi lần dựng lại pipeline (rotation) */
+void snapshot_attach(GstElement *parser, const gchar *camera_name, StreamType stream_type);
+
+/* Đăng ký route trên http_control */
+void snapshot_init(void);
+
+/* Chờ các lần giải mã đang chạy và xóa cache */
+void snapshot_shutdown(void);
+
+#endif // SNAPSHOT_H
@@ -0,0 +1,369 @@
+#include "storage_tiers.h"
+#include "segment_index.h"
+#include "recording_manager.h"
+#include <glib/gstdio.h>
+#include <sys/statvfs.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+
+/* I/O priority idle cho thread migrator (không tranh với recording) */
+#define IOPRIO_CLASS_IDLE   3
+#define IOPRIO_CLASS_SHIFT  13
+#define IOPRIO_WHO_PROCESS  1
+
+#define MIGRATE_CHUNK_SIZE  (1024 * 1024)
+/* Kiểm tra lại dung lượng sau mỗi N segment khi tier đầy */
+#define MIGRATE_CAPACITY_RECHECK 16
+
+static StorageTier tiers[MAX_STORAGE_TIERS];
+static gint tier_count = 0;
+
+static GThread *migrator_thread = NULL;
+static GMutex migrator_lock;
+static GCond migrator_cond;
+static gboolean migrator_running = FALSE;
+static guint64 migrate_rate = STORAGE_MIGRATE_RATE_BYTES;
+
+typedef struct {
+    gchar *camera_name;
+    StreamType stream_type;
+} StreamRef;
+
+/* Đọc lần lượt segment trên một tier của một stream, cũ nhất trước (chỉ giữ một ngày) */
+typedef struct {
+    StreamRef *ref;
+    GArray *days;               /* NULL khi đã hết */
+    guint day;
+    GPtrArray *records;         /* segment của ngày đang đọc */
+    guint next;
+} TierCursor;
+
+gboolean storage_tiers_add(const gchar *name,
+                           const gchar *root,
+                           guint max_fill_percent,
+                           gint64 max_age_sec) {
+    if (tier_count >= MAX_STORAGE_TIERS) {
+        g_printerr("Maximum storage tiers reached!\n");
+        return FALSE;
+    }
+
+    StorageTier *tier = &tiers[tier_count++];
+    tier->name = g_strdup(name);
+    tier->root = g_strdup(root);
+    tier->max_fill_percent = max_fill_percent;
+    tier->max_age_sec = max_age_sec;
+    g_mkdir_with_parents(tier->root, 0755);
+
+    g_print("Storage tier %d: %s -> %s (fill<=%u%%, age<=%lds)\n",
+            tier_count - 1, name, root, max_fill_percent, (long)max_age_sec);
+    return TRUE;
+}
+
+gint storage_tiers_count(void) {
+    return tier_count;
+}
+
+const StorageTier* storage_tiers_get(gint index) {
+    if (index < 0 || index >= tier_count) return NULL;
+    return &tiers[index];
+}
+
+const gchar* storage_tiers_primary_root(void) {
+    return tier_count > 0 ? tiers[0].root : RECORD_BASE_PATH;
+}
+
+gint storage_tier_for_path(const gchar *path) {
+    gint best = -1;
+    gsize best_len = 0;
+
+    if (!path) return -1;
+
+    for (gint i = 0; i < tier_count; i++) {
+        gsize len = strlen(tiers[i].root);
+        if (len > best_len && strncmp(path, tiers[i].root, len) == 0 &&
+            (path[len] == '/' || path[len] == '\0')) {
+            best = i;
+            best_len = len;
+        }
+    }
+    return best;
+}
+
+gint storage_tier_fill_percent(gint index) {
+    struct statvfs st;
+
+    if (index < 0 || index >= tier_count) return -1;
+    if (statvfs(tiers[index].root, &st) != 0 || st.f_blocks == 0) return -1;
+
+    return (gint)(100 - (st.f_bavail * 100) / st.f_blocks);
+}
+
+static gboolean migrator_should_run(void) {
+    g_mutex_lock(&migrator_lock);
+    gboolean running = migrator_running;
+    g_mutex_unlock(&migrator_lock);
+    return running;
+}
+
+/* Copy có giới hạn tốc độ, không để lại dữ liệu trong page cache */
+static gboolean copy_file_throttled(const gchar *src, const gchar *dst) {
+    int in = g_open(src, O_RDONLY | O_CLOEXEC, 0);
+    if (in < 0) return FALSE;
+
+    int out = g_open(dst, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (out < 0) {
+        close(in);
+        return FALSE;
+    }
+
+    posix_fadvise(in, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    gchar *buf = g_malloc(MIGRATE_CHUNK_SIZE);
+    gint64 start = g_get_monotonic_time();
+    guint64 total = 0;
+    gboolean ok = TRUE;
+
+    while (ok) {
+        gssize n = read(in, buf, MIGRATE_CHUNK_SIZE);
+        if (n == 0) break;
+        if (n < 0) {
+            ok = FALSE;
+            break;
+        }
+
+        for (gssize done = 0; done < n; ) {
+            gssize w = write(out, buf + done, n - done);
+            if (w <= 0) {
+                ok = FALSE;
+                break;
+            }
+            done += w;
+        }
+
+        posix_fadvise(in, total, n, POSIX_FADV_DONTNEED);
+        total += n;
+
+        if (!migrator_should_run()) {
+            ok = FALSE;
+            break;
+        }
+
+        /* Token bucket đơn giản: ngủ cho tới khi tốc độ trung bình <= rate */
+        if (migrate_rate > 0) {
+            gint64 expected_us = (gint64)(total * G_USEC_PER_SEC / migrate_rate);
+            gint64 elapsed_us = g_get_monotonic_time() - start;
+            if (expected_us > elapsed_us) {
+                g_usleep(expected_us - elapsed_us);
+            }
+        }
+    }
+
+    if (ok && fdatasync(out) != 0) ok = FALSE;
+    posix_fadvise(out, 0, 0, POSIX_FADV_DONTNEED);
+
+    g_free(buf);
+    close(in);
+    close(out);
+    return ok;
+}
+
+/* Chuyển một segment: copy -> rename -> cập nhật index -> xóa bản cũ.
+ * Người đọc luôn thấy một path hợp lệ: path cũ tồn tại cho tới khi index trỏ sang path mới. */
+static gboolean migrate_segment(const gchar *camera_name, StreamType stream_type,
+                                const SegmentRecord *record, gint from, gint to) {
+    const gchar *rel = record->path + strlen(tiers[from].root);
+    gchar *dst = g_strconcat(tiers[to].root, rel, NULL);
+    gchar *tmp = g_strconcat(dst, ".migrating", NULL);
+    gchar *dir = g_path_get_dirname(dst);
+    gboolean ok = FALSE;
+
+    g_mkdir_with_parents(dir, 0755);
+
+    if (!copy_file_throttled(record->path, tmp)) {
+        g_printerr("[migrator] Copy failed: %s -> %s\n", record->path, tmp);
+        g_unlink(tmp);
+        goto out;
+    }
+
+    if (g_rename(tmp, dst) != 0) {
+        g_printerr("[migrator] Rename failed: %s\n", dst);
+        g_unlink(tmp);
+        goto out;
+    }
+
+    if (!segment_index_relocate(camera_name, stream_type, record->start_us, record->path, dst)) {
+        g_unlink(dst);
+        goto out;
+    }
+
+    g_unlink(record->path);
+    ok = TRUE;
+
+out:
+    g_free(dir);
+    g_free(tmp);
+    g_free(dst);
+    return ok;
+}
+
+static void collect_stream(const gchar *camera_name, StreamType stream_type, gpointer user_data) {
+    GPtrArray *streams = user_data;
+    StreamRef *ref = g_new0(StreamRef, 1);
+    ref->camera_name = g_strdup(camera_name);
+    ref->stream_type = stream_type;
+    g_ptr_array_add(streams, ref);
+}
+
+static void stream_ref_free(gpointer data) {
+    StreamRef *ref = data;
+    g_free(ref->camera_name);
+    g_free(ref);
+}
+
+static void cursor_close(TierCursor *cursor) {
+    g_clear_pointer(&cursor->records, g_ptr_array_unref);
+    g_clear_pointer(&cursor->days, g_array_unref);
+}
+
+/* Segment kế tiếp của stream còn nằm trên tier `from`, NULL khi hết */
+static SegmentRecord* cursor_peek(TierCursor *cursor, gint from) {
+    while (cursor->days) {
+        if (cursor->records) {
+            while (cursor->next < cursor->records->len) {
+                SegmentRecord *record = g_ptr_array_index(cursor->records, cursor->next);
+                if (storage_tier_for_path(record->path) == from) return record;
+                cursor->next++;
+            }
+            g_clear_pointer(&cursor->records, g_ptr_array_unref);
+        }
+        if (cursor->day >= cursor->days->len) {
+            cursor_close(cursor);
+            break;
+        }
+        gint64 day = g_array_index(cursor->days, gint64, cursor->day++);
+        cursor->records = segment_index_get_day(cursor->ref->camera_name, cursor->ref->stream_type, day);
+        cursor->next = 0;
+    }
+    return NULL;
+}
+
+/* Chuyển segment từ tier `from` sang `from + 1`, cũ nhất trước trên mọi stream: khi tier đầy,
+ * recording cũ nhất của cả tier đi trước, không phải toàn bộ stream đầu tiên */
+static guint migrate_tier(gint from) {
+    const StorageTier *tier = &tiers[from];
+    gint64 now_us = g_get_real_time();
+    gint64 cutoff_us = tier->max_age_sec > 0 ? now_us - tier->max_age_sec * G_USEC_PER_SEC : G_MININT64;
+    gint fill = storage_tier_fill_percent(from);
+    gboolean over_capacity = fill >= 0 && (guint)fill > tier->max_fill_percent;
+    guint migrated = 0;
+
+    if (tier->max_age_sec <= 0 && !over_capacity) return 0;
+
+    GPtrArray *streams = g_ptr_array_new_with_free_func(stream_ref_free);
+    segment_index_foreach_stream(collect_stream, streams);
+
+    TierCursor *cursors = g_new0(TierCursor, MAX(streams->len, 1));
+    for (guint s = 0; s < streams->len; s++) {
+        cursors[s].ref = g_ptr_array_index(streams, s);
+        cursors[s].days = segment_index_list_days(cursors[s].ref->camera_name, cursors[s].ref->stream_type);
+    }
+
+    /* Gộp các stream theo start_us: mỗi lượt lấy segment cũ nhất còn trên tier */
+    while (migrator_should_run()) {
+        TierCursor *oldest = NULL;
+        SegmentRecord *record = NULL;
+        for (guint s = 0; s < streams->len; s++) {
+            SegmentRecord *candidate = cursor_peek(&cursors[s], from);
+            if (candidate && (!record || candidate->start_us < record->start_us)) {
+                oldest = &cursors[s];
+                record = candidate;
+            }
+        }
+        if (!record) break;
+        oldest->next++;
+
+        /* Chỉ còn theo tuổi: stream này đã tới segment chưa đủ tuổi */
+        if (!over_capacity && record->end_us > cutoff_us) {
+            cursor_close(oldest);
+            continue;
+        }
+
+        if (migrate_segment(oldest->ref->camera_name, oldest->ref->stream_type, record, from, from + 1)) {
+            migrated++;
+            if (over_capacity && migrated % MIGRATE_CAPACITY_RECHECK == 0) {
+                fill = storage_tier_fill_percent(from);
+                over_capacity = fill >= 0 && (guint)fill > tier->max_fill_percent;
+            }
+        }
+    }
+
+    for (guint s = 0; s < streams->len; s++) {
+        cursor_close(&cursors[s]);
+    }
+    g_free(cursors);
+    g_ptr_array_unref(streams);
+
+    if (migrated > 0) {
+        g_print("[migrator] Moved %u segment(s) %s -> %s\n",
+                migrated, tier->name, tiers[from + 1].name);
+    }
+    return migrated;
+}
+
+void storage_io_priority_idle(void) {
+    if (syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0,
+                IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT) != 0) {
+        g_printerr("Failed to set idle I/O priority\n");
+    }
+}
+
+static gpointer migrator_thread_func(gpointer data) {
+    /* ioprio idle: migrator chỉ dùng disk khi recording không cần */
+    storage_io_priority_idle();
+
+    while (migrator_should_run()) {
+        for (gint t = 0; t < tier_count - 1 && migrator_should_run(); t++) {
+            migrate_tier(t);
+        }
+
+        g_mutex_lock(&migrator_lock);
+        if (migrator_running) {
+            gint64 deadline = g_get_monotonic_time() + STORAGE_MIGRATE_INTERVAL_SEC * G_USEC_PER_SEC;
+            g_cond_wait_until(&migrator_cond, &migrator_lock, deadline);
+        }
+        g_mutex_unlock(&migrator_lock);
+    }
+
+    return NULL;
+}
+
+void storage_migrator_start(guint64 max_bytes_per_sec) {
+    if (tier_count < 2) return;
+
+    g_mutex_lock(&migrator_lock);
+    if (migrator_running) {
+        g_mutex_unlock(&migrator_lock);
+        return;
+    }
+    migrator_running = TRUE;
+    migrate_rate = max_bytes_per_sec;
+    g_mutex_unlock(&migrator_lock);
+
+    migrator_thread = g_thread_new("storage-migrator", migrator_thread_func, NULL);
+    g_print("Storage migrator started (%lu MB/s)\n",
+            (unsigned long)(max_bytes_per_sec / (1024 * 1024)));
+}
+
+void storage_migrator_stop(void) {
+    g_mutex_lock(&migrator_lock);
+    migrator_running = FALSE;
+    g_cond_signal(&migrator_cond);
+    g_mutex_unlock(&migrator_lock);
+
+    if (migrator_thread) {
+        g_thread_join(migrator_thread);
+        migrator_thread = NULL;
+    }
+}
@@ -0,0 +1,43 @@
+#ifndef STORAGE_TIERS_H
+#define STORAGE_TIERS_H
+
+#include <glib.h>
+
+#define MAX_STORAGE_TIERS 4
+#define STORAGE_MIGRATE_RATE_BYTES   (50ULL * 1024 * 1024)   /* 50 MB/s */
+#define STORAGE_MIGRATE_INTERVAL_SEC 60
+
+/* Một tầng lưu trữ, tier 0 là nơi ghi segment mới (NVMe) */
+typedef struct {
+    gchar *name;
+    gchar *root;
+    guint max_fill_percent;   /* vượt ngưỡng: chuyển segment cũ nhất xuống tier sau */
+    gint64 max_age_sec;       /* segment cũ hơn sẽ chuyển xuống tier sau, 0 = giữ lại */
+} StorageTier;
+
+/* Thêm tier theo thứ tự từ nhanh tới chậm */
+gboolean storage_tiers_add(const gchar *name,
+                           const gchar *root,
+                           guint max_fill_percent,
+                           gint64 max_age_sec);
+
+gint storage_tiers_count(void);
+const StorageTier* storage_tiers_get(gint index);
+
+/* Root để ghi segment mới (tier 0, mặc định RECORD_BASE_PATH) */
+const gchar* storage_tiers_primary_root(void);
+
+/* Tier chứa path (hoặc chính root của tier), -1 nếu không thuộc tier nào */
+gint storage_tier_for_path(const gchar *path);
+
+/* Phần trăm dung lượng đã dùng của tier, -1 nếu lỗi */
+gint storage_tier_fill_percent(gint index);
+
+/* Đặt I/O priority idle cho thread hiện tại (job nền không tranh disk với recording) */
+void storage_io_priority_idle(void);
+
+/* Migrator chạy nền, giới hạn tốc độ I/O */
+void storage_migrator_start(guint64 max_bytes_per_sec);
+void storage_migrator_stop(void);
+
+#endif // STORAGE_TIERS_H
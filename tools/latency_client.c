@@ -0,0 +1,160 @@
+/* Client đo glass-to-glass latency cho mount live ở chế độ ?measure=latency.
+ *
+ * Build:  cd tools && qmake latency_client.pro && make
+ * Chạy:   ./latency_client rtsp://127.0.0.1:8555/cam1?measure=latency 30
+ *
+ * Đọc RTP header extension LATENCY_EXT_ID trên từng gói và in phân bố (ms) của:
+ *   end_to_end   capture/arrival -> client nhận
+ *   ingest       capture (NTP từ RTCP SR) -> ra khỏi jitterbuffer (chỉ khi có NTP)
+ *   depay_parse  depayloader + parser -> vào send queue
+ *   queueing     thời gian nằm trong send queue
+ *   payloading   payloader
+ *   send         rời payloader -> client nhận (socket + mạng)
+ * end_to_end/send so sánh đồng hồ của hai máy: chạy trên cùng máy hoặc máy đã sync NTP.
+ */
+#include <gst/gst.h>
+#include <gst/rtp/gstrtpbuffer.h>
+#include <stdlib.h>
+#include "../latency_measure.h"
+
+typedef enum {
+    HOP_END_TO_END = 0,
+    HOP_INGEST,
+    HOP_DEPAY_PARSE,
+    HOP_QUEUEING,
+    HOP_PAYLOADING,
+    HOP_SEND,
+    HOP_COUNT
+} Hop;
+
+static const gchar *hop_names[HOP_COUNT] = {
+    "end_to_end", "ingest", "depay_parse", "queueing", "payloading", "send"
+};
+
+static GArray *samples[HOP_COUNT];   /* gdouble, ms */
+static GMutex samples_lock;
+static guint packets = 0;
+static guint stamped = 0;
+
+static void add_sample(Hop hop, gint64 us) {
+    gdouble ms = us / 1000.0;
+    g_array_append_val(samples[hop], ms);
+}
+
+static GstPadProbeReturn rtp_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+    gint64 now = g_get_real_time();
+    gpointer data = NULL;
+    guint size = 0;
+    guint8 appbits = 0;
+    LatencyStamp stamp;
+
+    if (!gst_rtp_buffer_map(buffer, GST_MAP_READ, &rtp)) return GST_PAD_PROBE_OK;
+    gboolean found = gst_rtp_buffer_get_extension_twobytes_header(&rtp, &appbits, LATENCY_EXT_ID,
+                                                                  0, &data, &size);
+    gboolean ok = found && latency_stamp_read(data, size, &stamp);
+    gst_rtp_buffer_unmap(&rtp);
+
+    g_mutex_lock(&samples_lock);
+    packets++;
+    if (ok) {
+        stamped++;
+        gint64 sent_us = stamp.arrival_us + stamp.pay_out_us;
+        add_sample(HOP_END_TO_END, now - stamp.ingest_us);
+        if (stamp.source == LATENCY_SOURCE_NTP) {
+            add_sample(HOP_INGEST, stamp.arrival_us - stamp.ingest_us);
+        }
+        add_sample(HOP_DEPAY_PARSE, stamp.sendq_in_us);
+        add_sample(HOP_QUEUEING, (gint64)stamp.pay_in_us - stamp.sendq_in_us);
+        add_sample(HOP_PAYLOADING, (gint64)stamp.pay_out_us - stamp.pay_in_us);
+        add_sample(HOP_SEND, now - sent_us);
+    }
+    g_mutex_unlock(&samples_lock);
+
+    return GST_PAD_PROBE_OK;
+}
+
+/* Probe trên pad RTP của rtspsrc (latency=0 nên gần như không thêm trễ phía client) */
+static void on_pad_added(GstElement *src, GstPad *pad, gpointer user_data) {
+    GstElement *sink = GST_ELEMENT(user_data);
+    GstPad *sink_pad = gst_element_get_static_pad(sink, "sink");
+
+    if (!gst_pad_is_linked(sink_pad)) {
+        gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, rtp_probe, NULL, NULL);
+        gst_pad_link(pad, sink_pad);
+    }
+    gst_object_unref(sink_pad);
+}
+
+static gint compare_double(gconstpointer a, gconstpointer b) {
+    gdouble da = *(const gdouble *)a;
+    gdouble db = *(const gdouble *)b;
+    return da < db ? -1 : (da > db ? 1 : 0);
+}
+
+static gdouble percentile(GArray *values, gdouble p) {
+    guint idx = (guint)(p * (values->len - 1) + 0.5);
+    return g_array_index(values, gdouble, idx);
+}
+
+static void print_report(void) {
+    g_mutex_lock(&samples_lock);
+    g_print("packets=%u stamped=%u\n", packets, stamped);
+    g_print("%-12s %8s %8s %8s %8s %8s\n", "hop (ms)", "min", "p50", "p95", "p99", "max");
+    for (gint h = 0; h < HOP_COUNT; h++) {
+        GArray *values = samples[h];
+        if (values->len == 0) continue;
+        g_array_sort(values, compare_double);
+        g_print("%-12s %8.1f %8.1f %8.1f %8.1f %8.1f\n", hop_names[h],
+                g_array_index(values, gdouble, 0),
+                percentile(values, 0.50), percentile(values, 0.95), percentile(values, 0.99),
+                g_array_index(values, gdouble, values->len - 1));
+    }
+    g_mutex_unlock(&samples_lock);
+}
+
+static gboolean on_timeout(gpointer user_data) {
+    g_main_loop_quit(user_data);
+    return G_SOURCE_REMOVE;
+}
+
+int main(int argc, char *argv[]) {
+    gst_init(&argc, &argv);
+
+    if (argc < 2) {
+        g_printerr("Usage: %s <rtsp-url?measure=latency> [seconds]\n", argv[0]);
+        return 1;
+    }
+    guint seconds = argc > 2 ? (guint)atoi(argv[2]) : 30;
+
+    for (gint h = 0; h < HOP_COUNT; h++) {
+        samples[h] = g_array_new(FALSE, FALSE, sizeof(gdouble));
+    }
+
+    GstElement *pipeline = gst_pipeline_new("latency-client");
+    GstElement *src = gst_element_factory_make("rtspsrc", NULL);
+    GstElement *sink = gst_element_factory_make("fakesink", NULL);
+    if (!pipeline || !src || !sink) {
+        g_printerr("Failed to create elements\n");
+        return 1;
+    }
+
+    g_object_set(src, "location", argv[1], "latency", 0, "protocols", 0x00000004, NULL);
+    g_object_set(sink, "sync", FALSE, "async", FALSE, NULL);
+    gst_bin_add_many(GST_BIN(pipeline), src, sink, NULL);
+    g_signal_connect(src, "pad-added", G_CALLBACK(on_pad_added), sink);
+
+    GMainLoop *loop = g_main_loop_new(NULL, FALSE);
+    g_timeout_add_seconds(seconds, on_timeout, loop);
+
+    gst_element_set_state(pipeline, GST_STATE_PLAYING);
+    g_main_loop_run(loop);
+    gst_element_set_state(pipeline, GST_STATE_NULL);
+
+    print_report();
+
+    gst_object_unref(pipeline);
+    g_main_loop_unref(loop);
+    return 0;
+}
@@ -0,0 +1,17 @@
+TARGET = latency_client
+TEMPLATE = app
+CONFIG -= qt
+
+SOURCES += \
+    latency_client.c \
+    ../latency_measure.c
+
+HEADERS += \
+    ../latency_measure.h
+
+INCLUDEPATH += /usr/include/gstreamer-1.0 \
+               /usr/include/glib-2.0 \
+               /usr/lib/x86_64-linux-gnu/glib-2.0/include
+
+LIBS += -L/usr/lib/x86_64-linux-gnu \
+        -lgstrtp-1.0 -lgstreamer-1.0 -lgobject-2.0 -lglib-2.0
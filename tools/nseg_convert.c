@@ -0,0 +1,122 @@
+/* Chuyển đổi segment giữa Matroska và định dạng native (native_segment.h), dùng khi export.
+ *
+ * Build:  cd tools && qmake nseg_convert.pro && make
+ * Chạy:   ./nseg_convert 1718000000.nseg export.mkv
+ *         ./nseg_convert 1718000000.mkv 1718000000.nseg
+ *         ./nseg_convert --h265 cam_h265.mkv cam_h265.nseg
+ *
+ * Chiều chuyển theo phần mở rộng của file vào. Access unit và timestamp giữ nguyên,
+ * không transcode. Codec của file .nseg đọc từ header; MKV -> nseg cần --h265 cho H.265.
+ */
+#include <gst/gst.h>
+#include <stdio.h>
+#include "../native_segment.h"
+
+static gboolean opt_h265 = FALSE;
+
+static GOptionEntry entries[] = {
+    { "h265", 0, 0, G_OPTION_ARG_NONE, &opt_h265, "MKV input is H.265", NULL },
+    { NULL }
+};
+
+static gboolean run_pipeline(const gchar *launch) {
+    GError *error = NULL;
+    GstElement *pipeline = gst_parse_launch(launch, &error);
+
+    if (error) {
+        g_printerr("Pipeline error: %s\n", error->message);
+        g_error_free(error);
+        if (pipeline) gst_object_unref(pipeline);
+        return FALSE;
+    }
+
+    gst_element_set_state(pipeline, GST_STATE_PLAYING);
+    GstBus *bus = gst_element_get_bus(pipeline);
+    GstMessage *msg = gst_bus_timed_pop_filtered(bus, GST_CLOCK_TIME_NONE,
+                                                 GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+    gboolean ok = msg && GST_MESSAGE_TYPE(msg) == GST_MESSAGE_EOS;
+
+    if (msg && !ok) {
+        GError *err = NULL;
+        gst_message_parse_error(msg, &err, NULL);
+        g_printerr("Error: %s\n", err->message);
+        g_error_free(err);
+    }
+    if (msg) gst_message_unref(msg);
+    gst_object_unref(bus);
+
+    gst_element_set_state(pipeline, GST_STATE_NULL);
+    gst_object_unref(pipeline);
+    return ok;
+}
+
+static gboolean nseg_to_mkv(const gchar *in, const gchar *out) {
+    GError *error = NULL;
+    NativeSegment *segment = native_segment_open(in, &error);
+
+    if (!segment) {
+        g_printerr("%s\n", error->message);
+        g_error_free(error);
+        return FALSE;
+    }
+    const gchar *parser = native_segment_codec(segment) == NATIVE_CODEC_H265 ? "h265parse" : "h264parse";
+    g_print("%s: %u frames, %.1f s\n", in, native_segment_frame_count(segment),
+            native_segment_duration(segment) / 1e9);
+    native_segment_unref(segment);
+
+    gchar *launch = g_strdup_printf(
+        NATIVE_SEGMENT_SRC_NAME " location=\"%s\" ! %s ! "
+        "matroskamux writing-app=\"RTSP Recorder\" ! filesink location=\"%s\"",
+        in, parser, out);
+    gboolean ok = run_pipeline(launch);
+    g_free(launch);
+    return ok;
+}
+
+static gboolean mkv_to_nseg(const gchar *in, const gchar *out) {
+    gchar *launch = g_strdup_printf(
+        "filesrc location=\"%s\" ! matroskademux ! %s ! "
+        NATIVE_SEGMENT_SINK_NAME " location=\"%s\"",
+        in, opt_h265 ? "h265parse" : "h264parse", out);
+    gboolean ok = run_pipeline(launch);
+    g_free(launch);
+
+    if (ok) {
+        NativeSegment *segment = native_segment_open(out, NULL);
+        if (segment) {
+            g_print("%s: %u frames, %.1f s\n", out, native_segment_frame_count(segment),
+                    native_segment_duration(segment) / 1e9);
+            native_segment_unref(segment);
+        }
+    }
+    return ok;
+}
+
+int main(int argc, char *argv[]) {
+    GError *error = NULL;
+    GOptionContext *context = g_option_context_new("INPUT OUTPUT - convert between .mkv and " NATIVE_SEGMENT_EXT);
+    g_option_context_add_main_entries(context, entries, NULL);
+    g_option_context_add_group(context, gst_init_get_option_group());
+    if (!g_option_context_parse(context, &argc, &argv, &error)) {
+        g_printerr("%s\n", error->message);
+        return 2;
+    }
+    g_option_context_free(context);
+
+    if (argc != 3) {
+        g_printerr("Usage: %s [--h265] INPUT OUTPUT\n", argv[0]);
+        return 2;
+    }
+
+    gst_init(&argc, &argv);
+    native_segment_init();
+
+    gboolean ok = native_segment_is_native_path(argv[1]) ? nseg_to_mkv(argv[1], argv[2])
+                                                         : mkv_to_nseg(argv[1], argv[2]);
+    if (!ok) {
+        g_printerr("Conversion failed\n");
+        return 1;
+    }
+    g_print("Wrote %s\n", argv[2]);
+    return 0;
+}
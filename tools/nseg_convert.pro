@@ -0,0 +1,19 @@
+TARGET = nseg_convert
+TEMPLATE = app
+CONFIG -= qt
+
+SOURCES += \
+    nseg_convert.c \
+    ../io_policy.c \
+    ../native_segment.c
+
+HEADERS += \
+    ../io_policy.h \
+    ../native_segment.h
+
+INCLUDEPATH += /usr/include/gstreamer-1.0 \
+               /usr/include/glib-2.0 \
+               /usr/lib/x86_64-linux-gnu/glib-2.0/include
+
+LIBS += -L/usr/lib/x86_64-linux-gnu \
+        -lgstbase-1.0 -lgstreamer-1.0 -lgobject-2.0 -lglib-2.0 -lpthread
@@ -0,0 +1,247 @@
+/* Peer WebRTC headless để kiểm tra egress trên LAN.
+ *
+ * Build:  cd tools && qmake webrtc_peer.pro && make
+ * Chạy:   ./webrtc_peer ws://127.0.0.1:8088/webrtc/cam_1 300 20
+ *         (URL signaling, số frame cần nhận, timeout giây)
+ *
+ * Nhận offer, trả answer, giải payload H.264 vào fakesink và in:
+ *   first_frame_ms  từ lúc mở WebSocket tới frame đầu tiên
+ *   frames          số access unit nhận được
+ * Exit code 0 khi nhận đủ frame trước timeout.
+ */
+#define GST_USE_UNSTABLE_API
+#include <gst/gst.h>
+#include <gst/sdp/sdp.h>
+#include <gst/webrtc/webrtc.h>
+#include <libsoup/soup.h>
+#include <json-glib/json-glib.h>
+#include <stdlib.h>
+
+static GMainLoop *loop = NULL;
+static GstElement *pipeline = NULL;
+static GstElement *webrtc = NULL;
+static SoupWebsocketConnection *ws = NULL;
+static gint64 start_us = 0;
+static gint64 first_frame_us = 0;
+static guint frames = 0;
+static guint wanted_frames = 300;
+static gint exit_code = 1;
+
+static gboolean send_text_idle(gpointer data) {
+    if (ws && soup_websocket_connection_get_state(ws) == SOUP_WEBSOCKET_STATE_OPEN) {
+        soup_websocket_connection_send_text(ws, data);
+    }
+    g_free(data);
+    return G_SOURCE_REMOVE;
+}
+
+static void send_json(JsonBuilder *builder) {
+    JsonGenerator *generator = json_generator_new();
+    JsonNode *root = json_builder_get_root(builder);
+    json_generator_set_root(generator, root);
+    g_main_context_invoke(NULL, send_text_idle, json_generator_to_data(generator, NULL));
+    json_node_unref(root);
+    g_object_unref(generator);
+}
+
+static gboolean finish_idle(gpointer data) {
+    g_main_loop_quit(loop);
+    return G_SOURCE_REMOVE;
+}
+
+static GstPadProbeReturn frame_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    if (frames == 0) {
+        first_frame_us = g_get_monotonic_time();
+        g_print("first_frame_ms=%.1f\n", (first_frame_us - start_us) / 1000.0);
+    }
+    if (++frames == wanted_frames) {
+        exit_code = 0;
+        g_idle_add(finish_idle, NULL);
+    }
+    return GST_PAD_PROBE_OK;
+}
+
+static void on_pad_added(GstElement *element, GstPad *pad, gpointer user_data) {
+    if (GST_PAD_DIRECTION(pad) != GST_PAD_SRC) return;
+
+    GstElement *bin = gst_parse_bin_from_description(
+        "rtph264depay ! h264parse ! fakesink name=sink sync=false", TRUE, NULL);
+    gst_bin_add(GST_BIN(pipeline), bin);
+    gst_element_sync_state_with_parent(bin);
+
+    GstPad *sink = gst_element_get_static_pad(bin, "sink");
+    gst_pad_link(pad, sink);
+    gst_object_unref(sink);
+
+    GstElement *fakesink = gst_bin_get_by_name(GST_BIN(bin), "sink");
+    GstPad *fakesink_pad = gst_element_get_static_pad(fakesink, "sink");
+    gst_pad_add_probe(fakesink_pad, GST_PAD_PROBE_TYPE_BUFFER, frame_probe, NULL, NULL);
+    gst_object_unref(fakesink_pad);
+    gst_object_unref(fakesink);
+}
+
+static void on_ice_candidate(GstElement *element, guint mline, gchar *candidate, gpointer user_data) {
+    JsonBuilder *builder = json_builder_new();
+    json_builder_begin_object(builder);
+    json_builder_set_member_name(builder, "type");
+    json_builder_add_string_value(builder, "ice");
+    json_builder_set_member_name(builder, "candidate");
+    json_builder_add_string_value(builder, candidate);
+    json_builder_set_member_name(builder, "sdpMLineIndex");
+    json_builder_add_int_value(builder, mline);
+    json_builder_end_object(builder);
+    send_json(builder);
+    g_object_unref(builder);
+}
+
+static void on_answer_created(GstPromise *promise, gpointer user_data) {
+    GstWebRTCSessionDescription *answer = NULL;
+    const GstStructure *reply = gst_promise_get_reply(promise);
+
+    if (reply) {
+        gst_structure_get(reply, "answer", GST_TYPE_WEBRTC_SESSION_DESCRIPTION, &answer, NULL);
+    }
+    gst_promise_unref(promise);
+    if (!answer) {
+        g_printerr("Failed to create answer\n");
+        g_idle_add(finish_idle, NULL);
+        return;
+    }
+
+    g_signal_emit_by_name(webrtc, "set-local-description", answer, NULL);
+
+    gchar *sdp = gst_sdp_message_as_text(answer->sdp);
+    JsonBuilder *builder = json_builder_new();
+    json_builder_begin_object(builder);
+    json_builder_set_member_name(builder, "type");
+    json_builder_add_string_value(builder, "answer");
+    json_builder_set_member_name(builder, "sdp");
+    json_builder_add_string_value(builder, sdp);
+    json_builder_end_object(builder);
+    send_json(builder);
+    g_object_unref(builder);
+
+    g_free(sdp);
+    gst_webrtc_session_description_free(answer);
+}
+
+static void on_remote_set(GstPromise *promise, gpointer user_data) {
+    gst_promise_unref(promise);
+    GstPromise *answer = gst_promise_new_with_change_func(on_answer_created, NULL, NULL);
+    g_signal_emit_by_name(webrtc, "create-answer", NULL, answer);
+}
+
+static void on_message(SoupWebsocketConnection *conn, gint type, GBytes *message, gpointer user_data) {
+    if (type != SOUP_WEBSOCKET_DATA_TEXT) return;
+
+    gsize size;
+    const gchar *data = g_bytes_get_data(message, &size);
+    JsonParser *parser = json_parser_new();
+
+    if (!json_parser_load_from_data(parser, data, size, NULL) ||
+        !JSON_NODE_HOLDS_OBJECT(json_parser_get_root(parser))) {
+        g_object_unref(parser);
+        return;
+    }
+
+    JsonObject *object = json_node_get_object(json_parser_get_root(parser));
+    const gchar *msg_type = json_object_get_string_member_with_default(object, "type", "");
+
+    if (g_strcmp0(msg_type, "offer") == 0) {
+        GstSDPMessage *sdp = NULL;
+        const gchar *text = json_object_get_string_member_with_default(object, "sdp", "");
+        if (gst_sdp_message_new_from_text(text, &sdp) == GST_SDP_OK) {
+            GstWebRTCSessionDescription *offer =
+                gst_webrtc_session_description_new(GST_WEBRTC_SDP_TYPE_OFFER, sdp);
+            GstPromise *promise = gst_promise_new_with_change_func(on_remote_set, NULL, NULL);
+            g_signal_emit_by_name(webrtc, "set-remote-description", offer, promise);
+            gst_webrtc_session_description_free(offer);
+        }
+    } else if (g_strcmp0(msg_type, "ice") == 0) {
+        const gchar *candidate = json_object_get_string_member_with_default(object, "candidate", NULL);
+        gint64 mline = json_object_get_int_member_with_default(object, "sdpMLineIndex", 0);
+        if (candidate && candidate[0]) {
+            g_signal_emit_by_name(webrtc, "add-ice-candidate", (guint)mline, candidate);
+        }
+    }
+
+    g_object_unref(parser);
+}
+
+static void on_closed(SoupWebsocketConnection *conn, gpointer user_data) {
+    g_printerr("Signaling closed (code %u)\n", soup_websocket_connection_get_close_code(conn));
+    g_main_loop_quit(loop);
+}
+
+static void on_connected(GObject *session, GAsyncResult *res, gpointer user_data) {
+    GError *error = NULL;
+    ws = soup_session_websocket_connect_finish(SOUP_SESSION(session), res, &error);
+    if (!ws) {
+        g_printerr("WebSocket connect failed: %s\n", error->message);
+        g_error_free(error);
+        g_main_loop_quit(loop);
+        return;
+    }
+
+    g_signal_connect(ws, "message", G_CALLBACK(on_message), NULL);
+    g_signal_connect(ws, "closed", G_CALLBACK(on_closed), NULL);
+}
+
+static gboolean on_timeout(gpointer data) {
+    g_printerr("Timeout: %u/%u frames\n", frames, wanted_frames);
+    g_main_loop_quit(loop);
+    return G_SOURCE_REMOVE;
+}
+
+int main(int argc, char *argv[]) {
+    gst_init(&argc, &argv);
+
+    if (argc < 2) {
+        g_printerr("Usage: %s ws://host:8088/webrtc/<camera> [frames] [timeout_sec]\n", argv[0]);
+        return 2;
+    }
+    if (argc > 2) wanted_frames = MAX(1, atoi(argv[2]));
+    guint timeout_sec = argc > 3 ? (guint)MAX(1, atoi(argv[3])) : 20;
+
+    loop = g_main_loop_new(NULL, FALSE);
+    pipeline = gst_pipeline_new("peer");
+    webrtc = gst_element_factory_make("webrtcbin", "recv");
+    if (!webrtc) {
+        g_printerr("webrtcbin not available\n");
+        return 2;
+    }
+    gst_util_set_object_arg(G_OBJECT(webrtc), "bundle-policy", "max-bundle");
+    gst_bin_add(GST_BIN(pipeline), webrtc);
+
+    g_signal_connect(webrtc, "pad-added", G_CALLBACK(on_pad_added), NULL);
+    g_signal_connect(webrtc, "on-ice-candidate", G_CALLBACK(on_ice_candidate), NULL);
+    gst_element_set_state(pipeline, GST_STATE_PLAYING);
+
+    SoupSession *session = soup_session_new();
+    SoupMessage *msg = soup_message_new(SOUP_METHOD_GET, argv[1]);
+    if (!msg) {
+        g_printerr("Invalid URL: %s\n", argv[1]);
+        return 2;
+    }
+
+    start_us = g_get_monotonic_time();
+    soup_session_websocket_connect_async(session, msg, NULL, NULL, G_PRIORITY_DEFAULT,
+                                         NULL, on_connected, NULL);
+    g_timeout_add_seconds(timeout_sec, on_timeout, NULL);
+
+    g_main_loop_run(loop);
+
+    g_print("frames=%u\n", frames);
+
+    if (ws) {
+        g_signal_handlers_disconnect_by_data(ws, NULL);
+        soup_websocket_connection_close(ws, SOUP_WEBSOCKET_CLOSE_NORMAL, NULL);
+        g_object_unref(ws);
+    }
+    gst_element_set_state(pipeline, GST_STATE_NULL);
+    gst_object_unref(pipeline);
+    g_object_unref(msg);
+    g_object_unref(session);
+    g_main_loop_unref(loop);
+    return exit_code;
+}
@@ -0,0 +1,15 @@
+TARGET = webrtc_peer
+TEMPLATE = app
+CONFIG -= qt
+
+SOURCES += \
+    webrtc_peer.c
+
+INCLUDEPATH += /usr/include/gstreamer-1.0 \
+               /usr/include/glib-2.0 \
+               /usr/lib/x86_64-linux-gnu/glib-2.0/include \
+               /usr/include/libsoup-3.0 \
+               /usr/include/json-glib-1.0
+
+LIBS += -L/usr/lib/x86_64-linux-gnu \
+        -lgstwebrtc-1.0 -lgstsdp-1.0 -lgstreamer-1.0 -lsoup-3.0 -ljson-glib-1.0 -lgio-2.0 -lgobject-2.0 -lglib-2.0
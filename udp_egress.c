@@ -0,0 +1,615 @@
+#define _GNU_SOURCE   /* sendmmsg */
+#include "udp_egress.h"
+#include <gio/gio.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifndef SOL_UDP
+#define SOL_UDP 17
+#endif
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103   /* linux/udp.h, kernel >= 4.18 */
+#endif
+
+/* Số message tối đa mỗi lần sendmmsg (UIO_MAXIOV) */
+#define SENDMMSG_MAX_MSGS  1024
+#define SEND_WAIT_MS       100
+
+static const gchar *mode_names[] = { "sendto", "sendmmsg", "gso" };
+
+static gint egress_mode = UDP_EGRESS_SENDTO;
+
+UdpEgressMode udp_egress_init(UdpEgressMode requested) {
+    UdpEgressMode mode = UDP_EGRESS_SENDTO;
+
+    /* sendmmsg có từ 3.0: fd không hợp lệ trả EBADF, không có syscall trả ENOSYS */
+    if (requested >= UDP_EGRESS_SENDMMSG &&
+        (sendmmsg(-1, NULL, 0, 0) == 0 || errno != ENOSYS)) {
+        mode = UDP_EGRESS_SENDMMSG;
+    }
+
+    if (requested >= UDP_EGRESS_GSO && mode == UDP_EGRESS_SENDMMSG) {
+        int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        int segment = 1400;
+        if (fd >= 0 && setsockopt(fd, SOL_UDP, UDP_SEGMENT, &segment, sizeof(segment)) == 0) {
+            mode = UDP_EGRESS_GSO;
+        }
+        if (fd >= 0) close(fd);
+    }
+
+    g_atomic_int_set(&egress_mode, mode);
+    return mode;
+}
+
+UdpEgressMode udp_egress_mode(void) {
+    return (UdpEgressMode)g_atomic_int_get(&egress_mode);
+}
+
+const gchar* udp_egress_mode_name(UdpEgressMode mode) {
+    return mode_names[CLAMP(mode, UDP_EGRESS_SENDTO, UDP_EGRESS_GSO)];
+}
+
+gboolean udp_egress_parse_mode(const gchar *name, UdpEgressMode *mode) {
+    for (guint i = 0; i < G_N_ELEMENTS(mode_names); i++) {
+        if (g_strcmp0(name, mode_names[i]) == 0) {
+            *mode = (UdpEgressMode)i;
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/* ===== Batch ===== */
+
+typedef struct {
+    guint first_iov;
+    guint n_iov;
+    gsize size;
+} BatchPacket;
+
+/* Dãy gói gửi thành một message; segment > 0 là GSO */
+typedef struct {
+    guint first_packet;
+    guint n_packets;
+    guint16 segment;
+} BatchRun;
+
+typedef union {
+    char buf[CMSG_SPACE(sizeof(guint16))];
+    struct cmsghdr align;
+} GsoControl;
+
+struct _UdpBatch {
+    GArray *iov;        /* struct iovec */
+    GArray *packets;    /* BatchPacket */
+    GArray *runs;       /* BatchRun */
+    GArray *controls;   /* GsoControl, một cho mỗi run GSO */
+    GArray *msgs;       /* struct mmsghdr */
+    guint64 sent;
+    guint64 syscalls;
+    guint64 dropped;
+};
+
+UdpBatch* udp_batch_new(void) {
+    UdpBatch *batch = g_new0(UdpBatch, 1);
+    batch->iov = g_array_new(FALSE, FALSE, sizeof(struct iovec));
+    batch->packets = g_array_sized_new(FALSE, FALSE, sizeof(BatchPacket), UDP_EGRESS_MAX_PACKETS);
+    batch->runs = g_array_new(FALSE, FALSE, sizeof(BatchRun));
+    batch->controls = g_array_new(FALSE, TRUE, sizeof(GsoControl));
+    batch->msgs = g_array_new(FALSE, TRUE, sizeof(struct mmsghdr));
+    return batch;
+}
+
+void udp_batch_free(UdpBatch *batch) {
+    if (!batch) return;
+    g_array_unref(batch->iov);
+    g_array_unref(batch->packets);
+    g_array_unref(batch->runs);
+    g_array_unref(batch->controls);
+    g_array_unref(batch->msgs);
+    g_free(batch);
+}
+
+gboolean udp_batch_add(UdpBatch *batch, const struct iovec *iov, guint n_iov) {
+    if (batch->packets->len >= UDP_EGRESS_MAX_PACKETS) return FALSE;
+
+    BatchPacket packet = { batch->iov->len, n_iov, 0 };
+    for (guint i = 0; i < n_iov; i++) packet.size += iov[i].iov_len;
+    g_array_append_vals(batch->iov, iov, n_iov);
+    g_array_append_val(batch->packets, packet);
+    return TRUE;
+}
+
+guint udp_batch_count(const UdpBatch *batch) {
+    return batch->packets->len;
+}
+
+void udp_batch_get_stats(const UdpBatch *batch, guint64 *packets, guint64 *syscalls, guint64 *dropped) {
+    if (packets) *packets = batch->sent;
+    if (syscalls) *syscalls = batch->syscalls;
+    if (dropped) *dropped = batch->dropped;
+}
+
+static const BatchPacket* batch_packet(const UdpBatch *batch, guint index) {
+    return &g_array_index(batch->packets, BatchPacket, index);
+}
+
+/* GSO cắt datagram theo segment: mọi gói trong run cùng kích thước, riêng gói cuối được nhỏ hơn.
+ * RTP của một AU thường là vài gói nhỏ (SPS/PPS/STAP-A) rồi một dãy FU-A đúng mtu. */
+static void build_runs(UdpBatch *batch, guint from, gboolean gso) {
+    guint n = batch->packets->len;
+
+    g_array_set_size(batch->runs, 0);
+    for (guint i = from; i < n;) {
+        gsize segment = batch_packet(batch, i)->size;
+        gsize total = segment;
+        guint j = i + 1;
+
+        if (gso && segment <= G_MAXUINT16) {
+            while (j < n && j - i < UDP_EGRESS_GSO_MAX_SEGMENTS &&
+                   batch_packet(batch, j)->size == segment &&
+                   total + segment <= UDP_EGRESS_GSO_MAX_BYTES) {
+                total += segment;
+                j++;
+            }
+            if (j < n && j - i < UDP_EGRESS_GSO_MAX_SEGMENTS &&
+                batch_packet(batch, j)->size < segment &&
+                total + batch_packet(batch, j)->size <= UDP_EGRESS_GSO_MAX_BYTES) {
+                j++;
+            }
+        }
+
+        BatchRun run = { i, j - i, j - i > 1 ? (guint16)segment : 0 };
+        g_array_append_val(batch->runs, run);
+        i = j;
+    }
+
+    g_array_set_size(batch->controls, batch->runs->len);
+    for (guint r = 0; r < batch->runs->len; r++) {
+        BatchRun *run = &g_array_index(batch->runs, BatchRun, r);
+        if (!run->segment) continue;
+
+        GsoControl *control = &g_array_index(batch->controls, GsoControl, r);
+        struct msghdr msg = { .msg_control = control->buf, .msg_controllen = sizeof(control->buf) };
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_UDP;
+        cmsg->cmsg_type = UDP_SEGMENT;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(guint16));
+        memcpy(CMSG_DATA(cmsg), &run->segment, sizeof(guint16));
+    }
+}
+
+/* Message cho các run, lặp lại cho từng đích (iov và control dùng chung giữa các đích) */
+static void build_msgs(UdpBatch *batch, const UdpEgressDest *dests, guint n_dests) {
+    guint n_runs = batch->runs->len;
+
+    g_array_set_size(batch->msgs, 0);
+    g_array_set_size(batch->msgs, n_runs * n_dests);
+    for (guint d = 0; d < n_dests; d++) {
+        for (guint r = 0; r < n_runs; r++) {
+            const BatchRun *run = &g_array_index(batch->runs, BatchRun, r);
+            const BatchPacket *first = batch_packet(batch, run->first_packet);
+            const BatchPacket *last = batch_packet(batch, run->first_packet + run->n_packets - 1);
+            struct msghdr *msg = &g_array_index(batch->msgs, struct mmsghdr, d * n_runs + r).msg_hdr;
+
+            msg->msg_name = (void *)&dests[d].addr;
+            msg->msg_namelen = dests[d].len;
+            msg->msg_iov = &g_array_index(batch->iov, struct iovec, first->first_iov);
+            msg->msg_iovlen = last->first_iov + last->n_iov - first->first_iov;
+            if (run->segment) {
+                msg->msg_control = g_array_index(batch->controls, GsoControl, r).buf;
+                msg->msg_controllen = CMSG_SPACE(sizeof(guint16));
+            }
+        }
+    }
+}
+
+static gboolean wait_writable(int fd) {
+    struct pollfd pfd = { fd, POLLOUT, 0 };
+    return poll(&pfd, 1, SEND_WAIT_MS) > 0;
+}
+
+static gboolean gso_unsupported_error(int err) {
+    return err == EIO || err == EINVAL || err == ENOPROTOOPT || err == EOPNOTSUPP;
+}
+
+/* Gửi msgs; trả về index message đầu tiên chưa gửi nếu GSO bị kernel/NIC từ chối, ngược lại n */
+static guint send_msgs(UdpBatch *batch, int fd, UdpEgressMode mode) {
+    struct mmsghdr *msgs = (struct mmsghdr *)batch->msgs->data;
+    guint n = batch->msgs->len;
+    guint done = 0;
+
+    while (done < n) {
+        int ret;
+        if (mode == UDP_EGRESS_SENDTO) {
+            ssize_t sent = sendmsg(fd, &msgs[done].msg_hdr, 0);
+            ret = sent >= 0 ? 1 : -1;
+        } else {
+            ret = sendmmsg(fd, msgs + done, MIN(n - done, SENDMMSG_MAX_MSGS), 0);
+        }
+        batch->syscalls++;
+
+        if (ret > 0) {
+            done += ret;
+            continue;
+        }
+
+        int err = errno;
+        if (err == EINTR) continue;
+        if (err == EAGAIN || err == EWOULDBLOCK) {
+            if (wait_writable(fd)) continue;
+            break;
+        }
+        if (msgs[done].msg_hdr.msg_control && gso_unsupported_error(err)) {
+            return done;
+        }
+        /* Lỗi riêng của một đích (ICMP unreachable...): bỏ message đó */
+        done++;
+        batch->dropped++;
+    }
+
+    batch->dropped += n - done;
+    return n;
+}
+
+/* Số datagram trong msgs[from, to) */
+static guint count_datagrams(const UdpBatch *batch, guint from, guint to) {
+    guint n_runs = batch->runs->len;
+    guint count = 0;
+    for (guint i = from; i < to; i++) {
+        count += g_array_index(batch->runs, BatchRun, i % n_runs).n_packets;
+    }
+    return count;
+}
+
+guint udp_batch_flush(UdpBatch *batch, int fd, const UdpEgressDest *dests, guint n_dests) {
+    guint sent = 0;
+
+    if (fd < 0 || n_dests == 0 || batch->packets->len == 0) return 0;
+
+    UdpEgressMode mode = udp_egress_mode();
+    build_runs(batch, 0, mode == UDP_EGRESS_GSO);
+    build_msgs(batch, dests, n_dests);
+
+    guint n_runs = batch->runs->len;
+    guint total = batch->msgs->len;
+    guint64 dropped_before = batch->dropped;
+    guint failed_at = send_msgs(batch, fd, mode);
+
+    if (failed_at < total) {
+        /* GSO không dùng được trên đường này: hạ mode cho mọi batch, gửi lại phần còn lại từng gói */
+        int err = errno;
+        if (g_atomic_int_compare_and_exchange(&egress_mode, UDP_EGRESS_GSO, UDP_EGRESS_SENDMMSG)) {
+            g_printerr("[udp] GSO send failed (%s), falling back to sendmmsg\n", g_strerror(err));
+        }
+        sent = count_datagrams(batch, 0, failed_at);
+
+        guint dest = failed_at / n_runs;
+        guint from_packet = g_array_index(batch->runs, BatchRun, failed_at % n_runs).first_packet;
+        guint n_packets = batch->packets->len;
+
+        /* Đích đang dở: từ run lỗi tới hết; các đích sau: toàn bộ */
+        build_runs(batch, from_packet, FALSE);
+        build_msgs(batch, &dests[dest], 1);
+        send_msgs(batch, fd, UDP_EGRESS_SENDMMSG);
+        sent += n_packets - from_packet;
+
+        if (dest + 1 < n_dests) {
+            build_runs(batch, 0, FALSE);
+            build_msgs(batch, &dests[dest + 1], n_dests - dest - 1);
+            send_msgs(batch, fd, UDP_EGRESS_SENDMMSG);
+            sent += n_packets * (n_dests - dest - 1);
+        }
+    } else {
+        sent = count_datagrams(batch, 0, total);
+    }
+
+    /* Message bị bỏ tính theo message; với GSO một message là nhiều datagram nên đây là cận dưới */
+    sent -= MIN(sent, (guint)(batch->dropped - dropped_before));
+    batch->sent += sent;
+    return sent;
+}
+
+void udp_batch_clear(UdpBatch *batch) {
+    g_array_set_size(batch->iov, 0);
+    g_array_set_size(batch->packets, 0);
+}
+
+/* ===== multiudpsink trong media ===== */
+
+typedef struct {
+    GMutex lock;
+    gboolean checked;        /* đã xem caps */
+    gboolean passthrough;    /* không phải RTP video: để multiudpsink gửi */
+    GSocket *socket4;
+    GSocket *socket6;
+    GArray *dests4;          /* UdpEgressDest */
+    GArray *dests6;
+    UdpBatch *batch;
+    GPtrArray *held;         /* GstBuffer giữ tới khi flush */
+    GArray *maps;            /* GstMapInfo của từng GstMemory */
+} EgressSink;
+
+static void egress_sink_release(EgressSink *state) {
+    for (guint i = 0; i < state->maps->len; i++) {
+        GstMapInfo *info = &g_array_index(state->maps, GstMapInfo, i);
+        gst_memory_unmap(info->memory, info);
+    }
+    g_array_set_size(state->maps, 0);
+    g_ptr_array_set_size(state->held, 0);
+}
+
+static void egress_sink_free(gpointer data) {
+    EgressSink *state = data;
+    egress_sink_release(state);
+    udp_batch_free(state->batch);
+    g_ptr_array_unref(state->held);
+    g_array_unref(state->maps);
+    g_array_unref(state->dests4);
+    g_array_unref(state->dests6);
+    if (state->socket4) g_object_unref(state->socket4);
+    if (state->socket6) g_object_unref(state->socket6);
+    g_mutex_clear(&state->lock);
+    g_free(state);
+}
+
+static gboolean dest_from_host(const gchar *host, gint port, UdpEgressDest *dest) {
+    GInetAddress *addr = g_inet_address_new_from_string(host);
+    if (!addr) return FALSE;
+
+    GSocketAddress *sockaddr = g_inet_socket_address_new(addr, port);
+    memset(dest, 0, sizeof(*dest));
+    gboolean ok = g_socket_address_to_native(sockaddr, &dest->addr, sizeof(dest->addr), NULL);
+    dest->len = g_socket_address_get_native_size(sockaddr);
+    dest->refs = 1;
+    g_object_unref(sockaddr);
+    g_object_unref(addr);
+    return ok;
+}
+
+static GArray* dest_array(EgressSink *state, const UdpEgressDest *dest) {
+    return dest->addr.ss_family == AF_INET6 ? state->dests6 : state->dests4;
+}
+
+static gint find_dest(GArray *dests, const UdpEgressDest *dest) {
+    for (guint i = 0; i < dests->len; i++) {
+        const UdpEgressDest *d = &g_array_index(dests, UdpEgressDest, i);
+        if (d->len == dest->len && memcmp(&d->addr, &dest->addr, dest->len) == 0) return i;
+    }
+    return -1;
+}
+
+static void egress_add_client(EgressSink *state, const gchar *host, gint port) {
+    UdpEgressDest dest;
+    if (!dest_from_host(host, port, &dest)) return;
+
+    g_mutex_lock(&state->lock);
+    GArray *dests = dest_array(state, &dest);
+    gint index = find_dest(dests, &dest);
+    if (index >= 0) {
+        g_array_index(dests, UdpEgressDest, index).refs++;
+    } else {
+        g_array_append_val(dests, dest);
+    }
+    g_mutex_unlock(&state->lock);
+}
+
+static void on_client_added(GstElement *sink, const gchar *host, gint port, gpointer user_data) {
+    egress_add_client(user_data, host, port);
+}
+
+static void on_client_removed(GstElement *sink, const gchar *host, gint port, gpointer user_data) {
+    EgressSink *state = user_data;
+    UdpEgressDest dest;
+    if (!dest_from_host(host, port, &dest)) return;
+
+    g_mutex_lock(&state->lock);
+    GArray *dests = dest_array(state, &dest);
+    gint index = find_dest(dests, &dest);
+    if (index >= 0 && --g_array_index(dests, UdpEgressDest, index).refs == 0) {
+        g_array_remove_index_fast(dests, index);
+    }
+    g_mutex_unlock(&state->lock);
+}
+
+/* Client đã add trước khi attach: "host:port,host:port" (IPv6 host có dấu ':', tách ở ':' cuối) */
+static void seed_clients(EgressSink *state, GstElement *sink) {
+    gchar *clients = NULL;
+    g_object_get(sink, "clients", &clients, NULL);
+    if (!clients) return;
+
+    gchar **entries = g_strsplit(clients, ",", -1);
+    for (gint i = 0; entries[i]; i++) {
+        gchar *colon = strrchr(entries[i], ':');
+        if (!colon || colon == entries[i]) continue;
+        *colon = '\0';
+        egress_add_client(state, entries[i], atoi(colon + 1));
+    }
+    g_strfreev(entries);
+    g_free(clients);
+}
+
+static void flush_locked(EgressSink *state) {
+    if (state->dests4->len > 0 && state->socket4) {
+        udp_batch_flush(state->batch, g_socket_get_fd(state->socket4),
+                        (UdpEgressDest *)state->dests4->data, state->dests4->len);
+    }
+    if (state->dests6->len > 0 && state->socket6) {
+        udp_batch_flush(state->batch, g_socket_get_fd(state->socket6),
+                        (UdpEgressDest *)state->dests6->data, state->dests6->len);
+    }
+    udp_batch_clear(state->batch);
+    egress_sink_release(state);
+}
+
+/* Bỏ các gói đang giữ mà không gửi (flush/seek: gói cũ không còn hợp lệ) */
+static void drop_locked(EgressSink *state) {
+    udp_batch_clear(state->batch);
+    egress_sink_release(state);
+}
+
+/* Giữ buffer: map từng GstMemory (không gộp/copy) và thêm thành một gói */
+static void queue_buffer(EgressSink *state, GstBuffer *buffer) {
+    guint n_mem = gst_buffer_n_memory(buffer);
+    struct iovec iov[16];
+
+    if (n_mem == 0 || n_mem > G_N_ELEMENTS(iov)) return;
+
+    guint first_map = state->maps->len;
+    for (guint i = 0; i < n_mem; i++) {
+        GstMapInfo info;
+        if (!gst_memory_map(gst_buffer_peek_memory(buffer, i), &info, GST_MAP_READ)) {
+            for (guint j = first_map; j < state->maps->len; j++) {
+                GstMapInfo *held = &g_array_index(state->maps, GstMapInfo, j);
+                gst_memory_unmap(held->memory, held);
+            }
+            g_array_set_size(state->maps, first_map);
+            return;
+        }
+        g_array_append_val(state->maps, info);
+        iov[i].iov_base = info.data;
+        iov[i].iov_len = info.size;
+    }
+
+    g_ptr_array_add(state->held, gst_buffer_ref(buffer));
+    udp_batch_add(state->batch, iov, n_mem);
+}
+
+static gboolean buffer_has_marker(GstBuffer *buffer) {
+    guint8 b = 0;
+    return gst_buffer_extract(buffer, 1, &b, 1) == 1 && (b & 0x80);
+}
+
+static void check_sink(EgressSink *state, GstPad *pad) {
+    GstCaps *caps = gst_pad_get_current_caps(pad);
+    GstElement *sink = gst_pad_get_parent_element(pad);
+
+    state->checked = TRUE;
+    state->passthrough = TRUE;
+    if (caps && sink) {
+        const GstStructure *s = gst_caps_get_structure(caps, 0);
+        state->passthrough = !gst_structure_has_name(s, "application/x-rtp") ||
+                             g_strcmp0(gst_structure_get_string(s, "media"), "video") != 0;
+        /* Socket multiudpsink đang dùng (của GstRTSPStream hoặc tự tạo lúc start) */
+        if (!state->passthrough) {
+            g_object_get(sink, "used-socket", &state->socket4, "used-socket-v6", &state->socket6, NULL);
+            state->passthrough = !state->socket4 && !state->socket6;
+        }
+    }
+    if (caps) gst_caps_unref(caps);
+    if (sink) gst_object_unref(sink);
+}
+
+static gboolean queue_list_item(GstBuffer **buffer, guint idx, gpointer user_data) {
+    EgressSink *state = user_data;
+    if (udp_batch_count(state->batch) >= UDP_EGRESS_MAX_PACKETS) flush_locked(state);
+    queue_buffer(state, *buffer);
+    return TRUE;
+}
+
+static GstPadProbeReturn egress_probe(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    EgressSink *state = user_data;
+
+    if (info->type & (GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM | GST_PAD_PROBE_TYPE_EVENT_FLUSH)) {
+        GstEvent *event = GST_PAD_PROBE_INFO_EVENT(info);
+        g_mutex_lock(&state->lock);
+        switch (GST_EVENT_TYPE(event)) {
+            case GST_EVENT_FLUSH_START:
+            case GST_EVENT_FLUSH_STOP:
+                drop_locked(state);
+                break;
+            case GST_EVENT_EOS:
+                /* AU cuối có thể không có marker */
+                if (udp_batch_count(state->batch) > 0) flush_locked(state);
+                break;
+            default:
+                break;
+        }
+        g_mutex_unlock(&state->lock);
+        return GST_PAD_PROBE_OK;
+    }
+
+    g_mutex_lock(&state->lock);
+    if (!state->checked) check_sink(state, pad);
+    if (state->passthrough) {
+        g_mutex_unlock(&state->lock);
+        return GST_PAD_PROBE_OK;
+    }
+
+    if (info->type & GST_PAD_PROBE_TYPE_BUFFER_LIST) {
+        gst_buffer_list_foreach(GST_PAD_PROBE_INFO_BUFFER_LIST(info), queue_list_item, state);
+        if (udp_batch_count(state->batch) > 0) {
+            GstBufferList *list = GST_PAD_PROBE_INFO_BUFFER_LIST(info);
+            if (buffer_has_marker(gst_buffer_list_get(list, gst_buffer_list_length(list) - 1))) {
+                flush_locked(state);
+            }
+        }
+    } else {
+        GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+        if (udp_batch_count(state->batch) >= UDP_EGRESS_MAX_PACKETS) flush_locked(state);
+        queue_buffer(state, buffer);
+        /* Hết access unit: gửi cả AU cho mọi client */
+        if (buffer_has_marker(buffer)) flush_locked(state);
+    }
+    g_mutex_unlock(&state->lock);
+
+    /* Đã gửi (hoặc đang giữ) - multiudpsink không gửi lại */
+    return GST_PAD_PROBE_DROP;
+}
+
+static void attach_sink(GstElement *sink) {
+    GstElementFactory *factory = gst_element_get_factory(sink);
+    if (!factory || g_strcmp0(gst_plugin_feature_get_name(GST_PLUGIN_FEATURE(factory)), "multiudpsink") != 0) {
+        return;
+    }
+    if (g_object_get_data(G_OBJECT(sink), "udp-egress")) return;
+
+    EgressSink *state = g_new0(EgressSink, 1);
+    g_mutex_init(&state->lock);
+    state->dests4 = g_array_new(FALSE, FALSE, sizeof(UdpEgressDest));
+    state->dests6 = g_array_new(FALSE, FALSE, sizeof(UdpEgressDest));
+    state->batch = udp_batch_new();
+    state->held = g_ptr_array_new_with_free_func((GDestroyNotify)gst_buffer_unref);
+    state->maps = g_array_new(FALSE, FALSE, sizeof(GstMapInfo));
+    g_object_set_data(G_OBJECT(sink), "udp-egress", state);
+
+    g_signal_connect(sink, "client-added", G_CALLBACK(on_client_added), state);
+    g_signal_connect(sink, "client-removed", G_CALLBACK(on_client_removed), state);
+    seed_clients(state, sink);
+
+    GstPad *pad = gst_element_get_static_pad(sink, "sink");
+    gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST |
+                      GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM | GST_PAD_PROBE_TYPE_EVENT_FLUSH,
+                      egress_probe, state, egress_sink_free);
+    gst_object_unref(pad);
+}
+
+static void on_deep_element_added(GstBin *bin, GstBin *sub_bin, GstElement *element, gpointer user_data) {
+    attach_sink(element);
+}
+
+static void attach_existing(const GValue *value, gpointer user_data) {
+    attach_sink(g_value_get_object(value));
+}
+
+void udp_egress_attach_media(GstRTSPMedia *media) {
+    /* Không có sendmmsg thì batch không lợi gì hơn multiudpsink */
+    if (udp_egress_mode() == UDP_EGRESS_SENDTO) return;
+
+    GstElement *element = gst_rtsp_media_get_element(media);
+    GstObject *pipeline = gst_object_get_parent(GST_OBJECT(element));
+    gst_object_unref(element);
+    if (!pipeline) return;
+
+    /* multiudpsink do GstRTSPStream thêm vào pipeline khi prepare / SETUP */
+    g_signal_connect(pipeline, "deep-element-added", G_CALLBACK(on_deep_element_added), NULL);
+
+    GstIterator *it = gst_bin_iterate_recurse(GST_BIN(pipeline));
+    gst_iterator_foreach(it, attach_existing, NULL);
+    gst_iterator_free(it);
+    gst_object_unref(pipeline);
+}
@@ -0,0 +1,61 @@
+#ifndef UDP_EGRESS_H
+#define UDP_EGRESS_H
+
+#include <gst/gst.h>
+#include <gst/rtsp-server/rtsp-server.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+/* Gói chờ tối đa trong một batch (một access unit 1080p ~ 100 gói 1400 byte) */
+#define UDP_EGRESS_MAX_PACKETS       256
+/* Giới hạn UDP GSO của kernel: UDP_MAX_SEGMENTS và payload tối đa một datagram */
+#define UDP_EGRESS_GSO_MAX_SEGMENTS  64
+#define UDP_EGRESS_GSO_MAX_BYTES     65000
+
+/* Cách gửi, theo thứ tự khả năng kernel */
+typedef enum {
+    UDP_EGRESS_SENDTO,     /* một syscall mỗi gói mỗi client */
+    UDP_EGRESS_SENDMMSG,   /* cả access unit cho mọi client trong một sendmmsg */
+    UDP_EGRESS_GSO         /* sendmmsg + UDP_SEGMENT: một message cho mỗi dãy gói cùng kích thước */
+} UdpEgressMode;
+
+/* Đích gửi (địa chỉ native cho msg_name) */
+typedef struct {
+    struct sockaddr_storage addr;
+    socklen_t len;
+    guint refs;            /* multiudpsink cho phép add cùng client nhiều lần */
+} UdpEgressDest;
+
+/* Dò sendmmsg/UDP_SEGMENT; mode thực tế là mode cao nhất <= requested mà kernel hỗ trợ.
+ * Nếu gửi GSO lỗi lúc chạy (ví dụ NIC không có checksum offload) thì tự hạ xuống SENDMMSG. */
+UdpEgressMode udp_egress_init(UdpEgressMode requested);
+UdpEgressMode udp_egress_mode(void);
+const gchar* udp_egress_mode_name(UdpEgressMode mode);
+gboolean udp_egress_parse_mode(const gchar *name, UdpEgressMode *mode);
+
+/* Batch gói của một access unit, gửi tới nhiều đích trong ít syscall nhất */
+typedef struct _UdpBatch UdpBatch;
+
+UdpBatch* udp_batch_new(void);
+void udp_batch_free(UdpBatch *batch);
+
+/* Thêm một gói gồm n_iov mảnh; dữ liệu phải còn hợp lệ tới khi flush. FALSE nếu batch đầy */
+gboolean udp_batch_add(UdpBatch *batch, const struct iovec *iov, guint n_iov);
+guint udp_batch_count(const UdpBatch *batch);
+
+/* Gửi mọi gói tới mọi đích; trả về số datagram (gói x đích) đã gửi. Batch giữ nguyên
+ * (có thể flush tiếp qua socket IPv6), gọi udp_batch_clear khi xong.
+ * Socket non-blocking: chờ tối đa 100 ms khi buffer gửi đầy, sau đó bỏ phần còn lại. */
+guint udp_batch_flush(UdpBatch *batch, int fd, const UdpEgressDest *dests, guint n_dests);
+void udp_batch_clear(UdpBatch *batch);
+
+/* Bộ đếm cộng dồn của batch */
+void udp_batch_get_stats(const UdpBatch *batch, guint64 *packets, guint64 *syscalls, guint64 *dropped);
+
+/* Gửi RTP video của các multiudpsink trong media qua batch: gói được giữ tới bit marker
+ * (hết access unit) rồi flush một lần cho mọi client. RTCP và audio đi đường cũ.
+ * Chỉ cho media live: gói đi trước bước sync của multiudpsink, media không live (playback,
+ * clip, DVR) sẽ mất pacing theo clock. Flush/seek bỏ batch đang giữ, EOS gửi nốt. */
+void udp_egress_attach_media(GstRTSPMedia *media);
+
+#endif // UDP_EGRESS_H
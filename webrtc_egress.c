@@ -0,0 +1,422 @@
+#define GST_USE_UNSTABLE_API
+#include "webrtc_egress.h"
+#include "http_control.h"
+#include "server_context.h"
+#include "camera_probe.h"
+#include <gst/gst.h>
+#include <gst/sdp/sdp.h>
+#include <gst/webrtc/webrtc.h>
+#include <json-glib/json-glib.h>
+
+#define WEBRTC_RTP_CAPS \
+    "application/x-rtp,media=video,encoding-name=H264,payload=96,clock-rate=90000"
+
+/* Một pipeline cho mỗi camera: ingest + packetize một lần, tee ra các peer */
+typedef struct {
+    gchar *camera_name;
+    GstElement *pipeline;
+    GstElement *tee;
+    GList *peers;             /* WebRtcPeer*, chỉ truy cập trên main context */
+} WebRtcSource;
+
+typedef struct {
+    WebRtcSource *source;
+    SoupWebsocketConnection *ws;
+    GstElement *queue;
+    GstElement *webrtc;
+    GstPad *tee_pad;
+    gboolean closed;
+} WebRtcPeer;
+
+typedef struct {
+    WebRtcPeer *peer;
+    gchar *text;
+} PeerMessage;
+
+static GHashTable *sources = NULL;   /* camera name -> WebRtcSource* */
+
+/* ===== Peer refcount / signaling ===== */
+
+static WebRtcPeer* peer_ref(WebRtcPeer *peer) {
+    return g_atomic_rc_box_acquire(peer);
+}
+
+static void peer_clear(gpointer data) {
+    WebRtcPeer *peer = data;
+    if (peer->ws) {
+        g_signal_handlers_disconnect_by_data(peer->ws, peer);
+        g_clear_object(&peer->ws);
+    }
+}
+
+static void peer_unref(WebRtcPeer *peer) {
+    g_atomic_rc_box_release_full(peer, peer_clear);
+}
+
+static gboolean send_message_idle(gpointer data) {
+    PeerMessage *message = data;
+    WebRtcPeer *peer = message->peer;
+
+    if (!peer->closed && peer->ws &&
+        soup_websocket_connection_get_state(peer->ws) == SOUP_WEBSOCKET_STATE_OPEN) {
+        soup_websocket_connection_send_text(peer->ws, message->text);
+    }
+
+    peer_unref(peer);
+    g_free(message->text);
+    g_free(message);
+    return G_SOURCE_REMOVE;
+}
+
+/* Gửi JSON từ thread bất kỳ (callback webrtcbin chạy trên streaming thread) */
+static void peer_send(WebRtcPeer *peer, JsonBuilder *builder) {
+    JsonGenerator *generator = json_generator_new();
+    JsonNode *root = json_builder_get_root(builder);
+    json_generator_set_root(generator, root);
+
+    PeerMessage *message = g_new0(PeerMessage, 1);
+    message->peer = peer_ref(peer);
+    message->text = json_generator_to_data(generator, NULL);
+
+    json_node_unref(root);
+    g_object_unref(generator);
+    g_main_context_invoke(NULL, send_message_idle, message);
+}
+
+static void on_offer_created(GstPromise *promise, gpointer user_data) {
+    WebRtcPeer *peer = user_data;
+    GstWebRTCSessionDescription *offer = NULL;
+
+    const GstStructure *reply = gst_promise_get_reply(promise);
+    if (reply) {
+        gst_structure_get(reply, "offer", GST_TYPE_WEBRTC_SESSION_DESCRIPTION, &offer, NULL);
+    }
+    gst_promise_unref(promise);
+
+    if (!offer) {
+        g_printerr("[webrtc] Failed to create offer\n");
+        peer_unref(peer);
+        return;
+    }
+
+    g_signal_emit_by_name(peer->webrtc, "set-local-description", offer, NULL);
+
+    gchar *sdp = gst_sdp_message_as_text(offer->sdp);
+    JsonBuilder *builder = json_builder_new();
+    json_builder_begin_object(builder);
+    json_builder_set_member_name(builder, "type");
+    json_builder_add_string_value(builder, "offer");
+    json_builder_set_member_name(builder, "sdp");
+    json_builder_add_string_value(builder, sdp);
+    json_builder_end_object(builder);
+    peer_send(peer, builder);
+    g_object_unref(builder);
+
+    g_free(sdp);
+    gst_webrtc_session_description_free(offer);
+    peer_unref(peer);
+}
+
+static void on_negotiation_needed(GstElement *webrtc, gpointer user_data) {
+    WebRtcPeer *peer = user_data;
+    GstPromise *promise = gst_promise_new_with_change_func(on_offer_created, peer_ref(peer), NULL);
+    g_signal_emit_by_name(webrtc, "create-offer", NULL, promise);
+}
+
+static void on_ice_candidate(GstElement *webrtc, guint mline, gchar *candidate, gpointer user_data) {
+    WebRtcPeer *peer = user_data;
+    JsonBuilder *builder = json_builder_new();
+
+    json_builder_begin_object(builder);
+    json_builder_set_member_name(builder, "type");
+    json_builder_add_string_value(builder, "ice");
+    json_builder_set_member_name(builder, "candidate");
+    json_builder_add_string_value(builder, candidate);
+    json_builder_set_member_name(builder, "sdpMLineIndex");
+    json_builder_add_int_value(builder, mline);
+    json_builder_end_object(builder);
+
+    peer_send(peer, builder);
+    g_object_unref(builder);
+}
+
+static void peer_handle_message(WebRtcPeer *peer, const gchar *text) {
+    JsonParser *parser = json_parser_new();
+
+    if (!json_parser_load_from_data(parser, text, -1, NULL) ||
+        !JSON_NODE_HOLDS_OBJECT(json_parser_get_root(parser))) {
+        g_printerr("[webrtc] Invalid signaling message\n");
+        g_object_unref(parser);
+        return;
+    }
+
+    JsonObject *object = json_node_get_object(json_parser_get_root(parser));
+    const gchar *type = json_object_get_string_member_with_default(object, "type", "");
+
+    if (g_strcmp0(type, "answer") == 0) {
+        GstSDPMessage *sdp = NULL;
+        const gchar *text_sdp = json_object_get_string_member_with_default(object, "sdp", "");
+        if (gst_sdp_message_new_from_text(text_sdp, &sdp) == GST_SDP_OK) {
+            GstWebRTCSessionDescription *answer =
+                gst_webrtc_session_description_new(GST_WEBRTC_SDP_TYPE_ANSWER, sdp);
+            g_signal_emit_by_name(peer->webrtc, "set-remote-description", answer, NULL);
+            gst_webrtc_session_description_free(answer);
+        } else {
+            g_printerr("[webrtc] Invalid SDP answer\n");
+        }
+    } else if (g_strcmp0(type, "ice") == 0) {
+        const gchar *candidate = json_object_get_string_member_with_default(object, "candidate", NULL);
+        gint64 mline = json_object_get_int_member_with_default(object, "sdpMLineIndex", 0);
+        if (candidate && candidate[0]) {
+            g_signal_emit_by_name(peer->webrtc, "add-ice-candidate", (guint)mline, candidate);
+        }
+    }
+
+    g_object_unref(parser);
+}
+
+/* ===== Source pipeline ===== */
+
+static gboolean source_bus_cb(GstBus *bus, GstMessage *msg, gpointer user_data) {
+    WebRtcSource *source = user_data;
+
+    if (GST_MESSAGE_TYPE(msg) == GST_MESSAGE_ERROR) {
+        GError *err = NULL;
+        gst_message_parse_error(msg, &err, NULL);
+        g_printerr("[webrtc] %s: %s\n", source->camera_name, err->message);
+        g_error_free(err);
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+static WebRtcSource* source_get(CameraConfig *cam) {
+    WebRtcSource *source = g_hash_table_lookup(sources, cam->name);
+    if (source) return source;
+
+    /* Passthrough H.264, payload một lần; tee không chặn khi chưa có peer */
+    gchar *launch = g_strdup_printf(
+        "rtspsrc location=%s protocols=tcp latency=100 buffer-mode=none drop-on-latency=true ! "
+        "rtph264depay ! h264parse config-interval=-1 ! "
+        "rtph264pay config-interval=-1 pt=96 aggregate-mode=zero-latency mtu=1200 ! "
+        WEBRTC_RTP_CAPS " ! tee name=t allow-not-linked=true",
+        cam->rtsp_url_main);
+    GError *error = NULL;
+    GstElement *pipeline = gst_parse_launch(launch, &error);
+    g_free(launch);
+
+    if (error) {
+        g_printerr("[webrtc] Pipeline error: %s\n", error->message);
+        g_error_free(error);
+        if (pipeline) gst_object_unref(pipeline);
+        return NULL;
+    }
+
+    source = g_new0(WebRtcSource, 1);
+    source->camera_name = g_strdup(cam->name);
+    source->pipeline = pipeline;
+    source->tee = gst_bin_get_by_name(GST_BIN(pipeline), "t");
+
+    GstBus *bus = gst_pipeline_get_bus(GST_PIPELINE(pipeline));
+    gst_bus_add_watch(bus, source_bus_cb, source);
+    gst_object_unref(bus);
+
+    g_hash_table_insert(sources, source->camera_name, source);
+    return source;
+}
+
+static void source_free(gpointer data) {
+    WebRtcSource *source = data;
+
+    gst_element_set_state(source->pipeline, GST_STATE_NULL);
+    g_list_free_full(source->peers, (GDestroyNotify)peer_unref);
+
+    GstBus *bus = gst_pipeline_get_bus(GST_PIPELINE(source->pipeline));
+    gst_bus_remove_watch(bus);
+    gst_object_unref(bus);
+
+    gst_object_unref(source->tee);
+    gst_object_unref(source->pipeline);
+    g_free(source->camera_name);
+    g_free(source);
+}
+
+static gboolean peer_add(WebRtcSource *source, WebRtcPeer *peer) {
+    peer->queue = gst_element_factory_make("queue", NULL);
+    peer->webrtc = gst_element_factory_make("webrtcbin", NULL);
+    if (!peer->queue || !peer->webrtc) {
+        g_printerr("[webrtc] Failed to create peer elements\n");
+        g_clear_object(&peer->queue);
+        g_clear_object(&peer->webrtc);
+        return FALSE;
+    }
+
+    g_object_set(peer->queue,
+                 "leaky", 2,
+                 "max-size-buffers", 0,
+                 "max-size-bytes", 0,
+                 "max-size-time", (guint64)WEBRTC_PEER_QUEUE_TIME_NS,
+                 NULL);
+    /* Không STUN/TURN: chỉ host candidate trên LAN */
+    gst_util_set_object_arg(G_OBJECT(peer->webrtc), "bundle-policy", "max-bundle");
+
+    g_signal_connect(peer->webrtc, "on-negotiation-needed", G_CALLBACK(on_negotiation_needed), peer);
+    g_signal_connect(peer->webrtc, "on-ice-candidate", G_CALLBACK(on_ice_candidate), peer);
+
+    gst_bin_add_many(GST_BIN(source->pipeline), peer->queue, peer->webrtc, NULL);
+
+    GstPad *webrtc_sink = gst_element_request_pad_simple(peer->webrtc, "sink_%u");
+    GstPad *queue_src = gst_element_get_static_pad(peer->queue, "src");
+    gst_pad_link(queue_src, webrtc_sink);
+    gst_object_unref(queue_src);
+
+    /* Chỉ gửi, codec cố định theo caps RTP của tee */
+    GstWebRTCRTPTransceiver *transceiver = NULL;
+    g_object_get(webrtc_sink, "transceiver", &transceiver, NULL);
+    if (transceiver) {
+        GstCaps *caps = gst_caps_from_string(WEBRTC_RTP_CAPS);
+        g_object_set(transceiver,
+                     "direction", GST_WEBRTC_RTP_TRANSCEIVER_DIRECTION_SENDONLY,
+                     "codec-preferences", caps,
+                     NULL);
+        gst_caps_unref(caps);
+        gst_object_unref(transceiver);
+    }
+    gst_object_unref(webrtc_sink);
+
+    gst_element_sync_state_with_parent(peer->webrtc);
+    gst_element_sync_state_with_parent(peer->queue);
+
+    peer->tee_pad = gst_element_request_pad_simple(source->tee, "src_%u");
+    GstPad *queue_sink = gst_element_get_static_pad(peer->queue, "sink");
+    gst_pad_link(peer->tee_pad, queue_sink);
+    gst_object_unref(queue_sink);
+
+    source->peers = g_list_append(source->peers, peer);
+    if (g_list_length(source->peers) == 1) {
+        gst_element_set_state(source->pipeline, GST_STATE_PLAYING);
+    }
+
+    g_print("[webrtc] %s: peer added (%u peers)\n",
+            source->camera_name, g_list_length(source->peers));
+    return TRUE;
+}
+
+static gboolean peer_teardown_idle(gpointer data) {
+    WebRtcPeer *peer = data;
+    WebRtcSource *source = peer->source;
+
+    gst_element_set_state(peer->webrtc, GST_STATE_NULL);
+    gst_element_set_state(peer->queue, GST_STATE_NULL);
+    gst_bin_remove_many(GST_BIN(source->pipeline), peer->webrtc, peer->queue, NULL);
+    peer->webrtc = NULL;
+    peer->queue = NULL;
+
+    source->peers = g_list_remove(source->peers, peer);
+    g_print("[webrtc] %s: peer removed (%u peers)\n",
+            source->camera_name, g_list_length(source->peers));
+
+    /* Không còn peer: dừng ingest của camera */
+    if (!source->peers) {
+        g_hash_table_remove(sources, source->camera_name);
+    }
+
+    peer_unref(peer);
+    return G_SOURCE_REMOVE;
+}
+
+/* Tee pad idle: tháo link an toàn rồi dọn element trên main context */
+static GstPadProbeReturn tee_pad_idle(GstPad *pad, GstPadProbeInfo *info, gpointer user_data) {
+    WebRtcPeer *peer = user_data;
+    WebRtcSource *source = peer->source;
+    GstPad *queue_sink = gst_element_get_static_pad(peer->queue, "sink");
+
+    gst_pad_unlink(pad, queue_sink);
+    gst_object_unref(queue_sink);
+    gst_element_release_request_pad(source->tee, pad);
+    gst_object_unref(pad);
+
+    g_main_context_invoke(NULL, peer_teardown_idle, peer);
+    return GST_PAD_PROBE_REMOVE;
+}
+
+static void on_ws_message(SoupWebsocketConnection *ws, gint type, GBytes *message, gpointer user_data) {
+    if (type != SOUP_WEBSOCKET_DATA_TEXT) return;
+
+    gsize size;
+    const gchar *data = g_bytes_get_data(message, &size);
+    gchar *text = g_strndup(data, size);
+    peer_handle_message(user_data, text);
+    g_free(text);
+}
+
+static void on_ws_closed(SoupWebsocketConnection *ws, gpointer user_data) {
+    WebRtcPeer *peer = user_data;
+
+    if (peer->closed) return;
+    peer->closed = TRUE;
+
+    /* peer giữ ref tới khi teardown xong */
+    gst_pad_add_probe(peer->tee_pad, GST_PAD_PROBE_TYPE_IDLE, tee_pad_idle, peer, NULL);
+    peer->tee_pad = NULL;
+}
+
+static void on_websocket(SoupServer *server, SoupServerMessage *msg, const char *path,
+                         SoupWebsocketConnection *ws, gpointer user_data) {
+    gchar *camera_name = http_control_path_tail(path, WEBRTC_SIGNALING_PATH);
+    CameraConfig *cam = camera_name ? find_camera(camera_name) : NULL;
+
+    if (!cam || camera_resolve_codec(cam, TRUE) != CODEC_H264) {
+        /* WebRTC không transcode: chỉ camera H.264 */
+        g_printerr("[webrtc] Rejecting %s: unknown camera or not H.264\n", path);
+        soup_websocket_connection_close(ws, SOUP_WEBSOCKET_CLOSE_POLICY_VIOLATION,
+                                        "unknown camera or codec not H.264");
+        g_free(camera_name);
+        return;
+    }
+    g_free(camera_name);
+
+    WebRtcSource *source = source_get(cam);
+    if (!source) {
+        soup_websocket_connection_close(ws, SOUP_WEBSOCKET_CLOSE_SERVER_ERROR, "pipeline error");
+        return;
+    }
+
+    WebRtcPeer *peer = g_atomic_rc_box_new0(WebRtcPeer);
+    peer->source = source;
+    peer->ws = g_object_ref(ws);
+
+    if (!peer_add(source, peer)) {
+        soup_websocket_connection_close(ws, SOUP_WEBSOCKET_CLOSE_SERVER_ERROR, "peer error");
+        if (!source->peers) g_hash_table_remove(sources, source->camera_name);
+        peer_unref(peer);
+        return;
+    }
+
+    g_signal_connect(ws, "message", G_CALLBACK(on_ws_message), peer);
+    g_signal_connect(ws, "closed", G_CALLBACK(on_ws_closed), peer);
+}
+
+void webrtc_egress_init(void) {
+    if (!sources) {
+        sources = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, source_free);
+    }
+    http_control_add_websocket_handler(WEBRTC_SIGNALING_PATH, on_websocket, NULL);
+}
+
+static void source_close_peers(gpointer key, gpointer value, gpointer user_data) {
+    WebRtcSource *source = value;
+
+    /* Pipeline dừng cùng source: không cần IDLE probe */
+    for (GList *l = source->peers; l; l = l->next) {
+        WebRtcPeer *peer = l->data;
+        peer->closed = TRUE;
+        soup_websocket_connection_close(peer->ws, SOUP_WEBSOCKET_CLOSE_GOING_AWAY, NULL);
+    }
+}
+
+void webrtc_egress_shutdown(void) {
+    if (sources) {
+        g_hash_table_foreach(sources, source_close_peers, NULL);
+        g_hash_table_remove_all(sources);
+    }
+}
@@ -0,0 +1,22 @@
+#ifndef WEBRTC_EGRESS_H
+#define WEBRTC_EGRESS_H
+
+#include <glib.h>
+
+/* Signaling WebSocket: ws://<host>:HTTP_CONTROL_PORT/webrtc/<camera>
+ *   server -> client: {"type":"offer","sdp":"..."}
+ *   client -> server: {"type":"answer","sdp":"..."}
+ *   hai chiều:        {"type":"ice","candidate":"...","sdpMLineIndex":0}
+ * Chỉ dùng host candidate (LAN, không STUN/TURN). */
+#define WEBRTC_SIGNALING_PATH "/webrtc"
+
+/* Giới hạn hàng đợi riêng của mỗi peer (peer chậm không kéo các peer khác) */
+#define WEBRTC_PEER_QUEUE_TIME_NS (500 * GST_MSECOND)
+
+/* Đăng ký route signaling trên http_control */
+void webrtc_egress_init(void);
+
+/* Dừng tất cả pipeline WebRTC */
+void webrtc_egress_shutdown(void);
+
+#endif // WEBRTC_EGRESS_H